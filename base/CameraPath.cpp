@@ -0,0 +1,155 @@
+#include "CameraPath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+#include <json.hpp>
+
+#include "camera.hpp"
+
+namespace vks
+{
+	namespace
+	{
+		glm::vec3 unwrapAngles(const glm::vec3& angles, const glm::vec3& reference)
+		{
+			glm::vec3 result = angles;
+			for (int i = 0; i < 3; i++)
+			{
+				result[i] -= 360.0f * std::round((result[i] - reference[i]) / 360.0f);
+			}
+			return result;
+		}
+
+		// 非均匀时间的Catmull-Rom：切线按相邻关键帧的时间差算，关键帧间隔不等时速度也连续
+		glm::vec3 hermite(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& m0, const glm::vec3& m1, float t, float dt)
+		{
+			const float t2 = t * t;
+			const float t3 = t2 * t;
+			return (2.0f * t3 - 3.0f * t2 + 1.0f) * p0 + (t3 - 2.0f * t2 + t) * dt * m0 + (-2.0f * t3 + 3.0f * t2) * p1 + (t3 - t2) * dt * m1;
+		}
+
+		template <typename Member>
+		glm::vec3 tangent(const std::vector<CameraPath::Keyframe>& keyframes, size_t i, Member member)
+		{
+			const size_t prev = i > 0 ? i - 1 : i;
+			const size_t next = std::min(i + 1, keyframes.size() - 1);
+			const float dt = keyframes[next].time - keyframes[prev].time;
+			return dt > 0.0f ? (keyframes[next].*member - keyframes[prev].*member) / dt : glm::vec3(0.0f);
+		}
+
+		nlohmann::json vec3ToJson(const glm::vec3& v)
+		{
+			return nlohmann::json::array({v.x, v.y, v.z});
+		}
+
+		glm::vec3 jsonToVec3(const nlohmann::json& j)
+		{
+			return glm::vec3(j.at(0).get<float>(), j.at(1).get<float>(), j.at(2).get<float>());
+		}
+	}
+
+	void CameraPath::addKeyframe(float time, const glm::vec3& position, const glm::vec3& rotation)
+	{
+		if (!keyframes.empty() && time <= keyframes.back().time)
+		{
+			return;
+		}
+		Keyframe keyframe;
+		keyframe.time = time;
+		keyframe.position = position;
+		keyframe.rotation = keyframes.empty() ? rotation : unwrapAngles(rotation, keyframes.back().rotation);
+		keyframes.push_back(keyframe);
+	}
+
+	void CameraPath::record(const Camera& camera, float time, float minInterval)
+	{
+		if (!keyframes.empty() && time - keyframes.back().time < minInterval)
+		{
+			return;
+		}
+		addKeyframe(time, camera.position, camera.rotation);
+	}
+
+	CameraPath::Keyframe CameraPath::sample(float time) const
+	{
+		if (keyframes.empty())
+		{
+			return Keyframe{};
+		}
+		if (time <= keyframes.front().time)
+		{
+			return keyframes.front();
+		}
+		if (time >= keyframes.back().time)
+		{
+			return keyframes.back();
+		}
+
+		const auto upper = std::upper_bound(keyframes.begin(), keyframes.end(), time, [](float t, const Keyframe& keyframe) { return t < keyframe.time; });
+		const size_t i1 = static_cast<size_t>(upper - keyframes.begin());
+		const size_t i0 = i1 - 1;
+		const Keyframe& k0 = keyframes[i0];
+		const Keyframe& k1 = keyframes[i1];
+		const float dt = k1.time - k0.time;
+		const float t = (time - k0.time) / dt;
+
+		Keyframe result;
+		result.time = time;
+		result.position = hermite(k0.position, k1.position, tangent(keyframes, i0, &Keyframe::position), tangent(keyframes, i1, &Keyframe::position), t, dt);
+		result.rotation = hermite(k0.rotation, k1.rotation, tangent(keyframes, i0, &Keyframe::rotation), tangent(keyframes, i1, &Keyframe::rotation), t, dt);
+		return result;
+	}
+
+	void CameraPath::apply(Camera& camera, float time) const
+	{
+		const Keyframe keyframe = sample(time);
+		camera.setRotation(keyframe.rotation);
+		camera.setPosition(keyframe.position);
+	}
+
+	bool CameraPath::loadFromFile(const std::string& filename)
+	{
+		std::ifstream file(filename);
+		if (!file.is_open())
+		{
+			std::cerr << "Could not open camera path " << filename << std::endl;
+			return false;
+		}
+
+		nlohmann::json data = nlohmann::json::parse(file, nullptr, false);
+		if (data.is_discarded() || data.find("keyframes") == data.end() || !data["keyframes"].is_array())
+		{
+			std::cerr << "Invalid camera path " << filename << std::endl;
+			return false;
+		}
+
+		keyframes.clear();
+		for (const auto& entry : data["keyframes"])
+		{
+			addKeyframe(entry.at("time").get<float>(), jsonToVec3(entry.at("position")), jsonToVec3(entry.at("rotation")));
+		}
+		return !keyframes.empty();
+	}
+
+	bool CameraPath::saveToFile(const std::string& filename) const
+	{
+		nlohmann::json data;
+		data["keyframes"] = nlohmann::json::array();
+		for (const Keyframe& keyframe : keyframes)
+		{
+			data["keyframes"].push_back({{"time", keyframe.time}, {"position", vec3ToJson(keyframe.position)}, {"rotation", vec3ToJson(keyframe.rotation)}});
+		}
+
+		std::ofstream file(filename);
+		if (!file.is_open())
+		{
+			std::cerr << "Could not write camera path " << filename << std::endl;
+			return false;
+		}
+		file << data.dump(1, '\t');
+		return true;
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+class Camera;
+
+namespace vks
+{
+	/**
+	* @brief 相机路径：按时间排列的关键帧，位置和欧拉角用Catmull-Rom插值
+	* @note 文件格式是JSON：{"keyframes":[{"time":秒,"position":[x,y,z],"rotation":[x,y,z]}]}，rotation和Camera::rotation一样是角度
+	*/
+	class CameraPath
+	{
+	public:
+		static constexpr float DEFAULT_RECORD_INTERVAL = 0.25f;
+
+		struct Keyframe
+		{
+			float time = 0.0f;
+			glm::vec3 position{0.0f};
+			glm::vec3 rotation{0.0f};
+		};
+
+		// time要比上一个关键帧大；角度会展开到和上一帧相差不超过180度，插值不会绕远路
+		void addKeyframe(float time, const glm::vec3& position, const glm::vec3& rotation);
+		// 录制用，距上一个关键帧不到minInterval时忽略
+		void record(const Camera& camera, float time, float minInterval = DEFAULT_RECORD_INTERVAL);
+		void clear() { keyframes.clear(); }
+
+		// time超出路径范围时取两端
+		[[nodiscard]] Keyframe sample(float time) const;
+		void apply(Camera& camera, float time) const;
+
+		[[nodiscard]] bool empty() const { return keyframes.empty(); }
+		[[nodiscard]] size_t getKeyframeCount() const { return keyframes.size(); }
+		[[nodiscard]] float getDuration() const { return keyframes.empty() ? 0.0f : keyframes.back().time - keyframes.front().time; }
+		[[nodiscard]] const std::vector<Keyframe>& getKeyframes() const { return keyframes; }
+
+		bool loadFromFile(const std::string& filename);
+		bool saveToFile(const std::string& filename) const;
+
+	private:
+		std::vector<Keyframe> keyframes;
+	};
+}
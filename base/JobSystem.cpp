@@ -0,0 +1,298 @@
+#include "JobSystem.h"
+
+#include <cassert>
+#include <functional>
+
+namespace vks
+{
+	namespace
+	{
+		// worker找不到任务时先自旋这么多轮再睡
+		constexpr uint32_t IDLE_SPIN_COUNT = 64;
+
+		std::atomic<uint64_t> nextJobSystemId{1};
+
+		struct ThreadBinding
+		{
+			uint64_t systemId = 0;
+			uint32_t index = 0;
+			// 偷任务时选起始victim用
+			uint32_t random = 0;
+		};
+		thread_local ThreadBinding threadBinding;
+
+		uint32_t nextRandom(uint32_t& state)
+		{
+			// xorshift32
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		}
+	}
+
+	WorkStealingDeque::WorkStealingDeque(uint32_t capacity) : buffer(capacity), mask(static_cast<int64_t>(capacity) - 1)
+	{
+		assert((capacity & (capacity - 1)) == 0);
+	}
+
+	bool WorkStealingDeque::push(Job* job)
+	{
+		const int64_t b = bottom.load(std::memory_order_relaxed);
+		const int64_t t = top.load(std::memory_order_acquire);
+		if (b - t > mask)
+		{
+			return false;
+		}
+		buffer[b & mask].store(job, std::memory_order_relaxed);
+		bottom.store(b + 1, std::memory_order_release);
+		return true;
+	}
+
+	Job* WorkStealingDeque::pop()
+	{
+		const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+		// bottom先减再读top，和steal之间必须是全序
+		bottom.store(b, std::memory_order_seq_cst);
+		int64_t t = top.load(std::memory_order_seq_cst);
+		if (t > b)
+		{
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		Job* job = buffer[b & mask].load(std::memory_order_relaxed);
+		if (t == b)
+		{
+			// 只剩最后一个，和偷的线程抢
+			if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			{
+				job = nullptr;
+			}
+			bottom.store(b + 1, std::memory_order_relaxed);
+		}
+		return job;
+	}
+
+	Job* WorkStealingDeque::steal()
+	{
+		int64_t t = top.load(std::memory_order_seq_cst);
+		const int64_t b = bottom.load(std::memory_order_seq_cst);
+		if (t >= b)
+		{
+			return nullptr;
+		}
+		Job* job = buffer[t & mask].load(std::memory_order_relaxed);
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			return nullptr;
+		}
+		return job;
+	}
+
+	ScratchArena::ScratchArena(size_t capacity) : memory(std::make_unique<std::byte[]>(capacity)), capacity(capacity)
+	{
+	}
+
+	void* ScratchArena::allocate(size_t size, size_t alignment)
+	{
+		const size_t alignedOffset = (offset + alignment - 1) & ~(alignment - 1);
+		if (alignedOffset + size <= capacity)
+		{
+			offset = alignedOffset + size;
+			return memory.get() + alignedOffset;
+		}
+
+		// new[]保证max_align_t对齐，更大的对齐多分配一点再手动对齐
+		overflow.push_back(std::make_unique<std::byte[]>(size + alignment));
+		const uintptr_t address = reinterpret_cast<uintptr_t>(overflow.back().get());
+		return reinterpret_cast<void*>((address + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1));
+	}
+
+	JobSystem::JobSystem(uint32_t workerCount)
+	{
+		if (workerCount == 0)
+		{
+			workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+		}
+		id = nextJobSystemId.fetch_add(1, std::memory_order_relaxed);
+
+		for (uint32_t i = 0; i <= workerCount; i++)
+		{
+			deques.push_back(std::make_unique<WorkStealingDeque>(DEQUE_CAPACITY));
+			arenas.push_back(std::make_unique<ScratchArena>());
+		}
+		bindThread(workerCount);
+
+		workers.reserve(workerCount);
+		for (uint32_t i = 0; i < workerCount; i++)
+		{
+			workers.emplace_back(&JobSystem::workerLoop, this, i);
+		}
+	}
+
+	JobSystem::~JobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			stopping = true;
+		}
+		sleepCondition.notify_all();
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+		assert(queuedJobs.load() == 0);
+	}
+
+	JobSystem& JobSystem::shared()
+	{
+		static JobSystem instance;
+		return instance;
+	}
+
+	ScratchArena& JobSystem::scratch()
+	{
+		const uint32_t index = currentIndex();
+		if (index != NO_INDEX)
+		{
+			return *arenas[index];
+		}
+		thread_local ScratchArena threadArena;
+		return threadArena;
+	}
+
+	uint32_t JobSystem::currentIndex() const
+	{
+		return threadBinding.systemId == id ? threadBinding.index : NO_INDEX;
+	}
+
+	void JobSystem::bindThread(uint32_t index)
+	{
+		threadBinding.systemId = id;
+		threadBinding.index = index;
+		threadBinding.random = index * 2654435761u + 1;
+	}
+
+	void JobSystem::submit(Job* job)
+	{
+		// 先计数再入队，worker可能看到计数却暂时取不到任务，但不会漏掉唤醒
+		queuedJobs.fetch_add(1, std::memory_order_seq_cst);
+
+		const uint32_t self = currentIndex();
+		if (self == NO_INDEX || !deques[self]->push(job))
+		{
+			std::lock_guard<std::mutex> lock(injectedMutex);
+			injected.push_back(job);
+			injectedCount.fetch_add(1, std::memory_order_release);
+		}
+
+		if (sleepers.load(std::memory_order_seq_cst) > 0)
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			sleepCondition.notify_one();
+		}
+	}
+
+	Job* JobSystem::findJob(uint32_t self)
+	{
+		Job* job = self != NO_INDEX ? deques[self]->pop() : nullptr;
+
+		if (job == nullptr && injectedCount.load(std::memory_order_acquire) > 0)
+		{
+			std::lock_guard<std::mutex> lock(injectedMutex);
+			if (!injected.empty())
+			{
+				job = injected.front();
+				injected.pop_front();
+				injectedCount.fetch_sub(1, std::memory_order_relaxed);
+			}
+		}
+
+		if (job == nullptr)
+		{
+			const uint32_t dequeCount = static_cast<uint32_t>(deques.size());
+			const uint32_t start = nextRandom(threadBinding.random) % dequeCount;
+			for (uint32_t i = 0; i < dequeCount && job == nullptr; i++)
+			{
+				const uint32_t victim = (start + i) % dequeCount;
+				if (victim != self)
+				{
+					job = deques[victim]->steal();
+				}
+			}
+		}
+
+		if (job != nullptr)
+		{
+			queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+		}
+		return job;
+	}
+
+	void JobSystem::execute(Job* job)
+	{
+		// 计数减到0后TaskGroup可能马上清空任务，之后不能再碰job
+		TaskGroup* group = job->group;
+		job->invokeFn(*job);
+		group->pending.fetch_sub(1, std::memory_order_release);
+	}
+
+	bool JobSystem::helpOne()
+	{
+		if (threadBinding.random == 0)
+		{
+			threadBinding.random = static_cast<uint32_t>(std::hash<std::thread::id>()(std::this_thread::get_id())) | 1u;
+		}
+		Job* job = findJob(currentIndex());
+		if (job == nullptr)
+		{
+			return false;
+		}
+		execute(job);
+		return true;
+	}
+
+	void JobSystem::workerLoop(uint32_t index)
+	{
+		bindThread(index);
+
+		uint32_t idleSpins = 0;
+		for (;;)
+		{
+			if (Job* job = findJob(index))
+			{
+				execute(job);
+				idleSpins = 0;
+				continue;
+			}
+			if (++idleSpins < IDLE_SPIN_COUNT)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+			idleSpins = 0;
+
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			sleepers.fetch_add(1, std::memory_order_seq_cst);
+			sleepCondition.wait(lock, [this] { return stopping || queuedJobs.load(std::memory_order_seq_cst) > 0; });
+			sleepers.fetch_sub(1, std::memory_order_relaxed);
+			if (stopping)
+			{
+				break;
+			}
+		}
+	}
+
+	void TaskGroup::wait()
+	{
+		while (pending.load(std::memory_order_acquire) > 0)
+		{
+			if (!jobSystem.helpOne())
+			{
+				std::this_thread::yield();
+			}
+		}
+		jobs.clear();
+	}
+}
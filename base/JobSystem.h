@@ -0,0 +1,284 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace vks
+{
+	class JobSystem;
+	class TaskGroup;
+
+	/**
+	* @brief 一个任务，不超过INLINE_SIZE的可调用对象直接放在任务里，不做堆分配
+	* @note 提交后地址不能变，由TaskGroup持有；执行完立刻析构可调用对象
+	*/
+	class Job
+	{
+	public:
+		static constexpr size_t INLINE_SIZE = 64;
+
+		template <typename F>
+		Job(F&& function, TaskGroup* group) : group(group)
+		{
+			using Functor = std::decay_t<F>;
+			if constexpr (sizeof(Functor) <= INLINE_SIZE && alignof(Functor) <= alignof(std::max_align_t))
+			{
+				new (storage) Functor(std::forward<F>(function));
+				invokeFn = [](Job& job)
+				{
+					Functor* functor = std::launder(reinterpret_cast<Functor*>(job.storage));
+					(*functor)();
+					functor->~Functor();
+				};
+			}
+			else
+			{
+				*reinterpret_cast<Functor**>(storage) = new Functor(std::forward<F>(function));
+				invokeFn = [](Job& job)
+				{
+					std::unique_ptr<Functor> functor(*reinterpret_cast<Functor**>(job.storage));
+					(*functor)();
+				};
+			}
+		}
+		Job(const Job&) = delete;
+		Job& operator=(const Job&) = delete;
+
+	private:
+		friend class JobSystem;
+
+		alignas(std::max_align_t) std::byte storage[INLINE_SIZE];
+		void (*invokeFn)(Job&) = nullptr;
+		TaskGroup* group = nullptr;
+	};
+
+	/**
+	* @brief Chase-Lev work-stealing deque，固定容量
+	* @note push/pop只能由所属线程调用，steal任意线程都可以；满了push返回false
+	*/
+	class WorkStealingDeque
+	{
+	public:
+		explicit WorkStealingDeque(uint32_t capacity);
+
+		[[nodiscard]] bool push(Job* job);
+		// 所属线程从底部取，后进先出
+		[[nodiscard]] Job* pop();
+		// 其它线程从顶部偷，先进先出；和别的线程竞争失败也返回nullptr
+		[[nodiscard]] Job* steal();
+
+	private:
+		std::vector<std::atomic<Job*>> buffer;
+		int64_t mask;
+		alignas(64) std::atomic<int64_t> top{0};
+		alignas(64) std::atomic<int64_t> bottom{0};
+	};
+
+	/**
+	* @brief 线性分配的临时内存，用Scope在作用域结束时整体回退
+	* @note 只给所属线程用；超出容量时单独分配溢出块，随Scope一起释放；不调用析构函数
+	*/
+	class ScratchArena
+	{
+	public:
+		static constexpr size_t DEFAULT_CAPACITY = 1u << 20;
+
+		explicit ScratchArena(size_t capacity = DEFAULT_CAPACITY);
+
+		[[nodiscard]] void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+		template <typename T>
+		[[nodiscard]] T* allocate(size_t count)
+		{
+			static_assert(std::is_trivially_destructible_v<T>, "ScratchArena does not run destructors");
+			return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+		}
+
+		[[nodiscard]] size_t getUsed() const { return offset; }
+
+		class Scope
+		{
+		public:
+			explicit Scope(ScratchArena& arena) : arena(arena), offset(arena.offset), overflowCount(arena.overflow.size()) {}
+			~Scope()
+			{
+				arena.offset = offset;
+				arena.overflow.resize(overflowCount);
+			}
+			Scope(const Scope&) = delete;
+			Scope& operator=(const Scope&) = delete;
+
+		private:
+			ScratchArena& arena;
+			size_t offset;
+			size_t overflowCount;
+		};
+
+	private:
+		std::unique_ptr<std::byte[]> memory;
+		size_t capacity = 0;
+		size_t offset = 0;
+		std::vector<std::unique_ptr<std::byte[]>> overflow;
+	};
+
+	/**
+	* @brief work-stealing任务调度：每个worker一个Chase-Lev deque，空闲时从别的deque偷
+	* @note 构造它的线程也有自己的deque，其它线程提交的任务进一个加锁的共享队列
+	* @note 等待任务的线程不会空等，会帮忙执行别的任务
+	*/
+	class JobSystem
+	{
+	public:
+		static constexpr uint32_t DEQUE_CAPACITY = 4096;
+
+		// workerCount为0时用硬件线程数减一
+		explicit JobSystem(uint32_t workerCount = 0);
+		~JobSystem();
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		// 进程共享的实例，在第一次调用的线程上创建
+		static JobSystem& shared();
+
+		// 把[0, count)按grainSize切块，function(begin, end)；调用线程也参与，返回时全部完成
+		template <typename F>
+		void parallelFor(uint32_t count, uint32_t grainSize, F&& function);
+		// 每块map(begin, end)得到一个部分结果，再按块的顺序combine，结果和线程数无关
+		template <typename T, typename Map, typename Combine>
+		[[nodiscard]] T parallelReduce(uint32_t count, uint32_t grainSize, T identity, Map&& map, Combine&& combine);
+
+		// 当前线程的scratch arena，worker和构造线程各有一个，其它线程用线程本地的
+		ScratchArena& scratch();
+
+		[[nodiscard]] uint32_t getWorkerCount() const { return static_cast<uint32_t>(workers.size()); }
+
+	private:
+		friend class TaskGroup;
+
+		static constexpr uint32_t NO_INDEX = ~0u;
+
+		void submit(Job* job);
+		// 执行一个能找到的任务，没有返回false
+		bool helpOne();
+		void execute(Job* job);
+		Job* findJob(uint32_t self);
+		[[nodiscard]] uint32_t currentIndex() const;
+		void bindThread(uint32_t index);
+		void workerLoop(uint32_t index);
+
+		// 每个实例唯一，防止线程本地的绑定信息串到同地址的新实例上
+		uint64_t id = 0;
+		std::vector<std::thread> workers;
+		// workers.size()个worker的deque，最后一个给构造线程
+		std::vector<std::unique_ptr<WorkStealingDeque>> deques;
+		std::vector<std::unique_ptr<ScratchArena>> arenas;
+
+		std::mutex injectedMutex;
+		std::deque<Job*> injected;
+		std::atomic<uint32_t> injectedCount{0};
+
+		// 已提交还没被取走的任务数，worker据此决定要不要睡
+		std::atomic<int64_t> queuedJobs{0};
+		std::atomic<uint32_t> sleepers{0};
+		std::mutex sleepMutex;
+		std::condition_variable sleepCondition;
+		bool stopping = false;
+	};
+
+	/**
+	* @brief 一组任务，wait等它们全部结束，等待期间帮忙执行任务
+	* @note run和wait只能由创建它的线程调用；任务里要派生子任务就在任务里另建TaskGroup
+	*/
+	class TaskGroup
+	{
+	public:
+		explicit TaskGroup(JobSystem& jobSystem = JobSystem::shared()) : jobSystem(jobSystem) {}
+		~TaskGroup() { wait(); }
+		TaskGroup(const TaskGroup&) = delete;
+		TaskGroup& operator=(const TaskGroup&) = delete;
+
+		template <typename F>
+		void run(F&& function)
+		{
+			pending.fetch_add(1, std::memory_order_relaxed);
+			Job& job = jobs.emplace_back(std::forward<F>(function), this);
+			jobSystem.submit(&job);
+		}
+
+		void wait();
+		[[nodiscard]] bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+
+	private:
+		friend class JobSystem;
+
+		JobSystem& jobSystem;
+		// deque的元素地址在尾部追加时不变
+		std::deque<Job> jobs;
+		std::atomic<uint32_t> pending{0};
+	};
+
+	template <typename F>
+	void JobSystem::parallelFor(uint32_t count, uint32_t grainSize, F&& function)
+	{
+		if (count == 0) return;
+		grainSize = std::max(grainSize, 1u);
+		const uint32_t chunkCount = (count + grainSize - 1) / grainSize;
+		if (chunkCount == 1 || workers.empty())
+		{
+			function(0u, count);
+			return;
+		}
+
+		// 块按原子计数动态领取，谁先空下来谁多干，不依赖偷的粒度
+		std::atomic<uint32_t> nextChunk{0};
+		auto runChunks = [&]
+		{
+			for (uint32_t chunk = nextChunk.fetch_add(1, std::memory_order_relaxed); chunk < chunkCount; chunk = nextChunk.fetch_add(1, std::memory_order_relaxed))
+			{
+				const uint32_t begin = chunk * grainSize;
+				function(begin, std::min(begin + grainSize, count));
+			}
+		};
+
+		TaskGroup group(*this);
+		const uint32_t helperCount = std::min(chunkCount - 1, getWorkerCount());
+		for (uint32_t i = 0; i < helperCount; i++)
+		{
+			group.run(runChunks);
+		}
+		runChunks();
+		group.wait();
+	}
+
+	template <typename T, typename Map, typename Combine>
+	T JobSystem::parallelReduce(uint32_t count, uint32_t grainSize, T identity, Map&& map, Combine&& combine)
+	{
+		grainSize = std::max(grainSize, 1u);
+		const uint32_t chunkCount = (count + grainSize - 1) / grainSize;
+		std::vector<T> partials(chunkCount, identity);
+		parallelFor(chunkCount, 1, [&](uint32_t firstChunk, uint32_t lastChunk)
+		{
+			for (uint32_t chunk = firstChunk; chunk < lastChunk; chunk++)
+			{
+				const uint32_t begin = chunk * grainSize;
+				partials[chunk] = map(begin, std::min(begin + grainSize, count));
+			}
+		});
+
+		T result = identity;
+		for (const T& partial : partials)
+		{
+			result = combine(result, partial);
+		}
+		return result;
+	}
+}
@@ -0,0 +1,66 @@
+#include "VulkanAssetLoader.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cassert>
+
+namespace vks
+{
+	AssetLoader::AssetLoader() = default;
+
+	AssetLoader::~AssetLoader()
+	{
+		destroy();
+	}
+
+	void AssetLoader::create(vks::VulkanDevice* vulkanDevice, vks::UploadManager* uploads, vks::JobSystem* jobSystem)
+	{
+		device = vulkanDevice;
+		uploadManager = uploads;
+		tasks = std::make_unique<TaskGroup>(jobSystem ? *jobSystem : JobSystem::shared());
+		lastTicket = 0;
+	}
+
+	void AssetLoader::destroy()
+	{
+		if (!tasks) return;
+		tasks->wait();
+		tasks.reset();
+		device = nullptr;
+		uploadManager = nullptr;
+	}
+
+	void AssetLoader::loadTexture2D(vks::Texture2D& texture, const std::string& filename, VkFormat format, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
+	{
+		enqueue([this, &texture, filename, format, imageUsageFlags, imageLayout] {
+			texture.loadFromFile(filename, format, device, *uploadManager, imageUsageFlags, imageLayout);
+		});
+	}
+
+	void AssetLoader::loadTextureCubeMap(vks::TextureCubeMap& texture, const std::string& filename, VkFormat format, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout)
+	{
+		enqueue([this, &texture, filename, format, imageUsageFlags, imageLayout] {
+			texture.loadFromFile(filename, format, device, *uploadManager, imageUsageFlags, imageLayout);
+		});
+	}
+
+	void AssetLoader::enqueue(std::function<void()> job)
+	{
+		assert(tasks);
+		// 空闲的worker会把任务偷走，大纹理不会把同一线程上的其它任务堵住
+		tasks->run([this, job = std::move(job)] {
+			job();
+			// 每个资源写完就提交，GPU拷贝和后面的解码重叠
+			const UploadTicket ticket = uploadManager->flush();
+			std::lock_guard<std::mutex> lock(ticketMutex);
+			lastTicket = std::max(lastTicket, ticket);
+		});
+	}
+
+	UploadTicket AssetLoader::finish()
+	{
+		assert(tasks);
+		tasks->wait();
+		std::lock_guard<std::mutex> lock(ticketMutex);
+		return lastTicket;
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+#include "VulkanTexture.h"
+#include "VulkanUploadManager.h"
+
+namespace vks
+{
+	class JobSystem;
+	class TaskGroup;
+
+	/**
+	* @brief 并行资源加载：任务在JobSystem上映射文件、解码，数据直接写进上传环，每个任务结束就提交自己的拷贝
+	* @note 磁盘IO、CPU解码和GPU拷贝互相重叠；目标对象在finish()之前不能被访问
+	*/
+	class AssetLoader
+	{
+	public:
+		AssetLoader();
+		~AssetLoader();
+		AssetLoader(const AssetLoader&) = delete;
+		AssetLoader& operator=(const AssetLoader&) = delete;
+
+		// jobSystem为空时用JobSystem::shared()；enqueue和finish只能在调用create的线程上调用
+		void create(vks::VulkanDevice* device, vks::UploadManager* uploadManager, vks::JobSystem* jobSystem = nullptr);
+		void destroy();
+
+		void loadTexture2D(vks::Texture2D& texture, const std::string& filename, VkFormat format, VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT, VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		void loadTextureCubeMap(vks::TextureCubeMap& texture, const std::string& filename, VkFormat format, VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT, VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		// 任意加载任务，内部的上传在任务结束时提交
+		void enqueue(std::function<void()> job);
+		// 等所有任务结束，等待期间调用线程也执行任务；返回覆盖全部上传的ticket(已提交，还没等GPU)
+		UploadTicket finish();
+
+		[[nodiscard]] bool isCreated() const { return tasks != nullptr; }
+
+	private:
+		vks::VulkanDevice* device = nullptr;
+		vks::UploadManager* uploadManager = nullptr;
+		std::unique_ptr<TaskGroup> tasks;
+		std::mutex ticketMutex;
+		UploadTicket lastTicket = 0;
+	};
+}
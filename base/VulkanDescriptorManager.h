@@ -11,7 +11,13 @@ enum class DescriptorType
 	depthCopy,
 	debugQuad,
 	culling,
-	errorPorj,
+	instanceCulling,
+	dagTraversal,
+	triangleCulling,
+	swRaster,
+	visResolve,
+	visBuffer,
+	meshShading,
 };
 
 class VulkanDescriptorManager: public Singleton<VulkanDescriptorManager>
@@ -13,6 +13,7 @@
 #define VK_ENABLE_BETA_EXTENSIONS
 #endif
 #include <VulkanDevice.h>
+#include <algorithm>
 #include <unordered_set>
 
 namespace vks
@@ -68,6 +69,7 @@ namespace vks
 		{
 			vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
 		}
+		memoryAllocator.destroy();
 		if (logicalDevice)
 		{
 			vkDestroyDevice(logicalDevice, nullptr);
@@ -164,6 +166,24 @@ namespace vks
 		throw std::runtime_error("Could not find a matching queue family index");
 	}
 
+	/**
+	* Get the distinct queue family indices used by the logical device
+	*
+	* @return Graphics, compute and transfer family indices with duplicates removed, used for concurrent sharing
+	*/
+	std::vector<uint32_t> VulkanDevice::getSharedQueueFamilies() const
+	{
+		std::vector<uint32_t> families = { queueFamilyIndices.graphics };
+		for (uint32_t family : { queueFamilyIndices.compute, queueFamilyIndices.transfer })
+		{
+			if (std::find(families.begin(), families.end(), family) == families.end())
+			{
+				families.push_back(family);
+			}
+		}
+		return families;
+	}
+
 	/**
 	* Create the logical device based on the assigned physical device, also gets default queue family indices
 	*
@@ -301,6 +321,8 @@ namespace vks
 		// Create a default command pool for graphics command buffers
 		commandPool = createCommandPool(queueFamilyIndices.graphics);
 
+		memoryAllocator.create(logicalDevice, memoryProperties, properties.limits);
+
 		return result;
 	}
 
@@ -313,14 +335,22 @@ namespace vks
 	* @param buffer Pointer to the buffer handle acquired by the function
 	* @param memory Pointer to the memory handle acquired by the function
 	* @param data Pointer to the data that should be copied to the buffer after creation (optional, if not set, no data is copied over)
+	* @param shareQueueFamilies (Optional) Create the buffer with concurrent sharing across the graphics, compute and transfer queue families
 	*
 	* @return VK_SUCCESS if buffer handle and memory have been created and (optionally passed) data has been copied
 	*/
-	VkResult VulkanDevice::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory, void *data)
+	VkResult VulkanDevice::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory, void *data, bool shareQueueFamilies)
 	{
 		// Create the buffer handle
 		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
 		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		const std::vector<uint32_t> sharedFamilies = shareQueueFamilies ? getSharedQueueFamilies() : std::vector<uint32_t>();
+		if (sharedFamilies.size() > 1)
+		{
+			bufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			bufferCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>(sharedFamilies.size());
+			bufferCreateInfo.pQueueFamilyIndices = sharedFamilies.data();
+		}
 		VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, buffer));
 
 		// Create the memory backing up the buffer handle
@@ -371,32 +401,36 @@ namespace vks
 	* @param buffer Pointer to a vk::Vulkan buffer object
 	* @param size Size of the buffer in bytes
 	* @param data Pointer to the data that should be copied to the buffer after creation (optional, if not set, no data is copied over)
+	* @param strategy (Optional) Sub-allocation strategy, use Linear for short lived buffers like staging
+	* @param shareQueueFamilies (Optional) Create the buffer with concurrent sharing across the graphics, compute and transfer queue families so it can be written and read by all of them without ownership transfers
 	*
 	* @return VK_SUCCESS if buffer handle and memory have been created and (optionally passed) data has been copied
+	*
+	* @note The memory is sub-allocated from memoryAllocator, buffer->memory is the shared block and must not be freed directly
 	*/
-	VkResult VulkanDevice::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data)
+	VkResult VulkanDevice::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data, AllocationStrategy strategy, bool shareQueueFamilies)
 	{
 		buffer->device = logicalDevice;
 
 		// Create the buffer handle
 		VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
+		const std::vector<uint32_t> sharedFamilies = shareQueueFamilies ? getSharedQueueFamilies() : std::vector<uint32_t>();
+		if (sharedFamilies.size() > 1)
+		{
+			bufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+			bufferCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>(sharedFamilies.size());
+			bufferCreateInfo.pQueueFamilyIndices = sharedFamilies.data();
+		}
 		VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, &buffer->buffer));
 
-		// Create the memory backing up the buffer handle
+		// Sub-allocate the memory backing up the buffer handle
 		VkMemoryRequirements memReqs;
-		VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
 		vkGetBufferMemoryRequirements(logicalDevice, buffer->buffer, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		// Find a memory type index that fits the properties of the buffer
-		memAlloc.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
-		// If the buffer has VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT set we also need to enable the appropriate flag during allocation
-		VkMemoryAllocateFlagsInfoKHR allocFlagsInfo{};
-		if (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
-			allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO_KHR;
-			allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
-			memAlloc.pNext = &allocFlagsInfo;
-		}
-		VK_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAlloc, nullptr, &buffer->memory));
+		// If the buffer has VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT set the allocator gives it a dedicated allocation with the appropriate flag
+		const bool deviceAddress = (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) != 0;
+		VK_CHECK_RESULT(memoryAllocator.allocate(memReqs, memoryPropertyFlags, ResourceKind::Buffer, strategy, buffer->allocation, deviceAddress));
+		buffer->allocator = &memoryAllocator;
+		buffer->memory = buffer->allocation.memory;
 
 		buffer->alignment = memReqs.alignment;
 		buffer->size = size;
@@ -528,7 +562,7 @@ namespace vks
 		VkFence fence;
 		VK_CHECK_RESULT(vkCreateFence(logicalDevice, &fenceInfo, nullptr, &fence));
 		// Submit to the queue
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
+		VK_CHECK_RESULT(queueSubmit(queue, 1, &submitInfo, fence));
 		// Wait for the fence to signal that command buffer has finished executing
 		VK_CHECK_RESULT(vkWaitForFences(logicalDevice, 1, &fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
 		vkDestroyFence(logicalDevice, fence, nullptr);
@@ -543,6 +577,36 @@ namespace vks
 		return flushCommandBuffer(commandBuffer, queue, commandPool, free);
 	}
 
+	/**
+	* Get the mutex guarding host access to a queue
+	*
+	* @param queue Queue handle, families without a dedicated queue share the same handle
+	*
+	* @note Loader workers and the main thread may submit to the same queue concurrently, every submit/wait/present has to hold this mutex
+	*/
+	std::mutex& VulkanDevice::getQueueMutex(VkQueue queue)
+	{
+		std::lock_guard<std::mutex> lock(queueMutexesLock);
+		auto& queueMutex = queueMutexes[queue];
+		if (!queueMutex)
+		{
+			queueMutex = std::make_unique<std::mutex>();
+		}
+		return *queueMutex;
+	}
+
+	VkResult VulkanDevice::queueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo *submits, VkFence fence)
+	{
+		std::lock_guard<std::mutex> lock(getQueueMutex(queue));
+		return vkQueueSubmit(queue, submitCount, submits, fence);
+	}
+
+	VkResult VulkanDevice::queueWaitIdle(VkQueue queue)
+	{
+		std::lock_guard<std::mutex> lock(getQueueMutex(queue));
+		return vkQueueWaitIdle(queue);
+	}
+
 	/**
 	* Check if an extension is supported by the (physical device)
 	*
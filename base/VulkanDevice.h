@@ -11,11 +11,15 @@
 #pragma once
 
 #include "VulkanBuffer.h"
+#include "VulkanMemoryAllocator.h"
 #include "VulkanTools.h"
 #include "vulkan/vulkan.h"
 #include <algorithm>
 #include <assert.h>
 #include <exception>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
 namespace vks
 {
@@ -37,6 +41,8 @@ struct VulkanDevice
 	std::vector<VkQueueFamilyProperties> queueFamilyProperties;
 	/** @brief List of extensions supported by the device */
 	std::vector<std::string> supportedExtensions;
+	/** @brief Sub-allocator used by vks::Buffer and vks::Texture, created together with the logical device */
+	MemoryAllocator memoryAllocator;
 	/** @brief Default command pool for the graphics queue family index */
 	VkCommandPool commandPool = VK_NULL_HANDLE;
 	/** @brief Contains queue family indices */
@@ -54,9 +60,10 @@ struct VulkanDevice
 	~VulkanDevice();
 	uint32_t        getMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties, VkBool32 *memTypeFound = nullptr) const;
 	uint32_t        getQueueFamilyIndex(VkQueueFlags queueFlags) const;
+	std::vector<uint32_t> getSharedQueueFamilies() const;
 	VkResult        createLogicalDevice(VkPhysicalDeviceFeatures enabledFeatures, std::vector<const char *> enabledExtensions, void *pNextChain, bool useSwapChain = true, VkQueueFlags requestedQueueTypes = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
-	VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory, void *data = nullptr);
-	VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data = nullptr);
+	VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory, void *data = nullptr, bool shareQueueFamilies = false);
+	VkResult        createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, vks::Buffer *buffer, VkDeviceSize size, void *data = nullptr, AllocationStrategy strategy = AllocationStrategy::FreeList, bool shareQueueFamilies = false);
 	void            copyBuffer(vks::Buffer *src, vks::Buffer *dst, VkQueue queue, VkBufferCopy *copyRegion = nullptr);
 	VkCommandPool   createCommandPool(uint32_t queueFamilyIndex, VkCommandPoolCreateFlags createFlags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 	VkCommandBuffer createCommandBuffer(VkCommandBufferLevel level, VkCommandPool pool, bool begin = false);
@@ -65,5 +72,14 @@ struct VulkanDevice
 	void            flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, bool free = true);
 	bool            extensionSupported(std::string extension);
 	VkFormat        getSupportedDepthFormat(bool checkSamplingSupport);
+	/** @brief Mutex that must be held for every vkQueueSubmit / vkQueueWaitIdle / vkQueuePresentKHR on the given queue (queues are externally synchronized and families may alias) */
+	std::mutex&     getQueueMutex(VkQueue queue);
+	VkResult        queueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo *submits, VkFence fence);
+	VkResult        queueWaitIdle(VkQueue queue);
+
+private:
+	/** @brief One mutex per VkQueue handle, created on first use */
+	std::mutex queueMutexesLock;
+	std::unordered_map<VkQueue, std::unique_ptr<std::mutex>> queueMutexes;
 };
 }        // namespace vks
@@ -0,0 +1,495 @@
+#include "VulkanMemoryAllocator.h"
+#include "VulkanTools.h"
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+namespace vks
+{
+	namespace
+	{
+		VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		VkDeviceSize alignDown(VkDeviceSize value, VkDeviceSize alignment)
+		{
+			return value / alignment * alignment;
+		}
+	}
+
+	struct MemoryBlock
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		uint8_t* mapped = nullptr;
+		uint32_t memoryTypeIndex = 0;
+		AllocationStrategy strategy = AllocationStrategy::FreeList;
+		bool dedicated = false;
+		uint64_t poolKey = 0;
+
+		// FreeList: offset -> size，相邻空闲段总是合并的
+		std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+		// Linear
+		VkDeviceSize linearHead = 0;
+
+		uint32_t allocationCount = 0;
+		VkDeviceSize usedBytes = 0;
+
+		bool tryAllocate(VkDeviceSize allocSize, VkDeviceSize alignment, VkDeviceSize& offset)
+		{
+			if (strategy == AllocationStrategy::Linear)
+			{
+				const VkDeviceSize aligned = alignUp(linearHead, alignment);
+				if (aligned + allocSize > size)
+					return false;
+				offset = aligned;
+				linearHead = aligned + allocSize;
+			}
+			else
+			{
+				// best-fit，对齐后放得下的最小空闲段
+				auto best = freeRanges.end();
+				for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it)
+				{
+					const VkDeviceSize aligned = alignUp(it->first, alignment);
+					if (aligned + allocSize <= it->first + it->second && (best == freeRanges.end() || it->second < best->second))
+					{
+						best = it;
+					}
+				}
+				if (best == freeRanges.end())
+					return false;
+
+				const VkDeviceSize rangeOffset = best->first;
+				const VkDeviceSize rangeEnd = best->first + best->second;
+				offset = alignUp(rangeOffset, alignment);
+				freeRanges.erase(best);
+				if (offset > rangeOffset)
+				{
+					freeRanges.emplace(rangeOffset, offset - rangeOffset);
+				}
+				if (offset + allocSize < rangeEnd)
+				{
+					freeRanges.emplace(offset + allocSize, rangeEnd - offset - allocSize);
+				}
+			}
+			++allocationCount;
+			usedBytes += allocSize;
+			return true;
+		}
+
+		void release(VkDeviceSize offset, VkDeviceSize allocSize)
+		{
+			--allocationCount;
+			usedBytes -= allocSize;
+			if (strategy == AllocationStrategy::Linear)
+			{
+				if (allocationCount == 0)
+				{
+					linearHead = 0;
+				}
+				return;
+			}
+
+			auto next = freeRanges.lower_bound(offset);
+			if (next != freeRanges.begin())
+			{
+				auto prev = std::prev(next);
+				if (prev->first + prev->second == offset)
+				{
+					offset = prev->first;
+					allocSize += prev->second;
+					freeRanges.erase(prev);
+				}
+			}
+			if (next != freeRanges.end() && offset + allocSize == next->first)
+			{
+				allocSize += next->second;
+				freeRanges.erase(next);
+			}
+			freeRanges.emplace(offset, allocSize);
+		}
+	};
+
+	MemoryAllocator::MemoryAllocator() = default;
+
+	// MemoryBlock只在这里完整定义
+	MemoryAllocator::~MemoryAllocator() = default;
+
+	void MemoryAllocator::create(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, const VkPhysicalDeviceLimits& limits)
+	{
+		this->device = device;
+		this->memoryProperties = memoryProperties;
+		bufferImageGranularity = std::max<VkDeviceSize>(limits.bufferImageGranularity, 1);
+		nonCoherentAtomSize = std::max<VkDeviceSize>(limits.nonCoherentAtomSize, 1);
+		maxAllocationCount = limits.maxMemoryAllocationCount;
+	}
+
+	void MemoryAllocator::destroy()
+	{
+		if (device == VK_NULL_HANDLE)
+			return;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		uint32_t leaked = 0;
+		for (auto& [key, pool] : pools)
+		{
+			for (auto& block : pool.blocks)
+			{
+				leaked += block->allocationCount;
+				freeDeviceMemory(block->memory, block->mapped != nullptr);
+			}
+		}
+		for (auto& block : dedicatedBlocks)
+		{
+			++leaked;
+			freeDeviceMemory(block->memory, block->mapped != nullptr);
+		}
+		if (leaked > 0)
+		{
+			std::cerr << "MemoryAllocator: " << leaked << " allocations still alive at destroy\n";
+		}
+		pools.clear();
+		dedicatedBlocks.clear();
+		device = VK_NULL_HANDLE;
+	}
+
+	uint32_t MemoryAllocator::findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags propertyFlags) const
+	{
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+		{
+			if ((typeBits & (1u << i)) && (memoryProperties.memoryTypes[i].propertyFlags & propertyFlags) == propertyFlags)
+			{
+				return i;
+			}
+		}
+		throw std::runtime_error("Could not find a matching memory type");
+	}
+
+	uint32_t MemoryAllocator::getSizeClass(VkDeviceSize size) const
+	{
+		for (uint32_t sizeClass = 0; sizeClass < SIZE_CLASS_COUNT; ++sizeClass)
+		{
+			if (size <= SIZE_CLASS_LIMITS[sizeClass])
+				return sizeClass;
+		}
+		return SIZE_CLASS_COUNT;
+	}
+
+	uint64_t MemoryAllocator::getPoolKey(uint32_t memoryTypeIndex, uint32_t sizeClass, ResourceKind kind, AllocationStrategy strategy) const
+	{
+		// 粒度为1时buffer和image可以混放
+		const uint64_t kindBit = bufferImageGranularity > 1 && kind == ResourceKind::OptimalImage ? 1 : 0;
+		const uint64_t strategyBit = strategy == AllocationStrategy::Linear ? 1 : 0;
+		return (static_cast<uint64_t>(memoryTypeIndex) << 8) | (static_cast<uint64_t>(sizeClass) << 2) | (kindBit << 1) | strategyBit;
+	}
+
+	VkResult MemoryAllocator::allocateDeviceMemory(uint32_t memoryTypeIndex, VkDeviceSize size, bool deviceAddress, VkDeviceMemory& memory, void*& mapped)
+	{
+		if (maxAllocationCount != 0 && deviceMemoryCount >= maxAllocationCount)
+		{
+			std::cerr << "MemoryAllocator: maxMemoryAllocationCount (" << maxAllocationCount << ") reached\n";
+			return VK_ERROR_TOO_MANY_OBJECTS;
+		}
+
+		VkMemoryAllocateInfo memAlloc{};
+		memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memAlloc.allocationSize = size;
+		memAlloc.memoryTypeIndex = memoryTypeIndex;
+		VkMemoryAllocateFlagsInfoKHR allocFlagsInfo{};
+		if (deviceAddress)
+		{
+			allocFlagsInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_FLAGS_INFO_KHR;
+			allocFlagsInfo.flags = VK_MEMORY_ALLOCATE_DEVICE_ADDRESS_BIT_KHR;
+			memAlloc.pNext = &allocFlagsInfo;
+		}
+		VkResult result = vkAllocateMemory(device, &memAlloc, nullptr, &memory);
+		++allocateCalls;
+		if (result != VK_SUCCESS)
+			return result;
+
+		mapped = nullptr;
+		if (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		{
+			// host可见的块整块常驻映射，同一块VkDeviceMemory不能映射两次
+			result = vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+			if (result != VK_SUCCESS)
+			{
+				vkFreeMemory(device, memory, nullptr);
+				return result;
+			}
+		}
+		++deviceMemoryCount;
+		return VK_SUCCESS;
+	}
+
+	void MemoryAllocator::freeDeviceMemory(VkDeviceMemory memory, bool mapped)
+	{
+		if (mapped)
+		{
+			vkUnmapMemory(device, memory);
+		}
+		vkFreeMemory(device, memory, nullptr);
+		--deviceMemoryCount;
+	}
+
+	VkResult MemoryAllocator::createBlock(Pool& pool, VkDeviceSize minSize, MemoryBlock*& block)
+	{
+		// 小堆(集显、软件ICD)上整块分配可能失败，逐次减半直到刚好放下
+		const VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[pool.memoryTypeIndex].heapIndex].size;
+		VkDeviceSize blockSize = std::max(std::min(pool.blockSize, heapSize / 8), minSize);
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		void* mapped = nullptr;
+		VkResult result;
+		while ((result = allocateDeviceMemory(pool.memoryTypeIndex, blockSize, false, memory, mapped)) != VK_SUCCESS)
+		{
+			if (result == VK_ERROR_TOO_MANY_OBJECTS || blockSize / 2 < minSize)
+				return result;
+			blockSize /= 2;
+		}
+
+		auto newBlock = std::make_unique<MemoryBlock>();
+		newBlock->memory = memory;
+		newBlock->size = blockSize;
+		newBlock->mapped = static_cast<uint8_t*>(mapped);
+		newBlock->memoryTypeIndex = pool.memoryTypeIndex;
+		newBlock->strategy = pool.strategy;
+		if (pool.strategy == AllocationStrategy::FreeList)
+		{
+			newBlock->freeRanges.emplace(0, blockSize);
+		}
+		block = newBlock.get();
+		pool.blocks.emplace_back(std::move(newBlock));
+		return VK_SUCCESS;
+	}
+
+	VkResult MemoryAllocator::allocateDedicated(uint32_t memoryTypeIndex, VkDeviceSize size, bool deviceAddress, Allocation& allocation)
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		void* mapped = nullptr;
+		const VkResult result = allocateDeviceMemory(memoryTypeIndex, size, deviceAddress, memory, mapped);
+		if (result != VK_SUCCESS)
+			return result;
+
+		auto block = std::make_unique<MemoryBlock>();
+		block->memory = memory;
+		block->size = size;
+		block->mapped = static_cast<uint8_t*>(mapped);
+		block->memoryTypeIndex = memoryTypeIndex;
+		block->dedicated = true;
+		block->allocationCount = 1;
+		block->usedBytes = size;
+
+		allocation.memory = memory;
+		allocation.offset = 0;
+		allocation.size = size;
+		allocation.mapped = mapped;
+		allocation.memoryTypeIndex = memoryTypeIndex;
+		allocation.block = block.get();
+		dedicatedBlocks.emplace_back(std::move(block));
+		return VK_SUCCESS;
+	}
+
+	VkResult MemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags propertyFlags, ResourceKind kind, AllocationStrategy strategy, Allocation& allocation, bool deviceAddress)
+	{
+		assert(device != VK_NULL_HANDLE);
+		const uint32_t memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, propertyFlags);
+		const uint32_t sizeClass = getSizeClass(requirements.size);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		// device address需要在vkAllocateMemory时带flag，不和普通分配共用块
+		if (sizeClass == SIZE_CLASS_COUNT || deviceAddress)
+		{
+			return allocateDedicated(memoryTypeIndex, requirements.size, deviceAddress, allocation);
+		}
+
+		const uint64_t key = getPoolKey(memoryTypeIndex, sizeClass, kind, strategy);
+		Pool& pool = pools[key];
+		if (pool.blocks.empty())
+		{
+			pool.memoryTypeIndex = memoryTypeIndex;
+			pool.blockSize = SIZE_CLASS_BLOCK_SIZES[sizeClass];
+			pool.strategy = strategy;
+		}
+
+		const VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+		MemoryBlock* target = nullptr;
+		VkDeviceSize offset = 0;
+		for (auto& block : pool.blocks)
+		{
+			if (block->tryAllocate(requirements.size, alignment, offset))
+			{
+				target = block.get();
+				break;
+			}
+		}
+		if (target == nullptr)
+		{
+			const VkResult result = createBlock(pool, requirements.size, target);
+			if (result != VK_SUCCESS)
+				return result;
+			target->poolKey = key;
+			[[maybe_unused]] const bool allocated = target->tryAllocate(requirements.size, alignment, offset);
+			assert(allocated);
+		}
+
+		allocation.memory = target->memory;
+		allocation.offset = offset;
+		allocation.size = requirements.size;
+		allocation.mapped = target->mapped ? target->mapped + offset : nullptr;
+		allocation.memoryTypeIndex = memoryTypeIndex;
+		allocation.block = target;
+		return VK_SUCCESS;
+	}
+
+	void MemoryAllocator::free(Allocation& allocation)
+	{
+		if (!allocation.valid())
+			return;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		MemoryBlock* block = allocation.block;
+		if (block->dedicated)
+		{
+			freeDeviceMemory(block->memory, block->mapped != nullptr);
+			std::erase_if(dedicatedBlocks, [block](const auto& entry) { return entry.get() == block; });
+		}
+		else
+		{
+			block->release(allocation.offset, allocation.size);
+			// 空块只保留一个，避免反复分配释放
+			Pool& pool = pools[block->poolKey];
+			if (block->allocationCount == 0 && pool.blocks.size() > 1)
+			{
+				freeDeviceMemory(block->memory, block->mapped != nullptr);
+				std::erase_if(pool.blocks, [block](const auto& entry) { return entry.get() == block; });
+			}
+		}
+		allocation = Allocation{};
+	}
+
+	VkResult MemoryAllocator::mappedRange(const Allocation& allocation, VkDeviceSize offset, VkDeviceSize size, VkMappedMemoryRange& range) const
+	{
+		if (memoryProperties.memoryTypes[allocation.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+			return VK_INCOMPLETE;
+
+		// 范围必须按nonCoherentAtomSize对齐，块内相邻的分配一起刷也没关系
+		const VkDeviceSize begin = alignDown(allocation.offset + offset, nonCoherentAtomSize);
+		const VkDeviceSize end = size == VK_WHOLE_SIZE ? allocation.offset + allocation.size : allocation.offset + offset + size;
+		range = {};
+		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		range.memory = allocation.memory;
+		range.offset = begin;
+		range.size = alignUp(end, nonCoherentAtomSize) >= allocation.block->size ? VK_WHOLE_SIZE : alignUp(end, nonCoherentAtomSize) - begin;
+		return VK_SUCCESS;
+	}
+
+	VkResult MemoryAllocator::flush(const Allocation& allocation, VkDeviceSize offset, VkDeviceSize size)
+	{
+		VkMappedMemoryRange range;
+		if (mappedRange(allocation, offset, size, range) != VK_SUCCESS)
+			return VK_SUCCESS;
+		return vkFlushMappedMemoryRanges(device, 1, &range);
+	}
+
+	VkResult MemoryAllocator::invalidate(const Allocation& allocation, VkDeviceSize offset, VkDeviceSize size)
+	{
+		VkMappedMemoryRange range;
+		if (mappedRange(allocation, offset, size, range) != VK_SUCCESS)
+			return VK_SUCCESS;
+		return vkInvalidateMappedMemoryRanges(device, 1, &range);
+	}
+
+	void MemoryAllocator::accumulate(const MemoryBlock& block, MemoryStatistics& stats) const
+	{
+		stats.allocationCount += block.allocationCount;
+		stats.usedBytes += block.usedBytes;
+		if (block.dedicated)
+		{
+			++stats.dedicatedCount;
+			stats.dedicatedBytes += block.size;
+			return;
+		}
+
+		++stats.blockCount;
+		stats.blockBytes += block.size;
+		if (block.strategy == AllocationStrategy::Linear)
+		{
+			// 线性块只有尾部可用，已释放但没复位的中间空洞不算
+			const VkDeviceSize tail = block.size - block.linearHead;
+			stats.freeRangeCount += tail > 0 ? 1 : 0;
+			stats.freeBytes += tail;
+			stats.largestFreeRange = std::max(stats.largestFreeRange, tail);
+			return;
+		}
+		for (const auto& [offset, size] : block.freeRanges)
+		{
+			++stats.freeRangeCount;
+			stats.freeBytes += size;
+			stats.largestFreeRange = std::max(stats.largestFreeRange, size);
+		}
+	}
+
+	MemoryStatistics MemoryAllocator::getStatistics() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		MemoryStatistics stats;
+		for (const auto& [key, pool] : pools)
+		{
+			for (const auto& block : pool.blocks)
+			{
+				accumulate(*block, stats);
+			}
+		}
+		for (const auto& block : dedicatedBlocks)
+		{
+			accumulate(*block, stats);
+		}
+		stats.deviceMemoryCount = deviceMemoryCount;
+		stats.allocateCalls = allocateCalls;
+		return stats;
+	}
+
+	MemoryStatistics MemoryAllocator::getStatistics(uint32_t memoryTypeIndex) const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		MemoryStatistics stats;
+		for (const auto& [key, pool] : pools)
+		{
+			if (pool.memoryTypeIndex != memoryTypeIndex)
+				continue;
+			for (const auto& block : pool.blocks)
+			{
+				accumulate(*block, stats);
+			}
+		}
+		for (const auto& block : dedicatedBlocks)
+		{
+			if (block->memoryTypeIndex == memoryTypeIndex)
+			{
+				accumulate(*block, stats);
+			}
+		}
+		stats.deviceMemoryCount = stats.blockCount + stats.dedicatedCount;
+		return stats;
+	}
+
+	void MemoryAllocator::printStatistics() const
+	{
+		constexpr double MB = 1024.0 * 1024.0;
+		const MemoryStatistics total = getStatistics();
+		std::cout << "Device memory: " << total.deviceMemoryCount << " VkDeviceMemory (" << total.blockCount << " blocks, " << total.dedicatedCount << " dedicated), "
+			<< total.allocationCount << " allocations, " << total.allocateCalls << " vkAllocateMemory calls\n";
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+		{
+			const MemoryStatistics stats = getStatistics(i);
+			if (stats.deviceMemoryCount == 0)
+				continue;
+			std::cout << "  type " << i << ": used " << stats.usedBytes / MB << " MB of " << (stats.blockBytes + stats.dedicatedBytes) / MB << " MB, "
+				<< stats.allocationCount << " allocations, " << stats.freeRangeCount << " free ranges, fragmentation " << stats.fragmentation() << "\n";
+		}
+	}
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+namespace vks
+{
+	struct MemoryBlock;
+
+	// 子分配策略
+	enum class AllocationStrategy
+	{
+		// 通用，best-fit空闲链表，释放时合并相邻空闲段
+		FreeList,
+		// 只往后推的线性分配，块里的分配全部释放后整体复位；适合staging这类用完就扔的
+		Linear,
+	};
+
+	// 资源类型，bufferImageGranularity大于1时buffer和optimal image不能紧挨着放，直接分到不同的池
+	enum class ResourceKind
+	{
+		Buffer,
+		OptimalImage,
+	};
+
+	struct Allocation
+	{
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		// host可见的块常驻映射，这里已经加上了offset
+		void* mapped = nullptr;
+		uint32_t memoryTypeIndex = 0;
+		MemoryBlock* block = nullptr;
+
+		[[nodiscard]] bool valid() const { return memory != VK_NULL_HANDLE; }
+	};
+
+	struct MemoryStatistics
+	{
+		// 当前存活的VkDeviceMemory数，包括dedicated
+		uint32_t deviceMemoryCount = 0;
+		uint32_t blockCount = 0;
+		uint32_t dedicatedCount = 0;
+		uint32_t allocationCount = 0;
+		// 累计的vkAllocateMemory调用次数
+		uint64_t allocateCalls = 0;
+		VkDeviceSize blockBytes = 0;
+		VkDeviceSize usedBytes = 0;
+		VkDeviceSize dedicatedBytes = 0;
+		uint32_t freeRangeCount = 0;
+		VkDeviceSize freeBytes = 0;
+		VkDeviceSize largestFreeRange = 0;
+
+		// 1 - 最大空闲段/总空闲，0表示空闲空间是连续的
+		[[nodiscard]] float fragmentation() const { return freeBytes == 0 ? 0.0f : 1.0f - static_cast<float>(largestFreeRange) / static_cast<float>(freeBytes); }
+	};
+
+	/**
+	* @brief 设备内存子分配器，按内存类型和大小档位分池，每个池从大块VkDeviceMemory里切
+	* @note 线程安全；超过档位上限或需要device address的分配走dedicated
+	*/
+	class MemoryAllocator
+	{
+	public:
+		// 大小档位：分配越小，所在块越小，避免小分配把大块切碎
+		static constexpr uint32_t SIZE_CLASS_COUNT = 3;
+		static constexpr VkDeviceSize SIZE_CLASS_LIMITS[SIZE_CLASS_COUNT] = {256ull << 10, 4ull << 20, 32ull << 20};
+		static constexpr VkDeviceSize SIZE_CLASS_BLOCK_SIZES[SIZE_CLASS_COUNT] = {8ull << 20, 64ull << 20, 256ull << 20};
+
+		MemoryAllocator();
+		~MemoryAllocator();
+		MemoryAllocator(const MemoryAllocator&) = delete;
+		MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+		void create(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, const VkPhysicalDeviceLimits& limits);
+		void destroy();
+
+		VkResult allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags propertyFlags, ResourceKind kind, AllocationStrategy strategy, Allocation& allocation, bool deviceAddress = false);
+		void free(Allocation& allocation);
+
+		// 按nonCoherentAtomSize对齐，coherent内存直接返回
+		VkResult flush(const Allocation& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+		VkResult invalidate(const Allocation& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+
+		[[nodiscard]] bool isCreated() const { return device != VK_NULL_HANDLE; }
+		[[nodiscard]] MemoryStatistics getStatistics() const;
+		[[nodiscard]] MemoryStatistics getStatistics(uint32_t memoryTypeIndex) const;
+		void printStatistics() const;
+
+	private:
+		struct Pool
+		{
+			uint32_t memoryTypeIndex = 0;
+			VkDeviceSize blockSize = 0;
+			AllocationStrategy strategy = AllocationStrategy::FreeList;
+			std::vector<std::unique_ptr<MemoryBlock>> blocks;
+		};
+
+		[[nodiscard]] uint32_t findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags propertyFlags) const;
+		[[nodiscard]] uint32_t getSizeClass(VkDeviceSize size) const;
+		[[nodiscard]] uint64_t getPoolKey(uint32_t memoryTypeIndex, uint32_t sizeClass, ResourceKind kind, AllocationStrategy strategy) const;
+		VkResult createBlock(Pool& pool, VkDeviceSize minSize, MemoryBlock*& block);
+		VkResult allocateDedicated(uint32_t memoryTypeIndex, VkDeviceSize size, bool deviceAddress, Allocation& allocation);
+		VkResult allocateDeviceMemory(uint32_t memoryTypeIndex, VkDeviceSize size, bool deviceAddress, VkDeviceMemory& memory, void*& mapped);
+		void freeDeviceMemory(VkDeviceMemory memory, bool mapped);
+		VkResult mappedRange(const Allocation& allocation, VkDeviceSize offset, VkDeviceSize size, VkMappedMemoryRange& range) const;
+		void accumulate(const MemoryBlock& block, MemoryStatistics& stats) const;
+
+		VkDevice device = VK_NULL_HANDLE;
+		VkPhysicalDeviceMemoryProperties memoryProperties{};
+		VkDeviceSize bufferImageGranularity = 1;
+		VkDeviceSize nonCoherentAtomSize = 1;
+		uint32_t maxAllocationCount = 0;
+
+		mutable std::mutex mutex;
+		std::map<uint64_t, Pool> pools;
+		std::vector<std::unique_ptr<MemoryBlock>> dedicatedBlocks;
+		uint32_t deviceMemoryCount = 0;
+		uint64_t allocateCalls = 0;
+	};
+}
@@ -0,0 +1,168 @@
+﻿#include "VulkanProfiler.h"
+#include <algorithm>
+#include <iostream>
+
+namespace vks
+{
+	void GpuProfiler::create(vks::VulkanDevice* vulkanDevice, uint32_t queueFamilyIndex, uint32_t framesInFlight)
+	{
+		device = vulkanDevice->logicalDevice;
+		timestampPeriod = vulkanDevice->properties.limits.timestampPeriod;
+
+		// timestampValidBits为0表示该队列不支持timestamp，软件ICD(lavapipe)一般是64
+		const uint32_t validBits = vulkanDevice->queueFamilyProperties[queueFamilyIndex].timestampValidBits;
+		supported = validBits > 0 && timestampPeriod > 0.0f;
+		if (!supported)
+		{
+			std::cerr << "GpuProfiler: timestamp queries not supported on queue family " << queueFamilyIndex << ", profiling disabled\n";
+			return;
+		}
+		timestampMask = validBits >= 64 ? ~0ull : ((1ull << validBits) - 1);
+
+		frames.resize(framesInFlight);
+		VkQueryPoolCreateInfo queryPoolCI{};
+		queryPoolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolCI.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolCI.queryCount = MAX_SCOPES * 2;
+		for (auto& frame : frames)
+		{
+			VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolCI, nullptr, &frame.queryPool));
+			frame.recorded.assign(MAX_SCOPES, false);
+			frame.pending.assign(MAX_SCOPES, false);
+		}
+	}
+
+	void GpuProfiler::destroy()
+	{
+		for (auto& frame : frames)
+		{
+			if (frame.queryPool != VK_NULL_HANDLE)
+			{
+				vkDestroyQueryPool(device, frame.queryPool, nullptr);
+			}
+		}
+		frames.clear();
+		supported = false;
+	}
+
+	void GpuProfiler::beginFrame(VkCommandBuffer cmdBuffer, uint32_t frameIndex)
+	{
+		if (!supported) return;
+		auto& frame = frames[frameIndex];
+		vkCmdResetQueryPool(cmdBuffer, frame.queryPool, 0, MAX_SCOPES * 2);
+		frame.recorded.assign(MAX_SCOPES, false);
+		frame.pending.assign(MAX_SCOPES, false);
+		// 重新录制后旧的提交结果作废
+		frame.submitted = false;
+	}
+
+	void GpuProfiler::beginScope(VkCommandBuffer cmdBuffer, uint32_t frameIndex, const std::string& name, VkPipelineStageFlagBits stage)
+	{
+		if (!supported) return;
+		const uint32_t index = getScopeIndex(name);
+		if (index >= MAX_SCOPES) return;
+		vkCmdWriteTimestamp(cmdBuffer, stage, frames[frameIndex].queryPool, index * 2);
+	}
+
+	void GpuProfiler::endScope(VkCommandBuffer cmdBuffer, uint32_t frameIndex, const std::string& name, VkPipelineStageFlagBits stage)
+	{
+		if (!supported) return;
+		const uint32_t index = getScopeIndex(name);
+		if (index >= MAX_SCOPES) return;
+		vkCmdWriteTimestamp(cmdBuffer, stage, frames[frameIndex].queryPool, index * 2 + 1);
+		frames[frameIndex].recorded[index] = true;
+	}
+
+	void GpuProfiler::markSubmitted(uint32_t frameIndex)
+	{
+		if (!supported) return;
+		auto& frame = frames[frameIndex];
+		// 同一个command buffer会被反复提交，每次提交都要重新读一遍录制过的scope
+		frame.pending = frame.recorded;
+		frame.submitted = true;
+	}
+
+	bool GpuProfiler::collect(uint32_t frameIndex)
+	{
+		if (!supported || scopes.empty()) return false;
+		auto& frame = frames[frameIndex];
+		if (!frame.submitted) return false;
+
+		// 每个query带一个availability值
+		const uint32_t queryCount = static_cast<uint32_t>(std::min<size_t>(scopes.size(), MAX_SCOPES)) * 2;
+		std::vector<uint64_t> results(queryCount * 2, 0);
+		const VkResult result = vkGetQueryPoolResults(device, frame.queryPool, 0, queryCount, results.size() * sizeof(uint64_t), results.data(), sizeof(uint64_t) * 2, VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+		if (result != VK_SUCCESS && result != VK_NOT_READY)
+		{
+			VK_CHECK_RESULT(result);
+		}
+
+		for (auto& scope : scopes)
+		{
+			scope.updated = false;
+		}
+
+		bool anyCollected = false;
+		for (uint32_t i = 0; i < queryCount / 2; ++i)
+		{
+			if (!frame.pending[i]) continue;
+			const uint64_t* begin = &results[i * 4];
+			const uint64_t* end = &results[i * 4 + 2];
+			// 还没完成的scope留到下次
+			if (begin[1] == 0 || end[1] == 0) continue;
+
+			const uint64_t ticks = ((end[0] & timestampMask) - (begin[0] & timestampMask)) & timestampMask;
+			auto& scope = scopes[i];
+			scope.lastMs = static_cast<double>(ticks) * timestampPeriod / 1e6;
+			scope.history[scope.historyHead] = scope.lastMs;
+			scope.historyHead = (scope.historyHead + 1) % HISTORY_SIZE;
+			scope.historyCount = std::min(scope.historyCount + 1, HISTORY_SIZE);
+
+			double sum = 0.0;
+			for (uint32_t h = 0; h < scope.historyCount; ++h)
+			{
+				sum += scope.history[h];
+			}
+			scope.avgMs = sum / scope.historyCount;
+			scope.updated = true;
+			frame.pending[i] = false;
+			anyCollected = true;
+		}
+
+		if (std::none_of(frame.pending.begin(), frame.pending.end(), [](bool pending) { return pending; }))
+		{
+			frame.submitted = false;
+		}
+		return anyCollected;
+	}
+
+	double GpuProfiler::getTotalAvgMs() const
+	{
+		double total = 0.0;
+		for (const auto& scope : scopes)
+		{
+			total += scope.avgMs;
+		}
+		return total;
+	}
+
+	uint32_t GpuProfiler::getScopeIndex(const std::string& name)
+	{
+		if (auto it = scopeIndices.find(name); it != scopeIndices.end())
+		{
+			return it->second;
+		}
+		const auto index = static_cast<uint32_t>(scopes.size());
+		if (index >= MAX_SCOPES)
+		{
+			std::cerr << "GpuProfiler: too many scopes, \"" << name << "\" ignored\n";
+			scopeIndices[name] = MAX_SCOPES;
+			return MAX_SCOPES;
+		}
+		Scope scope;
+		scope.name = name;
+		scopes.emplace_back(scope);
+		scopeIndices[name] = index;
+		return index;
+	}
+}
@@ -0,0 +1,73 @@
+﻿#pragma once
+#include <array>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "vulkan/vulkan.h"
+#include "VulkanDevice.h"
+
+namespace vks
+{
+	/**
+	* @brief 基于timestamp query的GPU分段计时器
+	* @note 每个in-flight的command buffer一个query pool，回读不等待GPU，结果至少延迟一次提交
+	*/
+	class GpuProfiler
+	{
+	public:
+		static constexpr uint32_t MAX_SCOPES = 32;
+		static constexpr uint32_t HISTORY_SIZE = 64;
+
+		struct Scope
+		{
+			std::string name;
+			double lastMs = 0.0;
+			double avgMs = 0.0;
+			// 最近一次collect读到了这个scope的新结果
+			bool updated = false;
+			// 滑动窗口
+			std::array<double, HISTORY_SIZE> history{};
+			uint32_t historyCount = 0;
+			uint32_t historyHead = 0;
+		};
+
+		void create(vks::VulkanDevice* device, uint32_t queueFamilyIndex, uint32_t framesInFlight);
+		void destroy();
+
+		// 在command buffer开头调用，renderpass之外
+		void beginFrame(VkCommandBuffer cmdBuffer, uint32_t frameIndex);
+		void beginScope(VkCommandBuffer cmdBuffer, uint32_t frameIndex, const std::string& name, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+		void endScope(VkCommandBuffer cmdBuffer, uint32_t frameIndex, const std::string& name, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+		// 提交frameIndex对应的command buffer之后调用
+		void markSubmitted(uint32_t frameIndex);
+		// 非阻塞回读，结果还没准备好时直接跳过
+		bool collect(uint32_t frameIndex);
+
+		[[nodiscard]] bool isSupported() const { return supported; }
+		[[nodiscard]] const std::vector<Scope>& getScopes() const { return scopes; }
+		[[nodiscard]] double getTotalAvgMs() const;
+
+	private:
+		uint32_t getScopeIndex(const std::string& name);
+
+		struct FrameQueries
+		{
+			VkQueryPool queryPool = VK_NULL_HANDLE;
+			// 该帧实际录制了哪些scope
+			std::vector<bool> recorded;
+			// 最近一次提交里还没读到结果的scope，全部读完才算这次提交收完
+			std::vector<bool> pending;
+			bool submitted = false;
+		};
+
+		VkDevice device = VK_NULL_HANDLE;
+		bool supported = false;
+		float timestampPeriod = 1.0f;
+		uint64_t timestampMask = ~0ull;
+		std::vector<FrameQueries> frames;
+		std::vector<Scope> scopes;
+		std::unordered_map<std::string, uint32_t> scopeIndices;
+	};
+}
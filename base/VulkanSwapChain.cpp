@@ -208,6 +208,131 @@ void VulkanSwapChain::connect(VkInstance instance, VkPhysicalDevice physicalDevi
 	this->device = device;
 }
 
+/**
+* Switch to offscreen mode: no surface or swapchain is created, frames are rendered to plain images and never presented
+*
+* @param queue Queue used to signal and consume the acquire and present semaphores
+* @param queueFamilyIndex Queue family the images are used on (replaces the present queue lookup done by initSurface)
+*/
+void VulkanSwapChain::initOffscreen(VkQueue queue, uint32_t queueFamilyIndex)
+{
+	offscreen = true;
+	offscreenQueue = queue;
+	queueNodeIndex = queueFamilyIndex;
+	colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+
+	// Use the format a typical swapchain would have, so pipelines and render passes behave the same as with a window
+	colorFormat = VK_FORMAT_B8G8R8A8_UNORM;
+	VkFormatProperties formatProps;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, colorFormat, &formatProps);
+	if (!(formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT))
+	{
+		colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
+	}
+}
+
+/**
+* Create the images used in place of swapchain images in offscreen mode
+*/
+void VulkanSwapChain::createOffscreenImages(uint32_t width, uint32_t height)
+{
+	destroyImages();
+
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+	imageCount = OFFSCREEN_IMAGE_COUNT;
+	images.resize(imageCount);
+	buffers.resize(imageCount);
+	offscreenMemory.resize(imageCount);
+	for (uint32_t i = 0; i < imageCount; i++)
+	{
+		VkImageCreateInfo imageCI = {};
+		imageCI.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageCI.imageType = VK_IMAGE_TYPE_2D;
+		imageCI.format = colorFormat;
+		imageCI.extent = { width, height, 1 };
+		imageCI.mipLevels = 1;
+		imageCI.arrayLayers = 1;
+		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+		// Transfer source so results can still be read back (e.g. for screenshots)
+		imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &images[i]));
+
+		VkMemoryRequirements memReqs;
+		vkGetImageMemoryRequirements(device, images[i], &memReqs);
+		// Prefer device local memory, software implementations may not expose any memory type with that flag
+		uint32_t memoryTypeIndex = UINT32_MAX;
+		for (uint32_t type = 0; type < memoryProperties.memoryTypeCount; type++)
+		{
+			if ((memReqs.memoryTypeBits & (1u << type)) == 0)
+			{
+				continue;
+			}
+			if (memoryTypeIndex == UINT32_MAX || (memoryProperties.memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+			{
+				memoryTypeIndex = type;
+				if (memoryProperties.memoryTypes[type].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+				{
+					break;
+				}
+			}
+		}
+		if (memoryTypeIndex == UINT32_MAX)
+		{
+			vks::tools::exitFatal("Could not find a memory type for the offscreen images!", -1);
+		}
+
+		VkMemoryAllocateInfo memAlloc = {};
+		memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memAlloc.allocationSize = memReqs.size;
+		memAlloc.memoryTypeIndex = memoryTypeIndex;
+		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &offscreenMemory[i]));
+		VK_CHECK_RESULT(vkBindImageMemory(device, images[i], offscreenMemory[i], 0));
+
+		VkImageViewCreateInfo colorAttachmentView = {};
+		colorAttachmentView.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		colorAttachmentView.format = colorFormat;
+		colorAttachmentView.components = {
+			VK_COMPONENT_SWIZZLE_R,
+			VK_COMPONENT_SWIZZLE_G,
+			VK_COMPONENT_SWIZZLE_B,
+			VK_COMPONENT_SWIZZLE_A
+		};
+		colorAttachmentView.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		colorAttachmentView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		colorAttachmentView.image = images[i];
+		buffers[i].image = images[i];
+		VK_CHECK_RESULT(vkCreateImageView(device, &colorAttachmentView, nullptr, &buffers[i].view));
+	}
+	offscreenImageIndex = imageCount - 1;
+}
+
+/**
+* Destroy the image views and, in offscreen mode, the images and their memory
+*/
+void VulkanSwapChain::destroyImages()
+{
+	for (auto& buffer : buffers)
+	{
+		vkDestroyImageView(device, buffer.view, nullptr);
+	}
+	buffers.clear();
+	if (offscreen)
+	{
+		for (uint32_t i = 0; i < images.size(); i++)
+		{
+			vkDestroyImage(device, images[i], nullptr);
+			vkFreeMemory(device, offscreenMemory[i], nullptr);
+		}
+		offscreenMemory.clear();
+	}
+	images.clear();
+}
+
 /** 
 * Create the swapchain and get its images with given width and height
 * 
@@ -217,6 +342,12 @@ void VulkanSwapChain::connect(VkInstance instance, VkPhysicalDevice physicalDevi
 */
 void VulkanSwapChain::create(uint32_t *width, uint32_t *height, bool vsync, bool fullscreen)
 {
+	if (offscreen)
+	{
+		createOffscreenImages(*width, *height);
+		return;
+	}
+
 	// Store the current swap chain handle so we can use it later on to ease up recreation
 	VkSwapchainKHR oldSwapchain = swapChain;
 
@@ -411,6 +542,21 @@ VkResult VulkanSwapChain::acquireNextImage(VkSemaphore presentCompleteSemaphore,
 {
 	// By setting timeout to UINT64_MAX we will always wait until the next image has been acquired or an actual error is thrown
 	// With that we don't have to handle VK_NOT_READY
+	if (offscreen)
+	{
+		// Images are simply rotated, an empty submission signals the semaphore the frame's submission waits on
+		offscreenImageIndex = (offscreenImageIndex + 1) % imageCount;
+		*imageIndex = offscreenImageIndex;
+		if (presentCompleteSemaphore == VK_NULL_HANDLE)
+		{
+			return VK_SUCCESS;
+		}
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &presentCompleteSemaphore;
+		return vkQueueSubmit(offscreenQueue, 1, &submitInfo, VK_NULL_HANDLE);
+	}
 	return vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, presentCompleteSemaphore, (VkFence)nullptr, imageIndex);
 }
 
@@ -425,6 +571,22 @@ VkResult VulkanSwapChain::acquireNextImage(VkSemaphore presentCompleteSemaphore,
 */
 VkResult VulkanSwapChain::queuePresent(VkQueue queue, uint32_t imageIndex, VkSemaphore waitSemaphore)
 {
+	if (offscreen)
+	{
+		// Nothing is presented, but the semaphore still has to be waited on so it can be signaled again next frame
+		if (waitSemaphore == VK_NULL_HANDLE)
+		{
+			return VK_SUCCESS;
+		}
+		const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &waitSemaphore;
+		submitInfo.pWaitDstStageMask = &waitStage;
+		return vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+	}
+
 	VkPresentInfoKHR presentInfo = {};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 	presentInfo.pNext = NULL;
@@ -446,6 +608,11 @@ VkResult VulkanSwapChain::queuePresent(VkQueue queue, uint32_t imageIndex, VkSem
 */
 void VulkanSwapChain::cleanup()
 {
+	if (offscreen)
+	{
+		destroyImages();
+		return;
+	}
 	if (swapChain != VK_NULL_HANDLE)
 	{
 		for (uint32_t i = 0; i < imageCount; i++)
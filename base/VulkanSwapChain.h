@@ -38,8 +38,18 @@ private:
 	VkInstance instance;
 	VkDevice device;
 	VkPhysicalDevice physicalDevice;
-	VkSurfaceKHR surface;
+	VkSurfaceKHR surface = VK_NULL_HANDLE;
+	/** @brief Offscreen mode: plain images instead of a presentable swapchain, no surface required */
+	bool offscreen = false;
+	VkQueue offscreenQueue = VK_NULL_HANDLE;
+	uint32_t offscreenImageIndex = 0;
+	std::vector<VkDeviceMemory> offscreenMemory;
+	void createOffscreenImages(uint32_t width, uint32_t height);
+	void destroyImages();
 public:
+	/** @brief Number of images rotated through in offscreen mode */
+	static constexpr uint32_t OFFSCREEN_IMAGE_COUNT = 3;
+
 	VkFormat colorFormat;
 	VkColorSpaceKHR colorSpace;
 	VkSwapchainKHR swapChain = VK_NULL_HANDLE;	
@@ -69,6 +79,8 @@ public:
 	void initSurface(screen_context_t screen_context, screen_window_t screen_window);
 #endif
 	void connect(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device);
+	void initOffscreen(VkQueue queue, uint32_t queueFamilyIndex);
+	bool isOffscreen() const { return offscreen; }
 	void create(uint32_t* width, uint32_t* height, bool vsync = false, bool fullscreen = false);
 	VkResult acquireNextImage(VkSemaphore presentCompleteSemaphore, uint32_t* imageIndex);
 	VkResult queuePresent(VkQueue queue, uint32_t imageIndex, VkSemaphore waitSemaphore = VK_NULL_HANDLE);
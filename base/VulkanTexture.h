@@ -21,6 +21,7 @@
 #include "VulkanBuffer.h"
 #include "VulkanDevice.h"
 #include "VulkanTools.h"
+#include "VulkanUploadManager.h"
 
 #if defined(__ANDROID__)
 #	include <android/asset_manager.h>
@@ -41,10 +42,16 @@ class Texture
 	uint32_t              layerCount;
 	VkDescriptorImageInfo descriptor;
 	VkSampler             sampler;
+	/** @brief Sub-allocation backing the image, invalid for textures whose deviceMemory is a dedicated allocation */
+	Allocation            allocation;
 
 	void      updateDescriptor();
 	void      destroy();
+	void      allocateImageMemory(vks::VulkanDevice *device, VkMemoryPropertyFlags memoryPropertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 	ktxResult loadKTXFile(std::string filename, ktxTexture **target);
+
+  protected:
+	UploadTicket uploadKTX(ktxTexture *ktxTexture, VkFormat format, uint32_t faceCount, vks::VulkanDevice *device, vks::UploadManager &uploadManager, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout);
 };
 
 class Texture2D : public Texture
@@ -58,6 +65,13 @@ class Texture2D : public Texture
 	    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
 	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
 	    bool               forceLinear     = false);
+	UploadTicket loadFromFile(
+	    std::string         filename,
+	    VkFormat            format,
+	    vks::VulkanDevice * device,
+	    vks::UploadManager &uploadManager,
+	    VkImageUsageFlags   imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+	    VkImageLayout       imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 	void fromBuffer(
 	    void *             buffer,
 	    VkDeviceSize       bufferSize,
@@ -93,5 +107,12 @@ class TextureCubeMap : public Texture
 	    VkQueue            copyQueue,
 	    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
 	    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	UploadTicket loadFromFile(
+	    std::string         filename,
+	    VkFormat            format,
+	    vks::VulkanDevice * device,
+	    vks::UploadManager &uploadManager,
+	    VkImageUsageFlags   imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+	    VkImageLayout       imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 };
 }        // namespace vks
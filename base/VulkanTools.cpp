@@ -8,6 +8,13 @@
 
 #include "VulkanTools.h"
 
+#if !defined(_WIN32) && !defined(__ANDROID__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #if !(defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK))
 // iOS & macOS: VulkanExampleBase::getAssetPath() implemented externally to allow access to Objective-C components
 const std::string getAssetPath()
@@ -441,5 +448,86 @@ namespace vks
 			return (value + alignment - 1) & ~(alignment - 1);
 		}
 
+		MappedFile::~MappedFile()
+		{
+			close();
+		}
+
+		bool MappedFile::open(const std::string &filename)
+		{
+			close();
+#if defined(_WIN32)
+			file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (file == INVALID_HANDLE_VALUE) {
+				return false;
+			}
+			LARGE_INTEGER fileSize{};
+			GetFileSizeEx(file, &fileSize);
+			length = static_cast<size_t>(fileSize.QuadPart);
+			mapping = length > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+			if (mapping) {
+				bytes = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			}
+#elif defined(__ANDROID__)
+			// APK里未压缩的asset用BUFFER模式可以直接拿到映射
+			asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_BUFFER);
+			if (!asset) {
+				return false;
+			}
+			length = AAsset_getLength(asset);
+			bytes = static_cast<const uint8_t*>(AAsset_getBuffer(asset));
+#else
+			const int fd = ::open(filename.c_str(), O_RDONLY);
+			if (fd < 0) {
+				return false;
+			}
+			struct stat fileStat{};
+			if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0) {
+				length = static_cast<size_t>(fileStat.st_size);
+				void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (mapped != MAP_FAILED) {
+					// 整个文件都会被顺序读完，提前让内核预读
+					madvise(mapped, length, MADV_SEQUENTIAL | MADV_WILLNEED);
+					bytes = static_cast<const uint8_t*>(mapped);
+				}
+			}
+			// 映射建立后fd就可以关掉
+			::close(fd);
+#endif
+			if (!bytes) {
+				close();
+				return false;
+			}
+			return true;
+		}
+
+		void MappedFile::close()
+		{
+#if defined(_WIN32)
+			if (bytes) {
+				UnmapViewOfFile(bytes);
+			}
+			if (mapping) {
+				CloseHandle(mapping);
+			}
+			if (file != INVALID_HANDLE_VALUE) {
+				CloseHandle(file);
+			}
+			mapping = nullptr;
+			file = INVALID_HANDLE_VALUE;
+#elif defined(__ANDROID__)
+			if (asset) {
+				AAsset_close(asset);
+			}
+			asset = nullptr;
+#else
+			if (bytes) {
+				munmap(const_cast<uint8_t*>(bytes), length);
+			}
+#endif
+			bytes = nullptr;
+			length = 0;
+		}
+
 	}
 }
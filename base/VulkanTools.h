@@ -133,5 +133,30 @@ namespace vks
 		bool fileExists(const std::string &filename);
 
 		uint32_t alignedSize(uint32_t value, uint32_t alignment);
+
+		/** @brief Read-only memory mapping of a whole file, unmapped on destruction */
+		class MappedFile
+		{
+		public:
+			MappedFile() = default;
+			~MappedFile();
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+
+			bool open(const std::string &filename);
+			void close();
+			const uint8_t* data() const { return bytes; }
+			size_t size() const { return length; }
+
+		private:
+			const uint8_t* bytes = nullptr;
+			size_t length = 0;
+#if defined(_WIN32)
+			HANDLE file = INVALID_HANDLE_VALUE;
+			HANDLE mapping = nullptr;
+#elif defined(__ANDROID__)
+			AAsset* asset = nullptr;
+#endif
+		};
 	}
 }
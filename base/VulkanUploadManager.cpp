@@ -0,0 +1,358 @@
+#include "VulkanUploadManager.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+namespace vks
+{
+	namespace
+	{
+		VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+	}
+
+	void UploadManager::create(vks::VulkanDevice* vulkanDevice, bool timelineSupported, VkDeviceSize size)
+	{
+		device = vulkanDevice;
+		vkGetDeviceQueue(device->logicalDevice, device->queueFamilyIndices.transfer, 0, &transferQueue);
+		cmdPool = device->createCommandPool(device->queueFamilyIndices.transfer);
+
+		if (timelineSupported)
+		{
+			getSemaphoreCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkGetSemaphoreCounterValueKHR"));
+			waitSemaphores = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(vkGetDeviceProcAddr(device->logicalDevice, "vkWaitSemaphoresKHR"));
+		}
+		if (getSemaphoreCounterValue && waitSemaphores)
+		{
+			VkSemaphoreTypeCreateInfoKHR typeCI{};
+			typeCI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+			typeCI.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+			typeCI.initialValue = 0;
+			VkSemaphoreCreateInfo semaphoreCI = vks::initializers::semaphoreCreateInfo();
+			semaphoreCI.pNext = &typeCI;
+			VK_CHECK_RESULT(vkCreateSemaphore(device->logicalDevice, &semaphoreCI, nullptr, &timeline));
+		}
+		else
+		{
+			std::cerr << "UploadManager: timeline semaphores not supported, falling back to per-batch fences\n";
+		}
+
+		// staging环常驻映射，coherent内存提交时host写入自动可见，不用flush
+		ringSize = size;
+		maxChunk = ringSize / 4;
+		copyAlignment = std::max<VkDeviceSize>(16, device->properties.limits.optimalBufferCopyOffsetAlignment);
+		VK_CHECK_RESULT(device->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &ring, ringSize));
+		VK_CHECK_RESULT(ring.map());
+	}
+
+	void UploadManager::destroy()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!device) return;
+		flushLocked();
+		device->queueWaitIdle(transferQueue);
+		collectLocked();
+
+		// 销毁pool时command buffer一起释放
+		vkDestroyCommandPool(device->logicalDevice, cmdPool, nullptr);
+		for (VkFence fence : freeFences)
+		{
+			vkDestroyFence(device->logicalDevice, fence, nullptr);
+		}
+		if (timeline != VK_NULL_HANDLE)
+		{
+			vkDestroySemaphore(device->logicalDevice, timeline, nullptr);
+		}
+		ring.destroy();
+
+		device = nullptr;
+		transferQueue = VK_NULL_HANDLE;
+		cmdPool = VK_NULL_HANDLE;
+		timeline = VK_NULL_HANDLE;
+		getSemaphoreCounterValue = nullptr;
+		waitSemaphores = nullptr;
+		ringHead = ringTail = 0;
+		current = Batch();
+		recording = false;
+		inFlight.clear();
+		freeCmdBuffers.clear();
+		freeFences.clear();
+		nextTicket = 1;
+		completedTicket = 0;
+		submitCount = 0;
+	}
+
+	UploadTicket UploadManager::uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		assert(device && data);
+		const uint8_t* src = static_cast<const uint8_t*>(data);
+		VkDeviceSize done = 0;
+		while (done < size)
+		{
+			const VkDeviceSize chunk = std::min(size - done, maxChunk);
+			const VkDeviceSize ringOffset = stage(src + done, chunk);
+			VkBufferCopy region{ ringOffset, dstOffset + done, chunk };
+			vkCmdCopyBuffer(current.cmdBuffer, ring.buffer, dstBuffer, 1, &region);
+			done += chunk;
+		}
+		// 当前批次提交时会拿到nextTicket；中途因为环满提交过的部分ticket更小
+		return recording ? nextTicket : getLastSubmitted();
+	}
+
+	UploadTicket UploadManager::uploadImage(VkImage dstImage, const VkImageSubresourceRange& range, const std::vector<VkBufferImageCopy>& regions, const std::vector<VkDeviceSize>& regionSizes, const void* data, VkImageLayout finalLayout)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		assert(device && data && regions.size() == regionSizes.size());
+		const uint8_t* src = static_cast<const uint8_t*>(data);
+
+		VkImageMemoryBarrier barrier = vks::initializers::imageMemoryBarrier();
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = dstImage;
+		barrier.subresourceRange = range;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		if (!recording)
+		{
+			beginBatch();
+		}
+		vkCmdPipelineBarrier(current.cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		for (size_t i = 0; i < regions.size(); i++)
+		{
+			const VkBufferImageCopy& region = regions[i];
+			const VkDeviceSize regionSize = regionSizes[i];
+			// 一行的字节数，region太大时按行拆成几次拷贝；中途换批次时同一队列上的提交顺序保证barrier在前
+			const uint32_t rows = region.imageExtent.height * region.imageExtent.depth;
+			assert(regionSize <= maxChunk || (region.imageExtent.depth == 1 && regionSize % rows == 0));
+			const VkDeviceSize rowBytes = regionSize / rows;
+			const uint32_t rowsPerChunk = regionSize <= maxChunk ? rows : static_cast<uint32_t>(std::max<VkDeviceSize>(1, maxChunk / rowBytes));
+			for (uint32_t row = 0; row < rows; row += rowsPerChunk)
+			{
+				const uint32_t rowCount = std::min(rowsPerChunk, rows - row);
+				const VkDeviceSize chunk = regionSize <= maxChunk ? regionSize : rowCount * rowBytes;
+				VkBufferImageCopy copy = region;
+				copy.bufferOffset = stage(src + region.bufferOffset + row * rowBytes, chunk);
+				copy.bufferRowLength = 0;
+				copy.bufferImageHeight = 0;
+				if (regionSize > maxChunk)
+				{
+					copy.imageOffset.y += static_cast<int32_t>(row);
+					copy.imageExtent.height = rowCount;
+				}
+				vkCmdCopyBufferToImage(current.cmdBuffer, ring.buffer, dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+			}
+		}
+
+		// transfer队列不一定支持着色器阶段，这里只做布局转换，可见性交给semaphore/host等待
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = finalLayout;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(current.cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		return nextTicket;
+	}
+
+	UploadTicket UploadManager::flush()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return flushLocked();
+	}
+
+	bool UploadManager::isComplete(UploadTicket ticket)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return ticket <= completedTicket || ticket <= getCompletedTicket();
+	}
+
+	void UploadManager::wait(UploadTicket ticket)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		waitLocked(ticket);
+	}
+
+	void UploadManager::collect()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		collectLocked();
+	}
+
+	UploadTicket UploadManager::flushLocked()
+	{
+		if (!recording)
+		{
+			return getLastSubmitted();
+		}
+		VK_CHECK_RESULT(vkEndCommandBuffer(current.cmdBuffer));
+		current.ticket = nextTicket++;
+
+		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &current.cmdBuffer;
+		VkTimelineSemaphoreSubmitInfoKHR timelineInfo{};
+		if (usesTimeline())
+		{
+			timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+			timelineInfo.signalSemaphoreValueCount = 1;
+			timelineInfo.pSignalSemaphoreValues = &current.ticket;
+			submitInfo.pNext = &timelineInfo;
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &timeline;
+		}
+		else
+		{
+			if (freeFences.empty())
+			{
+				VkFenceCreateInfo fenceCI = vks::initializers::fenceCreateInfo();
+				VK_CHECK_RESULT(vkCreateFence(device->logicalDevice, &fenceCI, nullptr, &current.fence));
+			}
+			else
+			{
+				current.fence = freeFences.back();
+				freeFences.pop_back();
+			}
+		}
+		// transfer族不独立时和图形队列是同一个VkQueue，和主线程的提交共用一把锁
+		VK_CHECK_RESULT(device->queueSubmit(transferQueue, 1, &submitInfo, current.fence));
+
+		inFlight.push_back(current);
+		current = Batch();
+		recording = false;
+		submitCount++;
+		return getLastSubmitted();
+	}
+
+	void UploadManager::waitLocked(UploadTicket ticket)
+	{
+		if (ticket > getLastSubmitted())
+		{
+			flushLocked();
+		}
+		if (ticket <= getCompletedTicket()) return;
+
+		if (usesTimeline())
+		{
+			VkSemaphoreWaitInfoKHR waitInfo{};
+			waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+			waitInfo.semaphoreCount = 1;
+			waitInfo.pSemaphores = &timeline;
+			waitInfo.pValues = &ticket;
+			VK_CHECK_RESULT(waitSemaphores(device->logicalDevice, &waitInfo, UINT64_MAX));
+		}
+		else
+		{
+			std::vector<VkFence> fences;
+			for (const Batch& batch : inFlight)
+			{
+				if (batch.ticket > ticket) break;
+				fences.push_back(batch.fence);
+			}
+			if (!fences.empty())
+			{
+				VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, static_cast<uint32_t>(fences.size()), fences.data(), VK_TRUE, UINT64_MAX));
+			}
+		}
+		collectLocked();
+	}
+
+	void UploadManager::collectLocked()
+	{
+		if (!device) return;
+		const UploadTicket completed = getCompletedTicket();
+		while (!inFlight.empty() && inFlight.front().ticket <= completed)
+		{
+			retire(inFlight.front());
+			inFlight.pop_front();
+		}
+	}
+
+	UploadTicket UploadManager::getCompletedTicket()
+	{
+		if (usesTimeline())
+		{
+			uint64_t value = 0;
+			VK_CHECK_RESULT(getSemaphoreCounterValue(device->logicalDevice, timeline, &value));
+			completedTicket = std::max(completedTicket, value);
+		}
+		else
+		{
+			// 同一队列上的批次按提交顺序完成，遇到第一个没完成的就停
+			for (const Batch& batch : inFlight)
+			{
+				if (vkGetFenceStatus(device->logicalDevice, batch.fence) != VK_SUCCESS) break;
+				completedTicket = std::max(completedTicket, batch.ticket);
+			}
+		}
+		return completedTicket;
+	}
+
+	VkDeviceSize UploadManager::stage(const void* data, VkDeviceSize size)
+	{
+		const VkDeviceSize reserved = alignUp(size, copyAlignment);
+		// 放不下就跳到环开头，尾部这段填充随下一个批次一起回收
+		const VkDeviceSize position = ringHead % ringSize;
+		if (position + reserved > ringSize)
+		{
+			ringHead += ringSize - position;
+		}
+		while (ringHead + reserved - ringTail > ringSize)
+		{
+			// 环满：把正在录的批次交出去，再等最旧的批次
+			if (recording)
+			{
+				flushLocked();
+			}
+			if (inFlight.empty())
+			{
+				ringTail = ringHead;
+				break;
+			}
+			waitLocked(inFlight.front().ticket);
+		}
+		const VkDeviceSize offset = ringHead % ringSize;
+		ringHead += reserved;
+		memcpy(static_cast<uint8_t*>(ring.mapped) + offset, data, size);
+
+		if (!recording)
+		{
+			beginBatch();
+		}
+		current.ringEnd = ringHead;
+		return offset;
+	}
+
+	void UploadManager::beginBatch()
+	{
+		if (freeCmdBuffers.empty())
+		{
+			current.cmdBuffer = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, cmdPool, false);
+		}
+		else
+		{
+			current.cmdBuffer = freeCmdBuffers.back();
+			freeCmdBuffers.pop_back();
+		}
+		VkCommandBufferBeginInfo beginInfo = vks::initializers::commandBufferBeginInfo();
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(current.cmdBuffer, &beginInfo));
+		recording = true;
+	}
+
+	void UploadManager::retire(const Batch& batch)
+	{
+		ringTail = std::max(ringTail, batch.ringEnd);
+		// pool带RESET_COMMAND_BUFFER_BIT，下次begin时隐式reset
+		freeCmdBuffers.push_back(batch.cmdBuffer);
+		if (batch.fence != VK_NULL_HANDLE)
+		{
+			VK_CHECK_RESULT(vkResetFences(device->logicalDevice, 1, &batch.fence));
+			freeFences.push_back(batch.fence);
+		}
+	}
+}
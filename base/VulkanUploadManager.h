@@ -0,0 +1,92 @@
+#pragma once
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+#include "VulkanBuffer.h"
+#include "VulkanDevice.h"
+
+namespace vks
+{
+	// 单调递增的批次编号，完成值大于等于它时对应的上传已经写入目标buffer
+	using UploadTicket = uint64_t;
+
+	/**
+	* @brief 批量上传：数据先拷进常驻映射的staging环，拷贝命令攒成一批在transfer队列上一次提交
+	* @note 完成情况用timeline semaphore跟踪，不支持时退回每批一个fence；线程安全，加载线程可以直接往环里写
+	* @note 目标buffer/image需要能被transfer队列族访问，队列族不同时用VulkanDevice::getSharedQueueFamilies()创建成concurrent
+	*/
+	class UploadManager
+	{
+	public:
+		static constexpr VkDeviceSize DEFAULT_RING_SIZE = 64ull << 20;
+
+		void create(vks::VulkanDevice* device, bool timelineSupported, VkDeviceSize ringSize = DEFAULT_RING_SIZE);
+		void destroy();
+
+		// 数据立即拷进staging环，调用返回后源内存就可以释放；环满时先提交当前批次并等最旧的批次完成
+		UploadTicket uploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+		// regions的bufferOffset相对data，regionSizes是每个region的字节数；整个range从UNDEFINED转到finalLayout
+		// 超过单次上限的region按行拆分，只支持非压缩格式
+		UploadTicket uploadImage(VkImage dstImage, const VkImageSubresourceRange& range, const std::vector<VkBufferImageCopy>& regions, const std::vector<VkDeviceSize>& regionSizes, const void* data, VkImageLayout finalLayout);
+		// 提交当前批次，返回它的ticket；没有待提交的拷贝时返回最近一次提交的ticket
+		UploadTicket flush();
+
+		[[nodiscard]] bool isComplete(UploadTicket ticket);
+		void wait(UploadTicket ticket);
+		// 回收已完成批次占用的环空间和command buffer，每帧调用一次
+		void collect();
+
+		[[nodiscard]] bool isCreated() const { return device != nullptr; }
+		[[nodiscard]] bool usesTimeline() const { return timeline != VK_NULL_HANDLE; }
+		[[nodiscard]] UploadTicket getLastSubmitted() const { return nextTicket - 1; }
+		[[nodiscard]] uint64_t getSubmitCount() const { return submitCount; }
+
+	private:
+		struct Batch
+		{
+			VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			UploadTicket ticket = 0;
+			// 这个批次用到的环空间的末尾(虚拟偏移)
+			uint64_t ringEnd = 0;
+		};
+
+		// 以下都要求已经持有mutex
+		UploadTicket flushLocked();
+		void waitLocked(UploadTicket ticket);
+		void collectLocked();
+		[[nodiscard]] UploadTicket getCompletedTicket();
+		// 在环里预留size字节并拷入数据，返回实际偏移，确保当前批次在录制
+		VkDeviceSize stage(const void* data, VkDeviceSize size);
+		void beginBatch();
+		void retire(const Batch& batch);
+
+		std::mutex mutex;
+		vks::VulkanDevice* device = nullptr;
+		VkQueue transferQueue = VK_NULL_HANDLE;
+		VkCommandPool cmdPool = VK_NULL_HANDLE;
+		VkSemaphore timeline = VK_NULL_HANDLE;
+		PFN_vkGetSemaphoreCounterValueKHR getSemaphoreCounterValue = nullptr;
+		PFN_vkWaitSemaphoresKHR waitSemaphores = nullptr;
+
+		vks::Buffer ring;
+		VkDeviceSize ringSize = 0;
+		// 单次拷贝不超过环的1/4，绕回时的填充再大也放得下
+		VkDeviceSize maxChunk = 0;
+		VkDeviceSize copyAlignment = 16;
+		// 虚拟偏移，对ringSize取模得到实际位置
+		uint64_t ringHead = 0;
+		uint64_t ringTail = 0;
+
+		Batch current;
+		bool recording = false;
+		std::deque<Batch> inFlight;
+		std::vector<VkCommandBuffer> freeCmdBuffers;
+		std::vector<VkFence> freeFences;
+		UploadTicket nextTicket = 1;
+		UploadTicket completedTicket = 0;
+		uint64_t submitCount = 0;
+	};
+}
@@ -11,6 +11,7 @@
 #define TINYGLTF_NO_STB_IMAGE_WRITE
 
 #include "VulkanglTFModel.h"
+#include "JobSystem.h"
 
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutImage = VK_NULL_HANDLE;
 VkDescriptorSetLayout vkglTF::descriptorSetLayoutUbo = VK_NULL_HANDLE;
@@ -19,8 +20,9 @@ uint32_t vkglTF::descriptorBindingFlags = vkglTF::DescriptorBindingFlags::ImageB
 
 /*
 	We use a custom image loading function with tinyglTF, so we can do custom stuff loading ktx textures
+	While parsing only the encoded bytes are kept, they are decoded in parallel on a thread pool afterwards
 */
-bool loadImageDataFunc(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int req_width, int req_height, const unsigned char* bytes, int size, void* userData)
+bool deferImageDataFunc(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int req_width, int req_height, const unsigned char* bytes, int size, void* userData)
 {
 	// KTX files will be handled by our own code
 	if (image->uri.find_last_of(".") != std::string::npos) {
@@ -29,7 +31,29 @@ bool loadImageDataFunc(tinygltf::Image* image, const int imageIndex, std::string
 		}
 	}
 
-	return tinygltf::LoadImageData(image, imageIndex, error, warning, req_width, req_height, bytes, size, userData);
+	auto* encodedImages = static_cast<std::vector<std::vector<unsigned char>>*>(userData);
+	if (encodedImages->size() <= static_cast<size_t>(imageIndex)) {
+		encodedImages->resize(imageIndex + 1);
+	}
+	(*encodedImages)[imageIndex].assign(bytes, bytes + size);
+	return true;
+}
+
+void decodeImages(tinygltf::Model& gltfModel, std::vector<std::vector<unsigned char>>& encodedImages)
+{
+	vks::JobSystem::shared().parallelFor(static_cast<uint32_t>(encodedImages.size()), 1, [&gltfModel, &encodedImages](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; i++) {
+			std::vector<unsigned char>& encoded = encodedImages[i];
+			if (encoded.empty()) {
+				continue;
+			}
+			std::string error, warning;
+			if (!tinygltf::LoadImageData(&gltfModel.images[i], static_cast<int>(i), &error, &warning, 0, 0, encoded.data(), static_cast<int>(encoded.size()), nullptr)) {
+				std::cerr << "Could not decode glTF image " << gltfModel.images[i].uri << ": " << error << "\n";
+			}
+			std::vector<unsigned char>().swap(encoded);
+		}
+	});
 }
 
 bool loadImageDataFuncEmpty(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int req_width, int req_height, const unsigned char* bytes, int size, void* userData) 
@@ -1161,10 +1185,11 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 {
 	tinygltf::Model gltfModel;
 	tinygltf::TinyGLTF gltfContext;
+	std::vector<std::vector<unsigned char>> encodedImages;
 	if (fileLoadingFlags & FileLoadingFlags::DontLoadImages) {
 		gltfContext.SetImageLoader(loadImageDataFuncEmpty, nullptr);
 	} else {
-		gltfContext.SetImageLoader(loadImageDataFunc, nullptr);
+		gltfContext.SetImageLoader(deferImageDataFunc, &encodedImages);
 	}
 #if defined(__ANDROID__)
 	// On Android all assets are packed with the apk in a compressed form, so we need to open them using the asset manager
@@ -1189,6 +1214,7 @@ void vkglTF::Model::loadFromFile(std::string filename, vks::VulkanDevice *device
 
 	if (fileLoaded) {
 		if (!(fileLoadingFlags & FileLoadingFlags::DontLoadImages)) {
+			decodeImages(gltfModel, encodedImages);
 			loadImages(gltfModel, device, transferQueue);
 		}
 		loadMaterials(gltfModel);
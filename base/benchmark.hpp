@@ -13,6 +13,13 @@
 #include <functional>
 #include <chrono>
 #include <iomanip>
+#include <map>
+#include <numeric>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+
+#include "CameraPath.h"
 
 namespace vks
 {
@@ -28,11 +35,57 @@ namespace vks
 		uint32_t duration = 10;
 		std::vector<double> frameTimes;
 		std::string filename = "";
+		// Render target description, only used for the report
+		uint32_t width = 0;
+		uint32_t height = 0;
+		bool offscreen = false;
 
 		double runtime = 0.0;
 		uint32_t frameCount = 0;
 
-		void run(std::function<void()> renderFunc, VkPhysicalDeviceProperties deviceProps) {
+		// Per pass GPU times (ms) and generic per frame counters, filled by the example during the benchmark phase
+		// GPU results are read back with a delay of at least one frame, so series start a few frames after frameTimes
+		std::map<std::string, std::vector<double>> passTimes;
+		std::map<std::string, std::vector<double>> counters;
+		bool measuring = false;
+
+		// Optional camera path, when set the benchmark renders frames at fixed steps of path time instead of running for a fixed duration
+		// so every run sees exactly the same views regardless of frame rate
+		vks::CameraPath cameraPath;
+		float pathFrameStep = 1.0f / 60.0f;
+		std::vector<float> framePathTimes;
+
+		static constexpr double PERCENTILES[] = { 50.0, 90.0, 99.0, 99.9 };
+
+		// Nearest rank percentile
+		static double percentile(std::vector<double> values, double p) {
+			if (values.empty()) {
+				return 0.0;
+			}
+			std::sort(values.begin(), values.end());
+			const size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * static_cast<double>(values.size())));
+			return values[std::clamp<size_t>(rank, 1, values.size()) - 1];
+		}
+
+		static std::string percentileName(double p) {
+			std::ostringstream name;
+			name << "p" << p;
+			return name.str();
+		}
+
+		void addPassTime(const std::string& name, double ms) {
+			if (measuring) {
+				passTimes[name].push_back(ms);
+			}
+		}
+
+		void addCounter(const std::string& name, double value) {
+			if (measuring) {
+				counters[name].push_back(value);
+			}
+		}
+
+		void run(std::function<void()> renderFunc, VkPhysicalDeviceProperties deviceProps, Camera* camera = nullptr) {
 			active = true;
 			this->deviceProps = deviceProps;
 #if defined(_WIN32)
@@ -42,6 +95,16 @@ namespace vks
 #endif
 			std::cout << std::fixed << std::setprecision(3);
 
+			const bool playPath = camera && !cameraPath.empty();
+			uint32_t pathFrames = 0;
+			if (playPath) {
+				pathFrames = static_cast<uint32_t>(std::floor(cameraPath.getDuration() / pathFrameStep)) + 1;
+				if (outputFrames != -1) {
+					pathFrames = std::min(pathFrames, static_cast<uint32_t>(outputFrames));
+				}
+				cameraPath.apply(*camera, cameraPath.getKeyframes().front().time);
+			}
+
 			// Warm up phase to get more stable frame rates
 			{
 				double tMeasured = 0.0;
@@ -55,36 +118,218 @@ namespace vks
 
 			// Benchmark phase
 			{
-				while (runtime < (duration * 1000.0)) {
-					auto tStart = std::chrono::high_resolution_clock::now();
-					renderFunc();
-					auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
-					runtime += tDiff;
-					frameTimes.push_back(tDiff);
-					frameCount++;
-					if (outputFrames != -1 && outputFrames == frameCount) break;
-				};
+				measuring = true;
+				if (playPath) {
+					for (uint32_t frame = 0; frame < pathFrames; frame++) {
+						const float pathTime = cameraPath.getKeyframes().front().time + static_cast<float>(frame) * pathFrameStep;
+						cameraPath.apply(*camera, pathTime);
+						auto tStart = std::chrono::high_resolution_clock::now();
+						renderFunc();
+						auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+						runtime += tDiff;
+						frameTimes.push_back(tDiff);
+						framePathTimes.push_back(pathTime);
+						frameCount++;
+					}
+				}
+				else {
+					while (runtime < (duration * 1000.0)) {
+						auto tStart = std::chrono::high_resolution_clock::now();
+						renderFunc();
+						auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+						runtime += tDiff;
+						frameTimes.push_back(tDiff);
+						frameCount++;
+						if (outputFrames != -1 && outputFrames == frameCount) break;
+					};
+				}
+				measuring = false;
 				std::cout << "Benchmark finished" << "\n";
 				std::cout << "device : " << deviceProps.deviceName << " (driver version: " << deviceProps.driverVersion << ")" << "\n";
+				std::cout << "target : " << width << "x" << height << (offscreen ? " offscreen" : "") << "\n";
 				std::cout << "runtime: " << (runtime / 1000.0) << "\n";
 				std::cout << "frames : " << frameCount << "\n";
 				std::cout << "fps    : " << frameCount / (runtime / 1000.0) << "\n";
+				if (playPath) {
+					std::cout << "path   : " << cameraPath.getKeyframeCount() << " keyframes, " << cameraPath.getDuration() << " s" << "\n";
+				}
+				for (double p : PERCENTILES) {
+					std::cout << std::left << std::setw(7) << percentileName(p) << std::right << ": " << percentile(frameTimes, p) << " ms" << "\n";
+				}
+				for (auto& [name, times] : passTimes) {
+					if (times.empty()) continue;
+					double tAvg = std::accumulate(times.begin(), times.end(), 0.0) / (double)times.size();
+					std::cout << "gpu " << name << ": " << tAvg << " ms (p99 " << percentile(times, 99.0) << " ms)" << "\n";
+				}
+				for (auto& [name, values] : counters) {
+					if (values.empty()) continue;
+					double vAvg = std::accumulate(values.begin(), values.end(), 0.0) / (double)values.size();
+					std::cout << name << ": " << vAvg << "\n";
+				}
+			}
+		}
+
+		void writeSeries(std::ofstream& result, const std::string& header, const std::map<std::string, std::vector<double>>& series) {
+			if (series.empty()) {
+				return;
+			}
+			result << "\n" << header << "\n";
+			for (auto& [name, values] : series) {
+				if (values.empty()) continue;
+				double vMin = *std::min_element(values.begin(), values.end());
+				double vMax = *std::max_element(values.begin(), values.end());
+				double vAvg = std::accumulate(values.begin(), values.end(), 0.0) / (double)values.size();
+				result << name << "," << values.size() << "," << vAvg << "," << vMin << "," << vMax;
+				for (double p : PERCENTILES) {
+					result << "," << percentile(values, p);
+				}
+				result << "\n";
+			}
+		}
+
+		static std::string seriesHeader(const std::string& prefix) {
+			std::string header = prefix + ",samples,avg,min,max";
+			for (double p : PERCENTILES) {
+				header += "," + percentileName(p);
+			}
+			return header;
+		}
+
+		// One row per frame with path time, frame time and every pass / counter series, missing samples are left empty
+		void writeFrames(std::ofstream& result) {
+			result << "\n" << "frame,path time (s),ms";
+			for (auto& [name, values] : passTimes) {
+				result << ",gpu " << name << " (ms)";
+			}
+			for (auto& [name, values] : counters) {
+				result << "," << name;
+			}
+			result << "\n";
+			for (size_t i = 0; i < frameTimes.size(); i++) {
+				result << i << ",";
+				if (i < framePathTimes.size()) {
+					result << framePathTimes[i];
+				}
+				result << "," << frameTimes[i];
+				for (auto& [name, values] : passTimes) {
+					result << ",";
+					if (i < values.size()) result << values[i];
+				}
+				for (auto& [name, values] : counters) {
+					result << ",";
+					if (i < values.size()) result << values[i];
+				}
+				result << "\n";
 			}
 		}
 
+		static std::string jsonString(const std::string& value) {
+			std::string escaped = "\"";
+			for (char c : value) {
+				if (c == '"' || c == '\\') escaped += '\\';
+				escaped += c;
+			}
+			return escaped + "\"";
+		}
+
+		static void writeJsonArray(std::ofstream& result, const std::vector<double>& values) {
+			result << "[";
+			for (size_t i = 0; i < values.size(); i++) {
+				result << (i > 0 ? "," : "") << values[i];
+			}
+			result << "]";
+		}
+
+		static void writeJsonStats(std::ofstream& result, const std::vector<double>& values) {
+			const double vAvg = values.empty() ? 0.0 : std::accumulate(values.begin(), values.end(), 0.0) / (double)values.size();
+			const double vMin = values.empty() ? 0.0 : *std::min_element(values.begin(), values.end());
+			const double vMax = values.empty() ? 0.0 : *std::max_element(values.begin(), values.end());
+			result << "{\"samples\":" << values.size() << ",\"avg\":" << vAvg << ",\"min\":" << vMin << ",\"max\":" << vMax;
+			for (double p : PERCENTILES) {
+				result << "," << jsonString(percentileName(p)) << ":" << percentile(values, p);
+			}
+			result << "}";
+		}
+
+		static void writeJsonSeries(std::ofstream& result, const std::map<std::string, std::vector<double>>& series, bool perFrame) {
+			result << "{";
+			bool first = true;
+			for (auto& [name, values] : series) {
+				if (values.empty()) continue;
+				result << (first ? "" : ",") << "\n\t\t" << jsonString(name) << ":";
+				if (perFrame) {
+					writeJsonArray(result, values);
+				}
+				else {
+					writeJsonStats(result, values);
+				}
+				first = false;
+			}
+			result << "}";
+		}
+
+		void saveJson(std::ofstream& result) {
+			result << "{\n";
+			result << "\t\"device\":" << jsonString(deviceProps.deviceName) << ",\n";
+			result << "\t\"driverVersion\":" << deviceProps.driverVersion << ",\n";
+			result << "\t\"width\":" << width << ",\n";
+			result << "\t\"height\":" << height << ",\n";
+			result << "\t\"offscreen\":" << (offscreen ? "true" : "false") << ",\n";
+			result << "\t\"cameraPath\":" << (framePathTimes.empty() ? "false" : "true") << ",\n";
+			result << "\t\"runtimeMs\":" << runtime << ",\n";
+			result << "\t\"frames\":" << frameCount << ",\n";
+			result << "\t\"fps\":" << frameCount / (runtime / 1000.0) << ",\n";
+			result << "\t\"frameTime\":";
+			writeJsonStats(result, frameTimes);
+			result << ",\n\t\"passes\":";
+			writeJsonSeries(result, passTimes, false);
+			result << ",\n\t\"counters\":";
+			writeJsonSeries(result, counters, false);
+			if (outputFrameTimes || !framePathTimes.empty()) {
+				result << ",\n\t\"perFrame\":{\n\t\t\"ms\":";
+				writeJsonArray(result, frameTimes);
+				result << ",\n\t\t\"pathTime\":";
+				writeJsonArray(result, std::vector<double>(framePathTimes.begin(), framePathTimes.end()));
+				result << ",\n\t\t\"passes\":";
+				writeJsonSeries(result, passTimes, true);
+				result << ",\n\t\t\"counters\":";
+				writeJsonSeries(result, counters, true);
+				result << "\n\t}";
+			}
+			result << "\n}\n";
+		}
+
+		// Results are written as JSON when the file name ends with .json, as CSV otherwise
 		void saveResults() {
 			std::ofstream result(filename, std::ios::out);
 			if (result.is_open()) {
 				result << std::fixed << std::setprecision(4);
 
-				result << "device,driverversion,duration (ms),frames,fps" << "\n";
-				result << deviceProps.deviceName << "," << deviceProps.driverVersion << "," << runtime << "," << frameCount << "," << frameCount / (runtime / 1000.0) << "\n";
+				const bool json = filename.size() >= 5 && filename.compare(filename.size() - 5, 5, ".json") == 0;
+				if (json) {
+					saveJson(result);
+				}
+				else {
+					result << "device,driverversion,duration (ms),frames,fps";
+					for (double p : PERCENTILES) {
+						result << "," << percentileName(p) << " (ms)";
+					}
+					result << "\n";
+					result << deviceProps.deviceName << "," << deviceProps.driverVersion << "," << runtime << "," << frameCount << "," << frameCount / (runtime / 1000.0);
+					for (double p : PERCENTILES) {
+						result << "," << percentile(frameTimes, p);
+					}
+					result << "\n";
 
-				if (outputFrameTimes) {
-					result << "\n" << "frame,ms" << "\n";
-					for (size_t i = 0; i < frameTimes.size(); i++) {
-						result << i << "," << frameTimes[i] << "\n";
+					writeSeries(result, seriesHeader("pass (ms)"), passTimes);
+					writeSeries(result, seriesHeader("counter"), counters);
+
+					if (outputFrameTimes || !framePathTimes.empty()) {
+						writeFrames(result);
 					}
+				}
+
+				if (outputFrameTimes) {
 					double tMin = *std::min_element(frameTimes.begin(), frameTimes.end());
 					double tMax = *std::max_element(frameTimes.begin(), frameTimes.end());
 					double tAvg = std::accumulate(frameTimes.begin(), frameTimes.end(), 0.0) / (double)frameTimes.size();
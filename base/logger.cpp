@@ -1,7 +1,362 @@
 ﻿#include "logger.h"
 
+#include <cstring>
+#include <ctime>
+
 namespace Log
 {
+	namespace
+	{
+		// 写线程没有Flush请求时的轮询间隔，生产者不通知写线程
+		constexpr auto WRITER_INTERVAL = std::chrono::milliseconds(5);
+		constexpr uint32_t MIN_SLOTS_PER_THREAD = 16;
+
+		struct RecordSpan
+		{
+			Level level;
+			size_t begin;
+			size_t end;
+		};
+	}
+
+	struct Logger::ThreadRing
+	{
+		explicit ThreadRing(uint32_t slotCount) : slots(slotCount), mask(slotCount - 1) {}
+
+		std::vector<RecordSlot> slots;
+		uint64_t mask;
+		// head只由所属线程写，tail只由写线程写
+		alignas(64) std::atomic<uint64_t> head{0};
+		alignas(64) std::atomic<uint64_t> tail{0};
+		// 所属线程已退出或换了代，写线程排空后移除
+		std::atomic<bool> abandoned{false};
+	};
+
+	void Logger::EnableAsync(OverflowPolicy policy, uint32_t slotsPerThread)
+	{
+		DisableAsync();
+
+		uint32_t slots = MIN_SLOTS_PER_THREAD;
+		while (slots < slotsPerThread)
+		{
+			slots <<= 1;
+		}
+		m_overflowPolicy = policy;
+		m_slotsPerThread = slots;
+		{
+			std::lock_guard<std::mutex> lock(m_writerMutex);
+			m_stopWriter = false;
+			m_flushRequested = false;
+		}
+		m_asyncGeneration.fetch_add(1, std::memory_order_release);
+		m_writer = std::thread(&Logger::WriterLoop, this);
+		m_asyncEnabled.store(true, std::memory_order_release);
+	}
+
+	void Logger::DisableAsync()
+	{
+		if (!m_asyncEnabled.exchange(false, std::memory_order_acq_rel))
+		{
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_writerMutex);
+			m_stopWriter = true;
+		}
+		m_writerWake.notify_one();
+		m_writer.join();
+
+		std::lock_guard<std::mutex> lock(m_ringsMutex);
+		m_rings.clear();
+	}
+
+	void Logger::Flush()
+	{
+		if (!m_asyncEnabled.load(std::memory_order_acquire))
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_fileStream.is_open())
+			{
+				m_fileStream.flush();
+			}
+			return;
+		}
+
+		// 正在进行的那一遍可能已经扫过当前线程的环，要等下一遍完整扫完
+		std::unique_lock<std::mutex> lock(m_writerMutex);
+		const uint64_t targetPass = m_writerPass + 2;
+		m_flushRequested = true;
+		m_writerWake.notify_one();
+		m_writerPassDone.wait(lock, [&] { return m_writerPass >= targetPass || m_stopWriter; });
+	}
+
+	void Logger::Log(Level level, const char* file, int line, const char* func, std::string_view message)
+	{
+		if (level < m_minLevel) return;
+
+		char prefix[256];
+		const std::string_view prefixView(prefix, FormatPrefix(prefix, sizeof(prefix), level, file, line));
+
+		if (!m_asyncEnabled.load(std::memory_order_acquire) || !PushAsync(level, prefixView, message))
+		{
+			WriteSync(level, prefixView, message);
+			return;
+		}
+		// Fatal之后通常紧跟abort，不能留在环里
+		if (level == Level::Fatal)
+		{
+			Flush();
+		}
+	}
+
+	size_t Logger::FormatPrefix(char* buffer, size_t size, Level level, const char* file, int line)
+	{
+		const auto now = std::chrono::system_clock::now();
+		const std::time_t time = std::chrono::system_clock::to_time_t(std::chrono::time_point_cast<std::chrono::seconds>(now));
+		const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % 1000;
+
+		thread_local std::time_t cachedTime = -1;
+		thread_local char cachedTimeString[32];
+		if (time != cachedTime)
+		{
+			std::tm tm_buf;
+#ifdef _WIN32
+			localtime_s(&tm_buf, &time);
+#else
+			localtime_r(&time, &tm_buf);
+#endif
+			std::strftime(cachedTimeString, sizeof(cachedTimeString), "%Y-%m-%d %H:%M:%S", &tm_buf);
+			cachedTime = time;
+		}
+
+		// 提取文件名（去掉路径）
+		const char* filename = file;
+		for (const char* c = file; *c != '\0'; c++)
+		{
+			if (*c == '/' || *c == '\\')
+			{
+				filename = c + 1;
+			}
+		}
+
+		const int length = snprintf(buffer, size, "%s.%03d [%s] [%s:%d] ", cachedTimeString, static_cast<int>(ms.count()), LevelToString(level), filename, line);
+		return length < 0 ? 0 : std::min(static_cast<size_t>(length), size - 1);
+	}
+
+	void Logger::WriteSync(Level level, std::string_view prefix, std::string_view message)
+	{
+		std::string logLine;
+		logLine.reserve(prefix.size() + message.size());
+		logLine.append(prefix).append(message);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		// 输出到控制台
+		if (m_consoleEnabled)
+		{
+			PrintToConsole(level, logLine);
+		}
+
+		// 输出到文件
+		if (m_fileStream.is_open())
+		{
+			m_fileStream << logLine << std::endl;
+			m_fileStream.flush();
+		}
+	}
+
+	Logger::ThreadRing& Logger::AcquireThreadRing()
+	{
+		struct Handle
+		{
+			std::shared_ptr<ThreadRing> ring;
+			uint64_t generation = 0;
+
+			~Handle()
+			{
+				if (ring)
+				{
+					ring->abandoned.store(true, std::memory_order_release);
+				}
+			}
+		};
+		thread_local Handle handle;
+
+		const uint64_t generation = m_asyncGeneration.load(std::memory_order_acquire);
+		if (!handle.ring || handle.generation != generation)
+		{
+			if (handle.ring)
+			{
+				handle.ring->abandoned.store(true, std::memory_order_release);
+			}
+			auto ring = std::make_shared<ThreadRing>(m_slotsPerThread);
+			{
+				std::lock_guard<std::mutex> lock(m_ringsMutex);
+				m_rings.push_back(ring);
+			}
+			handle.ring = std::move(ring);
+			handle.generation = generation;
+		}
+		return *handle.ring;
+	}
+
+	bool Logger::PushAsync(Level level, std::string_view prefix, std::string_view message)
+	{
+		ThreadRing& ring = AcquireThreadRing();
+		const uint64_t capacity = ring.slots.size();
+
+		// 比整个环还长的记录截断
+		const uint64_t textLength = prefix.size() + message.size();
+		const uint64_t slotCount = std::min(std::max<uint64_t>(1, (textLength + RECORD_SLOT_TEXT - 1) / RECORD_SLOT_TEXT), capacity);
+
+		const uint64_t head = ring.head.load(std::memory_order_relaxed);
+		while (head + slotCount - ring.tail.load(std::memory_order_acquire) > capacity)
+		{
+			if (m_overflowPolicy == OverflowPolicy::Drop)
+			{
+				m_dropped.fetch_add(1, std::memory_order_relaxed);
+				m_droppedTotal.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+			if (!m_asyncEnabled.load(std::memory_order_acquire))
+			{
+				return false;
+			}
+			m_writerWake.notify_one();
+			std::this_thread::yield();
+		}
+
+		size_t prefixOffset = 0;
+		size_t messageOffset = 0;
+		for (uint64_t i = 0; i < slotCount; i++)
+		{
+			RecordSlot& slot = ring.slots[(head + i) & ring.mask];
+			const size_t fromPrefix = std::min(prefix.size() - prefixOffset, RECORD_SLOT_TEXT);
+			std::memcpy(slot.text, prefix.data() + prefixOffset, fromPrefix);
+			prefixOffset += fromPrefix;
+			const size_t fromMessage = std::min(message.size() - messageOffset, RECORD_SLOT_TEXT - fromPrefix);
+			std::memcpy(slot.text + fromPrefix, message.data() + messageOffset, fromMessage);
+			messageOffset += fromMessage;
+
+			slot.level = level;
+			slot.length = static_cast<uint16_t>(fromPrefix + fromMessage);
+			slot.more = i + 1 < slotCount ? 1 : 0;
+		}
+		ring.head.store(head + slotCount, std::memory_order_release);
+		return true;
+	}
+
+	void Logger::WriterLoop()
+	{
+		std::string batch;
+		std::vector<RecordSpan> spans;
+		std::vector<std::shared_ptr<ThreadRing>> rings;
+
+		for (;;)
+		{
+			bool stopping;
+			{
+				std::lock_guard<std::mutex> lock(m_writerMutex);
+				stopping = m_stopWriter;
+			}
+			{
+				std::lock_guard<std::mutex> lock(m_ringsMutex);
+				rings = m_rings;
+			}
+
+			for (const auto& ring : rings)
+			{
+				uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+				const uint64_t head = ring->head.load(std::memory_order_acquire);
+				// 生产者一次发布整条记录，一遍里不会读到半条
+				bool recordStart = true;
+				for (; tail != head; tail++)
+				{
+					const RecordSlot& slot = ring->slots[tail & ring->mask];
+					if (recordStart)
+					{
+						spans.push_back({slot.level, batch.size(), 0});
+					}
+					batch.append(slot.text, slot.length);
+					recordStart = slot.more == 0;
+					if (recordStart)
+					{
+						spans.back().end = batch.size();
+						batch.push_back('\n');
+					}
+				}
+				ring->tail.store(tail, std::memory_order_release);
+			}
+
+			const uint64_t dropped = m_dropped.exchange(0, std::memory_order_relaxed);
+			if (dropped > 0)
+			{
+				char prefix[256];
+				const size_t prefixLength = FormatPrefix(prefix, sizeof(prefix), Level::Warn, __FILE__, __LINE__);
+				spans.push_back({Level::Warn, batch.size(), 0});
+				batch.append(prefix, prefixLength).append(std::to_string(dropped)).append(" log records dropped, async ring full");
+				spans.back().end = batch.size();
+				batch.push_back('\n');
+			}
+
+			if (!batch.empty())
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (m_fileStream.is_open())
+				{
+					m_fileStream.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+					m_fileStream.flush();
+				}
+				if (m_consoleEnabled)
+				{
+#ifdef _WIN32
+					for (const RecordSpan& span : spans)
+					{
+						PrintToConsole(span.level, std::string_view(batch).substr(span.begin, span.end - span.begin));
+					}
+#else
+					if (m_colorEnabled)
+					{
+						std::string colored;
+						colored.reserve(batch.size() + spans.size() * 10);
+						for (const RecordSpan& span : spans)
+						{
+							colored.append(GetAnsiColor(span.level)).append(batch, span.begin, span.end - span.begin).append("\033[0m\n");
+						}
+						std::cout << colored;
+					}
+					else
+					{
+						std::cout << batch;
+					}
+					std::cout.flush();
+#endif
+				}
+			}
+			batch.clear();
+			spans.clear();
+
+			{
+				std::lock_guard<std::mutex> lock(m_ringsMutex);
+				std::erase_if(m_rings, [](const std::shared_ptr<ThreadRing>& ring)
+				{
+					return ring->abandoned.load(std::memory_order_acquire) && ring->tail.load(std::memory_order_relaxed) == ring->head.load(std::memory_order_acquire);
+				});
+			}
+			rings.clear();
+
+			std::unique_lock<std::mutex> lock(m_writerMutex);
+			m_writerPass++;
+			m_writerPassDone.notify_all();
+			if (stopping)
+			{
+				break;
+			}
+			m_writerWake.wait_for(lock, WRITER_INTERVAL, [this] { return m_stopWriter || m_flushRequested; });
+			m_flushRequested = false;
+		}
+	}
+
 	void LogStream::Example()
 	{
 		auto &logger = Logger::Instance();
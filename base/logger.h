@@ -4,10 +4,17 @@
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <vector>
 #include <chrono>
 #include <iomanip>
 #include <memory>
+#include <algorithm>
+#include <cstdint>
 #include <cstdarg>
 #ifdef _WIN32
 	#include <windows.h>
@@ -29,6 +36,21 @@ namespace Log
 		Off = 6
 	};
 
+	// 低于这个级别的LOG_*调用在编译期整个去掉，参数表达式也不会求值；可以在编译选项里定义LOG_COMPILE_LEVEL
+#ifndef LOG_COMPILE_LEVEL
+	#define LOG_COMPILE_LEVEL 0
+#endif
+	constexpr Level CompiledLevel = static_cast<Level>(LOG_COMPILE_LEVEL);
+
+	// 异步模式下某个线程的环满了怎么办
+	enum class OverflowPolicy
+	{
+		// 丢掉这条记录并计数，写线程之后补一行丢弃数量；调用线程永不阻塞
+		Drop,
+		// 等写线程腾出空间
+		Block,
+	};
+
 	// ============================================================================
 	// 控制台颜色（跨平台）
 	// ============================================================================
@@ -107,57 +129,20 @@ namespace Log
 			}
 		}
 
-		// 核心日志函数
-		void Log(Level level, const char* file, int line, const char* func, const std::string& message)
-		{
-			if (level < m_minLevel) return;
-
-			std::lock_guard<std::mutex> lock(m_mutex);
-
-			// 获取时间戳
-			auto now = std::chrono::system_clock::now();
-			auto time = std::chrono::system_clock::to_time_t(now);
-			auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-				now.time_since_epoch()) % 1000;
-
-			std::tm tm_buf;
-#ifdef _WIN32
-			localtime_s(&tm_buf, &time);
-#else
-			localtime_r(&time, &tm_buf);
-#endif
-
-			// 提取文件名（去掉路径）
-			std::string filename = file;
-			size_t pos = filename.find_last_of("/\\");
-			if (pos != std::string::npos)
-			{
-				filename = filename.substr(pos + 1);
-			}
+		[[nodiscard]] bool IsEnabled(Level level) const { return level >= m_minLevel; }
 
-			// 格式化日志
-			std::ostringstream oss;
-			oss << std::put_time(&tm_buf, "%Y-%m-%d %H:%M:%S")
-				<< '.' << std::setfill('0') << std::setw(3) << ms.count()
-				<< " [" << LevelToString(level) << "] "
-				<< "[" << filename << ":" << line << "] "
-				<< message;
+		// 异步模式：每个线程一个无锁单生产者环，里面是格式化好的记录，后台写线程批量写文件和控制台
+		// slotsPerThread取2的幂，每个slot放RECORD_SLOT_TEXT个字符，更长的记录占连续多个slot
+		void EnableAsync(OverflowPolicy policy = OverflowPolicy::Drop, uint32_t slotsPerThread = 1024);
+		// 写完所有已提交的记录后停止写线程，回到同步模式
+		void DisableAsync();
+		[[nodiscard]] bool IsAsync() const { return m_asyncEnabled.load(std::memory_order_acquire); }
+		// 阻塞到调用前提交的记录都写出去；Fatal记录会自动调用
+		void Flush();
+		[[nodiscard]] uint64_t GetDroppedCount() const { return m_droppedTotal.load(std::memory_order_relaxed); }
 
-			std::string logLine = oss.str();
-
-			// 输出到控制台
-			if (m_consoleEnabled)
-			{
-				PrintToConsole(level, logLine);
-			}
-
-			// 输出到文件
-			if (m_fileStream.is_open())
-			{
-				m_fileStream << logLine << std::endl;
-				m_fileStream.flush();
-			}
-		}
+		// 核心日志函数
+		void Log(Level level, const char* file, int line, const char* func, std::string_view message);
 
 		// printf 风格的格式化
 		template <typename... Args>
@@ -167,16 +152,42 @@ namespace Log
 			if (level < m_minLevel) return;
 
 			char buffer[4096];
-			snprintf(buffer, sizeof(buffer), fmt, args...);
-			Log(level, file, line, func, std::string(buffer));
+			int length = snprintf(buffer, sizeof(buffer), fmt, args...);
+			if (length < 0) return;
+			Log(level, file, line, func, std::string_view(buffer, std::min(static_cast<size_t>(length), sizeof(buffer) - 1)));
 		}
 
+		static constexpr size_t RECORD_SLOT_TEXT = 248;
+
 	private:
+		struct RecordSlot
+		{
+			Level level;
+			// 1表示记录在下一个slot里继续
+			uint8_t more;
+			uint16_t length;
+			char text[RECORD_SLOT_TEXT];
+		};
+		struct ThreadRing;
+
 		Logger() = default;
-		~Logger() { CloseLogFile(); }
+		~Logger()
+		{
+			DisableAsync();
+			CloseLogFile();
+		}
 		Logger(const Logger&) = delete;
 		Logger& operator=(const Logger&) = delete;
 
+		// 时间戳按秒缓存在线程本地，同一秒内只做一次localtime
+		size_t FormatPrefix(char* buffer, size_t size, Level level, const char* file, int line);
+		void WriteSync(Level level, std::string_view prefix, std::string_view message);
+		// 返回false表示异步模式已经关闭，调用方改走同步路径
+		bool PushAsync(Level level, std::string_view prefix, std::string_view message);
+		// 当前线程的环，第一次写日志或重新EnableAsync后注册
+		ThreadRing& AcquireThreadRing();
+		void WriterLoop();
+
 		const char* LevelToString(Level level)
 		{
 			switch (level)
@@ -191,7 +202,7 @@ namespace Log
 			}
 		}
 
-		void PrintToConsole(Level level, const std::string& message)
+		void PrintToConsole(Level level, std::string_view message)
 		{
 #ifdef _WIN32
 			if (m_colorEnabled)
@@ -250,6 +261,25 @@ namespace Log
 		bool m_colorEnabled = true;
 		std::mutex m_mutex;
 		std::ofstream m_fileStream;
+
+		// 异步模式
+		std::atomic<bool> m_asyncEnabled{false};
+		OverflowPolicy m_overflowPolicy = OverflowPolicy::Drop;
+		uint32_t m_slotsPerThread = 0;
+		// 每次EnableAsync加一，线程本地缓存的环代数不对时重新注册
+		std::atomic<uint64_t> m_asyncGeneration{0};
+		std::mutex m_ringsMutex;
+		std::vector<std::shared_ptr<ThreadRing>> m_rings;
+		std::atomic<uint64_t> m_dropped{0};
+		std::atomic<uint64_t> m_droppedTotal{0};
+		std::thread m_writer;
+		std::mutex m_writerMutex;
+		std::condition_variable m_writerWake;
+		std::condition_variable m_writerPassDone;
+		bool m_stopWriter = false;
+		bool m_flushRequested = false;
+		// 写线程每完整扫一遍所有环加一，Flush靠它判断
+		uint64_t m_writerPass = 0;
 	};
 
 	// ============================================================================
@@ -265,7 +295,7 @@ namespace Log
 
 		~LogStream()
 		{
-			Logger::Instance().Log(m_level, m_file, m_line, m_func, m_stream.str());
+			Logger::Instance().Log(m_level, m_file, m_line, m_func, m_stream.view());
 		}
 
 		template <typename T>
@@ -290,22 +320,26 @@ namespace Log
 // 便捷宏定义
 // ============================================================================
 
+// 编译期低于CompiledLevel的整条语句被丢弃；运行期低于SetLevel的不构造LogStream，<<右边也不求值
+#define LOG_STREAM(level) if constexpr ((level) < Log::CompiledLevel) {} else if (!Log::Logger::Instance().IsEnabled(level)) {} else Log::LogStream(level, __FILE__, __LINE__, __FUNCTION__)
+#define LOGF_LEVEL(level, fmt, ...) do { if constexpr ((level) >= Log::CompiledLevel) Log::Logger::Instance().LogFormat(level, __FILE__, __LINE__, __FUNCTION__, fmt, ##__VA_ARGS__); } while (0)
+
 // 流式日志（推荐）
-#define LOG_TRACE Log::LogStream(Log::Level::Trace, __FILE__, __LINE__, __FUNCTION__)
-#define LOG_DEBUG Log::LogStream(Log::Level::Debug, __FILE__, __LINE__, __FUNCTION__)
-#define LOG_INFO  Log::LogStream(Log::Level::Info,  __FILE__, __LINE__, __FUNCTION__)
-#define LOG_WARN  Log::LogStream(Log::Level::Warn,  __FILE__, __LINE__, __FUNCTION__)
-#define LOG_ERROR Log::LogStream(Log::Level::Error, __FILE__, __LINE__, __FUNCTION__)
-#define LOG_FATAL Log::LogStream(Log::Level::Fatal, __FILE__, __LINE__, __FUNCTION__)
+#define LOG_TRACE LOG_STREAM(Log::Level::Trace)
+#define LOG_DEBUG LOG_STREAM(Log::Level::Debug)
+#define LOG_INFO  LOG_STREAM(Log::Level::Info)
+#define LOG_WARN  LOG_STREAM(Log::Level::Warn)
+#define LOG_ERROR LOG_STREAM(Log::Level::Error)
+#define LOG_FATAL LOG_STREAM(Log::Level::Fatal)
 
 // printf 风格日志
-#define LOGF_TRACE(fmt, ...) Log::Logger::Instance().LogFormat(Log::Level::Trace, __FILE__, __LINE__, __FUNCTION__, fmt, ##__VA_ARGS__)
-#define LOGF_DEBUG(fmt, ...) Log::Logger::Instance().LogFormat(Log::Level::Debug, __FILE__, __LINE__, __FUNCTION__, fmt, ##__VA_ARGS__)
-#define LOGF_INFO(fmt, ...)  Log::Logger::Instance().LogFormat(Log::Level::Info,  __FILE__, __LINE__, __FUNCTION__, fmt, ##__VA_ARGS__)
-#define LOGF_WARN(fmt, ...)  Log::Logger::Instance().LogFormat(Log::Level::Warn,  __FILE__, __LINE__, __FUNCTION__, fmt, ##__VA_ARGS__)
-#define LOGF_ERROR(fmt, ...) Log::Logger::Instance().LogFormat(Log::Level::Error, __FILE__, __LINE__, __FUNCTION__, fmt, ##__VA_ARGS__)
-#define LOGF_FATAL(fmt, ...) Log::Logger::Instance().LogFormat(Log::Level::Fatal, __FILE__, __LINE__, __FUNCTION__, fmt, ##__VA_ARGS__)
+#define LOGF_TRACE(fmt, ...) LOGF_LEVEL(Log::Level::Trace, fmt, ##__VA_ARGS__)
+#define LOGF_DEBUG(fmt, ...) LOGF_LEVEL(Log::Level::Debug, fmt, ##__VA_ARGS__)
+#define LOGF_INFO(fmt, ...)  LOGF_LEVEL(Log::Level::Info,  fmt, ##__VA_ARGS__)
+#define LOGF_WARN(fmt, ...)  LOGF_LEVEL(Log::Level::Warn,  fmt, ##__VA_ARGS__)
+#define LOGF_ERROR(fmt, ...) LOGF_LEVEL(Log::Level::Error, fmt, ##__VA_ARGS__)
+#define LOGF_FATAL(fmt, ...) LOGF_LEVEL(Log::Level::Fatal, fmt, ##__VA_ARGS__)
 
 // 条件日志
-#define LOG_IF(condition, level) if(condition) LOG_##level
+#define LOG_IF(condition, level) if(!(condition)) {} else LOG_##level
 #define LOG_ASSERT(condition, msg) if(!(condition)) { LOG_FATAL << "Assertion failed: " << #condition << " - " << msg; std::abort(); }
@@ -31,9 +31,11 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 	appInfo.pEngineName = name.c_str();
 	appInfo.apiVersion = apiVersion;
 
-	std::vector<const char*> instanceExtensions = { VK_KHR_SURFACE_EXTENSION_NAME };
+	std::vector<const char*> instanceExtensions;
 
-	// Enable surface extensions depending on os
+	// Enable surface extensions depending on os (not needed when rendering offscreen)
+	if (!settings.offscreen) {
+		instanceExtensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
 #if defined(_WIN32)
 	instanceExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
@@ -55,6 +57,7 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 #elif defined(VK_USE_PLATFORM_SCREEN_QNX)
 	instanceExtensions.push_back(VK_QNX_SCREEN_SURFACE_EXTENSION_NAME);
 #endif
+	}
 	
 	// Get extensions supported by the instance and store for later use
 	uint32_t extCount = 0;
@@ -157,7 +160,7 @@ void VulkanExampleBase::renderFrame()
 	VulkanExampleBase::prepareFrame();
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+	VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 	VulkanExampleBase::submitFrame();
 }
 
@@ -207,6 +210,7 @@ void VulkanExampleBase::prepare()
 {
 	initSwapchain();
 	createCommandPool();
+	uploadManager.create(vulkanDevice, timelineSemaphoreEnabled);
 	setupSwapChain();
 	createCommandBuffers();
 	createSynchronizationPrimitives();
@@ -267,6 +271,11 @@ void VulkanExampleBase::nextFrame()
 	{
 		viewUpdated = true;
 	}
+	if (!cameraPathRecordFile.empty())
+	{
+		cameraPathRecordTime += frameTimer;
+		recordedCameraPath.record(camera, cameraPathRecordTime);
+	}
 	// Convert to clamped timer value
 	if (!paused)
 	{
@@ -302,16 +311,21 @@ void VulkanExampleBase::renderLoop()
 #if !(defined(VK_USE_PLATFORM_IOS_MVK) || defined(VK_USE_PLATFORM_MACOS_MVK))
 	if (benchmark.active) {
 #if defined(VK_USE_PLATFORM_WAYLAND_KHR)
-		while (!configured)
-			wl_display_dispatch(display);
-		while (wl_display_prepare_read(display) != 0)
+		if (!settings.offscreen) {
+			while (!configured)
+				wl_display_dispatch(display);
+			while (wl_display_prepare_read(display) != 0)
+				wl_display_dispatch_pending(display);
+			wl_display_flush(display);
+			wl_display_read_events(display);
 			wl_display_dispatch_pending(display);
-		wl_display_flush(display);
-		wl_display_read_events(display);
-		wl_display_dispatch_pending(display);
+		}
 #endif
 
-		benchmark.run([=] { render(); }, vulkanDevice->properties);
+		benchmark.width = width;
+		benchmark.height = height;
+		benchmark.offscreen = settings.offscreen;
+		benchmark.run([=] { render(); }, vulkanDevice->properties, &camera);
 		vkDeviceWaitIdle(device);
 		if (benchmark.filename != "") {
 			benchmark.saveResults();
@@ -540,13 +554,17 @@ void VulkanExampleBase::renderLoop()
 			viewChanged();
 		}
 
-		while (!configured)
-			wl_display_dispatch(display);
-		while (wl_display_prepare_read(display) != 0)
+		// Offscreen rendering has no display connection to pump
+		if (!settings.offscreen)
+		{
+			while (!configured)
+				wl_display_dispatch(display);
+			while (wl_display_prepare_read(display) != 0)
+				wl_display_dispatch_pending(display);
+			wl_display_flush(display);
+			wl_display_read_events(display);
 			wl_display_dispatch_pending(display);
-		wl_display_flush(display);
-		wl_display_read_events(display);
-		wl_display_dispatch_pending(display);
+		}
 
 		render();
 		frameCounter++;
@@ -570,7 +588,7 @@ void VulkanExampleBase::renderLoop()
 		float fpsTimer = std::chrono::duration<double, std::milli>(tEnd - lastTimestamp).count();
 		if (fpsTimer > 1000.0f)
 		{
-			if (!settings.overlay)
+			if (!settings.overlay && !settings.offscreen)
 			{
 				std::string windowTitle = getWindowTitle();
 				xdg_toplevel_set_title(xdg_toplevel, windowTitle.c_str());
@@ -582,7 +600,10 @@ void VulkanExampleBase::renderLoop()
 		updateOverlay();
 	}
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
-	xcb_flush(connection);
+	if (!settings.offscreen)
+	{
+		xcb_flush(connection);
+	}
 	while (!quit)
 	{
 		auto tStart = std::chrono::high_resolution_clock::now();
@@ -591,8 +612,9 @@ void VulkanExampleBase::renderLoop()
 			viewUpdated = false;
 			viewChanged();
 		}
+		// Offscreen rendering has no display connection to poll
 		xcb_generic_event_t *event;
-		while ((event = xcb_poll_for_event(connection)))
+		while (!settings.offscreen && (event = xcb_poll_for_event(connection)))
 		{
 			handleEvent(event);
 			free(event);
@@ -619,7 +641,7 @@ void VulkanExampleBase::renderLoop()
 		float fpsTimer = std::chrono::duration<double, std::milli>(tEnd - lastTimestamp).count();
 		if (fpsTimer > 1000.0f)
 		{
-			if (!settings.overlay)
+			if (!settings.overlay && !settings.offscreen)
 			{
 				std::string windowTitle = getWindowTitle();
 				xcb_change_property(connection, XCB_PROP_MODE_REPLACE,
@@ -748,8 +770,12 @@ void VulkanExampleBase::drawUI(const VkCommandBuffer commandBuffer)
 
 void VulkanExampleBase::prepareFrame()
 {
-	// Acquire the next image from the swap chain
-	VkResult result = swapChain.acquireNextImage(semaphores.presentComplete, &currentBuffer);
+	// Acquire the next image from the swap chain (offscreen mode submits to the graphics queue)
+	VkResult result;
+	{
+		std::lock_guard<std::mutex> lock(vulkanDevice->getQueueMutex(queue));
+		result = swapChain.acquireNextImage(semaphores.presentComplete, &currentBuffer);
+	}
 	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE)
 	// SRS - If no longer optimal (VK_SUBOPTIMAL_KHR), wait until submitFrame() in case number of swapchain images will change on resize
 	if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
@@ -765,7 +791,11 @@ void VulkanExampleBase::prepareFrame()
 
 void VulkanExampleBase::submitFrame()
 {
-	VkResult result = swapChain.queuePresent(queue, currentBuffer, semaphores.renderComplete);
+	VkResult result;
+	{
+		std::lock_guard<std::mutex> lock(vulkanDevice->getQueueMutex(queue));
+		result = swapChain.queuePresent(queue, currentBuffer, semaphores.renderComplete);
+	}
 	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE) or no longer optimal for presentation (SUBOPTIMAL)
 	if ((result == VK_ERROR_OUT_OF_DATE_KHR) || (result == VK_SUBOPTIMAL_KHR)) {
 		windowResize();
@@ -776,7 +806,7 @@ void VulkanExampleBase::submitFrame()
 	else {
 		VK_CHECK_RESULT(result);
 	}
-	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+	VK_CHECK_RESULT(vulkanDevice->queueWaitIdle(queue));
 }
 
 VulkanExampleBase::VulkanExampleBase(bool enableValidation)
@@ -814,6 +844,9 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	commandLineParser.add("benchmarkresultfile", { "-bf", "--benchfilename" }, 1, "Set file name for benchmark results");
 	commandLineParser.add("benchmarkresultframes", { "-bt", "--benchframetimes" }, 0, "Save frame times to benchmark results file");
 	commandLineParser.add("benchmarkframes", { "-bfs", "--benchmarkframes" }, 1, "Only render the given number of frames");
+	commandLineParser.add("benchmarkcamerapath", { "-bcp", "--benchcamerapath" }, 1, "Play back a recorded camera path in benchmark mode (results as .json or .csv)");
+	commandLineParser.add("recordcamerapath", { "-rcp", "--recordcamerapath" }, 1, "Record the camera path to the given file while running");
+	commandLineParser.add("offscreen", { "-os", "--offscreen" }, 0, "Render to offscreen images without presenting (e.g. for benchmarks on CI)");
 
 	commandLineParser.parse(args);
 	if (commandLineParser.isSet("help")) {
@@ -867,6 +900,15 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	if (commandLineParser.isSet("benchmarkframes")) {
 		benchmark.outputFrames = commandLineParser.getValueAsInt("benchmarkframes", benchmark.outputFrames);
 	}
+	if (commandLineParser.isSet("benchmarkcamerapath")) {
+		benchmark.cameraPath.loadFromFile(commandLineParser.getValueAsString("benchmarkcamerapath", ""));
+	}
+	if (commandLineParser.isSet("recordcamerapath")) {
+		cameraPathRecordFile = commandLineParser.getValueAsString("recordcamerapath", "");
+	}
+	if (commandLineParser.isSet("offscreen")) {
+		settings.offscreen = true;
+	}
 
 #if defined(VK_USE_PLATFORM_ANDROID_KHR)
 	// Vulkan library is loaded dynamically on Android
@@ -875,9 +917,14 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 #elif defined(_DIRECT2DISPLAY)
 
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
-	initWaylandConnection();
+	// Offscreen rendering does not need a display, so it also runs where none is available
+	if (!settings.offscreen) {
+		initWaylandConnection();
+	}
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
-	initxcbConnection();
+	if (!settings.offscreen) {
+		initxcbConnection();
+	}
 #endif
 
 #if defined(_WIN32)
@@ -892,6 +939,11 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 
 VulkanExampleBase::~VulkanExampleBase()
 {
+	if (!cameraPathRecordFile.empty() && !recordedCameraPath.empty())
+	{
+		recordedCameraPath.saveToFile(cameraPathRecordFile);
+		std::cout << "Camera path with " << recordedCameraPath.getKeyframeCount() << " keyframes saved to " << cameraPathRecordFile << "\n";
+	}
 	// Clean up Vulkan resources
 	swapChain.cleanup();
 	if (descriptorPool != VK_NULL_HANDLE)
@@ -930,6 +982,8 @@ VulkanExampleBase::~VulkanExampleBase()
 		UIOverlay.freeResources();
 	}
 
+	uploadManager.destroy();
+
 	delete vulkanDevice;
 
 	if (settings.validation)
@@ -953,24 +1007,28 @@ VulkanExampleBase::~VulkanExampleBase()
 	if (dfb)
 		dfb->Release(dfb);
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
-	xdg_toplevel_destroy(xdg_toplevel);
-	xdg_surface_destroy(xdg_surface);
-	wl_surface_destroy(surface);
-	if (keyboard)
-		wl_keyboard_destroy(keyboard);
-	if (pointer)
-		wl_pointer_destroy(pointer);
-	if (seat)
-		wl_seat_destroy(seat);
-	xdg_wm_base_destroy(shell);
-	wl_compositor_destroy(compositor);
-	wl_registry_destroy(registry);
-	wl_display_disconnect(display);
+	if (!settings.offscreen) {
+		xdg_toplevel_destroy(xdg_toplevel);
+		xdg_surface_destroy(xdg_surface);
+		wl_surface_destroy(surface);
+		if (keyboard)
+			wl_keyboard_destroy(keyboard);
+		if (pointer)
+			wl_pointer_destroy(pointer);
+		if (seat)
+			wl_seat_destroy(seat);
+		xdg_wm_base_destroy(shell);
+		wl_compositor_destroy(compositor);
+		wl_registry_destroy(registry);
+		wl_display_disconnect(display);
+	}
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
 	// todo : android cleanup (if required)
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
-	xcb_destroy_window(connection, window);
-	xcb_disconnect(connection);
+	if (!settings.offscreen) {
+		xcb_destroy_window(connection, window);
+		xcb_disconnect(connection);
+	}
 #elif defined(VK_USE_PLATFORM_SCREEN_QNX)
 	screen_destroy_event(screen_event);
 	screen_destroy_window(screen_window);
@@ -1061,7 +1119,21 @@ bool VulkanExampleBase::initVulkan()
 	// Derived examples can enable extensions based on the list of supported extensions read from the physical device
 	getEnabledExtensions();
 
-	VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain);
+	// The upload manager tracks its batches with a timeline semaphore (core in 1.2, the extension needs 1.1 for physical device properties 2)
+	if (apiVersion >= VK_API_VERSION_1_1 && vulkanDevice->extensionSupported(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME)) {
+		enabledDeviceExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+		timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+		timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+		timelineSemaphoreFeatures.pNext = deviceCreatepNextChain;
+		deviceCreatepNextChain = &timelineSemaphoreFeatures;
+		timelineSemaphoreEnabled = true;
+	}
+
+	// Offscreen rendering doesn't present, but render passes still use VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, so keep the swapchain extension if the device has it
+	const bool useSwapChain = !settings.offscreen || vulkanDevice->extensionSupported(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
+	// Also request a dedicated transfer queue (if the device has one) for the upload manager
+	VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledDeviceExtensions, deviceCreatepNextChain, useSwapChain, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT);
 	if (res != VK_SUCCESS) {
 		vks::tools::exitFatal("Could not create Vulkan device: \n" + vks::tools::errorString(res), res);
 		return false;
@@ -1908,7 +1980,10 @@ void VulkanExampleBase::displayLinkOutputCb()
 {
 #if defined(VK_EXAMPLE_XCODE_GENERATED)
 	if (benchmark.active) {
-		benchmark.run([=] { render(); }, vulkanDevice->properties);
+		benchmark.width = width;
+		benchmark.height = height;
+		benchmark.offscreen = settings.offscreen;
+		benchmark.run([=] { render(); }, vulkanDevice->properties, &camera);
 		if (benchmark.filename != "") {
 			benchmark.saveResults();
 		}
@@ -2449,6 +2524,10 @@ static const struct xdg_toplevel_listener xdg_toplevel_listener = {
 
 struct xdg_surface *VulkanExampleBase::setupWindow()
 {
+	// No window is created when rendering offscreen
+	if (settings.offscreen) {
+		return nullptr;
+	}
 	surface = wl_compositor_create_surface(compositor);
 	xdg_surface = xdg_wm_base_get_xdg_surface(shell, surface);
 
@@ -2473,6 +2552,11 @@ static inline xcb_intern_atom_reply_t* intern_atom_helper(xcb_connection_t *conn
 // Set up a window using XCB and request event types
 xcb_window_t VulkanExampleBase::setupWindow()
 {
+	// No window is created when rendering offscreen
+	if (settings.offscreen) {
+		return 0;
+	}
+
 	uint32_t value_mask, value_list[32];
 
 	window = xcb_generate_id(connection);
@@ -3232,6 +3316,10 @@ void VulkanExampleBase::windowResized() {}
 
 void VulkanExampleBase::initSwapchain()
 {
+	if (settings.offscreen) {
+		swapChain.initOffscreen(queue, vulkanDevice->queueFamilyIndices.graphics);
+		return;
+	}
 #if defined(_WIN32)
 	swapChain.initSurface(windowInstance, window);
 #elif defined(VK_USE_PLATFORM_ANDROID_KHR)
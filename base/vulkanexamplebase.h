@@ -68,6 +68,7 @@
 #include "VulkanBuffer.h"
 #include "VulkanDevice.h"
 #include "VulkanTexture.h"
+#include "VulkanUploadManager.h"
 
 #include "VulkanInitializers.hpp"
 #include "camera.hpp"
@@ -115,6 +116,9 @@ protected:
 	std::vector<const char*> enabledInstanceExtensions;
 	/** @brief Optional pNext structure for passing extension structures to device creation */
 	void* deviceCreatepNextChain = nullptr;
+	/** @brief Enabled by the base when VK_KHR_timeline_semaphore is available, used by the upload manager */
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphoreFeatures{};
+	bool timelineSemaphoreEnabled = false;
 	/** @brief Logical device, application's view of the physical device (GPU) */
 	VkDevice device;
 	// Handle to the device graphics queue that command buffers are submitted to
@@ -174,9 +178,15 @@ public:
 	float frameTimer = 1.0f;
 
 	vks::Benchmark benchmark;
+	/** @brief Camera path recorded while running with --recordcamerapath, written to cameraPathRecordFile on exit */
+	vks::CameraPath recordedCameraPath;
+	std::string cameraPathRecordFile;
+	float cameraPathRecordTime = 0.0f;
 
 	/** @brief Encapsulated physical and logical vulkan device */
 	vks::VulkanDevice *vulkanDevice;
+	/** @brief Batched buffer uploads on the transfer queue, created in prepare() */
+	vks::UploadManager uploadManager;
 
 	/** @brief Example settings that can be changed e.g. by command line arguments */
 	struct Settings {
@@ -188,6 +198,12 @@ public:
 		bool vsync = false;
 		/** @brief Enable UI overlay */
 		bool overlay = true;
+		/** @brief Render to offscreen images instead of a swapchain, nothing is presented (default for headless builds) */
+#if defined(VK_USE_PLATFORM_HEADLESS_EXT)
+		bool offscreen = true;
+#else
+		bool offscreen = false;
+#endif
 	} settings;
 
 	VkClearColorValue defaultClearColor = { { 0.025f, 0.025f, 0.025f, 1.0f } };
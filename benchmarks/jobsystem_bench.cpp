@@ -0,0 +1,190 @@
+// vks::JobSystem和原来的vks::ThreadPool对比：大量小任务、parallelFor求和、负载不均的任务
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "JobSystem.h"
+#include "threadpool.hpp"
+
+namespace
+{
+	constexpr uint32_t REPETITIONS = 9;
+	constexpr uint32_t SMALL_TASK_COUNT = 100000;
+	constexpr uint32_t SUM_ELEMENT_COUNT = 1u << 24;
+	constexpr uint32_t UNBALANCED_TASK_COUNT = 256;
+
+	// 取中位数，排除偶发的调度抖动
+	template <typename F>
+	double measureMedianMs(F&& run)
+	{
+		std::vector<double> samples;
+		for (uint32_t i = 0; i < REPETITIONS; i++)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			run();
+			samples.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+		std::sort(samples.begin(), samples.end());
+		return samples[samples.size() / 2];
+	}
+
+	// 可控长度的纯计算
+	float burn(uint32_t iterations, float seed)
+	{
+		float value = seed;
+		for (uint32_t i = 0; i < iterations; i++)
+		{
+			value = std::sin(value) * 0.5f + 1.0f;
+		}
+		return value;
+	}
+
+	void report(const std::string& name, double threadPoolMs, double jobSystemMs)
+	{
+		std::cout << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(3)
+			<< std::setw(12) << threadPoolMs << std::setw(12) << jobSystemMs
+			<< std::setw(10) << std::setprecision(2) << threadPoolMs / jobSystemMs << "x" << std::endl;
+	}
+}
+
+int main()
+{
+	const uint32_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+	// JobSystem的调用线程也干活，worker少一个，总线程数相同
+	vks::JobSystem jobSystem(threadCount - 1);
+	vks::ThreadPool threadPool;
+	threadPool.setThreadCount(threadCount);
+
+	std::cout << "threads: " << threadCount << ", median of " << REPETITIONS << " runs" << std::endl;
+	std::cout << std::left << std::setw(28) << "benchmark" << std::right << std::setw(12) << "pool ms" << std::setw(12) << "jobs ms" << std::setw(11) << "speedup" << std::endl;
+
+	// 大量小任务：主要比调度开销，ThreadPool每个任务一次std::function分配和两次加锁
+	{
+		std::vector<float> results(SMALL_TASK_COUNT);
+		const double poolMs = measureMedianMs([&]
+		{
+			for (uint32_t i = 0; i < SMALL_TASK_COUNT; i++)
+			{
+				threadPool.threads[i % threadCount]->addJob([&results, i] { results[i] = burn(64, static_cast<float>(i)); });
+			}
+			threadPool.wait();
+		});
+		const double jobsMs = measureMedianMs([&]
+		{
+			vks::TaskGroup group(jobSystem);
+			for (uint32_t i = 0; i < SMALL_TASK_COUNT; i++)
+			{
+				group.run([&results, i] { results[i] = burn(64, static_cast<float>(i)); });
+			}
+			group.wait();
+		});
+		const double forMs = measureMedianMs([&]
+		{
+			jobSystem.parallelFor(SMALL_TASK_COUNT, 256, [&results](uint32_t begin, uint32_t end)
+			{
+				for (uint32_t i = begin; i < end; i++)
+				{
+					results[i] = burn(64, static_cast<float>(i));
+				}
+			});
+		});
+		report("small tasks (TaskGroup)", poolMs, jobsMs);
+		report("small tasks (parallelFor)", poolMs, forMs);
+	}
+
+	// 大数组求和：ThreadPool按线程数均分，JobSystem用parallelReduce
+	{
+		std::vector<float> values(SUM_ELEMENT_COUNT);
+		for (uint32_t i = 0; i < SUM_ELEMENT_COUNT; i++)
+		{
+			values[i] = static_cast<float>(i % 1024) * 0.001f;
+		}
+		std::vector<double> partials(threadCount);
+		const double poolMs = measureMedianMs([&]
+		{
+			const uint32_t range = (SUM_ELEMENT_COUNT + threadCount - 1) / threadCount;
+			for (uint32_t t = 0; t < threadCount; t++)
+			{
+				threadPool.threads[t]->addJob([&, t, range]
+				{
+					const uint32_t begin = t * range;
+					const uint32_t end = std::min(begin + range, SUM_ELEMENT_COUNT);
+					double sum = 0.0;
+					for (uint32_t i = begin; i < end; i++)
+					{
+						sum += values[i];
+					}
+					partials[t] = sum;
+				});
+			}
+			threadPool.wait();
+		});
+		double jobSum = 0.0;
+		const double jobsMs = measureMedianMs([&]
+		{
+			jobSum = jobSystem.parallelReduce(SUM_ELEMENT_COUNT, 1u << 16, 0.0, [&values](uint32_t begin, uint32_t end)
+			{
+				double sum = 0.0;
+				for (uint32_t i = begin; i < end; i++)
+				{
+					sum += values[i];
+				}
+				return sum;
+			}, [](double a, double b) { return a + b; });
+		});
+		report("array sum (parallelReduce)", poolMs, jobsMs);
+		(void)jobSum;
+	}
+
+	// 负载不均：重任务按轮转全落在同一个ThreadPool线程上，JobSystem靠偷任务摊开
+	{
+		std::vector<float> results(UNBALANCED_TASK_COUNT);
+		auto taskCost = [threadCount](uint32_t i) { return i % threadCount == 0 ? 200000u : 2000u; };
+		const double poolMs = measureMedianMs([&]
+		{
+			for (uint32_t i = 0; i < UNBALANCED_TASK_COUNT; i++)
+			{
+				threadPool.threads[i % threadCount]->addJob([&, i] { results[i] = burn(taskCost(i), static_cast<float>(i)); });
+			}
+			threadPool.wait();
+		});
+		const double jobsMs = measureMedianMs([&]
+		{
+			vks::TaskGroup group(jobSystem);
+			for (uint32_t i = 0; i < UNBALANCED_TASK_COUNT; i++)
+			{
+				group.run([&, i] { results[i] = burn(taskCost(i), static_cast<float>(i)); });
+			}
+			group.wait();
+		});
+		report("unbalanced tasks", poolMs, jobsMs);
+	}
+
+	// 嵌套：外层任务里再parallelFor，ThreadPool没法在等待时帮忙，只比JobSystem自己
+	{
+		std::vector<float> results(64 * 1024);
+		const double jobsMs = measureMedianMs([&]
+		{
+			jobSystem.parallelFor(64, 1, [&](uint32_t outerBegin, uint32_t outerEnd)
+			{
+				for (uint32_t outer = outerBegin; outer < outerEnd; outer++)
+				{
+					jobSystem.parallelFor(1024, 64, [&, outer](uint32_t begin, uint32_t end)
+					{
+						for (uint32_t i = begin; i < end; i++)
+						{
+							results[outer * 1024 + i] = burn(64, static_cast<float>(i));
+						}
+					});
+				}
+			});
+		});
+		std::cout << std::left << std::setw(28) << "nested parallelFor" << std::right << std::setw(12) << "-" << std::setw(12) << std::fixed << std::setprecision(3) << jobsMs << std::endl;
+	}
+
+	return 0;
+}
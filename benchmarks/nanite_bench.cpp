@@ -0,0 +1,435 @@
+// Nanite构建流程各阶段的耗时：内置模型和细分球体，每项重复多次取统计，结果写成JSON跟踪趋势
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <glm/gtc/constants.hpp>
+#include <json.hpp>
+
+#include "CommandLineParser.hpp"
+#include "JobSystem.h"
+#include "VulkanTools.h"
+#include "../src/NaniteMesh/NaniteMesh.h"
+#include "../src/NaniteMesh/NaniteLodMesh.h"
+
+namespace
+{
+	// JSON格式有不兼容的改动时加一
+	constexpr uint32_t SCHEMA_VERSION = 1;
+	constexpr uint32_t DEFAULT_REPETITIONS = 5;
+	const std::vector<std::string> BUNDLED_MODELS = {"bunny", "teapot", "venus", "torusknot", "voyager"};
+	const std::vector<uint32_t> SPHERE_TRIANGLE_COUNTS = {10000, 100000, 1000000, 10000000};
+
+	struct Input
+	{
+		std::string name;
+		Nanite::NaniteTriMesh mesh;
+	};
+
+	template <typename F>
+	double timeMs(F&& function)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		function();
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	nlohmann::json statsToJson(std::vector<double> samples)
+	{
+		nlohmann::json result;
+		result["samplesMs"] = samples;
+		std::sort(samples.begin(), samples.end());
+		result["minMs"] = samples.front();
+		result["maxMs"] = samples.back();
+		result["medianMs"] = samples[samples.size() / 2];
+		result["meanMs"] = std::accumulate(samples.begin(), samples.end(), 0.0) / static_cast<double>(samples.size());
+		return result;
+	}
+
+	// 和NaniteMesh::vkglTFMeshToOpenMesh一样准备好decimater需要的状态
+	void finishMesh(Nanite::NaniteTriMesh& mesh)
+	{
+		mesh.request_face_status();
+		mesh.request_edge_status();
+		mesh.request_vertex_status();
+	}
+
+	template <typename T>
+	const T* accessorElement(const tinygltf::Model& model, const tinygltf::Accessor& accessor, size_t index, size_t elementSize)
+	{
+		const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+		const size_t stride = view.byteStride != 0 ? view.byteStride : elementSize;
+		const unsigned char* data = model.buffers[view.buffer].data.data() + view.byteOffset + accessor.byteOffset;
+		return reinterpret_cast<const T*>(data + index * stride);
+	}
+
+	uint32_t readIndex(const tinygltf::Model& model, const tinygltf::Accessor& accessor, size_t index)
+	{
+		switch (accessor.componentType)
+		{
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+			return *accessorElement<uint32_t>(model, accessor, index, sizeof(uint32_t));
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+			return *accessorElement<uint16_t>(model, accessor, index, sizeof(uint16_t));
+		case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+			return *accessorElement<uint8_t>(model, accessor, index, sizeof(uint8_t));
+		default:
+			std::cerr << "Index component type " << accessor.componentType << " not supported" << std::endl;
+			return 0;
+		}
+	}
+
+	const tinygltf::Mesh* findFirstMesh(const tinygltf::Model& model, int nodeIndex)
+	{
+		const tinygltf::Node& node = model.nodes[nodeIndex];
+		if (node.mesh >= 0)
+		{
+			return &model.meshes[node.mesh];
+		}
+		for (const int child : node.children)
+		{
+			if (const tinygltf::Mesh* mesh = findFirstMesh(model, child))
+			{
+				return mesh;
+			}
+		}
+		return nullptr;
+	}
+
+	// 不经过vkglTF::Model（需要Vulkan设备），直接用tinygltf读；和NaniteMesh::loadvkglTFModel一样只取场景里的第一个mesh
+	bool loadGltfMesh(const std::string& filename, Nanite::NaniteTriMesh& mesh)
+	{
+		tinygltf::Model model;
+		tinygltf::TinyGLTF loader;
+		std::string error, warning;
+		if (!loader.LoadASCIIFromFile(&model, &error, &warning, filename))
+		{
+			return false;
+		}
+
+		const tinygltf::Mesh* gltfMesh = nullptr;
+		const int sceneIndex = model.defaultScene >= 0 ? model.defaultScene : 0;
+		if (sceneIndex < static_cast<int>(model.scenes.size()))
+		{
+			for (const int node : model.scenes[sceneIndex].nodes)
+			{
+				if ((gltfMesh = findFirstMesh(model, node)) != nullptr)
+				{
+					break;
+				}
+			}
+		}
+		if (gltfMesh == nullptr)
+		{
+			return false;
+		}
+
+		for (const tinygltf::Primitive& primitive : gltfMesh->primitives)
+		{
+			const auto position = primitive.attributes.find("POSITION");
+			if (position == primitive.attributes.end() || primitive.indices < 0)
+			{
+				continue;
+			}
+			const tinygltf::Accessor& positions = model.accessors[position->second];
+			const auto normal = primitive.attributes.find("NORMAL");
+			const auto texcoord = primitive.attributes.find("TEXCOORD_0");
+
+			std::vector<Nanite::NaniteTriMesh::VertexHandle> handles(positions.count);
+			for (size_t i = 0; i < positions.count; i++)
+			{
+				const float* p = accessorElement<float>(model, positions, i, sizeof(float) * 3);
+				handles[i] = mesh.add_vertex(Nanite::NaniteTriMesh::Point(p[0], p[1], p[2]));
+				if (normal != primitive.attributes.end())
+				{
+					const float* n = accessorElement<float>(model, model.accessors[normal->second], i, sizeof(float) * 3);
+					mesh.set_normal(handles[i], Nanite::NaniteTriMesh::Normal(n[0], n[1], n[2]));
+				}
+				if (texcoord != primitive.attributes.end())
+				{
+					const float* uv = accessorElement<float>(model, model.accessors[texcoord->second], i, sizeof(float) * 2);
+					mesh.set_texcoord2D(handles[i], Nanite::NaniteTriMesh::TexCoord2D(uv[0], uv[1]));
+				}
+			}
+
+			const tinygltf::Accessor& indices = model.accessors[primitive.indices];
+			for (size_t i = 0; i + 2 < indices.count; i += 3)
+			{
+				mesh.add_face(handles[readIndex(model, indices, i)], handles[readIndex(model, indices, i + 1)], handles[readIndex(model, indices, i + 2)]);
+			}
+		}
+		finishMesh(mesh);
+		return mesh.n_faces() > 0;
+	}
+
+	// 经纬度细分的单位球，两极共用一个顶点，接缝处回绕，是封闭的流形；三角形数为2 * segments * (rings - 1)
+	void buildSphere(uint32_t targetTriangles, Nanite::NaniteTriMesh& mesh)
+	{
+		const uint32_t rings = std::max(3u, static_cast<uint32_t>(std::sqrt(targetTriangles / 4.0)) + 1);
+		const uint32_t segments = std::max(3u, targetTriangles / (2 * (rings - 1)));
+		const float pi = glm::pi<float>();
+
+		const auto addVertex = [&mesh](const glm::vec3& p, const glm::vec2& uv)
+		{
+			const auto vh = mesh.add_vertex(Nanite::NaniteTriMesh::Point(p.x, p.y, p.z));
+			mesh.set_normal(vh, Nanite::NaniteTriMesh::Normal(p.x, p.y, p.z));
+			mesh.set_texcoord2D(vh, Nanite::NaniteTriMesh::TexCoord2D(uv.x, uv.y));
+			return vh;
+		};
+
+		const auto top = addVertex(glm::vec3(0.0f, 1.0f, 0.0f), glm::vec2(0.5f, 0.0f));
+		std::vector<Nanite::NaniteTriMesh::VertexHandle> ring((rings - 1) * segments);
+		for (uint32_t r = 1; r < rings; r++)
+		{
+			const float theta = pi * static_cast<float>(r) / static_cast<float>(rings);
+			for (uint32_t s = 0; s < segments; s++)
+			{
+				const float phi = 2.0f * pi * static_cast<float>(s) / static_cast<float>(segments);
+				const glm::vec3 p(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+				ring[(r - 1) * segments + s] = addVertex(p, glm::vec2(static_cast<float>(s) / segments, static_cast<float>(r) / rings));
+			}
+		}
+		const auto bottom = addVertex(glm::vec3(0.0f, -1.0f, 0.0f), glm::vec2(0.5f, 1.0f));
+
+		const auto at = [&ring, segments](uint32_t r, uint32_t s) { return ring[r * segments + s % segments]; };
+		for (uint32_t s = 0; s < segments; s++)
+		{
+			mesh.add_face(top, at(0, s + 1), at(0, s));
+			for (uint32_t r = 0; r + 2 < rings; r++)
+			{
+				mesh.add_face(at(r, s), at(r, s + 1), at(r + 1, s + 1));
+				mesh.add_face(at(r, s), at(r + 1, s + 1), at(r + 1, s));
+			}
+			mesh.add_face(bottom, at(rings - 2, s), at(rings - 2, s + 1));
+		}
+		finishMesh(mesh);
+	}
+
+	// 和NaniteMesh::generateNaniteInfo第一级LOD的初始状态一致
+	Nanite::NaniteLodMesh makeFirstLod(const Nanite::NaniteTriMesh& source, OpenMesh::HPropHandleT<int32_t> propHandle)
+	{
+		Nanite::NaniteLodMesh lod;
+		lod.mesh = source;
+		lod.clusterGroupIndexPropHandle = propHandle;
+		return lod;
+	}
+
+	nlohmann::json benchmarkInput(Input& input, uint32_t repetitions)
+	{
+		nlohmann::json result;
+		result["name"] = input.name;
+		result["triangles"] = input.mesh.n_faces();
+		result["vertices"] = input.mesh.n_vertices();
+
+		OpenMesh::HPropHandleT<int32_t> propHandle;
+		input.mesh.add_property(propHandle);
+
+		std::vector<double> samples;
+		const auto record = [&result, &samples](const std::string& stage)
+		{
+			result["stages"][stage] = statsToJson(samples);
+			std::cout << "  " << std::left << std::setw(22) << stage << std::right << std::fixed << std::setprecision(3)
+				<< std::setw(12) << result["stages"][stage]["medianMs"].get<double>() << " ms" << std::endl;
+			samples.clear();
+		};
+
+		// 每次都从新的状态开始，准备工作不计时
+		for (uint32_t i = 0; i < repetitions; i++)
+		{
+			Nanite::NaniteLodMesh lod = makeFirstLod(input.mesh, propHandle);
+			samples.push_back(timeMs([&] { lod.buildTriangleGraph(); }));
+		}
+		record("buildTriangleGraph");
+
+		Nanite::NaniteLodMesh lod = makeFirstLod(input.mesh, propHandle);
+		lod.buildTriangleGraph();
+		for (uint32_t i = 0; i < repetitions; i++)
+		{
+			Nanite::NaniteLodMesh partitioned = lod;
+			samples.push_back(timeMs([&] { partitioned.partitionTriangles(); }));
+		}
+		record("metisClustering");
+
+		lod.partitionTriangles();
+		// 只写各cluster的包围球和面积，重复执行结果相同
+		for (uint32_t i = 0; i < repetitions; i++)
+		{
+			samples.push_back(timeMs([&] { lod.computeClusterBounds(); }));
+		}
+		record("boundingSpheres");
+		result["lod0Clusters"] = lod.clusterNum;
+
+		lod.buildClusterGraph();
+		// 着色只在调试LOD缓冲时开，往空的着色表里写，每次从未着色的副本开始
+		for (uint32_t i = 0; i < repetitions; i++)
+		{
+			Nanite::NaniteLodMesh colored = lod;
+			samples.push_back(timeMs([&] { colored.colorClusterGraph(); }));
+		}
+		record("colorClusterGraph");
+
+		for (uint32_t i = 0; i < repetitions; i++)
+		{
+			Nanite::NaniteLodMesh grouped = lod;
+			samples.push_back(timeMs([&] { grouped.generateClusterGroup(); }));
+		}
+		record("generateClusterGroup");
+
+		lod.generateClusterGroup();
+		result["lod0ClusterGroups"] = lod.clusterGroupNum;
+		for (uint32_t i = 0; i < repetitions; i++)
+		{
+			Nanite::NaniteTriMesh simplified = lod.mesh;
+			samples.push_back(timeMs([&] { lod.simplifyMesh(simplified); }));
+		}
+		record("simplifyMesh");
+
+		std::unique_ptr<Nanite::NaniteMesh> baked;
+		for (uint32_t i = 0; i < repetitions; i++)
+		{
+			baked = std::make_unique<Nanite::NaniteMesh>();
+			Nanite::NaniteTriMesh source = input.mesh;
+			samples.push_back(timeMs([&] { baked->generateNaniteInfo(std::move(source)); }));
+		}
+		record("fullBake");
+		result["lods"] = baked->lodNums;
+		// 最后一次构建每级LOD各阶段结束时的内存
+		for (const auto& stage : baked->buildMemory)
+		{
+			result["buildMemory"].push_back({
+				{"lod", stage.lodLevel},
+				{"stage", stage.stage},
+				{"rssMB", stage.rssBytes / (1024.0 * 1024.0)},
+				{"peakRssMB", stage.peakRssBytes / (1024.0 * 1024.0)}});
+		}
+		size_t clusterCount = 0;
+		for (const auto& lodMesh : baked->meshes)
+		{
+			clusterCount += lodMesh.clusters.size();
+		}
+		result["clusters"] = clusterCount;
+
+		// 和缓存一样写obj和nanite_info.json，包含磁盘IO
+		const std::filesystem::path cacheDirectory = std::filesystem::temp_directory_path() / ("nanite_bench_" + input.name);
+		const std::string cachePath = cacheDirectory.string() + "/";
+		for (uint32_t i = 0; i < repetitions; i++)
+		{
+			std::filesystem::remove_all(cacheDirectory);
+			samples.push_back(timeMs([&] { baked->serialize(cachePath); }));
+		}
+		record("serialize");
+
+		for (uint32_t i = 0; i < repetitions; i++)
+		{
+			Nanite::NaniteMesh loaded;
+			samples.push_back(timeMs([&] { loaded.deserialize(cachePath); }));
+		}
+		record("deserialize");
+		std::filesystem::remove_all(cacheDirectory);
+
+		return result;
+	}
+
+	std::vector<std::string> splitList(const std::string& list)
+	{
+		std::vector<std::string> items;
+		std::stringstream stream(list);
+		std::string item;
+		while (std::getline(stream, item, ','))
+		{
+			if (!item.empty())
+			{
+				items.push_back(item);
+			}
+		}
+		return items;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	CommandLineParser commandLineParser;
+	commandLineParser.add("help", {"--help"}, 0, "Show help");
+	commandLineParser.add("repetitions", {"-r", "--repetitions"}, 1, "Number of runs per stage (default 5)");
+	commandLineParser.add("output", {"-o", "--output"}, 1, "JSON result file (default nanite_bench.json)");
+	commandLineParser.add("models", {"-m", "--models"}, 1, "Comma separated inputs, bundled model names or sphere<triangles> (default all)");
+	commandLineParser.add("maxtriangles", {"-mt", "--maxtriangles"}, 1, "Skip synthetic spheres above this triangle count");
+	commandLineParser.parse(argc, argv);
+	if (commandLineParser.isSet("help"))
+	{
+		commandLineParser.printHelp();
+		std::cout << std::endl;
+		return 0;
+	}
+
+	// 每项的统计至少要有一个样本
+	const int32_t repetitionsArg = commandLineParser.getValueAsInt("repetitions", DEFAULT_REPETITIONS);
+	if (repetitionsArg < 1)
+	{
+		std::cerr << "Repetitions must be at least 1, got " << repetitionsArg << std::endl;
+		return 1;
+	}
+	const uint32_t repetitions = static_cast<uint32_t>(repetitionsArg);
+	const std::string output = commandLineParser.getValueAsString("output", "nanite_bench.json");
+	const int32_t maxTriangles = commandLineParser.getValueAsInt("maxtriangles", INT32_MAX);
+
+	std::vector<std::string> names = BUNDLED_MODELS;
+	for (const uint32_t triangles : SPHERE_TRIANGLE_COUNTS)
+	{
+		if (triangles <= static_cast<uint32_t>(maxTriangles))
+		{
+			names.push_back("sphere" + std::to_string(triangles));
+		}
+	}
+	if (commandLineParser.isSet("models"))
+	{
+		names = splitList(commandLineParser.getValueAsString("models", ""));
+	}
+
+	nlohmann::json report;
+	report["schemaVersion"] = SCHEMA_VERSION;
+	report["repetitions"] = repetitions;
+	report["threads"] = vks::JobSystem::shared().getWorkerCount() + 1;
+	report["inputs"] = nlohmann::json::array();
+
+	for (const std::string& name : names)
+	{
+		Input input;
+		input.name = name;
+		if (name.rfind("sphere", 0) == 0)
+		{
+			buildSphere(static_cast<uint32_t>(std::stoul(name.substr(6))), input.mesh);
+		}
+		else if (!loadGltfMesh(getAssetPath() + "models/" + name + ".gltf", input.mesh))
+		{
+			// 不是所有模型都随仓库提供，缺的跳过并在结果里记下
+			std::cerr << "Skipping " << name << ": could not load " << getAssetPath() << "models/" << name << ".gltf" << std::endl;
+			report["inputs"].push_back({{"name", name}, {"skipped", true}});
+			continue;
+		}
+
+		std::cout << name << " (" << input.mesh.n_faces() << " triangles)" << std::endl;
+		report["inputs"].push_back(benchmarkInput(input, repetitions));
+	}
+
+	std::ofstream file(output);
+	if (!file.is_open())
+	{
+		std::cerr << "Could not write " << output << std::endl;
+		return 1;
+	}
+	file << report.dump(1, '\t') << std::endl;
+	std::cout << "Results written to " << output << std::endl;
+	return 0;
+}
@@ -4,7 +4,6 @@
 void vks::Textures::destroy()
 {
 	environmentCube.destroy();
-	irradianceCube.destroy();
 	prefilteredCube.destroy();
 	lutBrdf.destroy();
 	albedoMap.destroy();
@@ -11,7 +11,6 @@ namespace vks
 		TextureCubeMap environmentCube;
 		// Generated at runtime
 		Texture2D lutBrdf;
-		TextureCubeMap irradianceCube;
 		TextureCubeMap prefilteredCube;
 		// Object texture maps
 		Texture2D albedoMap;
@@ -47,11 +46,24 @@ namespace vks
 		glm::vec3 camPos;
 	};
 
+	// 着色器里按cluster、group、LOD的ID哈希出调试颜色，与pbrtexture.frag、visResolve.frag的DEBUG_VIEW_*一致
+	enum class DebugView : int32_t
+	{
+		None = 0,
+		Lod = 1,
+		Cluster = 2,
+		Group = 3,
+	};
+
 	struct UniformDataParams
 	{
 		glm::vec4 lights[4];
 		float exposure = 4.5f;
 		float gamma = 2.2f;
+		// DebugView，int32_t是为了直接给UIOverlay::comboBox用
+		int32_t debugView = static_cast<int32_t>(DebugView::Lod);
+		// 余弦卷积后的9个SH系数(rgb)，代替irradiance cubemap
+		alignas(16) glm::vec4 shIrradiance[9]{};
 	};
 
 	struct Pipelines
@@ -69,11 +81,47 @@ namespace vks
 		uint32_t vertexOffset;
 	};
 
+	// 实例剔除写出的cluster pass间接参数，后面跟着可见实例数，与instanceCulling.comp的ClusterDispatch一致
+	struct ClusterDispatchIndirect
+	{
+		VkDispatchIndirectCommand dispatch;
+		uint32_t visibleInstanceCount;
+	};
+
 	struct UBOCullingMatrices
 	{
 		glm::mat4 model;
+		// 上一帧的矩阵，和HZB对应
 		glm::mat4 lastView;
 		glm::mat4 lastProj;
+		// 当前帧的矩阵，视锥剔除用
+		glm::mat4 view;
+		glm::mat4 proj;
+	};
+
+	// 与culling.comp里的CullingStats一致
+	constexpr uint32_t CULLING_STATS_MAX_LOD = 16;
+
+	struct CullingStats
+	{
+		uint32_t clustersTested;
+		uint32_t lodRejected;
+		uint32_t frustumCulled;
+		uint32_t clustersSelected;
+		uint32_t trianglesEmitted;
+		uint32_t instancesCulled;
+		// 超出可见实例上限被丢弃的实例
+		uint32_t instancesDropped;
+		uint32_t lodHistogram[CULLING_STATS_MAX_LOD];
+		// 三角形级剔除，只有triangleCulling.comp会声明到这里
+		uint32_t triangleClusters;
+		uint32_t trianglesBackface;
+		uint32_t trianglesDegenerate;
+		uint32_t trianglesFrustum;
+		uint32_t trianglesSmall;
+		// 软件光栅化，只有swRaster.comp会声明到这里
+		uint32_t swRasterClusters;
+		uint32_t swRasterTriangles;
 	};
 
 	struct UBOErrorMatrices
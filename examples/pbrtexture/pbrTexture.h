@@ -3,6 +3,7 @@
 #include "Pipeline.h"
 #include "vulkanexamplebase.h"
 #include "VulkanglTFModel.h"
+#include "VulkanProfiler.h"
 #include "../src/NaniteMesh/NaniteScene.h"
 #include "../src/NaniteMesh/Const.h"
 
@@ -20,10 +21,12 @@ public:
 
 	// 虚函数覆盖
 	void getEnabledFeatures() override;
+	void getEnabledExtensions() override;
 	void prepare() override;
 	void buildCommandBuffers() override;
 	void render() override;
 	void viewChanged() override;
+	void windowResized() override;
 	void OnUpdateUIOverlay(vks::UIOverlay* overlay) override;
 	void setupDepthStencil() override;
 
@@ -34,41 +37,126 @@ public:
 
 	// IBL生成
 	void generateBRDFLUT();
-	void generateIrradianceCube();
 	void generatePrefilteredCube();
+	void prepareIBL();
 
 	// Uniform缓冲区
 	void prepareUniformBuffers();
 	void updateUniformBuffers();
 	void updateParams();
+	void updateCullingUniforms(Camera& lodCamera, const glm::mat4& frustumView, const glm::mat4& frustumProj);
 
 	// 缓冲区创建
 	void createHizBuffer();
 	void createCullingBuffers();
+	void createInstanceCullingBuffers();
+	void createDagTraversalBuffers();
+	void createTriangleCullingBuffers();
+	void createSwRasterBuffers();
+	void createVisibilityBuffer();
+	void createVisResolveRenderPass();
 	void createErrorProjectionBuffers();
 	void createNaniteScene();
+	// 场景buffer上传之后释放构建期数据
+	void finalizeNaniteScene();
 
 	void initLogSystem();
 
 private:
 	// 命令缓冲区辅助方法
 	void recordComputeCommands(VkCommandBuffer cmdBuffer, size_t frameIndex);
+	void recordDagTraversalCommands(VkCommandBuffer cmdBuffer, uint32_t frame);
+	void recordTriangleCullingCommands(VkCommandBuffer cmdBuffer, uint32_t frame);
+	void recordSwRasterCommands(VkCommandBuffer cmdBuffer, uint32_t frame);
 	void recordRenderPassCommands(VkCommandBuffer cmdBuffer, const VkRenderPassBeginInfo& rpBeginInfo);
+	void recordVisResolveCommands(VkCommandBuffer cmdBuffer);
+	void recordCullingStatsReadback(VkCommandBuffer cmdBuffer, size_t frameIndex, VkPipelineStageFlags srcStage);
 	void recordDepthCopyCommands(VkCommandBuffer cmdBuffer);
 	void recordHizGenerationCommands(VkCommandBuffer cmdBuffer);
 	void recordDebugQuadCommands(VkCommandBuffer cmdBuffer, const VkRenderPassBeginInfo& rpBeginInfo, const VkViewport& viewport, const VkRect2D& scissor);
 
+	// 软件光栅化校验：读回GPU的visibility buffer，和Nanite::SoftwareRasterizer对同一批cluster的结果逐像素对比
+	void runSwRasterCheck();
+	void readBackBuffer(VkBuffer buffer, VkDeviceSize size, void* data);
+
+	// 异步compute
+	void prepareAsyncCompute();
+	void destroyAsyncCompute();
+	void resetAsyncComputeSync();
+	void submitCullingCompute(bool aheadOfFrame);
+	void recordCullingRelease(VkCommandBuffer cmdBuffer);
+	void recordCullingAcquire(VkCommandBuffer cmdBuffer);
+	[[nodiscard]] vks::GpuProfiler& cullingProfiler() { return asyncComputeActive() ? computeProfiler : gpuProfiler; }
+	[[nodiscard]] bool asyncComputeActive() const { return useAsyncCompute && asyncComputeSupported && !useMeshShading; }
+	// 三角形剔除和软件光栅化依赖当帧的精确相机，异步模式下剔除早一帧提交，不参与
+	[[nodiscard]] bool triangleCullingActive() const { return enableTriangleCulling && !useMeshShading && !asyncComputeActive(); }
+	[[nodiscard]] bool swRasterActive() const { return enableSwRaster && !useMeshShading && !asyncComputeActive(); }
+	// visibility buffer在计算和fragment里都会原子写，专用计算队列不支持fragment阶段
+	[[nodiscard]] VkPipelineStageFlags visibilityShaderStages() const { return asyncComputeActive() ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT; }
+
 	// 内存屏障辅助方法
 	[[nodiscard]] static VkBufferMemoryBarrier createBufferBarrier(VkBuffer buffer, VkAccessFlags srcAccess, VkAccessFlags dstAccess);
 	[[nodiscard]] static VkImageMemoryBarrier createImageBarrier(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess, const VkImageSubresourceRange& subresourceRange);
 
 	// Pipeline创建辅助
 	void createGraphicsPipelines();
+	void createMeshShadingPipeline();
 	void createComputePipelines();
 
 public:
 	// 显示设置
 	bool displaySkybox = true;
+	// 用GPU上的DAG遍历代替逐cluster的误差投影和LOD测试
+	bool useDagTraversal = false;
+	// 对投影足够大的cluster再做一遍三角形级剔除
+	bool enableTriangleCulling = false;
+	float triangleCullingMinSize = 32.0f;
+	// 三角形平均投影边长很小的cluster改用compute软件光栅化，需要64位buffer atomic
+	bool enableSwRaster = false;
+	bool swRasterSupported = false;
+	float swRasterMaxTriangleSize = 2.0f;
+	// 几何pass只写visibility buffer，之后全屏material pass每个像素只着色一次
+	bool enableVisibilityBuffer = false;
+	bool visibilityBufferSupported = false;
+	// task shader做cluster剔除和LOD选择，mesh shader直接输出cluster，设备支持时默认使用
+	bool useMeshShading = false;
+	bool meshShaderSupported = false;
+	// 剔除链放到独立的compute队列，在上一帧present之后提前执行；需要单独的compute队列族
+	bool useAsyncCompute = false;
+	bool asyncComputeSupported = false;
+	// 提前一帧剔除时按上一帧的相机运动外推，并放大视锥盖住误差
+	bool expandCullingFrustum = true;
+
+	// 实例网格，由命令行配置；stress模式按实例数铺成近似正方形，并且每帧重建一次cluster数据测CPU开销
+	struct InstanceGridSettings
+	{
+		// models/下的glTF名字，不带扩展名
+		std::string mesh = "bunny";
+		uint32_t countX = 1;
+		uint32_t countZ = 1;
+		// 0表示countX * countZ，否则最后一行只放到这个数为止
+		uint32_t instanceCount = 0;
+		float spacing = 3.0f;
+		bool randomRotation = false;
+		// 缩放在[1 - randomScale, 1 + randomScale]里均匀分布
+		float randomScale = 0.0f;
+		uint32_t seed = 1;
+		bool stress = false;
+	} instanceGrid;
+	// 烘焙时做cluster图着色并给每级LOD建调试顶点缓冲，命令行开启
+	bool buildDebugLodBuffers = false;
+	// 命令行开启后强制只走软件光栅化路径，渲染到第frame帧后做一次GPU/CPU对比
+	struct SwRasterCheck
+	{
+		static constexpr uint32_t FRAME = 8;
+		bool requested = false;
+		uint32_t frameCounter = 0;
+	} swRasterCheck;
+	// 最近一次重建cluster数据的CPU耗时
+	double clusterInfoBuildMs = 0.0;
+	// finalizeNaniteScene前后的进程常驻内存
+	size_t residentBytesBeforeFinalize = 0;
+	size_t residentBytesAfterFinalize = 0;
 
 	// 资源
 	vks::Textures textures;
@@ -84,31 +172,100 @@ public:
 	Pipeline depthCopyPipeline;
 	Pipeline debugQuadPipeline;
 	Pipeline cullingPipeline;
-	Pipeline errorProjPipeline;
+	Pipeline instanceCullingPipeline;
+	Pipeline dagTraversalPipeline;
+	Pipeline triangleCullingPipeline;
+	Pipeline swRasterPipeline;
+	Pipeline visResolvePipeline;
+	Pipeline visBufferPipeline;
+	Pipeline meshShadingPipeline;
+	PFN_vkCmdDrawMeshTasksIndirectEXT vkCmdDrawMeshTasksIndirectEXT{nullptr};
+	// material pass用，LOAD已有的颜色和深度，和renderPass兼容，共用framebuffer
+	VkRenderPass visResolveRenderPass{VK_NULL_HANDLE};
 
 	// HIZ相关
 	std::vector<VkImageView> hizImageViews;
 	VkSampler depthStencilSampler{VK_NULL_HANDLE};
 
 	// Nanite相关
-	Nanite::NaniteMesh naniteMesh;
+	// mesh放在scene.naniteMeshes里，实例直接引用
 	Nanite::NaniteScene scene;
 	std::vector<glm::mat4> modelMats;
-	std::vector<Nanite::ClusterInfo> clusterInfos;
-	std::vector<Nanite::ErrorInfo> errorInfos;
 
 	// Culling缓冲区
 	vks::Buffer culledIndicesBuffer;
 	vks::Buffer clustersInfoBuffer;
+	// 剔除、DAG遍历和task shader读的Nanite::PackedCluster
+	vks::Buffer packedClustersBuffer;
 	vks::Buffer cullingUniformBuffer;
 	vks::Buffer drawIndexedIndirectBuffer;
 	vks::DrawIndexedIndirect drawIndexedIndirect{};
 
+	// 实例级剔除缓冲区
+	vks::Buffer instanceInfoBuffer;
+	vks::Buffer visibleInstancesBuffer;
+	vks::Buffer clusterDispatchBuffer;
+	uint32_t maxVisibleInstances = 0;
+	// task shader路径另外受maxTaskWorkGroupTotalCount限制
+	uint32_t maxMeshShadingVisibleInstances = 0;
+	// 可见实例每行的个数，放不下的换到下一行(groupCountZ)
+	uint32_t visibleInstanceRowSize = 0;
+
+	// DAG遍历缓冲区：打包的DAG拓扑，以及工作队列+访问标记
+	vks::Buffer dagBuffer;
+	vks::Buffer dagQueueBuffer;
+	VkDeviceSize dagQueueItemsSize = 0;
+	VkDeviceSize dagVisitedSize = 0;
+
+	// 三角形级剔除缓冲区：待处理cluster列表、间接dispatch参数、每个实例的变换
+	vks::Buffer triangleCullClustersBuffer;
+	vks::Buffer triangleCullDispatchBuffer;
+	vks::Buffer instanceTransformsBuffer;
+	uint32_t maxTriangleCullingClusters = 0;
+
+	// 软件光栅化缓冲区：每像素64位的 depth|clusterID|triangleID，以及待光栅化的cluster列表
+	vks::Buffer visibilityBuffer;
+	vks::Buffer swRasterClustersBuffer;
+	vks::Buffer swRasterDispatchBuffer;
+	// 和culledIndicesBuffer里的三角形一一对应的 clusterID << 7 | triangleID
+	vks::Buffer culledTriangleIdsBuffer;
+	uint32_t maxSwRasterClusters = 0;
+	// 设备创建时挂到pNext链上，需要活到createLogicalDevice之后
+	VkPhysicalDeviceShaderAtomicInt64Features enabledAtomicInt64Features{};
+	VkPhysicalDeviceMeshShaderFeaturesEXT enabledMeshShaderFeatures{};
+
 	// Error Projection缓冲区
-	vks::Buffer errorInfoBuffer;
-	vks::Buffer projectedErrorBuffer;
 	vks::Buffer errorUniformBuffer;
 
+	// GPU分段计时
+	vks::GpuProfiler gpuProfiler;
+
+	// 异步compute，command buffer按slot轮转，和swapchain image无关
+	VkQueue computeQueue{VK_NULL_HANDLE};
+	VkCommandPool computeCmdPool{VK_NULL_HANDLE};
+	std::vector<VkCommandBuffer> computeCmdBuffers;
+	struct
+	{
+		// compute -> graphics：剔除结果可用
+		VkSemaphore computeComplete{VK_NULL_HANDLE};
+		// graphics -> compute：HZB已生成，上一帧不再读剔除结果
+		VkSemaphore graphicsComplete{VK_NULL_HANDLE};
+	} asyncSemaphores;
+	vks::GpuProfiler computeProfiler;
+	// 最近一次提交的compute slot
+	uint32_t computeSlot = 0;
+	// 已提交、还没被graphics等待的compute
+	bool computePending = false;
+	// graphicsComplete已signal、还没被compute等待
+	bool graphicsSignaled = false;
+	glm::vec3 lastCullingCameraPosition{};
+	glm::vec3 lastCullingCameraRotation{};
+
+	// Culling统计，readback按command buffer分slot，持久映射
+	vks::Buffer cullingStatsBuffer;
+	vks::Buffer cullingStatsReadback;
+	vks::CullingStats cullingStats{};
+
 	// Uniform数据
 	vks::UBOCullingMatrices uboCullingMatrices;
 	vks::UBOErrorMatrices uboErrorMatrices;
@@ -117,18 +274,71 @@ public:
 	struct CullingPushConstants
 	{
 		int numClusters;
+		int triangleCullingEnabled;
+		float triangleCullingMinSize;
+		uint32_t maxTriangleCullingClusters;
+		int swRasterEnabled;
+		float swRasterMaxTriangleSize;
+		uint32_t maxSwRasterClusters;
+		// LOD误差投影用
+		alignas(8) glm::vec2 screenSize;
 	} cullingPushConstants{};
 
-	struct ErrorPushConstants
+	struct InstanceCullingPushConstants
+	{
+		int numInstances;
+		int maxVisibleInstances;
+		int visibleRowSize;
+	} instanceCullingPushConstants{};
+
+	struct DagTraversalPushConstants
+	{
+		uint32_t phase;
+		uint32_t numClusters;
+		alignas(8) glm::vec2 screenSize;
+		uint32_t rootRangeOffset;
+		uint32_t childIndexOffset;
+		int triangleCullingEnabled;
+		float triangleCullingMinSize;
+		uint32_t maxTriangleCullingClusters;
+		int swRasterEnabled;
+		float swRasterMaxTriangleSize;
+		uint32_t maxSwRasterClusters;
+	} dagTraversalPushConstants{};
+
+	struct TriangleCullingPushConstants
+	{
+		uint32_t vertexStride;
+		alignas(8) glm::vec2 screenSize;
+	} triangleCullingPushConstants{};
+
+	struct SwRasterPushConstants
+	{
+		uint32_t vertexStride;
+		uint32_t width;
+		uint32_t height;
+	} swRasterPushConstants{};
+
+	struct MeshShadingPushConstants
 	{
-		alignas(4) int numClusters;
+		uint32_t numClusters;
+		uint32_t vertexStride;
+		// 只有task shader用，LOD误差投影
 		alignas(8) glm::vec2 screenSize;
-	} errorPushConstants{};
+	} meshShadingPushConstants{};
 
 private:
 	// 常量
 	static constexpr int WORKGROUP_SIZE_X = 8;
 	static constexpr int WORKGROUP_SIZE_Y = 8;
 	static constexpr int DISPATCH_GROUP_SIZE = 64;
+	// DAG遍历的persistent workgroup数量，太多只会空转，太少填不满GPU
+	static constexpr uint32_t DAG_PERSISTENT_WORKGROUPS = 128;
+	// 与nanite.mesh的MAX_CLUSTER_TRIANGLES一致
+	static constexpr uint32_t MESH_MAX_CLUSTER_TRIANGLES = 64;
+	// 剔除输出的三角形上限，实例很多时不按所有实例的LOD0分配，装不下的cluster在shader里丢弃
+	static constexpr VkDeviceSize MAX_CULLED_TRIANGLES = 1u << 23;
+	// visibility payload是 clusterID << 7 | triangleID，与着色器里的VIS_TRIANGLE_BITS一致
+	static constexpr uint32_t VIS_TRIANGLE_BITS = 7;
 	static constexpr bool ENABLE_DEBUG_QUAD = false;
 };
@@ -10,21 +10,84 @@
 #include "logger.h"
 #include "pbrTexture.h"
 #include "VulkanDescriptorManager.h"
+#include "VulkanAssetLoader.h"
 #include "../../src/vksTools.h"
 #include "../../src/NaniteMesh/NaniteMesh.h"
 #include "../../src/NaniteMesh/NaniteInstance.h"
 #include "../../src/NaniteMesh/NaniteLodMesh.h"
+#include "../../src/NaniteMesh/SoftwareRasterizer.h"
+#include "../../src/utils.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+// 环境贴图，IBL缓存的key也由它的内容算出
+constexpr const char* ENVIRONMENT_CUBE_FILE = "textures/hdr/gcanyon_cube.ktx";
 
 PBRTexture::PBRTexture() : VulkanExampleBase(true)
 {
 	title = "Textured PBR with IBL";
+	// 软件光栅化要查询64位atomic的feature，需要vkGetPhysicalDeviceFeatures2
+	apiVersion = VK_API_VERSION_1_1;
 	camera.type = Camera::CameraType::firstperson;
 	camera.movementSpeed = 4.0f;
 	camera.setPerspective(60.0f, static_cast<float>(width) / static_cast<float>(height), 0.1f, 256.0f);
 	camera.rotationSpeed = 0.25f;
 	camera.setRotation({-7.75f, 150.25f, 0.0f});
 	camera.setPosition({0.7f, 0.1f, 1.7f});
+
+	// 基类构造时已经解析过一遍，这里加上本例的选项再解析一次
+	commandLineParser.add("instancesx", {"-ix", "--instancesx"}, 1, "Number of instances along x (default 1)");
+	commandLineParser.add("instancesz", {"-iz", "--instancesz"}, 1, "Number of instances along z (default 1)");
+	commandLineParser.add("instancespacing", {"-isp", "--instancespacing"}, 1, "Distance between neighbouring instances (default 3)");
+	commandLineParser.add("randomrotation", {"-irr", "--randomrotation"}, 0, "Rotate every instance by a random angle around the up axis");
+	commandLineParser.add("randomscale", {"-irs", "--randomscale"}, 1, "Scale every instance randomly by up to the given fraction, e.g. 0.25");
+	commandLineParser.add("instanceseed", {"-iseed", "--instanceseed"}, 1, "Seed for random instance rotation and scale (default 1)");
+	commandLineParser.add("mesh", {"-m", "--mesh"}, 1, "glTF model under models/ to instance, without extension (default bunny)");
+	commandLineParser.add("stress", {"-st", "--stress"}, 1, "Place the given number of instances (e.g. 100000) and rebuild cluster infos every frame");
+	commandLineParser.add("debuglodbuffers", {"-dlb", "--debuglodbuffers"}, 0, "Colour the cluster graphs at bake time and upload a debug vertex buffer per LOD");
+	commandLineParser.add("swrastercheck", {"-swc", "--swrastercheck"}, 0, "Render with software raster only and compare the GPU visibility buffer against the CPU reference rasterizer");
+	commandLineParser.parse(args);
+	if (commandLineParser.isSet("instancesx"))
+	{
+		instanceGrid.countX = static_cast<uint32_t>(commandLineParser.getValueAsInt("instancesx", 1));
+	}
+	if (commandLineParser.isSet("instancesz"))
+	{
+		instanceGrid.countZ = static_cast<uint32_t>(commandLineParser.getValueAsInt("instancesz", 1));
+	}
+	if (commandLineParser.isSet("instancespacing"))
+	{
+		instanceGrid.spacing = std::strtof(commandLineParser.getValueAsString("instancespacing", "3").c_str(), nullptr);
+	}
+	if (commandLineParser.isSet("randomrotation"))
+	{
+		instanceGrid.randomRotation = true;
+	}
+	if (commandLineParser.isSet("randomscale"))
+	{
+		instanceGrid.randomScale = std::clamp(std::strtof(commandLineParser.getValueAsString("randomscale", "0").c_str(), nullptr), 0.0f, 0.9f);
+	}
+	if (commandLineParser.isSet("instanceseed"))
+	{
+		instanceGrid.seed = static_cast<uint32_t>(commandLineParser.getValueAsInt("instanceseed", 1));
+	}
+	if (commandLineParser.isSet("mesh"))
+	{
+		instanceGrid.mesh = commandLineParser.getValueAsString("mesh", instanceGrid.mesh);
+	}
+	if (commandLineParser.isSet("stress"))
+	{
+		// 铺成近似正方形，最后一行不满
+		instanceGrid.stress = true;
+		instanceGrid.instanceCount = static_cast<uint32_t>(commandLineParser.getValueAsInt("stress", 100000));
+		instanceGrid.countX = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(instanceGrid.instanceCount))));
+		instanceGrid.countZ = (instanceGrid.instanceCount + instanceGrid.countX - 1) / instanceGrid.countX;
+	}
+	buildDebugLodBuffers = commandLineParser.isSet("debuglodbuffers");
+	swRasterCheck.requested = commandLineParser.isSet("swrastercheck");
 }
 
 PBRTexture::~PBRTexture()
@@ -57,6 +120,39 @@ PBRTexture::~PBRTexture()
 	hizComputePipeline.destroy(device);
 	depthCopyPipeline.destroy(device);
 	debugQuadPipeline.destroy(device);
+
+	gpuProfiler.destroy();
+	destroyAsyncCompute();
+	cullingStatsBuffer.destroy();
+	cullingStatsReadback.destroy();
+
+	instanceCullingPipeline.destroy(device);
+	instanceInfoBuffer.destroy();
+	visibleInstancesBuffer.destroy();
+	clusterDispatchBuffer.destroy();
+
+	dagTraversalPipeline.destroy(device);
+	dagBuffer.destroy();
+	dagQueueBuffer.destroy();
+
+	triangleCullingPipeline.destroy(device);
+	triangleCullClustersBuffer.destroy();
+	triangleCullDispatchBuffer.destroy();
+	instanceTransformsBuffer.destroy();
+
+	swRasterPipeline.destroy(device);
+	visResolvePipeline.destroy(device);
+	visibilityBuffer.destroy();
+	swRasterClustersBuffer.destroy();
+	swRasterDispatchBuffer.destroy();
+
+	visBufferPipeline.destroy(device);
+	culledTriangleIdsBuffer.destroy();
+	meshShadingPipeline.destroy(device);
+	if (visResolveRenderPass != VK_NULL_HANDLE)
+	{
+		vkDestroyRenderPass(device, visResolveRenderPass, nullptr);
+	}
 }
 
 void PBRTexture::getEnabledFeatures()
@@ -65,6 +161,73 @@ void PBRTexture::getEnabledFeatures()
 	{
 		enabledFeatures.samplerAnisotropy = VK_TRUE;
 	}
+	if (deviceFeatures.shaderInt64)
+	{
+		enabledFeatures.shaderInt64 = VK_TRUE;
+	}
+	// visibility buffer模式在片元里做64位atomic
+	if (deviceFeatures.fragmentStoresAndAtomics)
+	{
+		enabledFeatures.fragmentStoresAndAtomics = VK_TRUE;
+	}
+}
+
+void PBRTexture::getEnabledExtensions()
+{
+	// 软件光栅化用64位buffer atomicMin写visibility buffer，不支持时只保留硬件光栅化
+	swRasterSupported = false;
+	if (deviceFeatures.shaderInt64 && vulkanDevice->extensionSupported(VK_KHR_SHADER_ATOMIC_INT64_EXTENSION_NAME))
+	{
+		VkPhysicalDeviceShaderAtomicInt64Features atomicInt64Features{};
+		atomicInt64Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_ATOMIC_INT64_FEATURES;
+		VkPhysicalDeviceFeatures2 features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &atomicInt64Features;
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+		swRasterSupported = atomicInt64Features.shaderBufferInt64Atomics == VK_TRUE;
+	}
+
+	if (swRasterSupported)
+	{
+		enabledDeviceExtensions.push_back(VK_KHR_SHADER_ATOMIC_INT64_EXTENSION_NAME);
+		enabledAtomicInt64Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_ATOMIC_INT64_FEATURES;
+		enabledAtomicInt64Features.shaderBufferInt64Atomics = VK_TRUE;
+		enabledAtomicInt64Features.pNext = deviceCreatepNextChain;
+		deviceCreatepNextChain = &enabledAtomicInt64Features;
+	}
+	else
+	{
+		std::cout << "Software raster disabled: shaderBufferInt64Atomics not supported" << std::endl;
+	}
+
+	// mesh shader需要SPIR-V 1.4，不支持时回退到compute剔除 + indirect draw
+	meshShaderSupported = false;
+	if (vulkanDevice->extensionSupported(VK_EXT_MESH_SHADER_EXTENSION_NAME) && vulkanDevice->extensionSupported(VK_KHR_SPIRV_1_4_EXTENSION_NAME) && vulkanDevice->extensionSupported(VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME))
+	{
+		VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures{};
+		meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+		VkPhysicalDeviceFeatures2 features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &meshShaderFeatures;
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+		meshShaderSupported = meshShaderFeatures.taskShader == VK_TRUE && meshShaderFeatures.meshShader == VK_TRUE;
+	}
+
+	if (meshShaderSupported)
+	{
+		enabledDeviceExtensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+		enabledDeviceExtensions.push_back(VK_KHR_SPIRV_1_4_EXTENSION_NAME);
+		enabledDeviceExtensions.push_back(VK_KHR_SHADER_FLOAT_CONTROLS_EXTENSION_NAME);
+		enabledMeshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+		enabledMeshShaderFeatures.taskShader = VK_TRUE;
+		enabledMeshShaderFeatures.meshShader = VK_TRUE;
+		enabledMeshShaderFeatures.pNext = deviceCreatepNextChain;
+		deviceCreatepNextChain = &enabledMeshShaderFeatures;
+	}
+	else
+	{
+		std::cout << "Mesh shading disabled: VK_EXT_mesh_shader not supported, using compute culling" << std::endl;
+	}
 }
 
 void PBRTexture::loadAssets()
@@ -73,30 +236,41 @@ void PBRTexture::loadAssets()
 
 	const std::string assetPath = getAssetPath();
 
+	// 纹理在加载线程上映射、解码并写进上传环，主线程同时加载模型、构建Nanite数据
+	vks::AssetLoader assetLoader;
+	assetLoader.create(vulkanDevice, &uploadManager);
+	assetLoader.loadTextureCubeMap(textures.environmentCube, assetPath + ENVIRONMENT_CUBE_FILE, VK_FORMAT_R16G16B16A16_SFLOAT);
+	assetLoader.loadTexture2D(textures.albedoMap, assetPath + "models/cerberus/albedo.ktx", VK_FORMAT_R8G8B8A8_UNORM);
+	assetLoader.loadTexture2D(textures.normalMap, assetPath + "models/cerberus/normal.ktx", VK_FORMAT_R8G8B8A8_UNORM);
+	assetLoader.loadTexture2D(textures.aoMap, assetPath + "models/cerberus/ao.ktx", VK_FORMAT_R8_UNORM);
+	assetLoader.loadTexture2D(textures.metallicMap, assetPath + "models/cerberus/metallic.ktx", VK_FORMAT_R8_UNORM);
+	assetLoader.loadTexture2D(textures.roughnessMap, assetPath + "models/cerberus/roughness.ktx", VK_FORMAT_R8_UNORM);
+
 	models.skybox.loadFromFile(assetPath + "models/cube.gltf", vulkanDevice, queue, glTFLoadingFlags);
-	models.object.loadFromFile(assetPath + "models/bunny.gltf", vulkanDevice, queue, glTFLoadingFlags);
+	const std::string meshPath = assetPath + "models/" + instanceGrid.mesh;
+	models.object.loadFromFile(meshPath + ".gltf", vulkanDevice, queue, glTFLoadingFlags);
 
-	// Nanite mesh初始化
-	naniteMesh.setModelPath((assetPath + "models/bunny/").c_str());
+	// Nanite mesh初始化，直接建在场景里，不再拷贝一份
+	auto& naniteMesh = scene.naniteMeshes.emplace_back();
+	naniteMesh.setModelPath((meshPath + "/").c_str());
 	naniteMesh.loadvkglTFModel(models.object);
-	naniteMesh.initNaniteInfo(assetPath + "models/bunny.gltf", true);
+	naniteMesh.colorClusterGraphs = buildDebugLodBuffers;
+	naniteMesh.initNaniteInfo(meshPath + ".gltf", true);
 
-	for (auto& lodMesh : naniteMesh.meshes)
+	// 绘制路径不用这些逐LOD的非索引顶点缓冲，调试视图在着色器里按ID哈希上色
+	if (buildDebugLodBuffers)
 	{
-		lodMesh.initUniqueVertexBuffer();
-		lodMesh.initVertexBuffer();
-		lodMesh.createVertexBuffer(*this);
+		for (auto& lodMesh : naniteMesh.meshes)
+		{
+			lodMesh.initVertexBuffer();
+			lodMesh.createVertexBuffer(*this);
+		}
 	}
 
 	createNaniteScene();
 
-	// 加载纹理
-	textures.environmentCube.loadFromFile(assetPath + "textures/hdr/gcanyon_cube.ktx", VK_FORMAT_R16G16B16A16_SFLOAT, vulkanDevice, queue);
-	textures.albedoMap.loadFromFile(assetPath + "models/cerberus/albedo.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
-	textures.normalMap.loadFromFile(assetPath + "models/cerberus/normal.ktx", VK_FORMAT_R8G8B8A8_UNORM, vulkanDevice, queue);
-	textures.aoMap.loadFromFile(assetPath + "models/cerberus/ao.ktx", VK_FORMAT_R8_UNORM, vulkanDevice, queue);
-	textures.metallicMap.loadFromFile(assetPath + "models/cerberus/metallic.ktx", VK_FORMAT_R8_UNORM, vulkanDevice, queue);
-	textures.roughnessMap.loadFromFile(assetPath + "models/cerberus/roughness.ktx", VK_FORMAT_R8_UNORM, vulkanDevice, queue);
+	// 环境贴图马上要被IBL预计算采样，这里等它真正拷完
+	uploadManager.wait(assetLoader.finish());
 }
 
 void PBRTexture::setupDescriptors()
@@ -149,8 +323,11 @@ void PBRTexture::createGraphicsPipelines()
 
 	std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
 
-	// Pipeline layout
+	// Pipeline layout，pbrtexture.vert按push常量里的步长从storage buffer取顶点
+	VkPushConstantRange vertexStridePush{VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(uint32_t)};
 	VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descManager->getSetLayout(DescriptorType::Scene), 1);
+	pipelineLayoutCI.pushConstantRangeCount = 1;
+	pipelineLayoutCI.pPushConstantRanges = &vertexStridePush;
 	VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
 
 	// Pipeline创建信息
@@ -172,7 +349,9 @@ void PBRTexture::createGraphicsPipelines()
 	shaderStages[1] = loadShader(shaderPath + "skybox.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipelines.skybox));
 
-	// PBR pipeline
+	// PBR pipeline：不走顶点输入，顶点和实例变换都在顶点着色器里从storage buffer取
+	VkPipelineVertexInputStateCreateInfo emptyVertexInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
+	pipelineCI.pVertexInputState = &emptyVertexInputState;
 	rasterizationState.cullMode = VK_CULL_MODE_BACK_BIT;
 	depthStencilState.depthWriteEnable = VK_TRUE;
 	depthStencilState.depthTestEnable = VK_TRUE;
@@ -188,11 +367,105 @@ void PBRTexture::createGraphicsPipelines()
 	depthStencilState.depthWriteEnable = VK_FALSE;
 	depthStencilState.depthTestEnable = VK_FALSE;
 	rasterizationState.cullMode = VK_CULL_MODE_NONE;
-	VkPipelineVertexInputStateCreateInfo emptyVertexInputState = vks::initializers::pipelineVertexInputStateCreateInfo();
-	pipelineCI.pVertexInputState = &emptyVertexInputState;
 	shaderStages[0] = loadShader(shaderPath + "debugQuad.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
 	shaderStages[1] = loadShader(shaderPath + "debugQuad.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
 	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &debugQuadPipeline.pipeline));
+
+	// Visibility buffer resolve pipeline：全屏三角形，片元里写gl_FragDepth和硬件光栅化的结果做深度测试
+	if (swRasterSupported)
+	{
+		VkPushConstantRange visResolvePush{VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SwRasterPushConstants)};
+		pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descManager->getSetLayout(DescriptorType::visResolve), 1);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &visResolvePush;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &visResolvePipeline.pipelineLayout));
+
+		pipelineCI.layout = visResolvePipeline.pipelineLayout;
+		depthStencilState.depthWriteEnable = VK_TRUE;
+		depthStencilState.depthTestEnable = VK_TRUE;
+		shaderStages[0] = loadShader(shaderPath + "debugQuad.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[1] = loadShader(shaderPath + "visResolve.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &visResolvePipeline.pipeline));
+	}
+
+	// Visibility buffer几何pass：和PBR pipeline一样的光栅化状态，不写颜色
+	if (visibilityBufferSupported)
+	{
+		VkPushConstantRange visBufferPush{VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SwRasterPushConstants)};
+		pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(&descManager->getSetLayout(DescriptorType::visBuffer), 1);
+		pipelineLayoutCI.pushConstantRangeCount = 1;
+		pipelineLayoutCI.pPushConstantRanges = &visBufferPush;
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &visBufferPipeline.pipelineLayout));
+
+		pipelineCI.layout = visBufferPipeline.pipelineLayout;
+		rasterizationState.cullMode = VK_CULL_MODE_BACK_BIT;
+		depthStencilState.depthWriteEnable = VK_TRUE;
+		depthStencilState.depthTestEnable = VK_TRUE;
+		blendAttachmentState.colorWriteMask = 0;
+		shaderStages[0] = loadShader(shaderPath + "visBuffer.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shaderStages[1] = loadShader(shaderPath + "visBuffer.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &visBufferPipeline.pipeline));
+	}
+
+	if (meshShaderSupported)
+	{
+		createMeshShadingPipeline();
+	}
+}
+
+void PBRTexture::createMeshShadingPipeline()
+{
+	// nanite.mesh一个workgroup输出一个cluster，cluster的三角形数不能超过上限
+	for (const auto& cluster : scene.clusterInfo)
+	{
+		if (cluster.triangleIndicesEnd - cluster.triangleIndicesStart > MESH_MAX_CLUSTER_TRIANGLES)
+		{
+			std::cout << "Mesh shading disabled: cluster has more than " << MESH_MAX_CLUSTER_TRIANGLES << " triangles" << std::endl;
+			meshShaderSupported = false;
+			useMeshShading = false;
+			return;
+		}
+	}
+
+	auto descManager = VulkanDescriptorManager::getManager();
+	const std::string shaderPath = getShadersPath() + "pbrtexture/";
+
+	// set 0是pbrtexture.frag用的scene set，set 1是task/mesh读的cluster数据
+	std::array<VkDescriptorSetLayout, 2> setLayouts{descManager->getSetLayout(DescriptorType::Scene), descManager->getSetLayout(DescriptorType::meshShading)};
+	VkPushConstantRange meshPush{VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT, 0, sizeof(MeshShadingPushConstants)};
+	VkPipelineLayoutCreateInfo pipelineLayoutCI = vks::initializers::pipelineLayoutCreateInfo(setLayouts.data(), static_cast<uint32_t>(setLayouts.size()));
+	pipelineLayoutCI.pushConstantRangeCount = 1;
+	pipelineLayoutCI.pPushConstantRanges = &meshPush;
+	VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &meshShadingPipeline.pipelineLayout));
+
+	// 光栅化状态和PBR pipeline一致，没有顶点输入和图元装配
+	VkPipelineRasterizationStateCreateInfo rasterizationState = vks::initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_BACK_BIT, VK_FRONT_FACE_COUNTER_CLOCKWISE);
+	VkPipelineColorBlendAttachmentState blendAttachmentState = vks::initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
+	VkPipelineColorBlendStateCreateInfo colorBlendState = vks::initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
+	VkPipelineDepthStencilStateCreateInfo depthStencilState = vks::initializers::pipelineDepthStencilStateCreateInfo(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS_OR_EQUAL);
+	VkPipelineViewportStateCreateInfo viewportState = vks::initializers::pipelineViewportStateCreateInfo(1, 1);
+	VkPipelineMultisampleStateCreateInfo multisampleState = vks::initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT);
+	std::vector<VkDynamicState> dynamicStateEnables = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+	VkPipelineDynamicStateCreateInfo dynamicState = vks::initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
+
+	std::array<VkPipelineShaderStageCreateInfo, 3> shaderStages{
+		loadShader(shaderPath + "nanite.task.spv", VK_SHADER_STAGE_TASK_BIT_EXT),
+		loadShader(shaderPath + "nanite.mesh.spv", VK_SHADER_STAGE_MESH_BIT_EXT),
+		loadShader(shaderPath + "pbrtexture.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT),
+	};
+
+	VkGraphicsPipelineCreateInfo pipelineCI = vks::initializers::pipelineCreateInfo(meshShadingPipeline.pipelineLayout, renderPass);
+	pipelineCI.pVertexInputState = nullptr;
+	pipelineCI.pInputAssemblyState = nullptr;
+	pipelineCI.pRasterizationState = &rasterizationState;
+	pipelineCI.pColorBlendState = &colorBlendState;
+	pipelineCI.pMultisampleState = &multisampleState;
+	pipelineCI.pViewportState = &viewportState;
+	pipelineCI.pDepthStencilState = &depthStencilState;
+	pipelineCI.pDynamicState = &dynamicState;
+	pipelineCI.stageCount = static_cast<uint32_t>(shaderStages.size());
+	pipelineCI.pStages = shaderStages.data();
+	VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &meshShadingPipeline.pipeline));
 }
 
 void PBRTexture::createComputePipelines()
@@ -222,8 +495,20 @@ void PBRTexture::createComputePipelines()
 	VkPushConstantRange cullingPush{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullingPushConstants)};
 	createComputePipeline("culling.comp.spv", DescriptorType::culling, cullingPipeline, &cullingPush);
 
-	VkPushConstantRange errorPush{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ErrorPushConstants)};
-	createComputePipeline("error.comp.spv", DescriptorType::errorPorj, errorProjPipeline, &errorPush);
+	VkPushConstantRange instanceCullingPush{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(InstanceCullingPushConstants)};
+	createComputePipeline("instanceCulling.comp.spv", DescriptorType::instanceCulling, instanceCullingPipeline, &instanceCullingPush);
+
+	VkPushConstantRange dagTraversalPush{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DagTraversalPushConstants)};
+	createComputePipeline("dagTraversal.comp.spv", DescriptorType::dagTraversal, dagTraversalPipeline, &dagTraversalPush);
+
+	VkPushConstantRange triangleCullingPush{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(TriangleCullingPushConstants)};
+	createComputePipeline("triangleCulling.comp.spv", DescriptorType::triangleCulling, triangleCullingPipeline, &triangleCullingPush);
+
+	if (swRasterSupported)
+	{
+		VkPushConstantRange swRasterPush{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SwRasterPushConstants)};
+		createComputePipeline("swRaster.comp.spv", DescriptorType::swRaster, swRasterPipeline, &swRasterPush);
+	}
 }
 
 void PBRTexture::preparePipelines()
@@ -239,12 +524,6 @@ void PBRTexture::generateBRDFLUT()
 	vks::vksTools::generateBRDFLUT(*this);
 }
 
-// Generate an irradiance cube map from the environment cube map
-void PBRTexture::generateIrradianceCube()
-{
-	vks::vksTools::generateIrradianceCube(*this);
-}
-
 // Prefilter environment cubemap
 // See https://placeholderart.wordpress.com/2015/07/28/implementation-notes-runtime-environment-map-filtering-for-image-based-lighting/
 void PBRTexture::generatePrefilteredCube()
@@ -252,6 +531,12 @@ void PBRTexture::generatePrefilteredCube()
 	vks::vksTools::generatePrefilteredCube(*this);
 }
 
+// BRDF LUT和prefiltered cube优先从磁盘缓存加载，环境图、生成参数或着色器变了才重新生成；漫反射用CPU投影的SH
+void PBRTexture::prepareIBL()
+{
+	vks::vksTools::prepareIBL(*this, getAssetPath() + ENVIRONMENT_CUBE_FILE);
+}
+
 // Prepare and initialize uniform buffer containing shader uniforms
 void PBRTexture::prepareUniformBuffers()
 {
@@ -275,7 +560,8 @@ void PBRTexture::updateUniformBuffers()
 	// 3D object
 	uniformDataMatrices.projection = camera.matrices.perspective;
 	uniformDataMatrices.view = camera.matrices.view;
-	uniformDataMatrices.model = glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	// 和实例变换保持一致，剔除和LOD误差都是基于实例变换后的包围盒计算的
+	uniformDataMatrices.model = modelMats.empty() ? glm::mat4(1.0f) : modelMats.front();
 	uniformDataMatrices.camPos = camera.position * -1.0f;
 	memcpy(uniformBuffers.scene.mapped, &uniformDataMatrices, sizeof(vks::UniformDataMatrices));
 
@@ -283,11 +569,140 @@ void PBRTexture::updateUniformBuffers()
 	uniformDataMatrices.model = glm::mat4(glm::mat3(camera.matrices.view));
 	memcpy(uniformBuffers.skybox.mapped, &uniformDataMatrices, sizeof(vks::UniformDataMatrices));
 
-	uboErrorMatrices.view = camera.matrices.view;
-	uboErrorMatrices.proj = camera.matrices.perspective;
-	uboErrorMatrices.camRight = camera.getRight();
-	uboErrorMatrices.camUp = camera.getUp();
+	// 异步模式下compute可能正在读，剔除用的uniform只在提交compute之前写
+	if (!asyncComputeActive())
+	{
+		updateCullingUniforms(camera, camera.matrices.view, camera.matrices.perspective);
+	}
+}
+
+void PBRTexture::updateCullingUniforms(Camera& lodCamera, const glm::mat4& frustumView, const glm::mat4& frustumProj)
+{
+	// LOD误差按真实相机投影，视锥剔除可以用放大过的视锥
+	uboErrorMatrices.view = lodCamera.matrices.view;
+	uboErrorMatrices.proj = lodCamera.matrices.perspective;
+	uboErrorMatrices.camRight = lodCamera.getRight();
+	uboErrorMatrices.camUp = lodCamera.getUp();
 	memcpy(errorUniformBuffer.mapped, &uboErrorMatrices, sizeof(vks::UBOErrorMatrices));
+
+	uboCullingMatrices.view = frustumView;
+	uboCullingMatrices.proj = frustumProj;
+	memcpy(cullingUniformBuffer.mapped, &uboCullingMatrices, sizeof(vks::UBOCullingMatrices));
+}
+
+void PBRTexture::prepareAsyncCompute()
+{
+	const uint32_t computeFamily = vulkanDevice->queueFamilyIndices.compute;
+	asyncComputeSupported = computeFamily != vulkanDevice->queueFamilyIndices.graphics;
+	if (!asyncComputeSupported)
+	{
+		std::cout << "No dedicated compute queue family, culling stays on the graphics queue" << std::endl;
+		return;
+	}
+
+	vkGetDeviceQueue(device, computeFamily, 0, &computeQueue);
+	computeCmdPool = vulkanDevice->createCommandPool(computeFamily);
+	computeCmdBuffers.resize(drawCmdBuffers.size());
+	VkCommandBufferAllocateInfo allocateInfo = vks::initializers::commandBufferAllocateInfo(computeCmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, static_cast<uint32_t>(computeCmdBuffers.size()));
+	VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &allocateInfo, computeCmdBuffers.data()));
+
+	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &asyncSemaphores.computeComplete));
+	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &asyncSemaphores.graphicsComplete));
+
+	computeProfiler.create(vulkanDevice, computeFamily, static_cast<uint32_t>(computeCmdBuffers.size()));
+	lastCullingCameraPosition = camera.position;
+	lastCullingCameraRotation = camera.rotation;
+}
+
+void PBRTexture::destroyAsyncCompute()
+{
+	if (computeCmdPool == VK_NULL_HANDLE)
+	{
+		return;
+	}
+	vkFreeCommandBuffers(device, computeCmdPool, static_cast<uint32_t>(computeCmdBuffers.size()), computeCmdBuffers.data());
+	vkDestroyCommandPool(device, computeCmdPool, nullptr);
+	vkDestroySemaphore(device, asyncSemaphores.computeComplete, nullptr);
+	vkDestroySemaphore(device, asyncSemaphores.graphicsComplete, nullptr);
+	computeProfiler.destroy();
+	computeCmdBuffers.clear();
+	computeCmdPool = VK_NULL_HANDLE;
+}
+
+void PBRTexture::resetAsyncComputeSync()
+{
+	if (!asyncComputeSupported)
+	{
+		return;
+	}
+	// 切换模式时可能留下一个没人等待的signal，binary semaphore不能重复signal，直接重建
+	vkDeviceWaitIdle(device);
+	vkDestroySemaphore(device, asyncSemaphores.computeComplete, nullptr);
+	vkDestroySemaphore(device, asyncSemaphores.graphicsComplete, nullptr);
+	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &asyncSemaphores.computeComplete));
+	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &asyncSemaphores.graphicsComplete));
+	computePending = false;
+	graphicsSignaled = false;
+	lastCullingCameraPosition = camera.position;
+	lastCullingCameraRotation = camera.rotation;
+}
+
+void PBRTexture::submitCullingCompute(bool aheadOfFrame)
+{
+	if (aheadOfFrame)
+	{
+		// 刚画完的这一帧就是遮挡剔除的"上一帧"
+		uboCullingMatrices.lastView = camera.matrices.view;
+		uboCullingMatrices.lastProj = camera.matrices.perspective;
+
+		// 剔除比绘制早一帧算，按上一帧的相机运动外推，并把视锥放大到能覆盖这一帧的移动，避免边缘漏画
+		if (expandCullingFrustum)
+		{
+			const glm::vec3 deltaPosition = camera.position - lastCullingCameraPosition;
+			const glm::vec3 deltaRotation = camera.rotation - lastCullingCameraRotation;
+			Camera lodCamera = camera;
+			lodCamera.setPosition(camera.position + deltaPosition);
+			lodCamera.setRotation(camera.rotation + deltaRotation);
+
+			const float tanHalf = 1.0f / std::abs(camera.matrices.perspective[1][1]);
+			const float extraAngle = glm::radians(std::max(std::abs(deltaRotation.x), std::abs(deltaRotation.y)));
+			const float halfAngle = std::min(std::atan(tanHalf) + extraAngle, glm::radians(85.0f));
+			const float scale = tanHalf / std::tan(halfAngle);
+			glm::mat4 frustumProj = lodCamera.matrices.perspective;
+			frustumProj[0][0] *= scale;
+			frustumProj[1][1] *= scale;
+			// 相机往后退，使平移量也落在视锥内
+			const float backOff = glm::length(deltaPosition) / tanHalf;
+			const glm::mat4 frustumView = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -backOff)) * lodCamera.matrices.view;
+
+			lastCullingCameraPosition = camera.position;
+			lastCullingCameraRotation = camera.rotation;
+			updateCullingUniforms(lodCamera, frustumView, frustumProj);
+		}
+		else
+		{
+			updateCullingUniforms(camera, camera.matrices.view, camera.matrices.perspective);
+		}
+	}
+
+	computeSlot = (computeSlot + 1) % static_cast<uint32_t>(computeCmdBuffers.size());
+
+	constexpr VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	VkSubmitInfo computeSubmitInfo = vks::initializers::submitInfo();
+	computeSubmitInfo.commandBufferCount = 1;
+	computeSubmitInfo.pCommandBuffers = &computeCmdBuffers[computeSlot];
+	computeSubmitInfo.waitSemaphoreCount = graphicsSignaled ? 1 : 0;
+	computeSubmitInfo.pWaitSemaphores = &asyncSemaphores.graphicsComplete;
+	computeSubmitInfo.pWaitDstStageMask = &waitStage;
+	computeSubmitInfo.signalSemaphoreCount = 1;
+	computeSubmitInfo.pSignalSemaphores = &asyncSemaphores.computeComplete;
+	VK_CHECK_RESULT(vulkanDevice->queueSubmit(computeQueue, 1, &computeSubmitInfo, VK_NULL_HANDLE));
+	computeProfiler.markSubmitted(computeSlot);
+
+	graphicsSignaled = false;
+	computePending = true;
 }
 
 void PBRTexture::updateParams()
@@ -307,62 +722,285 @@ void PBRTexture::prepare()
 	enabledDeviceExtensions.emplace_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
 
 	VulkanExampleBase::prepare();
+	if (meshShaderSupported)
+	{
+		vkCmdDrawMeshTasksIndirectEXT = reinterpret_cast<PFN_vkCmdDrawMeshTasksIndirectEXT>(vkGetDeviceProcAddr(device, "vkCmdDrawMeshTasksIndirectEXT"));
+		meshShaderSupported = vkCmdDrawMeshTasksIndirectEXT != nullptr;
+	}
+	gpuProfiler.create(vulkanDevice, vulkanDevice->queueFamilyIndices.graphics, static_cast<uint32_t>(drawCmdBuffers.size()));
+	prepareAsyncCompute();
 	loadAssets();
-	generateBRDFLUT();
-	generateIrradianceCube();
-	generatePrefilteredCube();
+	prepareIBL();
 
 	createCullingBuffers();
+	createInstanceCullingBuffers();
+	createDagTraversalBuffers();
+	createTriangleCullingBuffers();
+	createSwRasterBuffers();
+	if (visibilityBufferSupported)
+	{
+		createVisResolveRenderPass();
+	}
 	createHizBuffer();
 	createErrorProjectionBuffers();
+	// 场景buffer的拷贝一次性提交到transfer队列，后面建管线时GPU并行执行
+	const vks::UploadTicket sceneUploads = uploadManager.flush();
 	prepareUniformBuffers();
 	setupDescriptors();
 	preparePipelines();
+	useMeshShading = meshShaderSupported;
+	useAsyncCompute = asyncComputeSupported;
+	if (swRasterCheck.requested)
+	{
+		// visibility buffer里只能有swRaster.comp的结果：硬件光栅化的visibility模式、mesh shading和异步剔除都关掉
+		if (swRasterSupported)
+		{
+			enableSwRaster = true;
+			enableVisibilityBuffer = false;
+			useMeshShading = false;
+			useAsyncCompute = false;
+		}
+		else
+		{
+			std::cerr << "Software raster check skipped: software raster is not supported on this device" << std::endl;
+			swRasterCheck.requested = false;
+		}
+	}
 	buildCommandBuffers();
+	// 第一帧之前只等这一次，代替每个buffer各自等队列空闲
+	uploadManager.wait(sceneUploads);
+	std::cout << "Uploads: " << uploadManager.getSubmitCount() << " transfer submits" << (uploadManager.usesTimeline() ? " (timeline)" : " (fence)") << "\n";
+	vulkanDevice->memoryAllocator.printStatistics();
+	finalizeNaniteScene();
 
 	prepared = true;
 }
 
-void PBRTexture::recordComputeCommands(VkCommandBuffer cmdBuffer, size_t /*frameIndex*/)
+void PBRTexture::recordComputeCommands(VkCommandBuffer cmdBuffer, size_t frameIndex)
 {
 	auto descMgr = VulkanDescriptorManager::getManager();
+	const auto frame = static_cast<uint32_t>(frameIndex);
+	// mesh shader路径的cluster剔除在task shader里做
+	const VkPipelineStageFlags cullingStages = useMeshShading ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+	// 清空剔除统计
+	vkCmdFillBuffer(cmdBuffer, cullingStatsBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+	auto statsBarrier = createBufferBarrier(cullingStatsBuffer.buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, cullingStages, 0, 0, nullptr, 1, &statsBarrier, 0, nullptr);
+
+	// 重置cluster pass的间接dispatch参数，y、z和可见实例数由实例剔除累加
+	const vks::ClusterDispatchIndirect clusterDispatch{{(scene.maxInstanceClusterCount + DISPATCH_GROUP_SIZE - 1) / DISPATCH_GROUP_SIZE, 0, 0}, 0};
+	vkCmdUpdateBuffer(cmdBuffer, clusterDispatchBuffer.buffer, 0, sizeof(vks::ClusterDispatchIndirect), &clusterDispatch);
+	// 最后一行没铺满的位置留着这个值，cluster pass和task shader跳过
+	vkCmdFillBuffer(cmdBuffer, visibleInstancesBuffer.buffer, 0, VK_WHOLE_SIZE, 0xFFFFFFFF);
+	// 三角形级剔除的x由cluster pass累加
+	const VkDispatchIndirectCommand triangleDispatch{0, 1, 1};
+	vkCmdUpdateBuffer(cmdBuffer, triangleCullDispatchBuffer.buffer, 0, sizeof(VkDispatchIndirectCommand), &triangleDispatch);
+	// 软件光栅化同理，visibility buffer清成最远
+	vkCmdUpdateBuffer(cmdBuffer, swRasterDispatchBuffer.buffer, 0, sizeof(VkDispatchIndirectCommand), &triangleDispatch);
+	vkCmdFillBuffer(cmdBuffer, visibilityBuffer.buffer, 0, VK_WHOLE_SIZE, 0xFFFFFFFF);
+	// indexCount由剔除pass原子累加，每帧在GPU上清零，不需要等设备空闲再从host写
+	vks::DrawIndexedIndirect drawReset = drawIndexedIndirect;
+	drawReset.indexCount = 0;
+	vkCmdUpdateBuffer(cmdBuffer, drawIndexedIndirectBuffer.buffer, 0, sizeof(vks::DrawIndexedIndirect), &drawReset);
+	std::array<VkBufferMemoryBarrier, 5> dispatchBarriers{
+		createBufferBarrier(clusterDispatchBuffer.buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT),
+		createBufferBarrier(visibleInstancesBuffer.buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT),
+		createBufferBarrier(triangleCullDispatchBuffer.buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT),
+		createBufferBarrier(swRasterDispatchBuffer.buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT),
+		createBufferBarrier(drawIndexedIndirectBuffer.buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT),
+	};
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, static_cast<uint32_t>(dispatchBarriers.size()), dispatchBarriers.data(), 0, nullptr);
+	// visibility buffer还会被硬件光栅的fragment原子写，清零要对fragment可见；异步计算时由所有权转移的acquire负责
+	auto visibilityClearBarrier = createBufferBarrier(visibilityBuffer.buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, visibilityShaderStages(), 0, 0, nullptr, 1, &visibilityClearBarrier, 0, nullptr);
 
-	// Error projection compute
-	auto barrier = createBufferBarrier(projectedErrorBuffer.buffer, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT);
-	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
-
-	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, errorProjPipeline.pipeline);
-	errorPushConstants.numClusters = static_cast<int>(clusterInfos.size());
-	errorPushConstants.screenSize = glm::vec2(width, height);
-	vkCmdPushConstants(cmdBuffer, errorProjPipeline.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ErrorPushConstants), &errorPushConstants);
-	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, errorProjPipeline.pipelineLayout, 0, 1, &descMgr->getSet(DescriptorType::errorPorj, 0), 0, nullptr);
-	vkCmdDispatch(cmdBuffer, (errorPushConstants.numClusters + DISPATCH_GROUP_SIZE - 1) / DISPATCH_GROUP_SIZE, 1, 1);
-
-	barrier = createBufferBarrier(projectedErrorBuffer.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
-	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+	// 误差投影不再单独一个pass，剔除、DAG遍历和task shader读到PackedCluster后就地计算
 
 	// HIZ布局转换
 	VkImageSubresourceRange hizRange{VK_IMAGE_ASPECT_COLOR_BIT, 0, textures.hizBuffer.mipLevels, 0, 1};
 	auto imgBarrier = createImageBarrier(textures.hizBuffer.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, hizRange);
 	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imgBarrier);
 
-	// Culling compute
-	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullingPipeline.pipeline);
-	cullingPushConstants.numClusters = static_cast<int>(clusterInfos.size());
-	vkCmdPushConstants(cmdBuffer, cullingPipeline.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullingPushConstants), &cullingPushConstants);
-	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullingPipeline.pipelineLayout, 0, 1, &descMgr->getSet(DescriptorType::culling, 0), 0, nullptr);
-	vkCmdDispatch(cmdBuffer, (cullingPushConstants.numClusters + DISPATCH_GROUP_SIZE - 1) / DISPATCH_GROUP_SIZE, 1, 1);
+	// Instance culling compute
+	cullingProfiler().beginScope(cmdBuffer, frame, "Instance culling");
+	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, instanceCullingPipeline.pipeline);
+	instanceCullingPushConstants.numInstances = static_cast<int>(scene.naniteObjects.size());
+	instanceCullingPushConstants.maxVisibleInstances = static_cast<int>(useMeshShading ? maxMeshShadingVisibleInstances : maxVisibleInstances);
+	instanceCullingPushConstants.visibleRowSize = static_cast<int>(visibleInstanceRowSize);
+	vkCmdPushConstants(cmdBuffer, instanceCullingPipeline.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(InstanceCullingPushConstants), &instanceCullingPushConstants);
+	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, instanceCullingPipeline.pipelineLayout, 0, 1, &descMgr->getSet(DescriptorType::instanceCulling, 0), 0, nullptr);
+	vkCmdDispatch(cmdBuffer, (instanceCullingPushConstants.numInstances + DISPATCH_GROUP_SIZE - 1) / DISPATCH_GROUP_SIZE, 1, 1);
+	cullingProfiler().endScope(cmdBuffer, frame, "Instance culling");
+
+	std::array<VkBufferMemoryBarrier, 2> instanceBarriers{
+		createBufferBarrier(visibleInstancesBuffer.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT),
+		createBufferBarrier(clusterDispatchBuffer.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT),
+	};
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | cullingStages, 0, 0, nullptr, static_cast<uint32_t>(instanceBarriers.size()), instanceBarriers.data(), 0, nullptr);
+
+	if (useMeshShading)
+	{
+		// cluster剔除、LOD选择和绘制都在render pass里的task/mesh shader完成，三角形剔除和软件光栅化不参与
+	}
+	else if (useDagTraversal)
+	{
+		recordDagTraversalCommands(cmdBuffer, frame);
+	}
+	else
+	{
+		// Culling compute，只处理幸存实例的cluster
+		cullingProfiler().beginScope(cmdBuffer, frame, "Culling");
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullingPipeline.pipeline);
+		cullingPushConstants.numClusters = static_cast<int>(scene.clusterCount);
+		cullingPushConstants.screenSize = glm::vec2(width, height);
+		cullingPushConstants.triangleCullingEnabled = triangleCullingActive() ? 1 : 0;
+		cullingPushConstants.triangleCullingMinSize = triangleCullingMinSize;
+		cullingPushConstants.maxTriangleCullingClusters = maxTriangleCullingClusters;
+		cullingPushConstants.swRasterEnabled = swRasterActive() ? 1 : 0;
+		cullingPushConstants.swRasterMaxTriangleSize = swRasterMaxTriangleSize;
+		cullingPushConstants.maxSwRasterClusters = maxSwRasterClusters;
+		vkCmdPushConstants(cmdBuffer, cullingPipeline.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullingPushConstants), &cullingPushConstants);
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullingPipeline.pipelineLayout, 0, 1, &descMgr->getSet(DescriptorType::culling, 0), 0, nullptr);
+		vkCmdDispatchIndirect(cmdBuffer, clusterDispatchBuffer.buffer, 0);
+		cullingProfiler().endScope(cmdBuffer, frame, "Culling");
+	}
+
+	if (triangleCullingActive())
+	{
+		recordTriangleCullingCommands(cmdBuffer, frame);
+	}
+
+	if (swRasterActive())
+	{
+		recordSwRasterCommands(cmdBuffer, frame);
+	}
+
+	// mesh shader路径的统计要等render pass结束再拷贝
+	if (!useMeshShading)
+	{
+		recordCullingStatsReadback(cmdBuffer, frameIndex, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	}
 
 	// 恢复HIZ布局
 	imgBarrier = createImageBarrier(textures.hizBuffer.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT, hizRange);
 	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imgBarrier);
 
+	// 异步模式下剔除结果的所有权交给graphics队列
+	if (asyncComputeActive())
+	{
+		recordCullingRelease(cmdBuffer);
+		return;
+	}
+
 	// Indirect draw buffer barrier
-	barrier = createBufferBarrier(drawIndexedIndirectBuffer.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+	auto barrier = createBufferBarrier(drawIndexedIndirectBuffer.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
 	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
 
-	barrier = createBufferBarrier(culledIndicesBuffer.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDEX_READ_BIT);
-	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+	// 顶点着色器按gl_VertexIndex读索引流和三角形ID，visibility buffer模式的几何pass还按gl_PrimitiveID读三角形ID
+	barrier = createBufferBarrier(culledIndicesBuffer.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+	barrier = createBufferBarrier(culledTriangleIdsBuffer.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void PBRTexture::recordCullingStatsReadback(VkCommandBuffer cmdBuffer, size_t frameIndex, VkPipelineStageFlags srcStage)
+{
+	// 统计结果拷贝到这个command buffer对应的readback slot
+	auto statsBarrier = createBufferBarrier(cullingStatsBuffer.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+	vkCmdPipelineBarrier(cmdBuffer, srcStage, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &statsBarrier, 0, nullptr);
+	VkBufferCopy statsCopy{0, frameIndex * sizeof(vks::CullingStats), sizeof(vks::CullingStats)};
+	vkCmdCopyBuffer(cmdBuffer, cullingStatsBuffer.buffer, cullingStatsReadback.buffer, 1, &statsCopy);
+	statsBarrier = createBufferBarrier(cullingStatsReadback.buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_HOST_READ_BIT);
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &statsBarrier, 0, nullptr);
+}
+
+void PBRTexture::recordDagTraversalCommands(VkCommandBuffer cmdBuffer, uint32_t frame)
+{
+	auto descMgr = VulkanDescriptorManager::getManager();
+
+	// 重置工作队列：头部清零，slot填无效值，访问标记清零
+	constexpr VkDeviceSize queueHeaderSize = 4 * sizeof(uint32_t);
+	vkCmdFillBuffer(cmdBuffer, dagQueueBuffer.buffer, 0, queueHeaderSize, 0);
+	vkCmdFillBuffer(cmdBuffer, dagQueueBuffer.buffer, queueHeaderSize, dagQueueItemsSize, 0xFFFFFFFF);
+	vkCmdFillBuffer(cmdBuffer, dagQueueBuffer.buffer, queueHeaderSize + dagQueueItemsSize, dagVisitedSize, 0);
+	auto queueBarrier = createBufferBarrier(dagQueueBuffer.buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &queueBarrier, 0, nullptr);
+
+	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, dagTraversalPipeline.pipeline);
+	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, dagTraversalPipeline.pipelineLayout, 0, 1, &descMgr->getSet(DescriptorType::dagTraversal, 0), 0, nullptr);
+	dagTraversalPushConstants.numClusters = scene.clusterCount;
+	dagTraversalPushConstants.screenSize = glm::vec2(width, height);
+	dagTraversalPushConstants.triangleCullingEnabled = triangleCullingActive() ? 1 : 0;
+	dagTraversalPushConstants.triangleCullingMinSize = triangleCullingMinSize;
+	dagTraversalPushConstants.maxTriangleCullingClusters = maxTriangleCullingClusters;
+	dagTraversalPushConstants.swRasterEnabled = swRasterActive() ? 1 : 0;
+	dagTraversalPushConstants.swRasterMaxTriangleSize = swRasterMaxTriangleSize;
+	dagTraversalPushConstants.maxSwRasterClusters = maxSwRasterClusters;
+
+	// 根节点入队，单独一次dispatch，保证遍历开始时pending已经包含全部根节点
+	cullingProfiler().beginScope(cmdBuffer, frame, "DAG seed");
+	dagTraversalPushConstants.phase = 0;
+	vkCmdPushConstants(cmdBuffer, dagTraversalPipeline.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DagTraversalPushConstants), &dagTraversalPushConstants);
+	vkCmdDispatch(cmdBuffer, DAG_PERSISTENT_WORKGROUPS, 1, 1);
+	cullingProfiler().endScope(cmdBuffer, frame, "DAG seed");
+
+	queueBarrier = createBufferBarrier(dagQueueBuffer.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &queueBarrier, 0, nullptr);
+
+	cullingProfiler().beginScope(cmdBuffer, frame, "DAG traversal");
+	dagTraversalPushConstants.phase = 1;
+	vkCmdPushConstants(cmdBuffer, dagTraversalPipeline.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DagTraversalPushConstants), &dagTraversalPushConstants);
+	vkCmdDispatch(cmdBuffer, DAG_PERSISTENT_WORKGROUPS, 1, 1);
+	cullingProfiler().endScope(cmdBuffer, frame, "DAG traversal");
+}
+
+void PBRTexture::recordTriangleCullingCommands(VkCommandBuffer cmdBuffer, uint32_t frame)
+{
+	auto descMgr = VulkanDescriptorManager::getManager();
+
+	// cluster pass写完列表和dispatch参数，indexCount也要在两个pass之间可见
+	std::array<VkBufferMemoryBarrier, 3> barriers{
+		createBufferBarrier(triangleCullClustersBuffer.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT),
+		createBufferBarrier(triangleCullDispatchBuffer.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT),
+		createBufferBarrier(drawIndexedIndirectBuffer.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT),
+	};
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+
+	cullingProfiler().beginScope(cmdBuffer, frame, "Triangle culling");
+	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, triangleCullingPipeline.pipeline);
+	triangleCullingPushConstants.vertexStride = sizeof(vkglTF::Vertex) / sizeof(float);
+	triangleCullingPushConstants.screenSize = glm::vec2(width, height);
+	vkCmdPushConstants(cmdBuffer, triangleCullingPipeline.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(TriangleCullingPushConstants), &triangleCullingPushConstants);
+	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, triangleCullingPipeline.pipelineLayout, 0, 1, &descMgr->getSet(DescriptorType::triangleCulling, 0), 0, nullptr);
+	vkCmdDispatchIndirect(cmdBuffer, triangleCullDispatchBuffer.buffer, 0);
+	cullingProfiler().endScope(cmdBuffer, frame, "Triangle culling");
+}
+
+void PBRTexture::recordSwRasterCommands(VkCommandBuffer cmdBuffer, uint32_t frame)
+{
+	auto descMgr = VulkanDescriptorManager::getManager();
+
+	std::array<VkBufferMemoryBarrier, 2> barriers{
+		createBufferBarrier(swRasterClustersBuffer.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT),
+		createBufferBarrier(swRasterDispatchBuffer.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT),
+	};
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+
+	cullingProfiler().beginScope(cmdBuffer, frame, "Software raster");
+	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, swRasterPipeline.pipeline);
+	swRasterPushConstants.vertexStride = sizeof(vkglTF::Vertex) / sizeof(float);
+	swRasterPushConstants.width = width;
+	swRasterPushConstants.height = height;
+	vkCmdPushConstants(cmdBuffer, swRasterPipeline.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SwRasterPushConstants), &swRasterPushConstants);
+	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, swRasterPipeline.pipelineLayout, 0, 1, &descMgr->getSet(DescriptorType::swRaster, 0), 0, nullptr);
+	vkCmdDispatchIndirect(cmdBuffer, swRasterDispatchBuffer.buffer, 0);
+	cullingProfiler().endScope(cmdBuffer, frame, "Software raster");
+
+	// render pass里硬件光栅的fragment继续原子写，resolve再读
+	auto visibilityBarrier = createBufferBarrier(visibilityBuffer.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, visibilityShaderStages(), 0, 0, nullptr, 1, &visibilityBarrier, 0, nullptr);
 }
 
 void PBRTexture::buildCommandBuffers()
@@ -380,20 +1018,101 @@ void PBRTexture::buildCommandBuffers()
 	renderPassBeginInfo.clearValueCount = 2;
 	renderPassBeginInfo.pClearValues = clearValues;
 
+	// 提前提交的compute可能还在执行，不能重新录制
+	if (computeQueue != VK_NULL_HANDLE)
+	{
+		VK_CHECK_RESULT(vulkanDevice->queueWaitIdle(computeQueue));
+	}
+
+	const bool asyncCompute = asyncComputeActive();
+	if (asyncCompute)
+	{
+		for (size_t i = 0; i < computeCmdBuffers.size(); ++i)
+		{
+			VK_CHECK_RESULT(vkBeginCommandBuffer(computeCmdBuffers[i], &cmdBufInfo));
+			computeProfiler.beginFrame(computeCmdBuffers[i], static_cast<uint32_t>(i));
+			recordComputeCommands(computeCmdBuffers[i], i);
+			VK_CHECK_RESULT(vkEndCommandBuffer(computeCmdBuffers[i]));
+		}
+	}
+
 	for (size_t i = 0; i < drawCmdBuffers.size(); ++i)
 	{
 		renderPassBeginInfo.framebuffer = frameBuffers[i];
 		VK_CHECK_RESULT(vkBeginCommandBuffer(drawCmdBuffers[i], &cmdBufInfo));
+		const auto frame = static_cast<uint32_t>(i);
+		gpuProfiler.beginFrame(drawCmdBuffers[i], frame);
+
+		if (asyncCompute)
+		{
+			recordCullingAcquire(drawCmdBuffers[i]);
+		}
+		else
+		{
+			recordComputeCommands(drawCmdBuffers[i], i);
+		}
 
-		recordComputeCommands(drawCmdBuffers[i], i);
+		gpuProfiler.beginScope(drawCmdBuffers[i], frame, "PBR render pass");
 		recordRenderPassCommands(drawCmdBuffers[i], renderPassBeginInfo);
+		gpuProfiler.endScope(drawCmdBuffers[i], frame, "PBR render pass");
+
+		if (useMeshShading)
+		{
+			recordCullingStatsReadback(drawCmdBuffers[i], i, VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT);
+		}
+
+		gpuProfiler.beginScope(drawCmdBuffers[i], frame, "Depth copy");
 		recordDepthCopyCommands(drawCmdBuffers[i]);
+		gpuProfiler.endScope(drawCmdBuffers[i], frame, "Depth copy");
+
+		gpuProfiler.beginScope(drawCmdBuffers[i], frame, "HZB generation");
 		recordHizGenerationCommands(drawCmdBuffers[i]);
+		gpuProfiler.endScope(drawCmdBuffers[i], frame, "HZB generation");
 
 		VK_CHECK_RESULT(vkEndCommandBuffer(drawCmdBuffers[i]));
 	}
 }
 
+// 剔除结果在compute和graphics队列族之间的所有权转移，release和acquire的buffer和范围必须一一对应
+// graphics用完之后不转回去，compute每帧都会重新写，内容不需要保留
+void PBRTexture::recordCullingRelease(VkCommandBuffer cmdBuffer)
+{
+	const uint32_t computeFamily = vulkanDevice->queueFamilyIndices.compute;
+	const uint32_t graphicsFamily = vulkanDevice->queueFamilyIndices.graphics;
+	std::array<VkBufferMemoryBarrier, 4> barriers{
+		createBufferBarrier(drawIndexedIndirectBuffer.buffer, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, 0),
+		createBufferBarrier(culledIndicesBuffer.buffer, VK_ACCESS_SHADER_WRITE_BIT, 0),
+		createBufferBarrier(culledTriangleIdsBuffer.buffer, VK_ACCESS_SHADER_WRITE_BIT, 0),
+		createBufferBarrier(visibilityBuffer.buffer, VK_ACCESS_TRANSFER_WRITE_BIT, 0),
+	};
+	for (auto& barrier : barriers)
+	{
+		barrier.srcQueueFamilyIndex = computeFamily;
+		barrier.dstQueueFamilyIndex = graphicsFamily;
+	}
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+}
+
+void PBRTexture::recordCullingAcquire(VkCommandBuffer cmdBuffer)
+{
+	const uint32_t computeFamily = vulkanDevice->queueFamilyIndices.compute;
+	const uint32_t graphicsFamily = vulkanDevice->queueFamilyIndices.graphics;
+	std::array<VkBufferMemoryBarrier, 4> barriers{
+		createBufferBarrier(drawIndexedIndirectBuffer.buffer, 0, VK_ACCESS_INDIRECT_COMMAND_READ_BIT),
+		createBufferBarrier(culledIndicesBuffer.buffer, 0, VK_ACCESS_SHADER_READ_BIT),
+		createBufferBarrier(culledTriangleIdsBuffer.buffer, 0, VK_ACCESS_SHADER_READ_BIT),
+		createBufferBarrier(visibilityBuffer.buffer, 0, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT),
+	};
+	for (auto& barrier : barriers)
+	{
+		barrier.srcQueueFamilyIndex = computeFamily;
+		barrier.dstQueueFamilyIndex = graphicsFamily;
+	}
+	// 和render()里computeComplete的等待阶段一致
+	constexpr VkPipelineStageFlags stages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	vkCmdPipelineBarrier(cmdBuffer, stages, stages, 0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+}
+
 void PBRTexture::recordRenderPassCommands(VkCommandBuffer cmdBuffer, const VkRenderPassBeginInfo& rpBeginInfo)
 {
 	auto descMgr = VulkanDescriptorManager::getManager();
@@ -405,8 +1124,6 @@ void PBRTexture::recordRenderPassCommands(VkCommandBuffer cmdBuffer, const VkRen
 	vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
 	vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
 
-	VkDeviceSize offsets[1] = {0};
-
 	if (displaySkybox)
 	{
 		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descMgr->getSet(DescriptorType::Scene, 4), 0, nullptr);
@@ -414,16 +1131,79 @@ void PBRTexture::recordRenderPassCommands(VkCommandBuffer cmdBuffer, const VkRen
 		models.skybox.draw(cmdBuffer);
 	}
 
-	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descMgr->getSet(DescriptorType::Scene, 0), 0, nullptr);
-	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.pbr);
-	vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &scene.vertices.buffer, offsets);
-	vkCmdBindIndexBuffer(cmdBuffer, culledIndicesBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-	vkCmdDrawIndexedIndirect(cmdBuffer, drawIndexedIndirectBuffer.buffer, 0, 1, 0);
+	swRasterPushConstants.vertexStride = sizeof(vkglTF::Vertex) / sizeof(float);
+	swRasterPushConstants.width = width;
+	swRasterPushConstants.height = height;
+
+	if (useMeshShading)
+	{
+		// task shader按实例剔除写出的间接参数发射，VkDispatchIndirectCommand和VkDrawMeshTasksIndirectCommandEXT布局相同
+		std::array<VkDescriptorSet, 2> meshSets{descMgr->getSet(DescriptorType::Scene, 0), descMgr->getSet(DescriptorType::meshShading, 0)};
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, meshShadingPipeline.pipelineLayout, 0, static_cast<uint32_t>(meshSets.size()), meshSets.data(), 0, nullptr);
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, meshShadingPipeline.pipeline);
+		meshShadingPushConstants.numClusters = scene.clusterCount;
+		meshShadingPushConstants.vertexStride = sizeof(vkglTF::Vertex) / sizeof(float);
+		meshShadingPushConstants.screenSize = glm::vec2(width, height);
+		vkCmdPushConstants(cmdBuffer, meshShadingPipeline.pipelineLayout, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT, 0, sizeof(MeshShadingPushConstants), &meshShadingPushConstants);
+		vkCmdDrawMeshTasksIndirectEXT(cmdBuffer, clusterDispatchBuffer.buffer, 0, 1, sizeof(VkDrawMeshTasksIndirectCommandEXT));
+
+		drawUI(cmdBuffer);
+		vkCmdEndRenderPass(cmdBuffer);
+		return;
+	}
+
+	if (enableVisibilityBuffer)
+	{
+		// 几何pass只写ID，不着色
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, visBufferPipeline.pipelineLayout, 0, 1, &descMgr->getSet(DescriptorType::visBuffer, 0), 0, nullptr);
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, visBufferPipeline.pipeline);
+		vkCmdPushConstants(cmdBuffer, visBufferPipeline.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SwRasterPushConstants), &swRasterPushConstants);
+	}
+	else
+	{
+		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descMgr->getSet(DescriptorType::Scene, 0), 0, nullptr);
+		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines.pbr);
+		vkCmdPushConstants(cmdBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(uint32_t), &swRasterPushConstants.vertexStride);
+	}
+	// 顶点着色器按gl_VertexIndex读剔除输出的索引流，前4个字段和VkDrawIndirectCommand布局相同，直接当非索引绘制的参数
+	vkCmdDrawIndirect(cmdBuffer, drawIndexedIndirectBuffer.buffer, 0, 1, 0);
+
+	if (enableVisibilityBuffer)
+	{
+		// 几何pass的atomic写入要对material pass可见，render pass没有self-dependency，分成两个render pass
+		vkCmdEndRenderPass(cmdBuffer);
+		auto visibilityBarrier = createBufferBarrier(visibilityBuffer.buffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 1, &visibilityBarrier, 0, nullptr);
+
+		VkRenderPassBeginInfo resolveBeginInfo = rpBeginInfo;
+		resolveBeginInfo.renderPass = visResolveRenderPass;
+		resolveBeginInfo.clearValueCount = 0;
+		resolveBeginInfo.pClearValues = nullptr;
+		vkCmdBeginRenderPass(cmdBuffer, &resolveBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+		recordVisResolveCommands(cmdBuffer);
+	}
+	else if (swRasterActive())
+	{
+		// 软件光栅化的结果，和硬件光栅化共用深度缓冲
+		recordVisResolveCommands(cmdBuffer);
+	}
 
 	drawUI(cmdBuffer);
 	vkCmdEndRenderPass(cmdBuffer);
 }
 
+void PBRTexture::recordVisResolveCommands(VkCommandBuffer cmdBuffer)
+{
+	auto descMgr = VulkanDescriptorManager::getManager();
+
+	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, visResolvePipeline.pipelineLayout, 0, 1, &descMgr->getSet(DescriptorType::visResolve, 0), 0, nullptr);
+	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, visResolvePipeline.pipeline);
+	vkCmdPushConstants(cmdBuffer, visResolvePipeline.pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SwRasterPushConstants), &swRasterPushConstants);
+	vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
+}
+
 
 void PBRTexture::recordDepthCopyCommands(VkCommandBuffer cmdBuffer)
 {
@@ -462,19 +1242,127 @@ void PBRTexture::render()
 	if (!prepared) return;
 
 	prepareFrame();
+	// 回收已经完成的上传批次占用的staging环
+	uploadManager.collect();
+
+	// 读取这个command buffer上一次提交的timestamp，不会阻塞；没录制或还没读到的scope不记，避免重复计入旧值
+	if (gpuProfiler.collect(currentBuffer))
+	{
+		for (const auto& scope : gpuProfiler.getScopes())
+		{
+			if (scope.updated)
+			{
+				benchmark.addPassTime(scope.name, scope.lastMs);
+			}
+		}
+	}
+
+	// 异步模式下剔除的timestamp和统计在compute slot里，取已经完成的上一个slot
+	const bool asyncCompute = asyncComputeActive();
+	const auto computeSlotCount = static_cast<uint32_t>(computeCmdBuffers.size());
+	const uint32_t statsSlot = asyncCompute ? (computeSlot + computeSlotCount - 1) % computeSlotCount : currentBuffer;
+	if (asyncCompute && computeProfiler.collect(statsSlot))
+	{
+		for (const auto& scope : computeProfiler.getScopes())
+		{
+			if (scope.updated)
+			{
+				benchmark.addPassTime(scope.name, scope.lastMs);
+			}
+		}
+	}
+
+	// stress模式每帧重建一次cluster数据，只测CPU耗时，结果不重新上传
+	if (instanceGrid.stress)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		scene.createClusterInfos();
+		clusterInfoBuildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		benchmark.addPassTime("createClusterInfos (cpu)", clusterInfoBuildMs);
+	}
 
-	if (drawIndexedIndirectBuffer.mapped)
+	// 同样是上一次提交这个command buffer时的剔除统计
+	if (cullingStatsReadback.mapped)
 	{
-		drawIndexedIndirect.indexCount = 0;
-		memcpy(drawIndexedIndirectBuffer.mapped, &drawIndexedIndirect, sizeof(vks::DrawIndexedIndirect));
-		drawIndexedIndirectBuffer.flush();
-		vkDeviceWaitIdle(device);
+		memcpy(&cullingStats, static_cast<char*>(cullingStatsReadback.mapped) + statsSlot * sizeof(vks::CullingStats), sizeof(vks::CullingStats));
+		benchmark.addCounter("instances culled", cullingStats.instancesCulled);
+		benchmark.addCounter("instances dropped", cullingStats.instancesDropped);
+		benchmark.addCounter("clusters tested", cullingStats.clustersTested);
+		benchmark.addCounter("clusters lod rejected", cullingStats.lodRejected);
+		benchmark.addCounter("clusters frustum culled", cullingStats.frustumCulled);
+		benchmark.addCounter("clusters selected", cullingStats.clustersSelected);
+		benchmark.addCounter("triangles emitted", cullingStats.trianglesEmitted);
+		if (triangleCullingActive())
+		{
+			benchmark.addCounter("triangle culled clusters", cullingStats.triangleClusters);
+			benchmark.addCounter("triangles backface culled", cullingStats.trianglesBackface);
+			benchmark.addCounter("triangles degenerate culled", cullingStats.trianglesDegenerate);
+			benchmark.addCounter("triangles frustum culled", cullingStats.trianglesFrustum);
+			benchmark.addCounter("triangles small culled", cullingStats.trianglesSmall);
+		}
+		if (swRasterActive())
+		{
+			benchmark.addCounter("sw raster clusters", cullingStats.swRasterClusters);
+			benchmark.addCounter("sw raster triangles", cullingStats.swRasterTriangles);
+		}
+		for (uint32_t lod = 0; lod < vks::CULLING_STATS_MAX_LOD; ++lod)
+		{
+			if (cullingStats.lodHistogram[lod] != 0)
+			{
+				benchmark.addCounter("lod " + std::to_string(lod) + " clusters", cullingStats.lodHistogram[lod]);
+			}
+		}
+	}
+
+	if (!asyncCompute)
+	{
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+		gpuProfiler.markSubmitted(currentBuffer);
+		submitFrame();
+		// submitFrame等过队列空闲，visibility buffer里就是这一帧的结果
+		if (swRasterCheck.requested && ++swRasterCheck.frameCounter == SwRasterCheck::FRAME)
+		{
+			runSwRasterCheck();
+		}
 	}
+	else
+	{
+		// 第一帧或刚切换过来时还没有提前提交的剔除
+		if (!computePending)
+		{
+			submitCullingCompute(false);
+		}
 
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
-	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-	submitFrame();
+		const std::array<VkSemaphore, 2> waitSemaphores{semaphores.presentComplete, asyncSemaphores.computeComplete};
+		const std::array<VkPipelineStageFlags, 2> waitStages{
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		};
+		const std::array<VkSemaphore, 2> signalSemaphores{semaphores.renderComplete, asyncSemaphores.graphicsComplete};
+		VkSubmitInfo frameSubmitInfo = vks::initializers::submitInfo();
+		frameSubmitInfo.commandBufferCount = 1;
+		frameSubmitInfo.pCommandBuffers = &drawCmdBuffers[currentBuffer];
+		frameSubmitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+		frameSubmitInfo.pWaitSemaphores = waitSemaphores.data();
+		frameSubmitInfo.pWaitDstStageMask = waitStages.data();
+		frameSubmitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+		frameSubmitInfo.pSignalSemaphores = signalSemaphores.data();
+		VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &frameSubmitInfo, VK_NULL_HANDLE));
+		gpuProfiler.markSubmitted(currentBuffer);
+		computePending = false;
+		graphicsSignaled = true;
+		submitFrame();
+
+		// 下一帧的剔除紧接着提交，和present、acquire以及CPU这边的工作重叠
+		if (camera.updated)
+		{
+			updateUniformBuffers();
+		}
+		submitCullingCompute(true);
+		return;
+	}
 
 	// culling是永久更新的，所以每帧重新绘制
 	uboCullingMatrices.lastView = camera.matrices.view;
@@ -505,10 +1393,122 @@ void PBRTexture::OnUpdateUIOverlay(vks::UIOverlay* overlay)
 		{
 			updateParams();
 		}
+		if (overlay->comboBox("Debug view", &uniformDataParams.debugView, {"Shaded", "LOD", "Cluster", "Cluster group"}))
+		{
+			updateParams();
+		}
 		if (overlay->checkBox("Skybox", &displaySkybox))
 		{
 			buildCommandBuffers();
 		}
+		if (meshShaderSupported && overlay->checkBox("Mesh shaders", &useMeshShading))
+		{
+			resetAsyncComputeSync();
+			buildCommandBuffers();
+		}
+		if (asyncComputeSupported && overlay->checkBox("Async compute", &useAsyncCompute))
+		{
+			resetAsyncComputeSync();
+			buildCommandBuffers();
+		}
+		if (asyncComputeActive())
+		{
+			overlay->checkBox("Expand culling frustum", &expandCullingFrustum);
+		}
+		if (overlay->checkBox("GPU DAG traversal", &useDagTraversal))
+		{
+			buildCommandBuffers();
+		}
+		if (overlay->checkBox("Triangle culling", &enableTriangleCulling))
+		{
+			buildCommandBuffers();
+		}
+		if (enableTriangleCulling && overlay->sliderFloat("Min cluster size (px)", &triangleCullingMinSize, 0.0f, 256.0f))
+		{
+			buildCommandBuffers();
+		}
+		if (swRasterSupported && overlay->checkBox("Software raster", &enableSwRaster))
+		{
+			buildCommandBuffers();
+		}
+		if (enableSwRaster && overlay->sliderFloat("Max triangle size (px)", &swRasterMaxTriangleSize, 0.5f, 8.0f))
+		{
+			buildCommandBuffers();
+		}
+		if (visibilityBufferSupported && overlay->checkBox("Visibility buffer", &enableVisibilityBuffer))
+		{
+			buildCommandBuffers();
+		}
+	}
+	if (gpuProfiler.isSupported() && overlay->header("GPU timings"))
+	{
+		for (const auto& scope : gpuProfiler.getScopes())
+		{
+			overlay->text("%s: %.3f ms", scope.name.c_str(), scope.avgMs);
+		}
+		overlay->text("Total: %.3f ms", gpuProfiler.getTotalAvgMs());
+		if (asyncComputeActive() && computeProfiler.isSupported())
+		{
+			for (const auto& scope : computeProfiler.getScopes())
+			{
+				overlay->text("[compute] %s: %.3f ms", scope.name.c_str(), scope.avgMs);
+			}
+			overlay->text("Compute total: %.3f ms", computeProfiler.getTotalAvgMs());
+		}
+	}
+	if (overlay->header("Scene"))
+	{
+		overlay->text("Instances: %u (%u x %u)", static_cast<uint32_t>(scene.naniteObjects.size()), instanceGrid.countX, instanceGrid.countZ);
+		overlay->text("Clusters: %u", scene.clusterCount);
+		overlay->text("Cluster data: %.1f MB", scene.getClusterDataBytes() / (1024.0f * 1024.0f));
+		// 跳过finalize时没有读数
+		if (residentBytesAfterFinalize > 0)
+		{
+			overlay->text("Resident: %.1f MB (%.1f MB before finalize)", residentBytesAfterFinalize / (1024.0f * 1024.0f), residentBytesBeforeFinalize / (1024.0f * 1024.0f));
+		}
+		overlay->text("createClusterInfos: %.3f ms%s", clusterInfoBuildMs, instanceGrid.stress ? " (every frame)" : "");
+	}
+	if (overlay->header("Device memory"))
+	{
+		constexpr float MB = 1024.0f * 1024.0f;
+		const vks::MemoryStatistics memoryStats = vulkanDevice->memoryAllocator.getStatistics();
+		overlay->text("VkDeviceMemory: %u (%u blocks, %u dedicated)", memoryStats.deviceMemoryCount, memoryStats.blockCount, memoryStats.dedicatedCount);
+		overlay->text("Allocations: %u", memoryStats.allocationCount);
+		overlay->text("Used: %.1f / %.1f MB", memoryStats.usedBytes / MB, (memoryStats.blockBytes + memoryStats.dedicatedBytes) / MB);
+		overlay->text("Free ranges: %u, fragmentation %.2f", memoryStats.freeRangeCount, memoryStats.fragmentation());
+	}
+	if (overlay->header("Culling statistics"))
+	{
+		overlay->text("Instances culled: %u / %u", cullingStats.instancesCulled, static_cast<uint32_t>(scene.naniteObjects.size()));
+		if (cullingStats.instancesDropped > 0)
+		{
+			overlay->text("Instances dropped: %u", cullingStats.instancesDropped);
+		}
+		overlay->text("Clusters tested: %u", cullingStats.clustersTested);
+		overlay->text("LOD rejected: %u", cullingStats.lodRejected);
+		overlay->text("Frustum culled: %u", cullingStats.frustumCulled);
+		overlay->text("Clusters selected: %u", cullingStats.clustersSelected);
+		overlay->text("Triangles emitted: %u", cullingStats.trianglesEmitted);
+		if (triangleCullingActive())
+		{
+			overlay->text("Triangle culled clusters: %u", cullingStats.triangleClusters);
+			overlay->text("Backface: %u", cullingStats.trianglesBackface);
+			overlay->text("Degenerate: %u", cullingStats.trianglesDegenerate);
+			overlay->text("Frustum: %u", cullingStats.trianglesFrustum);
+			overlay->text("Small: %u", cullingStats.trianglesSmall);
+		}
+		if (swRasterActive())
+		{
+			overlay->text("SW raster clusters: %u", cullingStats.swRasterClusters);
+			overlay->text("SW raster triangles: %u", cullingStats.swRasterTriangles);
+		}
+		for (uint32_t lod = 0; lod < vks::CULLING_STATS_MAX_LOD; ++lod)
+		{
+			if (cullingStats.lodHistogram[lod] != 0)
+			{
+				overlay->text("LOD %u: %u", lod, cullingStats.lodHistogram[lod]);
+			}
+		}
 	}
 }
 
@@ -529,15 +1529,17 @@ void PBRTexture::createHizBuffer()
 	imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
 	// 采样mipmap，也会作为起点，同时storage传给下一个
 	imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	// graphics队列生成，异步compute队列采样，每帧都要来回，直接两个队列族共享
+	const std::array<uint32_t, 2> hizQueueFamilies{vulkanDevice->queueFamilyIndices.graphics, vulkanDevice->queueFamilyIndices.compute};
+	if (asyncComputeSupported)
+	{
+		imageCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		imageCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>(hizQueueFamilies.size());
+		imageCreateInfo.pQueueFamilyIndices = hizQueueFamilies.data();
+	}
 	VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &textures.hizBuffer.image));
 
-	VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-	VkMemoryRequirements memRequirements;
-	vkGetImageMemoryRequirements(device, textures.hizBuffer.image, &memRequirements);
-	memAlloc.allocationSize = memRequirements.size;
-	memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &textures.hizBuffer.deviceMemory));
-	VK_CHECK_RESULT(vkBindImageMemory(device, textures.hizBuffer.image, textures.hizBuffer.deviceMemory, 0));
+	textures.hizBuffer.allocateImageMemory(vulkanDevice);
 
 	VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
 	viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
@@ -595,6 +1597,9 @@ void PBRTexture::createHizBuffer()
 	subResourceRange.levelCount = textures.hizBuffer.mipLevels;
 
 	vks::tools::setImageLayout(cmdBuffer, textures.hizBuffer.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, subResourceRange);
+	// 第一帧还没有深度，清成最远，避免遮挡剔除读到垃圾数据
+	VkClearColorValue farDepth{{1.0f, 0.0f, 0.0f, 0.0f}};
+	vkCmdClearColorImage(cmdBuffer, textures.hizBuffer.image, VK_IMAGE_LAYOUT_GENERAL, &farDepth, 1, &subResourceRange);
 
 	vulkanDevice->flushCommandBuffer(cmdBuffer, queue, true);
 	vkDeviceWaitIdle(device);
@@ -666,20 +1671,31 @@ void PBRTexture::setupDepthStencil()
 
 void PBRTexture::createCullingBuffers()
 {
-	// 创建剔除用的buffer
-	VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, models.object.indices.count*sizeof(uint32_t), &culledIndicesBuffer.buffer, &culledIndicesBuffer.memory, nullptr))
-
-	for (auto& clusterInfo : scene.clusterInfo)
+	// 剔除输出按所有实例都取LOD0的三角形数分配，实例很多时封顶
+	const VkDeviceSize culledTriangleCapacity = std::clamp<VkDeviceSize>(scene.visibleIndicesCount / 3, 1, MAX_CULLED_TRIANGLES);
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, culledTriangleCapacity * 3 * sizeof(uint32_t), &culledIndicesBuffer.buffer, &culledIndicesBuffer.memory, nullptr))
+	// 每个三角形存完整的clusterID和cluster内下标，顶点着色器按clusterID找实例变换，实例再多也不会回绕
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &culledTriangleIdsBuffer, culledTriangleCapacity * sizeof(glm::uvec2)));
+
+	// TRANSFER_SRC给软件光栅化校验读回用
+	vks::vksTools::createStagingBuffer(*this, 0, scene.clusterInfo.size() * sizeof(Nanite::ClusterInfo), scene.clusterInfo.data(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, clustersInfoBuffer);
+	// 剔除阶段只读打包的记录，每个cluster 48字节
+	vks::vksTools::createStagingBuffer(*this, 0, scene.packedClusters.size() * sizeof(Nanite::PackedCluster), scene.packedClusters.data(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, packedClustersBuffer);
+	for (const auto& cluster : scene.clusterInfo)
 	{
-		clusterInfos.emplace_back(clusterInfo);
+		if (!Nanite::PackedCluster::fits(cluster))
+		{
+			std::cerr << "Cluster triangle count or LOD level exceeds the packed cluster record" << std::endl;
+			break;
+		}
 	}
 
-	vks::vksTools::createStagingBuffer(*this, 0, clusterInfos.size() * sizeof(Nanite::ClusterInfo), clusterInfos.data(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, clustersInfoBuffer);
-
 	// 剔除用的uniform buffer
 	uboCullingMatrices.model = glm::mat4(1.0f);
 	uboCullingMatrices.lastView = camera.matrices.view;
 	uboCullingMatrices.lastProj = camera.matrices.perspective;
+	uboCullingMatrices.view = camera.matrices.view;
+	uboCullingMatrices.proj = camera.matrices.perspective;
 
 	VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, sizeof(uboCullingMatrices), &cullingUniformBuffer.buffer, &cullingUniformBuffer.memory, &uboCullingMatrices));
 	cullingUniformBuffer.device = device;
@@ -691,22 +1707,245 @@ void PBRTexture::createCullingBuffers()
 	drawIndexedIndirect.instanceCount = 1;
 	drawIndexedIndirect.vertexOffset = 0;
 
-	VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, sizeof(drawIndexedIndirect), &drawIndexedIndirectBuffer.buffer, &drawIndexedIndirectBuffer.memory, &drawIndexedIndirect));
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, sizeof(drawIndexedIndirect), &drawIndexedIndirectBuffer.buffer, &drawIndexedIndirectBuffer.memory, &drawIndexedIndirect));
 	drawIndexedIndirectBuffer.device = device;
 	VK_CHECK_RESULT(drawIndexedIndirectBuffer.map());
+
+	// 剔除统计，GPU端累加后拷贝进host可见的ring，延迟一帧读取
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &cullingStatsBuffer, sizeof(vks::CullingStats)));
+	const VkDeviceSize readbackSize = sizeof(vks::CullingStats) * drawCmdBuffers.size();
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &cullingStatsReadback, readbackSize));
+	VK_CHECK_RESULT(cullingStatsReadback.map());
+	memset(cullingStatsReadback.mapped, 0, readbackSize);
 }
 
-void PBRTexture::createErrorProjectionBuffers()
+void PBRTexture::createInstanceCullingBuffers()
+{
+	// 实例包围盒和cluster范围
+	vks::vksTools::createStagingBuffer(*this, 0, scene.instanceInfo.size() * sizeof(Nanite::InstanceInfo), scene.instanceInfo.data(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, instanceInfoBuffer);
+	instanceInfoBuffer.device = device;
+
+	// 可见实例铺在cluster pass的y和z上，每行不超过y的限制，行数不超过z的限制
+	const auto& limits = vulkanDevice->properties.limits;
+	visibleInstanceRowSize = limits.maxComputeWorkGroupCount[1];
+	uint32_t maxRows = limits.maxComputeWorkGroupCount[2];
+	uint64_t meshShadingCapacity = UINT64_MAX;
+	if (meshShaderSupported)
+	{
+		VkPhysicalDeviceMeshShaderPropertiesEXT meshShaderProperties{};
+		meshShaderProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_PROPERTIES_EXT;
+		VkPhysicalDeviceProperties2 properties2{};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties2.pNext = &meshShaderProperties;
+		vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+		visibleInstanceRowSize = std::min(visibleInstanceRowSize, meshShaderProperties.maxTaskWorkGroupCount[1]);
+		maxRows = std::min(maxRows, meshShaderProperties.maxTaskWorkGroupCount[2]);
+		// task shader的x*y*z还不能超过总数限制，按整行算
+		const uint32_t groupsX = std::max(1u, (scene.maxInstanceClusterCount + DISPATCH_GROUP_SIZE - 1) / DISPATCH_GROUP_SIZE);
+		meshShadingCapacity = meshShaderProperties.maxTaskWorkGroupTotalCount / groupsX;
+		if (meshShadingCapacity >= visibleInstanceRowSize)
+		{
+			meshShadingCapacity -= meshShadingCapacity % visibleInstanceRowSize;
+		}
+	}
+	const uint64_t instanceCount = scene.instanceInfo.size();
+	maxVisibleInstances = static_cast<uint32_t>(std::min<uint64_t>(instanceCount, static_cast<uint64_t>(visibleInstanceRowSize) * maxRows));
+	maxMeshShadingVisibleInstances = static_cast<uint32_t>(std::min<uint64_t>(maxVisibleInstances, meshShadingCapacity));
+	if (maxVisibleInstances < instanceCount)
+	{
+		std::cerr << "Instance culling: at most " << maxVisibleInstances << " of " << instanceCount << " instances can be visible, the rest are dropped\n";
+	}
+	if (meshShaderSupported && maxMeshShadingVisibleInstances < instanceCount)
+	{
+		std::cerr << "Mesh shading: at most " << maxMeshShadingVisibleInstances << " of " << instanceCount << " instances can be visible, the rest are dropped\n";
+	}
+	// 多于一行时最后一行整行都会被调度，按整行分配，没铺满的位置是INVALID_INSTANCE
+	VkDeviceSize visibleSlots = std::max(maxVisibleInstances, 1u);
+	if (visibleSlots > visibleInstanceRowSize)
+	{
+		visibleSlots = (visibleSlots + visibleInstanceRowSize - 1) / visibleInstanceRowSize * visibleInstanceRowSize;
+	}
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &visibleInstancesBuffer, visibleSlots * sizeof(uint32_t)));
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &clusterDispatchBuffer, sizeof(vks::ClusterDispatchIndirect)));
+}
+
+void PBRTexture::createDagTraversalBuffers()
+{
+	// 打包成一个uint数组：[子节点范围][根节点范围][子节点下标]，偏移通过push constant传入
+	std::vector<uint32_t> dagData;
+	dagData.reserve(scene.dagChildRanges.size() * 2 + scene.dagRootRanges.size() * 2 + scene.dagChildIndices.size());
+	for (const auto& range : scene.dagChildRanges)
+	{
+		dagData.emplace_back(range.x);
+		dagData.emplace_back(range.y);
+	}
+	dagTraversalPushConstants.rootRangeOffset = static_cast<uint32_t>(dagData.size());
+	for (const auto& range : scene.dagRootRanges)
+	{
+		dagData.emplace_back(range.x);
+		dagData.emplace_back(range.y);
+	}
+	dagTraversalPushConstants.childIndexOffset = static_cast<uint32_t>(dagData.size());
+	dagData.insert(dagData.end(), scene.dagChildIndices.begin(), scene.dagChildIndices.end());
+	if (dagData.empty())
+	{
+		dagData.emplace_back(0);
+	}
+	vks::vksTools::createStagingBuffer(*this, 0, dagData.size() * sizeof(uint32_t), dagData.data(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, dagBuffer);
+	dagBuffer.device = device;
+
+	// 队列头(4个uint) + 每个cluster一个slot + 每个cluster一位访问标记
+	const auto numClusters = std::max<VkDeviceSize>(scene.clusterInfo.size(), 1);
+	dagQueueItemsSize = numClusters * sizeof(uint32_t);
+	dagVisitedSize = (numClusters + 31) / 32 * sizeof(uint32_t);
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &dagQueueBuffer, 4 * sizeof(uint32_t) + dagQueueItemsSize + dagVisitedSize));
+}
+
+void PBRTexture::createTriangleCullingBuffers()
+{
+	// 列表长度即triangleCulling.comp的groupCountX，不能超过设备限制
+	maxTriangleCullingClusters = std::min(static_cast<uint32_t>(scene.clusterInfo.size()), vulkanDevice->properties.limits.maxComputeWorkGroupCount[0]);
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &triangleCullClustersBuffer, std::max<VkDeviceSize>(maxTriangleCullingClusters, 1) * sizeof(uint32_t)));
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &triangleCullDispatchBuffer, sizeof(VkDispatchIndirectCommand)));
+
+	// 按cluster的objectIdx索引，和实例包围盒用的是同一个变换
+	std::vector<glm::mat4> instanceTransforms;
+	instanceTransforms.reserve(std::max<size_t>(scene.naniteObjects.size(), 1));
+	for (const auto& naniteObject : scene.naniteObjects)
+	{
+		instanceTransforms.emplace_back(naniteObject.rootTransform);
+	}
+	if (instanceTransforms.empty())
+	{
+		instanceTransforms.emplace_back(1.0f);
+	}
+	vks::vksTools::createStagingBuffer(*this, 0, instanceTransforms.size() * sizeof(glm::mat4), instanceTransforms.data(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, instanceTransformsBuffer);
+	instanceTransformsBuffer.device = device;
+}
+
+void PBRTexture::createSwRasterBuffers()
+{
+	// payload是 clusterID << 7 | triangleID，cluster超过128个三角形或者cluster太多时放不下
+	// 这时软件光栅和visibility buffer模式都关掉，回退到按完整clusterID取实例变换的索引绘制
+	constexpr uint32_t triangleBits = VIS_TRIANGLE_BITS;
+	if (swRasterSupported)
+	{
+		for (const auto& clusterInfo : scene.clusterInfo)
+		{
+			if (clusterInfo.triangleIndicesEnd - clusterInfo.triangleIndicesStart > (1u << triangleBits))
+			{
+				std::cerr << "Software raster disabled: cluster has more than " << (1u << triangleBits) << " triangles" << std::endl;
+				swRasterSupported = false;
+				break;
+			}
+		}
+		if (scene.clusterInfo.size() >= (size_t(1) << (32 - triangleBits)))
+		{
+			std::cerr << "Software raster disabled: too many clusters for the visibility payload" << std::endl;
+			swRasterSupported = false;
+		}
+	}
+
+	// 不支持时也创建最小的缓冲区，保证描述符始终有效
+	maxSwRasterClusters = swRasterSupported ? std::min(static_cast<uint32_t>(scene.clusterInfo.size()), vulkanDevice->properties.limits.maxComputeWorkGroupCount[0]) : 0;
+	createVisibilityBuffer();
+	// TRANSFER_SRC给runSwRasterCheck读回用
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &swRasterClustersBuffer, std::max<VkDeviceSize>(maxSwRasterClusters, 1) * sizeof(uint32_t)));
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &swRasterDispatchBuffer, sizeof(VkDispatchIndirectCommand)));
+
+	// visibility buffer模式用同一套payload，额外需要片元里的storage写
+	visibilityBufferSupported = swRasterSupported && enabledFeatures.fragmentStoresAndAtomics;
+	if (swRasterSupported && !visibilityBufferSupported)
+	{
+		std::cout << "Visibility buffer disabled: fragmentStoresAndAtomics not supported" << std::endl;
+	}
+}
+
+void PBRTexture::createVisibilityBuffer()
 {
-	VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, scene.errorInfo.size()*sizeof(glm::vec2), &projectedErrorBuffer.buffer, &projectedErrorBuffer.memory, nullptr))
+	// 每个像素一个64位payload，不支持时也留一个元素保证描述符有效；TRANSFER_SRC给runSwRasterCheck读回用
+	const VkDeviceSize visibilitySize = swRasterSupported ? static_cast<VkDeviceSize>(width) * height * sizeof(uint64_t) : sizeof(uint64_t);
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &visibilityBuffer, visibilitySize));
+}
 
-	for (auto& errorInfo : scene.errorInfo)
+void PBRTexture::windowResized()
+{
+	// swRaster.comp、visBuffer.frag和visResolve.frag都按 y * width + x 索引，窗口变大后旧buffer会越界
+	if (!swRasterSupported)
 	{
-		errorInfos.emplace_back(errorInfo);
+		return;
 	}
-	vks::vksTools::createStagingBuffer(*this, 0, errorInfos.size() * sizeof(Nanite::ErrorInfo), errorInfos.data(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, errorInfoBuffer);
+	visibilityBuffer.destroy();
+	createVisibilityBuffer();
 
-	// uniform init
+	auto descMgr = VulkanDescriptorManager::getManager();
+	visibilityBuffer.setupDescriptor();
+	descMgr->writeToSet(DescriptorType::swRaster, 0, 5, &visibilityBuffer.descriptor);
+	descMgr->writeToSet(DescriptorType::visResolve, 0, 10, &visibilityBuffer.descriptor);
+	descMgr->writeToSet(DescriptorType::visBuffer, 0, 1, &visibilityBuffer.descriptor);
+
+	// 基类在调用这里之前已经录制过，录进去的是旧buffer
+	buildCommandBuffers();
+}
+
+void PBRTexture::createVisResolveRenderPass()
+{
+	// 和基类的renderPass只有load op和初始布局不同，framebuffer可以共用
+	std::array<VkAttachmentDescription, 2> attachments{};
+	attachments[0].format = swapChain.colorFormat;
+	attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+	attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[0].initialLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	attachments[1].format = depthFormat;
+	attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+	attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference colorReference{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+	VkAttachmentReference depthReference{1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+
+	VkSubpassDescription subpassDescription{};
+	subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpassDescription.colorAttachmentCount = 1;
+	subpassDescription.pColorAttachments = &colorReference;
+	subpassDescription.pDepthStencilAttachment = &depthReference;
+
+	// 上一个render pass的颜色和深度写入
+	std::array<VkSubpassDependency, 2> dependencies{};
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+	dependencies[1].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].dstSubpass = 0;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+
+	VkRenderPassCreateInfo renderPassCI = vks::initializers::renderPassCreateInfo();
+	renderPassCI.attachmentCount = static_cast<uint32_t>(attachments.size());
+	renderPassCI.pAttachments = attachments.data();
+	renderPassCI.subpassCount = 1;
+	renderPassCI.pSubpasses = &subpassDescription;
+	renderPassCI.dependencyCount = static_cast<uint32_t>(dependencies.size());
+	renderPassCI.pDependencies = dependencies.data();
+	VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCI, nullptr, &visResolveRenderPass));
+}
+
+void PBRTexture::createErrorProjectionBuffers()
+{
+	// 误差球和误差已经打包进packedClustersBuffer，这里只剩投影用的uniform
 	uboErrorMatrices.view = camera.matrices.view;
 	uboErrorMatrices.proj = camera.matrices.perspective;
 	uboErrorMatrices.camRight = camera.getRight();
@@ -717,32 +1956,130 @@ void PBRTexture::createErrorProjectionBuffers()
 	VK_CHECK_RESULT(errorUniformBuffer.map());
 }
 
+void PBRTexture::finalizeNaniteScene()
+{
+	// 调试用的逐LOD顶点缓冲挂在NaniteLodMesh上，开了就保留构建数据
+	if (buildDebugLodBuffers)
+	{
+		std::cout << "Runtime finalize skipped: debug LOD buffers keep the build data\n";
+		return;
+	}
+	// stress模式每帧重建cluster数组，释放了也会马上长回来，Resident读数就不准了
+	if (instanceGrid.stress)
+	{
+		std::cout << "Runtime finalize skipped: stress mode rebuilds cluster infos every frame\n";
+		return;
+	}
+
+	// 几何、cluster和DAG都已经在GPU上，CPU上只留紧凑的运行时数据
+	residentBytesBeforeFinalize = Nanite::getCurrentRSS();
+	scene.finalizeForRuntime();
+	// glTF源模型的CPU顶点和索引只在转换成OpenMesh和算间接绘制参数时用过
+	std::vector<vkglTF::Vertex>().swap(models.object.vertexBuffer);
+	std::vector<uint32_t>().swap(models.object.indexBuffer);
+	residentBytesAfterFinalize = Nanite::getCurrentRSS();
+
+	constexpr double MB = 1024.0 * 1024.0;
+	std::cout << "Runtime finalize: resident " << residentBytesBeforeFinalize / MB << " MB -> " << residentBytesAfterFinalize / MB << " MB, "
+		<< scene.getClusterDataBytes() / MB << " MB cluster data kept\n";
+}
+
+void PBRTexture::readBackBuffer(VkBuffer buffer, VkDeviceSize size, void* data)
+{
+	vks::Buffer readback;
+	VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &readback, size));
+	VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+	const VkBufferCopy region{0, 0, size};
+	vkCmdCopyBuffer(copyCmd, buffer, readback.buffer, 1, &region);
+	vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
+	VK_CHECK_RESULT(readback.map());
+	memcpy(data, readback.mapped, size);
+	readback.destroy();
+}
+
+void PBRTexture::runSwRasterCheck()
+{
+	// CPU上的cluster、顶点和索引在finalize之后已经释放，全部从GPU读回，顺带也校验了上传
+	VkDispatchIndirectCommand dispatch{};
+	readBackBuffer(swRasterDispatchBuffer.buffer, sizeof(dispatch), &dispatch);
+	const uint32_t clusterCount = std::min(dispatch.x, maxSwRasterClusters);
+	std::vector<uint32_t> swClusters(std::max(clusterCount, 1u));
+	readBackBuffer(swRasterClustersBuffer.buffer, swClusters.size() * sizeof(uint32_t), swClusters.data());
+	std::vector<Nanite::ClusterInfo> clusters(scene.clusterCount);
+	readBackBuffer(clustersInfoBuffer.buffer, clusters.size() * sizeof(Nanite::ClusterInfo), clusters.data());
+	std::vector<uint32_t> indices(scene.indices.count);
+	readBackBuffer(scene.indices.buffer, indices.size() * sizeof(uint32_t), indices.data());
+	const uint32_t vertexStride = sizeof(vkglTF::Vertex) / sizeof(float);
+	std::vector<float> vertices(static_cast<size_t>(scene.vertices.count) * vertexStride);
+	readBackBuffer(scene.vertices.buffer, vertices.size() * sizeof(float), vertices.data());
+	std::vector<uint64_t> gpuVisibility(static_cast<size_t>(width) * height);
+	readBackBuffer(visibilityBuffer.buffer, gpuVisibility.size() * sizeof(uint64_t), gpuVisibility.data());
+
+	// 和swRaster.comp同样的矩阵：当帧的view/proj乘实例变换
+	Nanite::SoftwareRasterizer reference(width, height);
+	uint32_t rasterized = 0;
+	for (uint32_t i = 0; i < clusterCount; ++i)
+	{
+		const uint32_t clusterIndex = swClusters[i];
+		const auto& cluster = clusters[clusterIndex];
+		const glm::mat4 mvp = uboCullingMatrices.proj * uboCullingMatrices.view * scene.naniteObjects[cluster.objectIdx].rootTransform;
+		rasterized += reference.rasterizeCluster(cluster, clusterIndex, indices, vertices.data(), vertexStride, mvp);
+	}
+
+	const size_t mismatches = Nanite::SoftwareRasterizer::countMismatches(reference.getVisibility(), gpuVisibility);
+	const size_t covered = static_cast<size_t>(std::count_if(gpuVisibility.begin(), gpuVisibility.end(), [](uint64_t texel) { return texel != Nanite::SoftwareRasterizer::EMPTY; }));
+	std::cout << "Software raster check: " << clusterCount << " clusters, " << rasterized << " triangles, " << covered << " covered pixels, "
+		<< mismatches << " / " << gpuVisibility.size() << " pixels differ from the CPU reference\n";
+	reference.writeDepthPGM("swraster_cpu.pgm");
+	Nanite::SoftwareRasterizer::writeDepthPGM("swraster_gpu.pgm", gpuVisibility, width, height);
+}
+
 void PBRTexture::initLogSystem()
 {
 	auto& Logger = Log::Logger::Instance();
 	Logger.SetLevel(Log::Level::Trace);
 	Logger.EnableColor(true);
 	Logger.SetLogFile("cyVulkanNanite.log");
+	// 构建线程和帧循环里写日志只进本线程的环，不等文件IO
+	Logger.EnableAsync(Log::OverflowPolicy::Drop);
 
 	// 如何使用log系统
 }
 
 void PBRTexture::createNaniteScene()
 {
-	scene.naniteMeshes.emplace_back(naniteMesh);
+	auto* naniteMesh = &scene.naniteMeshes.front();
 	modelMats.clear();
 
-	for (int i = 0; i <= 0; i++)
+	const uint32_t gridCount = instanceGrid.countX * instanceGrid.countZ;
+	const uint32_t instanceCount = instanceGrid.instanceCount != 0 ? std::min(instanceGrid.instanceCount, gridCount) : gridCount;
+	modelMats.reserve(instanceCount);
+	scene.naniteObjects.reserve(instanceCount);
+
+	// 固定种子，同样的参数每次生成同一个场景，基准结果之间可以对比
+	std::mt19937 random(instanceGrid.seed);
+	std::uniform_real_distribution<float> angleDistribution(0.0f, 360.0f);
+	std::uniform_real_distribution<float> scaleDistribution(1.0f - instanceGrid.randomScale, 1.0f + instanceGrid.randomScale);
+	for (uint32_t i = 0; i < instanceCount; i++)
 	{
-		for (int j = 0; j <= 0; j++)
-		{
-			auto modelMat = glm::translate(glm::mat4(1.0f), glm::vec3(i * 3, 1.2f, j * 3));
-			auto instance = Nanite::NaniteInstance(&naniteMesh, modelMat);
-			modelMats.emplace_back(modelMat);
-			scene.naniteObjects.emplace_back(instance);
-		}
+		const uint32_t x = i % instanceGrid.countX;
+		const uint32_t z = i / instanceGrid.countX;
+		const float angle = instanceGrid.randomRotation ? angleDistribution(random) : -90.0f;
+		const float scale = instanceGrid.randomScale > 0.0f ? scaleDistribution(random) : 1.0f;
+		auto modelMat = glm::translate(glm::mat4(1.0f), glm::vec3(x * instanceGrid.spacing, 0.0f, z * instanceGrid.spacing)) * glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f)) * glm::scale(glm::mat4(1.0f), glm::vec3(scale));
+		modelMats.emplace_back(modelMat);
+		scene.naniteObjects.emplace_back(naniteMesh, modelMat);
 	}
 
+	const auto buildStart = std::chrono::steady_clock::now();
 	scene.createVertexIndexBuffer(*this);
+	const auto clusterStart = std::chrono::steady_clock::now();
 	scene.createClusterInfos();
+	const auto buildEnd = std::chrono::steady_clock::now();
+	clusterInfoBuildMs = std::chrono::duration<double, std::milli>(buildEnd - clusterStart).count();
+
+	constexpr double MB = 1024.0 * 1024.0;
+	std::cout << "Instance grid: " << instanceCount << " x " << instanceGrid.mesh << " (" << instanceGrid.countX << " x " << instanceGrid.countZ << "), " << scene.clusterInfo.size() << " clusters\n";
+	std::cout << "Scene build: vertex/index buffers " << std::chrono::duration<double, std::milli>(clusterStart - buildStart).count() << " ms, cluster infos " << clusterInfoBuildMs << " ms, "
+		<< scene.getClusterDataBytes() / MB << " MB cluster data\n";
 }
@@ -4,8 +4,7 @@ layout (location = 0) in vec3 inWorldPos;
 layout (location = 1) in vec3 inNormal;
 layout (location = 2) in vec2 inUV;
 layout (location = 3) in vec4 inTangent;
-layout (location = 4) in vec4 inClusterInfos;
-layout (location = 5) in vec4 inClusterGroupInfos;
+layout (location = 4) flat in uvec4 inClusterIds;
 
 layout (binding = 0) uniform UBO {
 	mat4 projection;
@@ -18,9 +17,10 @@ layout (binding = 1) uniform UBOParams {
 	vec4 lights[4];
 	float exposure;
 	float gamma;
+	int debugView;
+	vec4 shIrradiance[9];
 } uboParams;
 
-layout (binding = 2) uniform samplerCube samplerIrradiance;
 layout (binding = 3) uniform sampler2D samplerBRDFLUT;
 layout (binding = 4) uniform samplerCube prefilteredMap;
 
@@ -36,6 +36,36 @@ layout (location = 0) out vec4 outColor;
 #define PI 3.1415926535897932384626433832795
 #define ALBEDO pow(texture(albedoMap, inUV).rgb, vec3(2.2))
 
+// 调试视图，与PBRTextureBuffer.h的DebugView一致
+#define DEBUG_VIEW_NONE 0
+#define DEBUG_VIEW_LOD 1
+#define DEBUG_VIEW_CLUSTER 2
+#define DEBUG_VIEW_GROUP 3
+
+// PCG整数哈希
+uint hashId(uint x)
+{
+	uint state = x * 747796405u + 2891336453u;
+	uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+vec3 hashColor(uint x)
+{
+	uint h = hashId(x);
+	return vec3(h & 0xFFu, (h >> 8) & 0xFFu, (h >> 16) & 0xFFu) / 255.0;
+}
+
+// group下标只在一个mesh的一级LOD内唯一，和LOD、实例一起哈希
+vec3 debugColor(uvec4 ids)
+{
+	if (uboParams.debugView == DEBUG_VIEW_LOD)
+		return hashColor(ids.z);
+	if (uboParams.debugView == DEBUG_VIEW_CLUSTER)
+		return hashColor(ids.x);
+	return hashColor(ids.y ^ hashId(ids.z ^ hashId(ids.w)));
+}
+
 // From http://filmicgames.com/archives/75
 vec3 Uncharted2Tonemap(vec3 x)
 {
@@ -77,6 +107,21 @@ vec3 F_SchlickR(float cosTheta, vec3 F0, float roughness)
 	return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(1.0 - cosTheta, 5.0);
 }
 
+// Irradiance from the 9 cosine-convolved SH coefficients (already divided by PI)
+vec3 irradianceSH(vec3 n)
+{
+	vec3 irradiance = uboParams.shIrradiance[0].rgb * 0.282095
+		+ uboParams.shIrradiance[1].rgb * (0.488603 * n.y)
+		+ uboParams.shIrradiance[2].rgb * (0.488603 * n.z)
+		+ uboParams.shIrradiance[3].rgb * (0.488603 * n.x)
+		+ uboParams.shIrradiance[4].rgb * (1.092548 * n.x * n.y)
+		+ uboParams.shIrradiance[5].rgb * (1.092548 * n.y * n.z)
+		+ uboParams.shIrradiance[6].rgb * (0.315392 * (3.0 * n.z * n.z - 1.0))
+		+ uboParams.shIrradiance[7].rgb * (1.092548 * n.x * n.z)
+		+ uboParams.shIrradiance[8].rgb * (0.546274 * (n.x * n.x - n.y * n.y));
+	return max(irradiance, vec3(0.0));
+}
+
 vec3 prefilteredReflection(vec3 R, float roughness)
 {
 	const float MAX_REFLECTION_LOD = 9.0; // todo: param/const
@@ -129,16 +174,13 @@ vec3 calculateNormal()
 
 void main()
 {		
+	if (uboParams.debugView != DEBUG_VIEW_NONE)
+	{
+		outColor = vec4(debugColor(inClusterIds), 1.0);
+		return;
+	}
+
 	vec3 N = calculateNormal();
-	
-	if(inClusterInfos.x < 0.5)
-		outColor = vec4(vec3(1.0,0,0), 1.0);
-	else if(inClusterInfos.x < 1.5)
-		outColor = vec4(vec3(0.0,1.0,0.0),1.0);
-	else if(inClusterInfos.x < 2.5)
-		outColor = vec4(vec3(0.0, 0.0, 1.0), 1.0);
-	return;
-	
 
 	vec3 V = normalize(ubo.camPos - inWorldPos);
 	vec3 R = reflect(-V, N); 
@@ -157,7 +199,7 @@ void main()
 	
 	vec2 brdf = texture(samplerBRDFLUT, vec2(max(dot(N, V), 0.0), roughness)).rg;
 	vec3 reflection = prefilteredReflection(R, roughness).rgb;	
-	vec3 irradiance = texture(samplerIrradiance, N).rgb;
+	vec3 irradiance = irradianceSH(N);
 
 	// Diffuse based on irradiance
 	vec3 diffuse = irradiance * ALBEDO;	
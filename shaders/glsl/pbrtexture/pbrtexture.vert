@@ -1,13 +1,8 @@
 #version 450
 
-layout (location = 0) in vec3 inPos;
-layout (location = 1) in vec3 inNormal;
-layout (location = 2) in vec2 inUV;
-layout (location = 3) in vec4 inTangent;
-layout (location = 4) in vec4 inClusterInfos;
-layout (location = 5) in vec4 inClusterGroupInfos;
-
-layout (binding = 0) uniform UBO 
+// 非索引绘制，gl_VertexIndex是剔除输出的索引流里的位置：按它取顶点，再按三角形ID找到cluster所属实例的变换
+
+layout (binding = 0) uniform UBO
 {
 	mat4 projection;
 	mat4 model;
@@ -16,22 +11,84 @@ layout (binding = 0) uniform UBO
 	vec3 camPos;
 } ubo;
 
+struct Cluster
+{
+	vec3 pMin;
+	vec3 pMax;
+	uint triangleStart;
+	uint triangleEnd;
+	uint objectIdx;
+	uint lodLevel;
+	uint groupIndex;
+};
+
+layout (std430, binding = 10) buffer readonly CulledIndices {
+	uint culledIndices[];
+};
+
+layout (std430, binding = 11) buffer readonly TriangleIds {
+	// (clusterID, cluster内三角形)，clusterID不受visibility payload位数限制
+	uvec2 triangleIds[];
+};
+
+layout (std430, binding = 12) buffer readonly ClustersIn {
+	Cluster clusters[];
+};
+
+layout (std430, binding = 13) buffer readonly VerticesIn {
+	float inVertices[];
+};
+
+layout (std430, binding = 14) buffer readonly InstanceTransforms {
+	mat4 instanceTransforms[];
+};
+
+layout (push_constant) uniform PushConstants {
+	uint vertexStride;
+} pcs;
+
 layout (location = 0) out vec3 outWorldPos;
 layout (location = 1) out vec3 outNormal;
 layout (location = 2) out vec2 outUV;
 layout (location = 3) out vec4 outTangent;
-layout (location = 4) out vec4 outClusterInfos;
-layout (location = 5) out vec4 outClusterGroupInfos;
+// x全局cluster下标，y cluster group下标，z LOD层级，w实例下标，调试视图按它们哈希出颜色
+layout (location = 4) flat out uvec4 outClusterIds;
 
-void main() 
+// vkglTF::Vertex里各分量的float偏移
+#define VERTEX_POS 0
+#define VERTEX_NORMAL 3
+#define VERTEX_UV 6
+#define VERTEX_TANGENT 20
+
+float fetch(uint vertexIndex, uint offset)
 {
-	vec3 locPos = vec3(ubo.model * vec4(inPos, 1.0));
+	return inVertices[vertexIndex * pcs.vertexStride + offset];
+}
+
+vec3 fetch3(uint vertexIndex, uint offset)
+{
+	return vec3(fetch(vertexIndex, offset), fetch(vertexIndex, offset + 1), fetch(vertexIndex, offset + 2));
+}
+
+vec4 fetch4(uint vertexIndex, uint offset)
+{
+	return vec4(fetch3(vertexIndex, offset), fetch(vertexIndex, offset + 3));
+}
+
+void main()
+{
+	uint vertexIndex = culledIndices[gl_VertexIndex];
+	uint clusterIndex = triangleIds[gl_VertexIndex / 3].x;
+	Cluster cluster = clusters[clusterIndex];
+	mat4 model = instanceTransforms[cluster.objectIdx];
+	vec4 tangent = fetch4(vertexIndex, VERTEX_TANGENT);
+
+	vec3 locPos = vec3(model * vec4(fetch3(vertexIndex, VERTEX_POS), 1.0));
 	outWorldPos = locPos;
-	outNormal = mat3(ubo.model) * inNormal;
-	outTangent = vec4(mat3(ubo.model) * inTangent.xyz, inTangent.w);
-	outUV = inUV;
-	outClusterInfos = inClusterInfos;
-	outClusterGroupInfos = inClusterGroupInfos;
-	
+	outNormal = mat3(model) * fetch3(vertexIndex, VERTEX_NORMAL);
+	outTangent = vec4(mat3(model) * tangent.xyz, tangent.w);
+	outUV = vec2(fetch(vertexIndex, VERTEX_UV), fetch(vertexIndex, VERTEX_UV + 1));
+	outClusterIds = uvec4(clusterIndex, cluster.groupIndex, cluster.lodLevel, cluster.objectIdx);
+
 	gl_Position =  ubo.projection * ubo.view * vec4(outWorldPos, 1.0);
 }
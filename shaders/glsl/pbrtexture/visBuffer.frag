@@ -0,0 +1,34 @@
+#version 450
+#extension GL_EXT_shader_explicit_arithmetic_types_int64 : require
+#extension GL_EXT_shader_atomic_int64 : require
+
+// visibility buffer模式的几何pass，不着色，只把 depth|clusterID|triangleID 写进visibility buffer
+// 先做深度测试，被挡住的片元不会执行，和swRaster.comp写的是同一个buffer
+layout (early_fragment_tests) in;
+
+// 与swRaster.comp一致
+#define VIS_TRIANGLE_BITS 7
+
+layout (std430, binding = 1) buffer VisibilityBuffer {
+	uint64_t visibility[];
+};
+
+// 剔除pass按输出顺序写的三角形ID，下标就是gl_PrimitiveID
+layout (std430, binding = 2) buffer readonly TriangleIds {
+	uvec2 triangleIds[];
+};
+
+layout (push_constant) uniform PushConstants {
+	uint vertexStride;
+	uint width;
+	uint height;
+} pcs;
+
+void main()
+{
+	// cluster数超过payload位数时host端不开visibility buffer模式
+	uvec2 triangleId = triangleIds[gl_PrimitiveID];
+	uint payload = (triangleId.x << VIS_TRIANGLE_BITS) | triangleId.y;
+	uint64_t key = (uint64_t(floatBitsToUint(gl_FragCoord.z)) << 32) | uint64_t(payload);
+	atomicMin(visibility[uint(gl_FragCoord.y) * pcs.width + uint(gl_FragCoord.x)], key);
+}
@@ -0,0 +1,58 @@
+#version 450
+
+// visibility buffer模式的几何pass，只需要位置，和pbrtexture.vert一样按索引流取顶点和实例变换
+
+layout (binding = 0) uniform UBO
+{
+	mat4 projection;
+	mat4 model;
+	mat4 view;
+	vec3 camPos;
+} ubo;
+
+struct Cluster
+{
+	vec3 pMin;
+	vec3 pMax;
+	uint triangleStart;
+	uint triangleEnd;
+	uint objectIdx;
+	uint lodLevel;
+	uint groupIndex;
+};
+
+layout (std430, binding = 2) buffer readonly TriangleIds {
+	uvec2 triangleIds[];
+};
+
+layout (std430, binding = 3) buffer readonly CulledIndices {
+	uint culledIndices[];
+};
+
+layout (std430, binding = 4) buffer readonly ClustersIn {
+	Cluster clusters[];
+};
+
+layout (std430, binding = 5) buffer readonly VerticesIn {
+	float inVertices[];
+};
+
+layout (std430, binding = 6) buffer readonly InstanceTransforms {
+	mat4 instanceTransforms[];
+};
+
+layout (push_constant) uniform PushConstants {
+	uint vertexStride;
+	uint width;
+	uint height;
+} pcs;
+
+void main()
+{
+	uint vertexIndex = culledIndices[gl_VertexIndex];
+	uint clusterIndex = triangleIds[gl_VertexIndex / 3].x;
+	mat4 model = instanceTransforms[clusters[clusterIndex].objectIdx];
+	uint base = vertexIndex * pcs.vertexStride;
+	vec3 pos = vec3(inVertices[base], inVertices[base + 1], inVertices[base + 2]);
+	gl_Position = ubo.projection * ubo.view * model * vec4(pos, 1.0);
+}
@@ -0,0 +1,342 @@
+#version 450
+// payload低7位是cluster内的三角形下标，其余是cluster下标，与swRaster.comp一致
+#define VIS_TRIANGLE_BITS 7
+#define VIS_EMPTY 0xFFFFFFFFu
+
+// 全屏resolve：读visibility buffer，按cluster/三角形ID取回顶点重建属性，写回深度并着色
+// 深度测试和硬件光栅化的结果合并成同一个深度缓冲，后面的depth copy和HZB直接用它
+// visibility buffer模式下硬件光栅化也只写ID，这里就是唯一的material pass，每个像素只着色一次
+
+layout (binding = 0) uniform UBO {
+	mat4 projection;
+	mat4 model;
+	mat4 view;
+	vec3 camPos;
+} ubo;
+
+layout (binding = 1) uniform UBOParams {
+	vec4 lights[4];
+	float exposure;
+	float gamma;
+	int debugView;
+	vec4 shIrradiance[9];
+} uboParams;
+
+layout (binding = 3) uniform sampler2D samplerBRDFLUT;
+layout (binding = 4) uniform samplerCube prefilteredMap;
+
+layout (binding = 5) uniform sampler2D albedoMap;
+layout (binding = 6) uniform sampler2D normalMap;
+layout (binding = 7) uniform sampler2D aoMap;
+layout (binding = 8) uniform sampler2D metallicMap;
+layout (binding = 9) uniform sampler2D roughnessMap;
+
+// 64位的 depth|payload 按uvec2读，x是低32位payload，y是深度
+layout (std430, binding = 10) buffer readonly VisibilityBuffer {
+	uvec2 visibility[];
+};
+
+struct Cluster
+{
+	vec3 pMin;
+	vec3 pMax;
+	uint triangleStart;
+	uint triangleEnd;
+	uint objectIdx;
+	uint lodLevel;
+	uint groupIndex;
+};
+
+layout (std430, binding = 11) buffer readonly ClustersIn {
+	Cluster clusters[];
+};
+
+layout (std430, binding = 12) buffer readonly TrianglesIn {
+	uint inTriangles[];
+};
+
+layout (std430, binding = 13) buffer readonly VerticesIn {
+	float inVertices[];
+};
+
+layout (std430, binding = 14) buffer readonly InstanceTransforms {
+	mat4 instanceTransforms[];
+};
+
+layout (push_constant) uniform PushConstants {
+	uint vertexStride;
+	uint width;
+	uint height;
+} pcs;
+
+layout (location = 0) out vec4 outColor;
+
+// vkglTF::Vertex里各分量的float偏移
+#define VERTEX_POS 0
+#define VERTEX_NORMAL 3
+#define VERTEX_UV 6
+#define VERTEX_TANGENT 20
+
+// 重建出来的插值属性，和pbrtexture.frag的输入同名，下面的着色代码保持一致
+vec3 inWorldPos;
+vec3 inNormal;
+vec2 inUV;
+vec4 inTangent;
+uvec4 inClusterIds;
+
+#define PI 3.1415926535897932384626433832795
+#define ALBEDO pow(texture(albedoMap, inUV).rgb, vec3(2.2))
+
+vec4 fetch4(uint vertexIndex, uint offset)
+{
+	uint base = vertexIndex * pcs.vertexStride + offset;
+	return vec4(inVertices[base + 0], inVertices[base + 1], inVertices[base + 2], inVertices[base + 3]);
+}
+
+vec3 fetch3(uint vertexIndex, uint offset)
+{
+	uint base = vertexIndex * pcs.vertexStride + offset;
+	return vec3(inVertices[base + 0], inVertices[base + 1], inVertices[base + 2]);
+}
+
+vec2 fetch2(uint vertexIndex, uint offset)
+{
+	uint base = vertexIndex * pcs.vertexStride + offset;
+	return vec2(inVertices[base + 0], inVertices[base + 1]);
+}
+
+float edgeFunction(vec2 a, vec2 b, vec2 p)
+{
+	return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+}
+
+// 在像素中心求透视校正的重心坐标
+vec3 perspectiveBarycentrics(vec4 c0, vec4 c1, vec4 c2, vec2 pixel, vec2 screenSize)
+{
+	vec2 p0 = (c0.xy / c0.w * 0.5 + 0.5) * screenSize;
+	vec2 p1 = (c1.xy / c1.w * 0.5 + 0.5) * screenSize;
+	vec2 p2 = (c2.xy / c2.w * 0.5 + 0.5) * screenSize;
+	vec3 b = vec3(edgeFunction(p1, p2, pixel), edgeFunction(p2, p0, pixel), edgeFunction(p0, p1, pixel)) / edgeFunction(p0, p1, p2);
+	b /= vec3(c0.w, c1.w, c2.w);
+	return b / (b.x + b.y + b.z);
+}
+
+void reconstructAttributes(uint payload)
+{
+	Cluster cluster = clusters[payload >> VIS_TRIANGLE_BITS];
+	uint triangle = cluster.triangleStart + (payload & ((1u << VIS_TRIANGLE_BITS) - 1u));
+	uint i0 = inTriangles[triangle * 3 + 0];
+	uint i1 = inTriangles[triangle * 3 + 1];
+	uint i2 = inTriangles[triangle * 3 + 2];
+
+	mat4 model = instanceTransforms[cluster.objectIdx];
+	vec3 w0 = vec3(model * vec4(fetch3(i0, VERTEX_POS), 1.0));
+	vec3 w1 = vec3(model * vec4(fetch3(i1, VERTEX_POS), 1.0));
+	vec3 w2 = vec3(model * vec4(fetch3(i2, VERTEX_POS), 1.0));
+	mat4 viewProj = ubo.projection * ubo.view;
+	vec3 b = perspectiveBarycentrics(viewProj * vec4(w0, 1.0), viewProj * vec4(w1, 1.0), viewProj * vec4(w2, 1.0), gl_FragCoord.xy, vec2(pcs.width, pcs.height));
+
+	inWorldPos = b.x * w0 + b.y * w1 + b.z * w2;
+	inNormal = mat3(model) * (b.x * fetch3(i0, VERTEX_NORMAL) + b.y * fetch3(i1, VERTEX_NORMAL) + b.z * fetch3(i2, VERTEX_NORMAL));
+	vec4 tangent = b.x * fetch4(i0, VERTEX_TANGENT) + b.y * fetch4(i1, VERTEX_TANGENT) + b.z * fetch4(i2, VERTEX_TANGENT);
+	inTangent = vec4(mat3(model) * tangent.xyz, tangent.w);
+	inUV = b.x * fetch2(i0, VERTEX_UV) + b.y * fetch2(i1, VERTEX_UV) + b.z * fetch2(i2, VERTEX_UV);
+	inClusterIds = uvec4(payload >> VIS_TRIANGLE_BITS, cluster.groupIndex, cluster.lodLevel, cluster.objectIdx);
+}
+
+// 调试视图，与PBRTextureBuffer.h的DebugView一致
+#define DEBUG_VIEW_NONE 0
+#define DEBUG_VIEW_LOD 1
+#define DEBUG_VIEW_CLUSTER 2
+#define DEBUG_VIEW_GROUP 3
+
+// PCG整数哈希
+uint hashId(uint x)
+{
+	uint state = x * 747796405u + 2891336453u;
+	uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+vec3 hashColor(uint x)
+{
+	uint h = hashId(x);
+	return vec3(h & 0xFFu, (h >> 8) & 0xFFu, (h >> 16) & 0xFFu) / 255.0;
+}
+
+// group下标只在一个mesh的一级LOD内唯一，和LOD、实例一起哈希
+vec3 debugColor(uvec4 ids)
+{
+	if (uboParams.debugView == DEBUG_VIEW_LOD)
+		return hashColor(ids.z);
+	if (uboParams.debugView == DEBUG_VIEW_CLUSTER)
+		return hashColor(ids.x);
+	return hashColor(ids.y ^ hashId(ids.z ^ hashId(ids.w)));
+}
+
+// From http://filmicgames.com/archives/75
+vec3 Uncharted2Tonemap(vec3 x)
+{
+	float A = 0.15;
+	float B = 0.50;
+	float C = 0.10;
+	float D = 0.20;
+	float E = 0.02;
+	float F = 0.30;
+	return ((x*(A*x+C*B)+D*E)/(x*(A*x+B)+D*F))-E/F;
+}
+
+// Normal Distribution function --------------------------------------
+float D_GGX(float dotNH, float roughness)
+{
+	float alpha = roughness * roughness;
+	float alpha2 = alpha * alpha;
+	float denom = dotNH * dotNH * (alpha2 - 1.0) + 1.0;
+	return (alpha2)/(PI * denom*denom);
+}
+
+// Geometric Shadowing function --------------------------------------
+float G_SchlicksmithGGX(float dotNL, float dotNV, float roughness)
+{
+	float r = (roughness + 1.0);
+	float k = (r*r) / 8.0;
+	float GL = dotNL / (dotNL * (1.0 - k) + k);
+	float GV = dotNV / (dotNV * (1.0 - k) + k);
+	return GL * GV;
+}
+
+// Fresnel function ----------------------------------------------------
+vec3 F_Schlick(float cosTheta, vec3 F0)
+{
+	return F0 + (1.0 - F0) * pow(1.0 - cosTheta, 5.0);
+}
+vec3 F_SchlickR(float cosTheta, vec3 F0, float roughness)
+{
+	return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(1.0 - cosTheta, 5.0);
+}
+
+// 余弦卷积后的SH求值，系数已经除过π，结果和原来的irradiance cubemap含义一致
+vec3 irradianceSH(vec3 n)
+{
+	vec3 irradiance = uboParams.shIrradiance[0].rgb * 0.282095
+		+ uboParams.shIrradiance[1].rgb * (0.488603 * n.y)
+		+ uboParams.shIrradiance[2].rgb * (0.488603 * n.z)
+		+ uboParams.shIrradiance[3].rgb * (0.488603 * n.x)
+		+ uboParams.shIrradiance[4].rgb * (1.092548 * n.x * n.y)
+		+ uboParams.shIrradiance[5].rgb * (1.092548 * n.y * n.z)
+		+ uboParams.shIrradiance[6].rgb * (0.315392 * (3.0 * n.z * n.z - 1.0))
+		+ uboParams.shIrradiance[7].rgb * (1.092548 * n.x * n.z)
+		+ uboParams.shIrradiance[8].rgb * (0.546274 * (n.x * n.x - n.y * n.y));
+	return max(irradiance, vec3(0.0));
+}
+
+vec3 prefilteredReflection(vec3 R, float roughness)
+{
+	const float MAX_REFLECTION_LOD = 9.0; // todo: param/const
+	float lod = roughness * MAX_REFLECTION_LOD;
+	float lodf = floor(lod);
+	float lodc = ceil(lod);
+	vec3 a = textureLod(prefilteredMap, R, lodf).rgb;
+	vec3 b = textureLod(prefilteredMap, R, lodc).rgb;
+	return mix(a, b, lod - lodf);
+}
+
+vec3 specularContribution(vec3 L, vec3 V, vec3 N, vec3 F0, float metallic, float roughness)
+{
+	// Precalculate vectors and dot products
+	vec3 H = normalize (V + L);
+	float dotNH = clamp(dot(N, H), 0.0, 1.0);
+	float dotNV = clamp(dot(N, V), 0.0, 1.0);
+	float dotNL = clamp(dot(N, L), 0.0, 1.0);
+
+	// Light color fixed
+	vec3 lightColor = vec3(1.0);
+
+	vec3 color = vec3(0.0);
+
+	if (dotNL > 0.0) {
+		// D = Normal distribution (Distribution of the microfacets)
+		float D = D_GGX(dotNH, roughness);
+		// G = Geometric shadowing term (Microfacets shadowing)
+		float G = G_SchlicksmithGGX(dotNL, dotNV, roughness);
+		// F = Fresnel factor (Reflectance depending on angle of incidence)
+		vec3 F = F_Schlick(dotNV, F0);
+		vec3 spec = D * F * G / (4.0 * dotNL * dotNV + 0.001);
+		vec3 kD = (vec3(1.0) - F) * (1.0 - metallic);
+		color += (kD * ALBEDO / PI + spec) * dotNL;
+	}
+
+	return color;
+}
+
+vec3 calculateNormal()
+{
+	vec3 tangentNormal = texture(normalMap, inUV).xyz * 2.0 - 1.0;
+
+	vec3 N = normalize(inNormal);
+	vec3 T = normalize(inTangent.xyz);
+	vec3 B = normalize(cross(N, T));
+	mat3 TBN = mat3(T, B, N);
+	return normalize(TBN * tangentNormal);
+}
+
+void main()
+{
+	uvec2 vis = visibility[uint(gl_FragCoord.y) * pcs.width + uint(gl_FragCoord.x)];
+	if (vis.y == VIS_EMPTY)
+		discard;
+
+	gl_FragDepth = uintBitsToFloat(vis.y);
+	reconstructAttributes(vis.x);
+
+	// 和pbrtexture.frag一样的调试视图
+	if (uboParams.debugView != DEBUG_VIEW_NONE)
+	{
+		outColor = vec4(debugColor(inClusterIds), 1.0);
+		return;
+	}
+
+	vec3 N = calculateNormal();
+
+	vec3 V = normalize(ubo.camPos - inWorldPos);
+	vec3 R = reflect(-V, N);
+
+	float metallic = texture(metallicMap, inUV).r;
+	float roughness = texture(roughnessMap, inUV).r;
+
+	vec3 F0 = vec3(0.04);
+	F0 = mix(F0, ALBEDO, metallic);
+
+	vec3 Lo = vec3(0.0);
+	for(int i = 0; i < uboParams.lights[i].length(); i++) {
+		vec3 L = normalize(uboParams.lights[i].xyz - inWorldPos);
+		Lo += specularContribution(L, V, N, F0, metallic, roughness);
+	}
+
+	vec2 brdf = texture(samplerBRDFLUT, vec2(max(dot(N, V), 0.0), roughness)).rg;
+	vec3 reflection = prefilteredReflection(R, roughness).rgb;
+	vec3 irradiance = irradianceSH(N);
+
+	// Diffuse based on irradiance
+	vec3 diffuse = irradiance * ALBEDO;
+
+	vec3 F = F_SchlickR(max(dot(N, V), 0.0), F0, roughness);
+
+	// Specular reflectance
+	vec3 specular = reflection * (F * brdf.x + brdf.y);
+
+	// Ambient part
+	vec3 kD = 1.0 - F;
+	kD *= 1.0 - metallic;
+	vec3 ambient = (kD * diffuse + specular) * texture(aoMap, inUV).rrr;
+
+	vec3 color = ambient + Lo;
+
+	// Tone mapping
+	color = Uncharted2Tonemap(color * uboParams.exposure);
+	color = color * (1.0f / Uncharted2Tonemap(vec3(11.2f)));
+	// Gamma correction
+	color = pow(color, vec3(1.0f / uboParams.gamma));
+
+	outColor = vec4(color, 1.0);
+}
@@ -64,14 +64,29 @@ namespace Nanite
 		alignas(4) uint32_t triangleIndicesStart;
 		alignas(4) uint32_t triangleIndicesEnd;
 		alignas(4) uint32_t objectIdx;
+		alignas(4) uint32_t lodLevel = 0;
+		// 本级LOD内的cluster group下标，占原来末尾的填充，只给调试视图用
+		alignas(4) uint32_t clusterGroupIdx = 0;
 
 		void mergeAABB(const glm::vec3& pMin, const glm::vec3& pMax)
 		{
 			pMinWorld = glm::min(pMinWorld, pMin);
-			pMaxWorld = glm::max(pMinWorld, pMax);
+			pMaxWorld = glm::max(pMaxWorld, pMax);
 		}
 	};
 
+	static_assert(sizeof(ClusterInfo) == 48, "ClusterInfo must match the std430 Cluster struct in the shaders");
+
+	// 实例级剔除用，会传入给shader
+	class InstanceInfo
+	{
+	public:
+		alignas(16) glm::vec3 pMinWorld = glm::vec3(FLT_MAX);
+		alignas(4) uint32_t clusterOffset = 0;
+		alignas(16) glm::vec3 pMaxWorld = glm::vec3(-FLT_MAX);
+		alignas(4) uint32_t clusterCount = 0;
+	};
+
 	class ErrorInfo
 	{
 	public:
@@ -5,8 +5,6 @@
 #include "../utils.h"
 
 #include <algorithm>
-#include <numeric>
-#include <optional>
 
 namespace Nanite
 {
@@ -15,175 +13,86 @@ namespace Nanite
 		return glm::vec3(rootTransform * glm::vec4(point, 1.0f));
 	}
 
-	glm::vec3 NaniteInstance::openMeshPointToGlm(const NaniteTriMesh::Point& point) const
-	{
-		return glm::vec3(point[0], point[1], point[2]);
-	}
-
 	float NaniteInstance::calculateWorldRadius(float localRadius) const
 	{
 		return glm::length(rootTransform * glm::vec4(localRadius, 0.0f, 0.0f, 0.0f));
 	}
 
-	void NaniteInstance::processFaceAABB(const NaniteLodMesh& lodMesh, size_t currClusterNum)
+	void NaniteInstance::transformAABB(const glm::vec3& pMin, const glm::vec3& pMax, ClusterInfo& cluster) const
 	{
-		const auto& mesh = lodMesh.mesh;
-
-		for (auto face_it = mesh.faces_begin(); face_it != mesh.faces_end(); ++face_it)
+		// 局部包围盒的8个角点变换到世界空间，有旋转时比逐三角形变换略松，但仍然保守
+		for (int corner = 0; corner < 8; ++corner)
 		{
-			const auto fh = *face_it;
-			const auto clusterIdx = lodMesh.triangleClusterIndex[fh.idx()] + currClusterNum;
-			auto& clusterI = clusterInfo[clusterIdx];
-
-			// 获取三角形顶点
-			auto fv_it = mesh.cfv_iter(fh);
-			const auto p0 = transformPoint(openMeshPointToGlm(mesh.point(*fv_it++)));
-			const auto p1 = transformPoint(openMeshPointToGlm(mesh.point(*fv_it++)));
-			const auto p2 = transformPoint(openMeshPointToGlm(mesh.point(*fv_it)));
-
-			glm::vec3 pMinWorld, pMaxWorld;
-			getTriangleAABB(p0, p1, p2, pMinWorld, pMaxWorld);
-			clusterI.mergeAABB(pMinWorld, pMaxWorld);
+			const glm::vec3 p((corner & 1) ? pMax.x : pMin.x, (corner & 2) ? pMax.y : pMin.y, (corner & 4) ? pMax.z : pMin.z);
+			const glm::vec3 pWorld = transformPoint(p);
+			cluster.mergeAABB(pWorld, pWorld);
 		}
 	}
 
-	void NaniteInstance::processClusterIndices(const NaniteLodMesh& lodMesh, size_t currClusterNum, size_t currTriangleNum)
+	void NaniteInstance::buildClusterInfo()
 	{
-		const auto& sortedIndices = lodMesh.triangleIndicesSortedByClusterIdx;
-		const auto& clusterIndex = lodMesh.triangleClusterIndex;
-
-		std::optional<uint32_t> prevClusterIdx;
-
-		for (size_t j = 0; j < sortedIndices.size(); ++j)
-		{
-			const auto currTriangleIndex = sortedIndices[j];
-			const auto currClusterIdx = clusterIndex[currTriangleIndex];
-
-			if (!prevClusterIdx.has_value() || currClusterIdx != prevClusterIdx.value())
-			{
-				if (prevClusterIdx.has_value())
-				{
-					clusterInfo[prevClusterIdx.value() + currClusterNum].triangleIndicesEnd = j + currTriangleNum;
-				}
-				clusterInfo[currClusterIdx + currClusterNum].triangleIndicesStart = j + currTriangleNum;
-				prevClusterIdx = currClusterIdx;
-			}
-		}
+		// 只读mesh的紧凑运行时数据，finalizeForRuntime之后也能重建
+		const auto& runtimeClusters = referenceMesh->runtimeClusters;
+		const uint32_t lastLodLevel = runtimeClusters.empty() ? 0 : runtimeClusters.back().lodLevel;
 
-		// 处理最后一个cluster
-		if (prevClusterIdx.has_value())
-		{
-			clusterInfo[prevClusterIdx.value() + currClusterNum].triangleIndicesEnd = sortedIndices.size() + currTriangleNum;
-		}
-	}
+		clusterInfo.resize(runtimeClusters.size());
+		errorInfo.resize(runtimeClusters.size());
 
-	void NaniteInstance::processClusterErrors(const NaniteLodMesh& lodMesh, size_t meshIndex, size_t currClusterNum)
-	{
-		const auto& meshes = referenceMesh->meshes;
-		const bool isLastLevel = (meshIndex == meshes.size() - 1);
-
-		for (size_t j = 0; j < lodMesh.clusters.size(); ++j)
+		for (size_t i = 0; i < runtimeClusters.size(); ++i)
 		{
-			const auto& cluster = lodMesh.clusters[j];
-			const auto globalClusterIdx = j + currClusterNum;
-
-			// 计算error
-			const float parentError = isLastLevel ? 1e5f : cluster.parentNormalizedError;
-			errorInfo[globalClusterIdx].errorWorld = glm::vec2(cluster.normalizedlodError, parentError);
-
-			// 计算世界空间包围球
-			const auto worldCenter = transformPoint(cluster.boundingSphereCenter);
-			const float worldRadius = calculateWorldRadius(cluster.boundingSphereRadius);
-
-			NaniteAssert(cluster.triangleIndices.size() <= CLUSTER_THRESHOLD, "cluster.triangleIndices.size() is over threshold");
-			NaniteAssert(cluster.boundingSphereRadius > 0 || cluster.triangleIndices.empty(), "boundingSphereRadius <= 0");
-			NaniteAssert(worldRadius > 0 || cluster.triangleIndices.empty(), "worldRadius <= 0");
-
-			errorInfo[globalClusterIdx].centerR = glm::vec4(worldCenter, worldRadius);
-
-			// 计算父级包围球
-			float parentBoundingRadius = 0.0f;
-			glm::vec3 parentCenter{0.0f};
-
-			if (isLastLevel)
-			{
-				parentBoundingRadius = worldRadius * 1.5f;
-				parentCenter = cluster.boundingSphereCenter;
-			}
-			else if (!cluster.parentClusterIndices.empty())
+			const auto& cluster = runtimeClusters[i];
+			auto& info = clusterInfo[i];
+			info = ClusterInfo();
+			// 空cluster保持反转的包围盒
+			if (cluster.boundsMin.x <= cluster.boundsMax.x)
 			{
-				const auto parentIdx = cluster.parentClusterIndices.front();
-				const auto& parentCluster = meshes[meshIndex + 1].clusters[parentIdx];
-				parentBoundingRadius = parentCluster.boundingSphereRadius;
-				parentCenter = parentCluster.boundingSphereCenter;
+				transformAABB(cluster.boundsMin, cluster.boundsMax, info);
 			}
-
-			const auto parentWorldCenter = transformPoint(parentCenter);
-			errorInfo[globalClusterIdx].centerRP = glm::vec4(parentWorldCenter, parentBoundingRadius);
-		}
-	}
-
-	void NaniteInstance::buildClusterInfo()
-	{
-		const auto& meshes = referenceMesh->meshes;
-
-		// 计算总cluster数量
-		const size_t totalClusterNum = std::accumulate(meshes.begin(), meshes.end(), size_t{0}, [](size_t sum, const NaniteLodMesh& mesh) { return sum + mesh.clusterNum; });
-
-		clusterInfo.resize(totalClusterNum);
-		errorInfo.resize(totalClusterNum);
-
-		size_t currClusterNum = 0;
-		size_t currTriangleNum = 0;
-
-		for (size_t i = 0; i < meshes.size(); ++i)
-		{
-			const auto& lodMesh = meshes[i];
-
-			processFaceAABB(lodMesh, currClusterNum);
-			processClusterIndices(lodMesh, currClusterNum, currTriangleNum);
-			processClusterErrors(lodMesh, i, currClusterNum);
-
-			currClusterNum += lodMesh.clusterNum;
-			currTriangleNum += lodMesh.triangleIndicesSortedByClusterIdx.size();
+			info.triangleIndicesStart = cluster.triangleStart;
+			info.triangleIndicesEnd = cluster.triangleEnd;
+			info.lodLevel = cluster.lodLevel;
+			info.clusterGroupIdx = cluster.groupIndex;
+
+			// 世界空间包围球和误差
+			const float worldRadius = calculateWorldRadius(cluster.sphere.w);
+			NaniteAssert(worldRadius > 0 || cluster.triangleStart == cluster.triangleEnd, "worldRadius <= 0");
+			auto& error = errorInfo[i];
+			error.errorWorld = glm::vec2(cluster.error, cluster.parentError);
+			error.centerR = glm::vec4(transformPoint(glm::vec3(cluster.sphere)), worldRadius);
+			const float parentRadius = cluster.lodLevel == lastLodLevel ? worldRadius * 1.5f : cluster.parentSphere.w;
+			error.centerRP = glm::vec4(transformPoint(glm::vec3(cluster.parentSphere)), parentRadius);
 		}
 	}
 
 	void NaniteInstance::initBufferForNaniteLODs()
 	{
 		const auto& meshes = referenceMesh->meshes;
+		NaniteAssert(!referenceMesh->isFinalized(), "NaniteInstance::initBufferForNaniteLODs: mesh already finalized for runtime");
+		assert(!referenceMesh->sharedVertexBuffer.empty());
 
-		// 计算总顶点和索引数量
-		size_t totalNumVertices = 0;
+		// 计算总索引数量
 		size_t totalNumIndices = 0;
 
 		for (const auto& lodMesh : meshes)
 		{
-			assert(!lodMesh.uniqueVertexBuffer.empty());
 			assert(!lodMesh.triangleVertexIndicesSortedByClusterIdx.empty());
+			assert(lodMesh.sharedVertexIndices.size() == lodMesh.mesh.n_vertices());
 
-			totalNumVertices += lodMesh.uniqueVertexBuffer.size();
 			totalNumIndices += lodMesh.triangleVertexIndicesSortedByClusterIdx.size();
 		}
 
-		vertexBuffer.clear();
+		// 所有LOD共用一个顶点池
+		vertexBuffer = referenceMesh->sharedVertexBuffer;
 		indexBuffer.clear();
-		vertexBuffer.reserve(totalNumVertices);
 		indexBuffer.reserve(totalNumIndices);
 
-		size_t currVertSize = 0;
 		for (const auto& lodMesh : meshes)
 		{
-			// 批量插入顶点
-			vertexBuffer.insert(vertexBuffer.end(), lodMesh.uniqueVertexBuffer.begin(), lodMesh.uniqueVertexBuffer.end());
-
-			// 添加偏移后的索引
+			// 本级顶点下标映射到顶点池
 			for (const auto index : lodMesh.triangleVertexIndicesSortedByClusterIdx)
 			{
-				indexBuffer.emplace_back(static_cast<uint32_t>(index + currVertSize));
+				indexBuffer.emplace_back(lodMesh.sharedVertexIndices[index]);
 			}
-
-			currVertSize += lodMesh.uniqueVertexBuffer.size();
 		}
 	}
 }
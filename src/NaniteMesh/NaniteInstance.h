@@ -37,10 +37,7 @@ namespace Nanite
 
 	private:
 		[[nodiscard]] glm::vec3 transformPoint(const glm::vec3& point) const;
-		[[nodiscard]] glm::vec3 openMeshPointToGlm(const NaniteTriMesh::Point& point) const;
 		[[nodiscard]] float calculateWorldRadius(float localRadius) const;
-		void processFaceAABB(const NaniteLodMesh& lodMesh, size_t currClusterNum);
-		void processClusterIndices(const NaniteLodMesh& lodMesh, size_t currClusterNum, size_t currTriangleNum);
-		void processClusterErrors(const NaniteLodMesh& lodMesh, size_t meshIndex, size_t currClusterNum);
+		void transformAABB(const glm::vec3& pMin, const glm::vec3& pMax, ClusterInfo& cluster) const;
 	};
 }
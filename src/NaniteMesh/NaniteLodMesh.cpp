@@ -8,6 +8,7 @@
 #include "ClusterGroup.h"
 #include "../utils.h"
 #include "../vksTools.h"
+#include "JobSystem.h"
 #include "metis.h"
 
 namespace Nanite
@@ -72,12 +73,9 @@ namespace Nanite
 
 	void NaniteLodMesh::assignTriangleClusterGroup(NaniteLodMesh& lastLOD)
 	{
-		// 复制上一级LOD的cluster group信息
-		for (size_t i = 0; i < lastLOD.clusterGroups.size(); ++i)
-		{
-			oldClusterGroups[i].clusterIndices = lastLOD.clusterGroups[i].clusterIndices;
-			oldClusterGroups[i].qemError = lastLOD.clusterGroups[i].qemError;
-		}
+		// 上一级LOD的cluster group在这一级重新切cluster，临时数据只活在这个函数里
+		const auto& lastClusterGroups = lastLOD.clusterGroups;
+		std::vector<ClusterGroup> oldClusterGroups(lastClusterGroups.size());
 
 		// 分配半边到cluster group
 		for (const auto& heh : mesh.halfedges())
@@ -113,12 +111,16 @@ namespace Nanite
 			}
 
 			std::vector<uint32_t> newClusterIndices(newClusterIndicesSet[i].begin(), newClusterIndicesSet[i].end());
-			for (const auto idx : oldClusterGroup.clusterIndices)
+			for (const auto idx : lastClusterGroups[i].clusterIndices)
 			{
 				lastLOD.clusters[idx].parentClusterIndices = newClusterIndices;
 			}
 			clusterIndexOffset += oldClusterGroup.localClusterNum;
+
+			// 这个group的局部三角形图和映射表用完就释放，同一时间只留一个group的
+			oldClusterGroup = ClusterGroup{};
 		}
+		oldClusterGroups = {};
 
 		// 验证所有三角形已分配
 		for (size_t i = 0; i < triangleClusterIndex.size(); ++i)
@@ -142,25 +144,29 @@ namespace Nanite
 		}
 
 		// 设置QEM误差
-		for (size_t i = 0; i < oldClusterGroups.size(); ++i)
+		for (size_t i = 0; i < lastClusterGroups.size(); ++i)
 		{
 			for (const auto& newClusterIndex : newClusterIndicesSet[i])
 			{
-				clusters[newClusterIndex].qemError = oldClusterGroups[i].qemError;
+				clusters[newClusterIndex].qemError = lastClusterGroups[i].qemError;
 			}
 		}
 
-		// 计算包围球和表面积
-		for (auto& cluster : clusters)
+		// 计算包围球和表面积，各cluster互不依赖
+		vks::JobSystem::shared().parallelFor(static_cast<uint32_t>(clusters.size()), CLUSTER_GRAIN_SIZE, [this, &lastLOD](uint32_t begin, uint32_t end)
 		{
-			calcBoundingSphereFromChildren(cluster, lastLOD);
-			calcSurfaceArea(cluster);
-			for (const int idx : cluster.childClusterIndices)
+			for (uint32_t i = begin; i < end; i++)
 			{
-				cluster.boundingSphereRadius = glm::max(cluster.boundingSphereRadius, 
-					lastLOD.clusters[idx].boundingSphereRadius * 2.0f);
+				auto& cluster = clusters[i];
+				calcBoundingSphereFromChildren(cluster, lastLOD);
+				calcSurfaceArea(cluster);
+				for (const int idx : cluster.childClusterIndices)
+				{
+					cluster.boundingSphereRadius = glm::max(cluster.boundingSphereRadius, 
+						lastLOD.clusters[idx].boundingSphereRadius * 2.0f);
+				}
 			}
-		}
+		});
 
 		// 计算LOD误差
 		for (auto& cluster : clusters)
@@ -202,28 +208,6 @@ namespace Nanite
 		const auto faceCount = mesh.n_faces();
 		const int embeddingSize = targetClusterSize * (1 + (faceCount + 1) / targetClusterSize) - faceCount;
 		triangleGraph.resize(faceCount + embeddingSize);
-		isLastLODEdgeVertices.resize(faceCount * 3, false);
-
-		// 标记边界顶点
-		for (const auto& edge : mesh.edges())
-		{
-			const auto heh = mesh.halfedge_handle(edge, 0);
-			const auto groupIdx1 = mesh.property(clusterGroupIndexPropHandle, heh) - 1;
-			const auto groupIdx2 = mesh.property(clusterGroupIndexPropHandle, mesh.opposite_halfedge_handle(heh)) - 1;
-
-			if (groupIdx1 != groupIdx2)
-			{
-				const auto fh = mesh.face_handle(heh);
-				const auto vh1 = mesh.to_vertex_handle(heh);
-				const auto vh2 = mesh.to_vertex_handle(mesh.opposite_halfedge_handle(heh));
-
-				for (auto fv_it = mesh.cfv_iter(fh); fv_it.is_valid(); ++fv_it)
-				{
-					if (*fv_it == vh1 || *fv_it == vh2)
-						isLastLODEdgeVertices[fv_it->idx()] = true;
-				}
-			}
-		}
 
 		// 构建对偶图
 		for (const auto& edge : mesh.edges())
@@ -240,8 +224,16 @@ namespace Nanite
 	}
 
 	void NaniteLodMesh::generateCluster()
+	{
+		partitionTriangles();
+		computeClusterBounds();
+	}
+
+	void NaniteLodMesh::partitionTriangles()
 	{
 		auto triangleMetisGraph = MetisGraph::GraphToMetisGraph(triangleGraph);
+		// 转成CSR以后邻接表就没用了，先释放再跑METIS
+		triangleGraph = {};
 		const auto vertexCount = triangleMetisGraph.nvtxs;
 
 		triangleClusterIndex.resize(vertexCount);
@@ -278,12 +270,19 @@ namespace Nanite
 			clusters[clusterIdx].lodLevel = lodLevel;
 			clusters[clusterIdx].lodError = -1;
 		}
+	}
 
-		for (auto& cluster : clusters)
+	void NaniteLodMesh::computeClusterBounds()
+	{
+		// 只读mesh，各cluster互不依赖
+		vks::JobSystem::shared().parallelFor(static_cast<uint32_t>(clusters.size()), CLUSTER_GRAIN_SIZE, [this](uint32_t begin, uint32_t end)
 		{
-			getBoundingSphere(cluster);
-			calcSurfaceArea(cluster);
-		}
+			for (uint32_t i = begin; i < end; i++)
+			{
+				getBoundingSphere(clusters[i]);
+				calcSurfaceArea(clusters[i]);
+			}
+		});
 	}
 
 	void NaniteLodMesh::buildClusterGraph()
@@ -491,6 +490,7 @@ namespace Nanite
 			{"clusterGroupIndex", clusterGroupIndex},
 			{"triangleIndicesSortedByClusterIdx", triangleIndicesSortedByClusterIdx},
 			{"triangleVertexIndicesSortedByClusterIdx", triangleVertexIndicesSortedByClusterIdx},
+			{"sharedVertexIndices", sharedVertexIndices},
 			{"clusters", nlohmann::json::array()}
 		};
 
@@ -508,6 +508,10 @@ namespace Nanite
 		clusterGroupIndex = j["clusterGroupIndex"].get<std::vector<idx_t>>();
 		triangleIndicesSortedByClusterIdx = j["triangleIndicesSortedByClusterIdx"].get<std::vector<uint32_t>>();
 		triangleVertexIndicesSortedByClusterIdx = j["triangleVertexIndicesSortedByClusterIdx"].get<std::vector<uint32_t>>();
+		// 旧缓存没有映射表，留空由NaniteMesh::deserialize补上
+		sharedVertexIndices.clear();
+		if (const auto it = j.find("sharedVertexIndices"); it != j.end())
+			sharedVertexIndices = it->get<std::vector<uint32_t>>();
 
 		clusters.resize(clusterNum);
 		for (size_t i = 0; i < clusters.size(); ++i)
@@ -517,6 +521,8 @@ namespace Nanite
 	void NaniteLodMesh::generateClusterGroup()
 	{
 		auto clusterMetisGraph = MetisGraph::GraphToMetisGraph(clusterGraph);
+		// 转成CSR以后邻接表就没用了，着色(colorClusterGraph)要在这之前做
+		clusterGraph = {};
 		clusterGroupIndex.resize(clusterMetisGraph.nvtxs);
 
 		idx_t ncon = 1;
@@ -562,9 +568,6 @@ namespace Nanite
 			clusterGroups[clusterGroupIdx].clusterIndices.emplace_back(clusterIdx);
 		}
 
-		isEdgeVertices.resize(mesh.n_faces() * 3, false);
-		std::vector<std::unordered_set<NaniteTriMesh::FaceHandle>> clusterGroupFaceHandles(clusterGroupNum);
-
 		for (const auto& edge : mesh.edges())
 		{
 			const auto heh = mesh.halfedge_handle(edge, 0);
@@ -576,7 +579,6 @@ namespace Nanite
 			{
 				const auto groupIdx = clusterGroupIndex[triangleClusterIndex[fh.idx()]];
 				mesh.property(clusterGroupIndexPropHandle, heh) = groupIdx + 1;
-				clusterGroupFaceHandles[groupIdx].insert(fh);
 				continue;
 			}
 
@@ -584,7 +586,6 @@ namespace Nanite
 			{
 				const auto groupIdx = clusterGroupIndex[triangleClusterIndex[fh2.idx()]];
 				mesh.property(clusterGroupIndexPropHandle, heh) = groupIdx + 1;
-				clusterGroupFaceHandles[groupIdx].insert(fh2);
 				continue;
 			}
 
@@ -593,14 +594,13 @@ namespace Nanite
 			const auto groupIdx1 = clusterGroupIndex[triangleClusterIndex[fh.idx()]];
 			const auto groupIdx2 = clusterGroupIndex[triangleClusterIndex[fh2.idx()]];
 
-			clusterGroupFaceHandles[groupIdx1].insert(fh);
-			clusterGroupFaceHandles[groupIdx2].insert(fh2);
 			mesh.property(clusterGroupIndexPropHandle, heh) = groupIdx1 + 1;
 			mesh.property(clusterGroupIndexPropHandle, oppositeHeh) = groupIdx2 + 1;
 		}
 
-		for (size_t i = 0; i < static_cast<size_t>(clusterGroupNum); ++i)
-			clusterGroups[i].localFaceNum = clusterGroupFaceHandles[i].size();
+		// 每个三角形只属于自己cluster所在的group，直接计数，不用给每个group建哈希集合
+		for (const auto& fh : mesh.faces())
+			++clusterGroups[clusterGroupIndex[triangleClusterIndex[fh.idx()]]].localFaceNum;
 	}
 
 	void NaniteLodMesh::initVertexBuffer()
@@ -625,22 +625,27 @@ namespace Nanite
 		}
 	}
 
-	void NaniteLodMesh::initUniqueVertexBuffer()
+	void NaniteLodMesh::initSharedVertexIndices(OpenMesh::VPropHandleT<int32_t> sharedVertexIndexPropHandle)
 	{
-		uniqueVertexBuffer.reserve(mesh.n_vertices());
-
+		sharedVertexIndices.resize(mesh.n_vertices());
 		for (const auto& vertex : mesh.vertices())
 		{
-			vkglTF::Vertex v;
-			v.pos = pointToVec3(mesh.point(vertex));
-			v.normal = pointToVec3(mesh.normal(vertex));
-			v.uv = glm::vec2(mesh.texcoord2D(vertex)[0], mesh.texcoord2D(vertex)[1]);
-			v.joint0 = glm::vec4(static_cast<float>(lodLevel));
-			v.weight0 = glm::vec4(0.0f);
-			uniqueVertexBuffer.emplace_back(v);
+			const auto sharedIdx = mesh.property(sharedVertexIndexPropHandle, vertex);
+			NaniteAssert(sharedIdx >= 0, "vertex has no shared vertex index");
+			sharedVertexIndices[vertex.idx()] = static_cast<uint32_t>(sharedIdx);
 		}
 	}
 
+	vkglTF::Vertex NaniteLodMesh::getVertex(NaniteTriMesh::VertexHandle vh) const
+	{
+		// LOD层级不再写进顶点，着色器从cluster取
+		vkglTF::Vertex v{};
+		v.pos = pointToVec3(mesh.point(vh));
+		v.normal = pointToVec3(mesh.normal(vh));
+		v.uv = glm::vec2(mesh.texcoord2D(vh)[0], mesh.texcoord2D(vh)[1]);
+		return v;
+	}
+
 	void NaniteLodMesh::createVertexBuffer(VulkanExampleBase& variableLink)
 	{
 		const size_t vertexBufferSize = vertexBuffer.size() * sizeof(vkglTF::Vertex);
@@ -25,8 +25,6 @@ namespace Nanite
 	class NaniteLodMesh
 	{
 	public:
-		std::vector<ClusterGroup> oldClusterGroups;
-		
 		NaniteTriMesh mesh;
 		OpenMesh::HPropHandleT<int32_t> clusterGroupIndexPropHandle;
 		glm::mat4 modelMatrix{1.0f};
@@ -46,18 +44,15 @@ namespace Nanite
 		int clusterGroupNum = 0;
 		const int targetClusterGroupSize = CLUSTER_GROUP_SIZE;
 		std::vector<idx_t> clusterGroupIndex;
-		std::unordered_map<int, int> clusterGroupColorAssignment;
 		std::vector<ClusterGroup> clusterGroups;
 
-		std::vector<bool> isEdgeVertices;
-		std::vector<bool> isLastLODEdgeVertices;
-
 		vks::VulkanDevice* device = nullptr;
 		const vkglTF::Model* model = nullptr;
 		vkglTF::Model::Vertices vertices;
 		std::vector<uint32_t> indexBuffer;
 		std::vector<vkglTF::Vertex> vertexBuffer;
-		std::vector<vkglTF::Vertex> uniqueVertexBuffer;
+		// 本级顶点下标到NaniteMesh::sharedVertexBuffer的映射，简化时没动过的顶点各级共用一份
+		std::vector<uint32_t> sharedVertexIndices;
 		std::vector<vkglTF::Primitive> primitives;
 
 		const std::array<glm::vec3, 8> nodeColors = {{
@@ -73,7 +68,12 @@ namespace Nanite
 
 		void assignTriangleClusterGroup(NaniteLodMesh& lastLOD);
 		void buildTriangleGraph();
+		// 等于partitionTriangles加computeClusterBounds，拆开是为了能分别计时
 		void generateCluster();
+		// METIS把三角形图切成cluster，排序三角形并填好每个cluster的三角形列表
+		void partitionTriangles();
+		// 逐cluster计算包围球和表面积
+		void computeClusterBounds();
 
 		void buildClusterGraph();
 		void generateClusterGroup();
@@ -90,13 +90,17 @@ namespace Nanite
 		void fromJson(const nlohmann::json& j);
 
 		void initVertexBuffer();
-		void initUniqueVertexBuffer();
+		// 从网格的顶点池下标属性取出sharedVertexIndices
+		void initSharedVertexIndices(OpenMesh::VPropHandleT<int32_t> sharedVertexIndexPropHandle);
+		[[nodiscard]] vkglTF::Vertex getVertex(NaniteTriMesh::VertexHandle vh) const;
 		void createVertexBuffer(VulkanExampleBase& variableLink);
 		std::vector<glm::vec3> positions;
 
 	private:
 		static constexpr idx_t METIS_RANDOM_SEED = 42;
 		static constexpr double SIMPLIFY_PERCENTAGE = 0.5;
+		// 逐cluster并行时每个任务处理的cluster数
+		static constexpr uint32_t CLUSTER_GRAIN_SIZE = 32;
 
 		void sortTrianglesByCluster();
 		void buildTriangleVertexIndices();
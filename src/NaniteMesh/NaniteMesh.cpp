@@ -1,5 +1,7 @@
 ﻿#include "NaniteMesh.h"
 
+#include <algorithm>
+#include <numeric>
 #include <queue>
 
 #include "BVH.h"
@@ -66,46 +68,93 @@ namespace Nanite
 
 	void NaniteMesh::generateNaniteInfo()
 	{
-		NaniteTriMesh mymesh;
-		vkglTFMeshToOpenMesh(mymesh, *vkglTFMesh);
-		int clusterGroupNum = -1;
-		int target = 6;
-		int currFaceNum = -1;
-
-		mymesh.add_property(clusterGroupIndexPropHandle);
-		do
+		// 直接转换进meshes里的LOD0，不经过临时网格
+		beginLods();
+		vkglTFMeshToOpenMesh(meshes.front().mesh, *vkglTFMesh);
+		generateLods();
+	}
+
+	void NaniteMesh::generateNaniteInfo(NaniteTriMesh mymesh)
+	{
+		beginLods();
+		meshes.front().mesh = std::move(mymesh);
+		generateLods();
+	}
+
+	void NaniteMesh::beginLods()
+	{
+		// 预留好所有LOD，构建中途不会因为扩容拷贝已有的NaniteLodMesh，下面拿的引用也一直有效
+		meshes.clear();
+		meshes.reserve(MAX_LOD_NUM);
+		meshes.emplace_back();
+		lodNums = 0;
+		hasClusterColors = colorClusterGraphs;
+		buildMemory.clear();
+		resetPeakRSS();
+	}
+
+	void NaniteMesh::recordBuildStage(uint32_t lodLevel, const char* stage)
+	{
+		buildMemory.push_back({lodLevel, stage, getCurrentRSS(), getPeakRSS()});
+		resetPeakRSS();
+	}
+
+	void NaniteMesh::generateLods()
+	{
+		auto& lod0 = meshes.front().mesh;
+		lod0.add_property(clusterGroupIndexPropHandle);
+		// 简化只删顶点不新建也不移动，LOD0的顶点就是整个顶点池
+		lod0.add_property(sharedVertexIndexPropHandle);
+		for (const auto& vh : lod0.vertices())
+			lod0.property(sharedVertexIndexPropHandle, vh) = vh.idx();
+
+		for (uint32_t lod = 0; lod < MAX_LOD_NUM; ++lod)
 		{
-			// For each lod mesh
-			NaniteLodMesh meshLOD;
-			meshLOD.mesh = mymesh;
-			meshLOD.lodLevel = lodNums;
+			auto& meshLOD = meshes[lod];
+			meshLOD.lodLevel = lod;
 			meshLOD.clusterGroupIndexPropHandle = clusterGroupIndexPropHandle;
-			if (clusterGroupNum > 0)
+			meshLOD.initSharedVertexIndices(sharedVertexIndexPropHandle);
+			if (lod > 0)
 			{
-				meshLOD.oldClusterGroups.resize(clusterGroupNum);
-				meshLOD.assignTriangleClusterGroup(meshes.back());
+				auto& lastLOD = meshes[lod - 1];
+				meshLOD.assignTriangleClusterGroup(lastLOD);
+				// 上一级的cluster group只用来切这一级的cluster
+				lastLOD.clusterGroups = {};
 			}
 			else
 			{
 				meshLOD.buildTriangleGraph();
 				meshLOD.generateCluster();
 			}
+			recordBuildStage(lod, "cluster");
 
 			meshLOD.buildClusterGraph();
-			meshLOD.colorClusterGraph();
+			if (colorClusterGraphs)
+			{
+				meshLOD.colorClusterGraph();
+			}
 			meshLOD.generateClusterGroup();
-			currFaceNum = meshLOD.mesh.n_faces();
-			clusterGroupNum = meshLOD.clusterGroupNum;
+			recordBuildStage(lod, "clusterGroup");
 
-			mymesh = meshLOD.mesh;
-			if (clusterGroupNum > 1)
+			if (lod + 1 < MAX_LOD_NUM)
 			{
-				meshLOD.simplifyMesh(mymesh);
+				// 下一级从这一级拷一份再简化，每级只有这一次整网格拷贝
+				auto& nextLOD = meshes.emplace_back();
+				nextLOD.mesh = meshLOD.mesh;
+				if (meshLOD.clusterGroupNum > 1)
+				{
+					meshLOD.simplifyMesh(nextLOD.mesh);
+				}
+				recordBuildStage(lod, "simplify");
 			}
-			meshes.emplace_back(meshLOD);
-			std::cout << "LOD " << lodNums++ << " generated" << std::endl;
+
+			// 这一级不会再改动，去掉只在构建时用的半边属性和顶点池属性；remove_property会把句柄清掉，传副本
+			auto groupPropHandle = clusterGroupIndexPropHandle;
+			auto sharedVertexPropHandle = sharedVertexIndexPropHandle;
+			meshLOD.mesh.remove_property(groupPropHandle);
+			meshLOD.mesh.remove_property(sharedVertexPropHandle);
+			std::cout << "LOD " << lodNums++ << " generated, peak RSS " << std::fixed << std::setprecision(1) << getPeakRSS() / (1024.0 * 1024.0) << " MB" << std::endl;
 		}
-		while (--target);
 	}
 
 	void NaniteMesh::serialize(const std::string& filepath)
@@ -146,6 +195,7 @@ namespace Nanite
 		}
 		result[cache_time_key] = std::time(nullptr);
 		result["lodNums"] = lodNums;
+		result["clusterColors"] = hasClusterColors;
 
 		// Save the JSON data to a file
 		std::ofstream file(std::string(filepath) + "nanite_info.json");
@@ -169,6 +219,8 @@ namespace Nanite
 		inputFile >> loadedJson;
 
 		lodNums = loadedJson["lodNums"].get<uint32_t>();
+		// 旧缓存没有这一项，按没着色处理
+		hasClusterColors = loadedJson.value("clusterColors", false);
 		meshes.resize(lodNums);
 		for (int i = 0; i < lodNums; ++i)
 		{
@@ -182,6 +234,7 @@ namespace Nanite
 		}
 		std::cout << std::endl;
 
+		uint32_t nextSharedVertexIndex = 0;
 		for (size_t i = 0; i < lodNums; i++)
 		{
 			std::string output_filename = std::string(filepath) + "LOD_" + std::to_string(i) + ".obj";
@@ -195,6 +248,17 @@ namespace Nanite
 			NaniteAssert(meshes[i].mesh.has_vertex_normals(), "mesh has no normals");
 			meshes[i].lodLevel = i;
 
+			// 旧缓存没有映射表，每级顶点各占一段，和共用顶点池之前一样
+			auto& sharedVertexIndices = meshes[i].sharedVertexIndices;
+			if (sharedVertexIndices.empty())
+			{
+				sharedVertexIndices.resize(meshes[i].mesh.n_vertices());
+				std::iota(sharedVertexIndices.begin(), sharedVertexIndices.end(), nextSharedVertexIndex);
+			}
+			NaniteAssert(sharedVertexIndices.size() == meshes[i].mesh.n_vertices(), "sharedVertexIndices size mismatch");
+			for (const auto idx : sharedVertexIndices)
+				nextSharedVertexIndex = std::max(nextSharedVertexIndex, idx + 1);
+
 			std::cout << "\r";
 			float percentage = static_cast<float>(i + 1) / lodNums * 100.0;
 			std::cout << "[Loading] Mesh LOD: " << std::fixed << std::setw(6) << std::setprecision(2) << percentage << "%";
@@ -225,6 +289,12 @@ namespace Nanite
 			{
 				deserialize(cachePath);
 				hasInitialized = true;
+				// 着色要用构建时的cluster图，缓存里没有，只能重新构建
+				if (colorClusterGraphs && !hasClusterColors)
+				{
+					std::cerr << "Cache has no cluster colors, rebuilding" << std::endl;
+					hasInitialized = false;
+				}
 			}
 			else
 			{
@@ -239,6 +309,194 @@ namespace Nanite
 			std::cout << cachePath << "nanite_info.json" << " generated" << std::endl;
 			//checkDeserializationResult(cachePath);
 		}
+
+		computeBounds();
+		initSharedVertexBuffer();
+		buildRuntimeData();
+	}
+
+	void NaniteMesh::initSharedVertexBuffer()
+	{
+		sharedVertexBuffer.clear();
+		std::vector<bool> filled;
+		size_t lodVertexCount = 0;
+
+		for (auto& lodMesh : meshes)
+		{
+			NaniteAssert(lodMesh.sharedVertexIndices.size() == lodMesh.mesh.n_vertices(), "sharedVertexIndices size mismatch");
+			lodVertexCount += lodMesh.mesh.n_vertices();
+
+			for (const auto& vh : lodMesh.mesh.vertices())
+			{
+				auto& sharedIdx = lodMesh.sharedVertexIndices[vh.idx()];
+				const auto vertex = lodMesh.getVertex(vh);
+				if (sharedIdx >= sharedVertexBuffer.size())
+				{
+					sharedVertexBuffer.resize(sharedIdx + 1);
+					filled.resize(sharedIdx + 1, false);
+				}
+
+				if (!filled[sharedIdx])
+				{
+					sharedVertexBuffer[sharedIdx] = vertex;
+					filled[sharedIdx] = true;
+				}
+				else if (sharedVertexBuffer[sharedIdx].pos != vertex.pos || sharedVertexBuffer[sharedIdx].normal != vertex.normal || sharedVertexBuffer[sharedIdx].uv != vertex.uv)
+				{
+					// 属性对不上（比如缓存精度不同）就单独存一份，不影响正确性
+					sharedIdx = static_cast<uint32_t>(sharedVertexBuffer.size());
+					sharedVertexBuffer.emplace_back(vertex);
+					filled.emplace_back(true);
+				}
+			}
+		}
+
+		std::cout << "Shared vertex pool: " << sharedVertexBuffer.size() << " vertices, " << lodVertexCount << " before sharing across LODs" << std::endl;
+	}
+
+	void NaniteMesh::buildRuntimeData()
+	{
+		runtimeClusters.clear();
+		dagChildRanges.clear();
+		dagChildIndices.clear();
+		lod0IndexCount = meshes.empty() ? 0 : meshes.front().triangleVertexIndicesSortedByClusterIdx.size();
+
+		// 与NaniteInstance::buildClusterInfo的排布一致：LOD0的cluster在前，逐级往后
+		std::vector<uint32_t> lodOffsets(meshes.size() + 1, 0);
+		for (size_t lod = 0; lod < meshes.size(); ++lod)
+		{
+			NaniteAssert(meshes[lod].clusters.size() == static_cast<size_t>(meshes[lod].clusterNum), "clusters size mismatch");
+			lodOffsets[lod + 1] = lodOffsets[lod] + static_cast<uint32_t>(meshes[lod].clusterNum);
+		}
+		runtimeClusters.resize(lodOffsets.back());
+
+		uint32_t triangleOffset = 0;
+		for (size_t lod = 0; lod < meshes.size(); ++lod)
+		{
+			const auto& lodMesh = meshes[lod];
+			const bool isLastLevel = lod + 1 == meshes.size();
+			auto* lodClusters = runtimeClusters.data() + lodOffsets[lod];
+
+			// 局部空间包围盒
+			for (const auto& fh : lodMesh.mesh.faces())
+			{
+				auto& cluster = lodClusters[lodMesh.triangleClusterIndex[fh.idx()]];
+				for (auto fv_it = lodMesh.mesh.cfv_iter(fh); fv_it.is_valid(); ++fv_it)
+				{
+					const auto& p = lodMesh.mesh.point(*fv_it);
+					const glm::vec3 point(p[0], p[1], p[2]);
+					cluster.boundsMin = glm::min(cluster.boundsMin, point);
+					cluster.boundsMax = glm::max(cluster.boundsMax, point);
+				}
+			}
+
+			// 按cluster排好序的三角形里，每个cluster是连续的一段
+			const auto& sortedIndices = lodMesh.triangleIndicesSortedByClusterIdx;
+			for (size_t j = 0; j < sortedIndices.size(); ++j)
+			{
+				auto& cluster = lodClusters[lodMesh.triangleClusterIndex[sortedIndices[j]]];
+				const auto triangle = triangleOffset + static_cast<uint32_t>(j);
+				if (j == 0 || lodMesh.triangleClusterIndex[sortedIndices[j - 1]] != lodMesh.triangleClusterIndex[sortedIndices[j]])
+				{
+					cluster.triangleStart = triangle;
+				}
+				cluster.triangleEnd = triangle + 1;
+			}
+			triangleOffset += static_cast<uint32_t>(sortedIndices.size());
+
+			for (size_t j = 0; j < lodMesh.clusters.size(); ++j)
+			{
+				const auto& source = lodMesh.clusters[j];
+				auto& cluster = lodClusters[j];
+				NaniteAssert(source.triangleIndices.size() <= CLUSTER_THRESHOLD, "cluster.triangleIndices.size() is over threshold");
+				NaniteAssert(source.boundingSphereRadius > 0 || source.triangleIndices.empty(), "boundingSphereRadius <= 0");
+
+				cluster.sphere = glm::vec4(source.boundingSphereCenter, source.boundingSphereRadius);
+				cluster.error = static_cast<float>(source.normalizedlodError);
+				cluster.parentError = isLastLevel ? 1e5f : static_cast<float>(source.parentNormalizedError);
+				cluster.lodLevel = static_cast<uint32_t>(lod);
+				cluster.groupIndex = static_cast<uint32_t>(lodMesh.clusterGroupIndex[j]);
+				if (isLastLevel)
+				{
+					cluster.parentSphere = cluster.sphere;
+				}
+				else if (!source.parentClusterIndices.empty())
+				{
+					const auto& parent = meshes[lod + 1].clusters[source.parentClusterIndices.front()];
+					cluster.parentSphere = glm::vec4(parent.boundingSphereCenter, parent.boundingSphereRadius);
+				}
+			}
+		}
+
+		// 反序列化时只恢复了parentClusterIndices，这里从父指针反推子节点
+		std::vector<std::vector<uint32_t>> children(runtimeClusters.size());
+		for (size_t lod = 0; lod + 1 < meshes.size(); ++lod)
+		{
+			const auto& clusters = meshes[lod].clusters;
+			for (size_t j = 0; j < clusters.size(); ++j)
+			{
+				for (const auto parent : clusters[j].parentClusterIndices)
+				{
+					children[lodOffsets[lod + 1] + parent].emplace_back(lodOffsets[lod] + static_cast<uint32_t>(j));
+				}
+			}
+		}
+
+		dagChildRanges.reserve(children.size());
+		for (const auto& list : children)
+		{
+			dagChildRanges.emplace_back(static_cast<uint32_t>(dagChildIndices.size()), static_cast<uint32_t>(list.size()));
+			dagChildIndices.insert(dagChildIndices.end(), list.begin(), list.end());
+		}
+		dagRootFirst = meshes.empty() ? 0 : lodOffsets[meshes.size() - 1];
+		dagRootCount = meshes.empty() ? 0 : static_cast<uint32_t>(meshes.back().clusterNum);
+	}
+
+	void NaniteMesh::finalizeForRuntime()
+	{
+		NaniteAssert(!runtimeClusters.empty(), "NaniteMesh::finalizeForRuntime: runtime data not built");
+
+		// swap到空vector才会真正还给分配器
+		std::vector<NaniteLodMesh>().swap(meshes);
+		std::vector<NaniteLodMesh>().swap(debugMeshes);
+		std::vector<vkglTF::Vertex>().swap(sharedVertexBuffer);
+		std::vector<vkglTF::Vertex>().swap(vertexBuffer);
+		std::vector<uint32_t>().swap(indexBuffer);
+		std::vector<vkglTF::Primitive>().swap(primitives);
+		std::vector<ClusterNode>().swap(flattenedClusterNodes);
+		std::vector<BuildStageMemory>().swap(buildMemory);
+		runtimeClusters.shrink_to_fit();
+		dagChildRanges.shrink_to_fit();
+		dagChildIndices.shrink_to_fit();
+	}
+
+	size_t NaniteMesh::getRuntimeBytes() const
+	{
+		return runtimeClusters.capacity() * sizeof(RuntimeCluster)
+			+ dagChildRanges.capacity() * sizeof(glm::uvec2)
+			+ dagChildIndices.capacity() * sizeof(uint32_t);
+	}
+
+	void NaniteMesh::computeBounds()
+	{
+		boundsMin = glm::vec3(FLT_MAX);
+		boundsMax = glm::vec3(-FLT_MAX);
+
+		// 简化后的顶点可能略微偏移，所以取所有LOD的并集
+		for (const auto& lodMesh : meshes)
+		{
+			for (auto vh : lodMesh.mesh.vertices())
+			{
+				const auto& p = lodMesh.mesh.point(vh);
+				const glm::vec3 point(p[0], p[1], p[2]);
+				boundsMin = glm::min(boundsMin, point);
+				boundsMax = glm::max(boundsMax, point);
+			}
+		}
+		NaniteAssert(boundsMin.x <= boundsMax.x, "NaniteMesh::computeBounds: empty mesh");
+
+		const glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+		boundingSphere = glm::vec4(center, glm::length(boundsMax - center));
 	}
 
 	void NaniteMesh::checkDeserializationResult(const std::string& filepath)
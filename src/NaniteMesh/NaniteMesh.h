@@ -32,6 +32,8 @@ namespace Nanite
 		glm::mat4 modelMatrix;
 		std::vector<NaniteLodMesh> meshes;
 		OpenMesh::HPropHandleT<int32_t> clusterGroupIndexPropHandle;
+		// 顶点在sharedVertexBuffer里的下标，跟着顶点经过拷贝、简化和garbage_collection
+		OpenMesh::VPropHandleT<int32_t> sharedVertexIndexPropHandle;
 
 		const vkglTF::Model* vkglTFModel;
 		const vkglTF::Mesh* vkglTFMesh;
@@ -48,12 +50,72 @@ namespace Nanite
 		std::vector<ClusterNode> flattenedClusterNodes;
 		void flattenDAG();
 
+		// 烘焙时给每级cluster图着色，只有调试用的逐LOD顶点缓冲(NaniteLodMesh::initVertexBuffer)需要
+		bool colorClusterGraphs = false;
+		// 当前LOD数据里有没有着色结果，记在nanite_info.json里；需要着色而缓存没有时重新构建
+		bool hasClusterColors = false;
+
 		// 序列化
 		void generateNaniteInfo();
+		// 从已有的OpenMesh网格生成所有LOD，不需要glTF模型（性能测试用）
+		void generateNaniteInfo(NaniteTriMesh mymesh);
 		void serialize(const std::string& filepath);
 		void deserialize(const std::string& filepath);
 
 		void initNaniteInfo(const std::string& filepath, bool useCache = true);
+
+		// 最近一次构建里每级LOD各阶段结束时的内存
+		// Linux上peakRssBytes是这个阶段内的峰值，其他平台是从进程启动开始的峰值
+		struct BuildStageMemory
+		{
+			uint32_t lodLevel = 0;
+			std::string stage;
+			size_t rssBytes = 0;
+			size_t peakRssBytes = 0;
+		};
+		std::vector<BuildStageMemory> buildMemory;
+
+		// 整个mesh（所有LOD）的局部空间包围盒和包围球，实例级剔除用
+		glm::vec3 boundsMin = glm::vec3(FLT_MAX);
+		glm::vec3 boundsMax = glm::vec3(-FLT_MAX);
+		glm::vec4 boundingSphere = glm::vec4(0.0f);
+		void computeBounds();
+
+		// 所有LOD共用的去重顶点池，各级的sharedVertexIndices指向这里
+		std::vector<vkglTF::Vertex> sharedVertexBuffer;
+		void initSharedVertexBuffer();
+
+		// 运行时每个cluster只需要的数据，都在局部空间，实例重建cluster数据时按自己的变换算世界空间
+		struct RuntimeCluster
+		{
+			glm::vec3 boundsMin = glm::vec3(FLT_MAX);
+			// 在本mesh索引缓冲里的三角形范围
+			uint32_t triangleStart = 0;
+			glm::vec3 boundsMax = glm::vec3(-FLT_MAX);
+			uint32_t triangleEnd = 0;
+			glm::vec4 sphere = glm::vec4(0.0f);
+			// 最后一级LOD没有父级，实例按世界半径放大1.5倍
+			glm::vec4 parentSphere = glm::vec4(0.0f);
+			float error = 0.0f;
+			float parentError = 0.0f;
+			uint32_t lodLevel = 0;
+			uint32_t groupIndex = 0;
+		};
+		// 所有LOD的cluster按LOD0在前逐级排成一个数组，和实例的cluster下标一致
+		std::vector<RuntimeCluster> runtimeClusters;
+		// mesh内部的DAG，下标相对于第一个cluster；每个cluster的子节点在dagChildIndices里的范围(offset, count)
+		std::vector<glm::uvec2> dagChildRanges;
+		std::vector<uint32_t> dagChildIndices;
+		uint32_t dagRootFirst = 0;
+		uint32_t dagRootCount = 0;
+		// LOD0的索引数，所有实例都取LOD0时剔除输出的上限
+		uint64_t lod0IndexCount = 0;
+		// 从meshes里提取上面的紧凑数据，initNaniteInfo最后调用
+		void buildRuntimeData();
+		// 几何上传之后释放OpenMesh网格、逐cluster的vector和顶点池，只留运行时数据
+		void finalizeForRuntime();
+		[[nodiscard]] bool isFinalized() const { return meshes.empty() && !runtimeClusters.empty(); }
+		[[nodiscard]] size_t getRuntimeBytes() const;
 		vks::VulkanDevice* device;
 		const vkglTF::Model* model;
 		vkglTF::Model::Vertices vertices;
@@ -69,5 +131,14 @@ namespace Nanite
 		void checkDeserializationResult(const std::string& filepath);
 
 		bool operator==(const NaniteMesh& other) const;
+
+	private:
+		static constexpr uint32_t MAX_LOD_NUM = 6;
+
+		// 清空meshes并放好空的LOD0，LOD0的网格由调用方填进去
+		void beginLods();
+		// 在meshes里原地逐级构建，下一级从上一级拷贝后简化
+		void generateLods();
+		void recordBuildStage(uint32_t lodLevel, const char* stage);
 	};
 }
@@ -5,6 +5,7 @@
 
 #include <OpenMesh/Core/IO/MeshIO.hh>
 #include "../vksTools.h"
+#include "JobSystem.h"
 
 namespace Nanite
 {
@@ -12,10 +13,7 @@ namespace Nanite
     {
         return std::accumulate(naniteMeshes.begin(), naniteMeshes.end(), size_t{0},
             [](size_t sum, const NaniteMesh& mesh) {
-                return sum + std::accumulate(mesh.meshes.begin(), mesh.meshes.end(), size_t{0},
-                    [](size_t s, const NaniteLodMesh& lod) {
-                        return s + lod.uniqueVertexBuffer.size();
-                    });
+                return sum + mesh.sharedVertexBuffer.size();
             });
     }
 
@@ -30,10 +28,14 @@ namespace Nanite
             });
     }
 
-    ptrdiff_t NaniteScene::findMeshIndex(const NaniteMesh& mesh) const
+    ptrdiff_t NaniteScene::findMeshIndex(const NaniteMesh* mesh) const
     {
-        auto it = std::find(naniteMeshes.begin(), naniteMeshes.end(), mesh);
-        return (it != naniteMeshes.end()) ? std::distance(naniteMeshes.begin(), it) : -1;
+        // 实例直接引用naniteMeshes里的元素，按地址找下标
+        if (naniteMeshes.empty() || mesh < naniteMeshes.data() || mesh >= naniteMeshes.data() + naniteMeshes.size())
+        {
+            return -1;
+        }
+        return mesh - naniteMeshes.data();
     }
 
     void NaniteScene::createVertexIndexBuffer(VulkanExampleBase& link)
@@ -75,11 +77,11 @@ namespace Nanite
             indexOffset += static_cast<uint32_t>(instance.vertexBuffer.size());
         }
 
-        // 创建Vulkan缓冲区
+        // 创建Vulkan缓冲区，TRANSFER_SRC给软件光栅化校验读回用
         constexpr VkBufferUsageFlags vertexUsage = 
-            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
         constexpr VkBufferUsageFlags indexUsage = 
-            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
 
         const size_t vertexBufferSize = vertexBuffer.size() * sizeof(vkglTF::Vertex);
         vertices.count = static_cast<uint32_t>(vertexBuffer.size());
@@ -97,66 +99,133 @@ namespace Nanite
         sceneIndicesCount = 0;
         visibleIndicesCount = 0;
 
-        // 预计算总cluster数量以预分配容量
-        size_t totalClusterCount = 0;
-        for (const auto& obj : naniteObjects)
+        clusterInfo.clear();
+        packedClusters.clear();
+        instanceInfo.clear();
+        instanceInfo.reserve(naniteObjects.size());
+        maxInstanceClusterCount = 0;
+        dagChildRanges.clear();
+        dagChildIndices.clear();
+        dagRootRanges.clear();
+        dagRootRanges.reserve(naniteObjects.size());
+
+        // 场景索引缓冲里每个mesh只存一份，mesh的三角形偏移是前面所有mesh三角形数的前缀和
+        std::vector<uint32_t> meshTriangleOffsets(indexCounts.size(), 0);
+        for (size_t m = 1; m < indexCounts.size(); ++m)
         {
-            if (obj.referenceMesh != nullptr)
-            {
-                totalClusterCount += std::accumulate(
-                    obj.referenceMesh->meshes.begin(),
-                    obj.referenceMesh->meshes.end(),
-                    size_t{0},
-                    [](size_t sum, const NaniteLodMesh& mesh) {
-                        return sum + mesh.clusterNum;
-                    });
-            }
+            meshTriangleOffsets[m] = meshTriangleOffsets[m - 1] + indexCounts[m - 1] / 3;
         }
+        std::vector<uint32_t> triangleOffsets(naniteObjects.size(), 0);
 
-        clusterInfo.clear();
-        clusterInfo.reserve(totalClusterCount);
-        errorInfo.clear();
-        errorInfo.reserve(totalClusterCount);
-
+        // 第一遍串行：实例包围盒、cluster偏移和DAG，之后并行填cluster时每个实例只写自己的区间
+        uint32_t clusterOffset = 0;
         for (size_t i = 0; i < naniteObjects.size(); ++i)
         {
-            auto& naniteObject = naniteObjects[i];
-            naniteObject.buildClusterInfo();
+            const auto& naniteObject = naniteObjects[i];
+            const auto& mesh = *naniteObject.referenceMesh;
+            const ptrdiff_t meshIndex = findMeshIndex(naniteObject.referenceMesh);
+            const auto meshClusterCount = static_cast<uint32_t>(mesh.runtimeClusters.size());
 
-            const auto referenceMeshIndex = findMeshIndex(*naniteObject.referenceMesh);
-            
             // 计算索引偏移量
-            uint32_t triangleOffset = 0;
-            if (referenceMeshIndex > 0)
+            if (meshIndex > 0)
             {
-                triangleOffset = indexCounts[referenceMeshIndex - 1] / 3;
+                triangleOffsets[i] = meshTriangleOffsets[meshIndex];
             }
 
-            // 添加cluster信息
-            for (auto ci : naniteObject.clusterInfo)
+            // 实例包围盒：mesh局部包围盒的8个角点变换到世界空间
+            InstanceInfo info;
+            for (int corner = 0; corner < 8; ++corner)
             {
-                ci.triangleIndicesStart += triangleOffset;
-                ci.triangleIndicesEnd += triangleOffset;
-                ci.objectIdx = static_cast<int>(i);
-                clusterInfo.emplace_back(ci);
+                const glm::vec3 p((corner & 1) ? mesh.boundsMax.x : mesh.boundsMin.x,
+                    (corner & 2) ? mesh.boundsMax.y : mesh.boundsMin.y,
+                    (corner & 4) ? mesh.boundsMax.z : mesh.boundsMin.z);
+                const glm::vec3 pWorld = glm::vec3(naniteObject.rootTransform * glm::vec4(p, 1.0f));
+                info.pMinWorld = glm::min(info.pMinWorld, pWorld);
+                info.pMaxWorld = glm::max(info.pMaxWorld, pWorld);
             }
-
-            // 批量插入error信息
-            errorInfo.insert(errorInfo.end(),
-                naniteObject.errorInfo.begin(),
-                naniteObject.errorInfo.end());
+            info.clusterOffset = clusterOffset;
+            info.clusterCount = meshClusterCount;
+            maxInstanceClusterCount = std::max(maxInstanceClusterCount, info.clusterCount);
+            instanceInfo.emplace_back(info);
+            clusterOffset += meshClusterCount;
+
+            // mesh的DAG拓扑，偏移到全局cluster下标
+            const auto childIndexOffset = static_cast<uint32_t>(dagChildIndices.size());
+            for (const auto& range : mesh.dagChildRanges)
+            {
+                dagChildRanges.emplace_back(range.x + childIndexOffset, range.y);
+            }
+            for (const auto child : mesh.dagChildIndices)
+            {
+                dagChildIndices.emplace_back(child + info.clusterOffset);
+            }
+            dagRootRanges.emplace_back(info.clusterOffset + mesh.dagRootFirst, mesh.dagRootCount);
 
             // 累加计数
-            if (referenceMeshIndex >= 0)
+            if (meshIndex >= 0)
             {
-                sceneIndicesCount += indexCounts[referenceMeshIndex];
+                sceneIndicesCount += indexCounts[meshIndex];
             }
-            
-            if (!naniteObject.referenceMesh->meshes.empty())
+            visibleIndicesCount += mesh.lod0IndexCount;
+        }
+        clusterCount = clusterOffset;
+
+        // 第二遍并行：逐实例变换cluster包围盒和误差球，拷进场景数组并打包成剔除用的记录，之后释放实例上的副本
+        clusterInfo.resize(clusterOffset);
+        packedClusters.resize(clusterOffset);
+        vks::JobSystem::shared().parallelFor(static_cast<uint32_t>(naniteObjects.size()), INSTANCE_GRAIN_SIZE, [this, &triangleOffsets](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t i = begin; i < end; ++i)
             {
-                visibleIndicesCount += static_cast<uint32_t>(
-                    naniteObject.referenceMesh->meshes[0].triangleVertexIndicesSortedByClusterIdx.size());
+                auto& naniteObject = naniteObjects[i];
+                naniteObject.buildClusterInfo();
+
+                const auto offset = instanceInfo[i].clusterOffset;
+                for (size_t j = 0; j < naniteObject.clusterInfo.size(); ++j)
+                {
+                    auto ci = naniteObject.clusterInfo[j];
+                    ci.triangleIndicesStart += triangleOffsets[i];
+                    ci.triangleIndicesEnd += triangleOffsets[i];
+                    ci.objectIdx = i;
+                    clusterInfo[offset + j] = ci;
+                    packedClusters[offset + j] = PackedCluster::pack(ci, naniteObject.errorInfo[j]);
+                }
+
+                std::vector<ClusterInfo>().swap(naniteObject.clusterInfo);
+                std::vector<ErrorInfo>().swap(naniteObject.errorInfo);
             }
+        });
+    }
+
+    void NaniteScene::finalizeForRuntime()
+    {
+        for (auto& mesh : naniteMeshes)
+        {
+            mesh.finalizeForRuntime();
         }
+
+        // 这些数组都已经拷进GPU buffer，渲染循环只用clusterCount和naniteObjects.size()
+        std::vector<ClusterInfo>().swap(clusterInfo);
+        std::vector<PackedCluster>().swap(packedClusters);
+        std::vector<InstanceInfo>().swap(instanceInfo);
+        std::vector<glm::uvec2>().swap(dagChildRanges);
+        std::vector<uint32_t>().swap(dagChildIndices);
+        std::vector<glm::uvec2>().swap(dagRootRanges);
+        naniteObjects.shrink_to_fit();
+    }
+
+    size_t NaniteScene::getClusterDataBytes() const
+    {
+        const size_t meshBytes = std::accumulate(naniteMeshes.begin(), naniteMeshes.end(), size_t{0},
+            [](size_t sum, const NaniteMesh& mesh) {
+                return sum + mesh.getRuntimeBytes();
+            });
+        return meshBytes + clusterInfo.capacity() * sizeof(ClusterInfo)
+            + packedClusters.capacity() * sizeof(PackedCluster)
+            + instanceInfo.capacity() * sizeof(InstanceInfo)
+            + dagChildRanges.capacity() * sizeof(glm::uvec2)
+            + dagChildIndices.capacity() * sizeof(uint32_t)
+            + dagRootRanges.capacity() * sizeof(glm::uvec2)
+            + naniteObjects.capacity() * sizeof(NaniteInstance);
     }
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include "Const.h"
 #include "NaniteInstance.h"
 #include "NaniteMesh.h"
+#include "PackedCluster.h"
 #include "VulkanglTFModel.h"
 
 namespace vks
@@ -28,18 +29,41 @@ namespace Nanite
 		std::vector<uint32_t> indexOffsets;
 		std::vector<uint32_t> indexCounts;
 
+		// 光栅化阶段按cluster下标读，只有被选中的cluster会访问
 		std::vector<ClusterInfo> clusterInfo;
-		std::vector<ErrorInfo> errorInfo;
+		// 剔除阶段每帧对所有候选cluster读一遍，和clusterInfo下标一一对应
+		std::vector<PackedCluster> packedClusters;
+		std::vector<InstanceInfo> instanceInfo;
+		uint32_t maxInstanceClusterCount = 0;
+		// finalizeForRuntime释放上面的数组之后，渲染循环和界面只用计数
+		uint32_t clusterCount = 0;
 
-		uint32_t sceneIndicesCount = 0;
-		uint32_t visibleIndicesCount = 0;
+		// GPU DAG遍历用，下标都是全局cluster下标
+		// 每个cluster的子节点在dagChildIndices里的范围(offset, count)
+		std::vector<glm::uvec2> dagChildRanges;
+		std::vector<uint32_t> dagChildIndices;
+		// 每个实例的根节点(最粗一级LOD)范围(firstCluster, count)
+		std::vector<glm::uvec2> dagRootRanges;
+
+		// 实例数很多时会超过32位
+		uint64_t sceneIndicesCount = 0;
+		// 所有实例都取LOD0时的索引数，剔除输出buffer的上限
+		uint64_t visibleIndicesCount = 0;
 
 		void createVertexIndexBuffer(VulkanExampleBase& link);
+		// 实例的cluster数据在JobSystem上并行构建，可以反复调用
 		void createClusterInfos();
+		// 场景buffer上传完之后调用：mesh只留运行时数据，上面的cluster、实例和DAG数组也释放
+		// 之后createClusterInfos仍然可用（stress模式每帧重建）
+		void finalizeForRuntime();
+		// CPU端cluster、误差、实例和DAG数组以及mesh运行时数据占用的字节数
+		[[nodiscard]] size_t getClusterDataBytes() const;
 
 	private:
+		static constexpr uint32_t INSTANCE_GRAIN_SIZE = 4;
+
 		[[nodiscard]] size_t calculateTotalVertexCount() const;
 		[[nodiscard]] size_t calculateTotalIndexCount() const;
-		[[nodiscard]] ptrdiff_t findMeshIndex(const NaniteMesh& mesh) const;
+		[[nodiscard]] ptrdiff_t findMeshIndex(const NaniteMesh* mesh) const;
 	};
 }
\ No newline at end of file
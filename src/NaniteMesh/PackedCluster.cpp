@@ -0,0 +1,150 @@
+#include "PackedCluster.h"
+
+#include <algorithm>
+
+#include <glm/gtc/packing.hpp>
+
+namespace Nanite
+{
+	namespace
+	{
+		constexpr float HALF_MAX = 65504.0f;
+		constexpr uint16_t HALF_MAX_BITS = 0x7BFF;
+
+		// 非负值转fp16并向上取整，包围盒和半径量化后只会变大，剔除保持保守
+		uint16_t packHalfCeil(float value)
+		{
+			const float clamped = std::clamp(value, 0.0f, HALF_MAX);
+			uint16_t bits = glm::packHalf1x16(clamped);
+			if (glm::unpackHalf1x16(bits) < clamped && bits < HALF_MAX_BITS)
+			{
+				++bits;
+			}
+			return bits;
+		}
+
+		// 误差只要求父子两边量化结果一致，就近取整；最后一级的父级误差是1e5，超出fp16范围，截到最大值
+		uint16_t packHalfNearest(float value)
+		{
+			return glm::packHalf1x16(std::clamp(value, 0.0f, HALF_MAX));
+		}
+
+		uint32_t packHalfPair(uint16_t low, uint16_t high)
+		{
+			return static_cast<uint32_t>(low) | (static_cast<uint32_t>(high) << 16);
+		}
+
+		float unpackLow(uint32_t packed)
+		{
+			return glm::unpackHalf1x16(static_cast<uint16_t>(packed & PackedCluster::HALF_MASK));
+		}
+
+		float unpackHigh(uint32_t packed)
+		{
+			return glm::unpackHalf1x16(static_cast<uint16_t>(packed >> 16));
+		}
+	}
+
+	bool PackedCluster::fits(const ClusterInfo& cluster)
+	{
+		return cluster.triangleIndicesEnd - cluster.triangleIndicesStart <= BYTE_MASK && cluster.lodLevel <= BYTE_MASK;
+	}
+
+	PackedCluster PackedCluster::pack(const ClusterInfo& cluster, const ErrorInfo& error)
+	{
+		PackedCluster packed;
+		packed.center = glm::vec3(error.centerR);
+		packed.radii = packHalfPair(packHalfCeil(error.centerR.w), packHalfCeil(error.centerRP.w));
+		packed.parentCenter = glm::vec3(error.centerRP);
+		packed.errors = packHalfPair(packHalfNearest(error.errorWorld.x), packHalfNearest(error.errorWorld.y));
+		packed.triangleStart = cluster.triangleIndicesStart;
+		packed.instanceIdx = cluster.objectIdx;
+
+		// 以包围球中心为中心包住原来的AABB
+		const glm::vec3 extent = glm::max(cluster.pMaxWorld - packed.center, packed.center - cluster.pMinWorld);
+		packed.extentXY = packHalfPair(packHalfCeil(extent.x), packHalfCeil(extent.y));
+		const uint32_t triangleCount = std::min(cluster.triangleIndicesEnd - cluster.triangleIndicesStart, BYTE_MASK);
+		const uint32_t lodLevel = std::min(cluster.lodLevel, BYTE_MASK);
+		packed.extentZCountLod = packHalfCeil(extent.z) | (triangleCount << TRIANGLE_COUNT_SHIFT) | (lodLevel << LOD_LEVEL_SHIFT);
+		return packed;
+	}
+
+	float PackedCluster::getRadius() const
+	{
+		return unpackLow(radii);
+	}
+
+	float PackedCluster::getParentRadius() const
+	{
+		return unpackHigh(radii);
+	}
+
+	float PackedCluster::getError() const
+	{
+		return unpackLow(errors);
+	}
+
+	float PackedCluster::getParentError() const
+	{
+		return unpackHigh(errors);
+	}
+
+	glm::vec3 PackedCluster::getExtent() const
+	{
+		return glm::vec3(unpackLow(extentXY), unpackHigh(extentXY), unpackLow(extentZCountLod));
+	}
+
+	void PackedClusterSoA::assign(const std::vector<PackedCluster>& clusters)
+	{
+		clear();
+		const size_t count = clusters.size();
+		for (auto* column : {&centerX, &centerY, &centerZ, &radius, &parentCenterX, &parentCenterY, &parentCenterZ, &parentRadius, &error, &parentError, &extentX, &extentY, &extentZ})
+		{
+			column->resize(count);
+		}
+		triangleStart.resize(count);
+		instanceIdx.resize(count);
+		triangleCount.resize(count);
+		lodLevel.resize(count);
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			const auto& cluster = clusters[i];
+			const glm::vec3 extent = cluster.getExtent();
+			centerX[i] = cluster.center.x;
+			centerY[i] = cluster.center.y;
+			centerZ[i] = cluster.center.z;
+			radius[i] = cluster.getRadius();
+			parentCenterX[i] = cluster.parentCenter.x;
+			parentCenterY[i] = cluster.parentCenter.y;
+			parentCenterZ[i] = cluster.parentCenter.z;
+			parentRadius[i] = cluster.getParentRadius();
+			error[i] = cluster.getError();
+			parentError[i] = cluster.getParentError();
+			extentX[i] = extent.x;
+			extentY[i] = extent.y;
+			extentZ[i] = extent.z;
+			triangleStart[i] = cluster.triangleStart;
+			instanceIdx[i] = cluster.instanceIdx;
+			triangleCount[i] = static_cast<uint8_t>(cluster.getTriangleCount());
+			lodLevel[i] = static_cast<uint8_t>(cluster.getLodLevel());
+		}
+	}
+
+	void PackedClusterSoA::clear()
+	{
+		for (auto* column : {&centerX, &centerY, &centerZ, &radius, &parentCenterX, &parentCenterY, &parentCenterZ, &parentRadius, &error, &parentError, &extentX, &extentY, &extentZ})
+		{
+			column->clear();
+		}
+		triangleStart.clear();
+		instanceIdx.clear();
+		triangleCount.clear();
+		lodLevel.clear();
+	}
+
+	size_t PackedClusterSoA::getBytes() const
+	{
+		return size() * (13 * sizeof(float) + 2 * sizeof(uint32_t) + 2 * sizeof(uint8_t));
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Const.h"
+#include "glm/glm.hpp"
+
+namespace Nanite
+{
+	/**
+	* @brief 剔除阶段用的紧凑cluster记录，合并了ClusterInfo和ErrorInfo里剔除需要的字段，48字节
+	* @note 与culling.comp、dagTraversal.comp、nanite.task里的PackedCluster一致，std430下是三个16字节对齐的行
+	* 包围球中心保持fp32(大场景里世界坐标很大)，半径、误差和包围盒半长用fp16，包围盒以包围球中心为中心
+	*/
+	struct PackedCluster
+	{
+		static constexpr uint32_t TRIANGLE_COUNT_SHIFT = 16;
+		static constexpr uint32_t LOD_LEVEL_SHIFT = 24;
+		static constexpr uint32_t BYTE_MASK = 0xFFu;
+		static constexpr uint32_t HALF_MASK = 0xFFFFu;
+
+		// xyz包围球中心，w是packHalf2x16(半径, 父级半径)
+		glm::vec3 center{0.0f};
+		uint32_t radii = 0;
+		// xyz父级包围球中心，w是packHalf2x16(误差, 父级误差)
+		glm::vec3 parentCenter{0.0f};
+		uint32_t errors = 0;
+		uint32_t triangleStart = 0;
+		uint32_t instanceIdx = 0;
+		// packHalf2x16(包围盒半长x, 半长y)
+		uint32_t extentXY = 0;
+		// 低16位包围盒半长z(fp16)，16-23位三角形数，24-31位LOD层级
+		uint32_t extentZCountLod = 0;
+
+		// 一个cluster的三角形数和LOD层级各占8位
+		[[nodiscard]] static bool fits(const ClusterInfo& cluster);
+		[[nodiscard]] static PackedCluster pack(const ClusterInfo& cluster, const ErrorInfo& error);
+
+		[[nodiscard]] float getRadius() const;
+		[[nodiscard]] float getParentRadius() const;
+		[[nodiscard]] float getError() const;
+		[[nodiscard]] float getParentError() const;
+		[[nodiscard]] glm::vec3 getExtent() const;
+		[[nodiscard]] uint32_t getTriangleCount() const { return (extentZCountLod >> TRIANGLE_COUNT_SHIFT) & BYTE_MASK; }
+		[[nodiscard]] uint32_t getLodLevel() const { return (extentZCountLod >> LOD_LEVEL_SHIFT) & BYTE_MASK; }
+	};
+
+	// std430布局检查，改字段时shader里的定义也要一起改
+	static_assert(sizeof(PackedCluster) == 48, "PackedCluster must match the std430 layout in the culling shaders");
+	static_assert(offsetof(PackedCluster, radii) == 12, "PackedCluster::radii must be the w component of row 0");
+	static_assert(offsetof(PackedCluster, parentCenter) == 16, "PackedCluster::parentCenter must start row 1");
+	static_assert(offsetof(PackedCluster, errors) == 28, "PackedCluster::errors must be the w component of row 1");
+	static_assert(offsetof(PackedCluster, triangleStart) == 32, "PackedCluster::triangleStart must start row 2");
+	static_assert(offsetof(PackedCluster, extentZCountLod) == 44, "PackedCluster::extentZCountLod must end row 2");
+
+	/**
+	* @brief 同样的字段按数组分开存，CPU上逐字段连续读，适合SIMD批量剔除
+	* @note 从PackedCluster解出来，量化误差和GPU上看到的一致
+	*/
+	struct PackedClusterSoA
+	{
+		std::vector<float> centerX, centerY, centerZ, radius;
+		std::vector<float> parentCenterX, parentCenterY, parentCenterZ, parentRadius;
+		std::vector<float> error, parentError;
+		std::vector<float> extentX, extentY, extentZ;
+		std::vector<uint32_t> triangleStart, instanceIdx;
+		std::vector<uint8_t> triangleCount, lodLevel;
+
+		void assign(const std::vector<PackedCluster>& clusters);
+		void clear();
+		[[nodiscard]] size_t size() const { return centerX.size(); }
+		[[nodiscard]] size_t getBytes() const;
+	};
+}
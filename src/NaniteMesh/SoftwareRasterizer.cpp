@@ -0,0 +1,162 @@
+#include "SoftwareRasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace Nanite
+{
+	namespace
+	{
+		float edgeFunction(const glm::vec2& a, const glm::vec2& b, const glm::vec2& p)
+		{
+			return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+		}
+
+		uint32_t floatBits(float value)
+		{
+			uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			return bits;
+		}
+
+		float bitsToFloat(uint32_t bits)
+		{
+			float value;
+			std::memcpy(&value, &bits, sizeof(value));
+			return value;
+		}
+	}
+
+	SoftwareRasterizer::SoftwareRasterizer(uint32_t width, uint32_t height) : width(width), height(height), visibility(static_cast<size_t>(width) * height, EMPTY)
+	{
+	}
+
+	void SoftwareRasterizer::clear()
+	{
+		std::fill(visibility.begin(), visibility.end(), EMPTY);
+	}
+
+	uint32_t SoftwareRasterizer::rasterizeCluster(const ClusterInfo& cluster, uint32_t clusterIndex, const std::vector<uint32_t>& indices, const float* vertices, uint32_t vertexStride, const glm::mat4& mvp)
+	{
+		auto fetchClipPos = [&](uint32_t vertexIndex)
+		{
+			const float* position = vertices + static_cast<size_t>(vertexIndex) * vertexStride;
+			return mvp * glm::vec4(position[0], position[1], position[2], 1.0f);
+		};
+
+		uint32_t rasterized = 0;
+		const uint32_t triangleCount = cluster.triangleIndicesEnd - cluster.triangleIndicesStart;
+		for (uint32_t triangle = 0; triangle < triangleCount; ++triangle)
+		{
+			const size_t inIndex = static_cast<size_t>(cluster.triangleIndicesStart + triangle) * 3;
+			const uint32_t payload = (clusterIndex << TRIANGLE_BITS) | triangle;
+			if (rasterizeTriangle(fetchClipPos(indices[inIndex + 0]), fetchClipPos(indices[inIndex + 1]), fetchClipPos(indices[inIndex + 2]), payload))
+			{
+				++rasterized;
+			}
+		}
+		return rasterized;
+	}
+
+	bool SoftwareRasterizer::rasterizeTriangle(const glm::vec4& c0, const glm::vec4& c1, const glm::vec4& c2, uint32_t payload)
+	{
+		if (c0.w <= 0.0f || c1.w <= 0.0f || c2.w <= 0.0f)
+			return false;
+
+		const glm::vec2 screenSize(static_cast<float>(width), static_cast<float>(height));
+		const glm::vec3 n0 = glm::vec3(c0) / c0.w;
+		const glm::vec3 n1 = glm::vec3(c1) / c1.w;
+		const glm::vec3 n2 = glm::vec3(c2) / c2.w;
+		const glm::vec2 p0 = (glm::vec2(n0) * 0.5f + 0.5f) * screenSize;
+		const glm::vec2 p1 = (glm::vec2(n1) * 0.5f + 0.5f) * screenSize;
+		const glm::vec2 p2 = (glm::vec2(n2) * 0.5f + 0.5f) * screenSize;
+
+		// 正面的edgeFunction为负，见swRaster.comp
+		const float area2 = edgeFunction(p0, p1, p2);
+		if (area2 >= 0.0f)
+			return false;
+
+		const glm::vec2 bbMin = glm::max(glm::ceil(glm::min(p0, glm::min(p1, p2)) - 0.5f), glm::vec2(0.0f));
+		const glm::vec2 bbMax = glm::min(glm::floor(glm::max(p0, glm::max(p1, p2)) - 0.5f), screenSize - 1.0f);
+		if (bbMin.x > bbMax.x || bbMin.y > bbMax.y)
+			return false;
+
+		for (float y = bbMin.y; y <= bbMax.y; y += 1.0f)
+		{
+			for (float x = bbMin.x; x <= bbMax.x; x += 1.0f)
+			{
+				const glm::vec2 p = glm::vec2(x, y) + 0.5f;
+				const float w0 = edgeFunction(p1, p2, p);
+				const float w1 = edgeFunction(p2, p0, p);
+				const float w2 = edgeFunction(p0, p1, p);
+				if (w0 > 0.0f || w1 > 0.0f || w2 > 0.0f)
+					continue;
+
+				const float depth = (w0 * n0.z + w1 * n1.z + w2 * n2.z) / area2;
+				if (depth < 0.0f || depth > 1.0f)
+					continue;
+
+				const uint64_t key = (static_cast<uint64_t>(floatBits(depth)) << 32) | payload;
+				uint64_t& texel = visibility[static_cast<size_t>(y) * width + static_cast<size_t>(x)];
+				texel = std::min(texel, key);
+			}
+		}
+		return true;
+	}
+
+	size_t SoftwareRasterizer::countMismatches(const std::vector<uint64_t>& lhs, const std::vector<uint64_t>& rhs)
+	{
+		const size_t count = std::min(lhs.size(), rhs.size());
+		size_t mismatches = std::max(lhs.size(), rhs.size()) - count;
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (lhs[i] != rhs[i])
+				++mismatches;
+		}
+		return mismatches;
+	}
+
+	bool SoftwareRasterizer::writeDepthPGM(const std::string& path) const
+	{
+		return writeDepthPGM(path, visibility, width, height);
+	}
+
+	bool SoftwareRasterizer::writeDepthPGM(const std::string& path, const std::vector<uint64_t>& visibility, uint32_t width, uint32_t height)
+	{
+		if (visibility.size() < static_cast<size_t>(width) * height)
+		{
+			std::cerr << "Visibility buffer is smaller than " << width << "x" << height << std::endl;
+			return false;
+		}
+
+		std::ofstream file(path, std::ios::binary);
+		if (!file)
+		{
+			std::cerr << "Failed to open " << path << std::endl;
+			return false;
+		}
+
+		file << "P5\n" << width << " " << height << "\n255\n";
+		std::vector<uint8_t> row(width);
+		// framebuffer的y向下，PGM也是从上到下，直接按行写
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				const uint64_t texel = visibility[static_cast<size_t>(y) * width + x];
+				if (texel == EMPTY)
+				{
+					row[x] = 0;
+					continue;
+				}
+				const float depth = bitsToFloat(static_cast<uint32_t>(texel >> 32));
+				row[x] = static_cast<uint8_t>(std::lround((1.0f - std::clamp(depth, 0.0f, 1.0f)) * 255.0f));
+			}
+			file.write(reinterpret_cast<const char*>(row.data()), row.size());
+		}
+		return static_cast<bool>(file);
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "glm/glm.hpp"
+
+#include "Const.h"
+
+namespace Nanite
+{
+	// swRaster.comp的CPU参考实现，规则完全一致，用来和GPU读回的visibility buffer逐像素对比
+	class SoftwareRasterizer
+	{
+	public:
+		// 与swRaster.comp保持一致
+		static constexpr uint32_t TRIANGLE_BITS = 7;
+		static constexpr uint64_t EMPTY = ~0ull;
+
+		SoftwareRasterizer(uint32_t width, uint32_t height);
+
+		void clear();
+
+		// vertices按vkglTF::Vertex的float布局，position在最前面；返回光栅化了的三角形数
+		uint32_t rasterizeCluster(const ClusterInfo& cluster, uint32_t clusterIndex, const std::vector<uint32_t>& indices, const float* vertices, uint32_t vertexStride, const glm::mat4& mvp);
+
+		[[nodiscard]] const std::vector<uint64_t>& getVisibility() const { return visibility; }
+		[[nodiscard]] uint32_t getWidth() const { return width; }
+		[[nodiscard]] uint32_t getHeight() const { return height; }
+
+		// 深度或payload不同的像素数
+		[[nodiscard]] static size_t countMismatches(const std::vector<uint64_t>& lhs, const std::vector<uint64_t>& rhs);
+
+		// 深度导出成8位PGM，空像素为黑，方便和GPU结果做图像diff
+		bool writeDepthPGM(const std::string& path) const;
+		// GPU读回的visibility buffer用同样的格式导出
+		static bool writeDepthPGM(const std::string& path, const std::vector<uint64_t>& visibility, uint32_t width, uint32_t height);
+
+	private:
+		bool rasterizeTriangle(const glm::vec4& c0, const glm::vec4& c1, const glm::vec4& c2, uint32_t payload);
+
+		uint32_t width;
+		uint32_t height;
+		std::vector<uint64_t> visibility;
+	};
+}
@@ -0,0 +1,175 @@
+#include "SphericalHarmonics.h"
+
+#include <cmath>
+#include <string>
+
+#include "utils.h"
+
+namespace vks
+{
+	namespace
+	{
+		constexpr float PI = 3.14159265358979323846f;
+
+		// 从面中心到(x,y)这块矩形在单位立方体面上对应的立体角
+		float areaElement(float x, float y)
+		{
+			return std::atan2(x * y, std::sqrt(x * x + y * y + 1.0f));
+		}
+	}
+
+	glm::vec3 SphericalHarmonics9::cubemapDirection(uint32_t face, float u, float v)
+	{
+		glm::vec3 direction;
+		switch (face)
+		{
+		case 0:
+			direction = glm::vec3(1.0f, -v, -u);
+			break;
+		case 1:
+			direction = glm::vec3(-1.0f, -v, u);
+			break;
+		case 2:
+			direction = glm::vec3(u, 1.0f, v);
+			break;
+		case 3:
+			direction = glm::vec3(u, -1.0f, -v);
+			break;
+		case 4:
+			direction = glm::vec3(u, -v, 1.0f);
+			break;
+		default:
+			direction = glm::vec3(-u, -v, -1.0f);
+			break;
+		}
+		return glm::normalize(direction);
+	}
+
+	std::array<float, SphericalHarmonics9::COEFFICIENT_COUNT> SphericalHarmonics9::evaluateBasis(const glm::vec3& direction)
+	{
+		const float x = direction.x;
+		const float y = direction.y;
+		const float z = direction.z;
+		return {
+			0.282095f,
+			0.488603f * y,
+			0.488603f * z,
+			0.488603f * x,
+			1.092548f * x * y,
+			1.092548f * y * z,
+			0.315392f * (3.0f * z * z - 1.0f),
+			1.092548f * x * z,
+			0.546274f * (x * x - y * y),
+		};
+	}
+
+	SphericalHarmonics9 SphericalHarmonics9::projectCubemap(uint32_t size, const CubemapTexelFunc& texel)
+	{
+		SphericalHarmonics9 result;
+		const float invSize = 1.0f / static_cast<float>(size);
+		float totalWeight = 0.0f;
+
+		for (uint32_t face = 0; face < 6; face++)
+		{
+			for (uint32_t y = 0; y < size; y++)
+			{
+				const float v0 = 2.0f * static_cast<float>(y) * invSize - 1.0f;
+				const float v1 = v0 + 2.0f * invSize;
+				for (uint32_t x = 0; x < size; x++)
+				{
+					const float u0 = 2.0f * static_cast<float>(x) * invSize - 1.0f;
+					const float u1 = u0 + 2.0f * invSize;
+					const float weight = areaElement(u0, v0) - areaElement(u0, v1) - areaElement(u1, v0) + areaElement(u1, v1);
+
+					const glm::vec3 direction = cubemapDirection(face, 0.5f * (u0 + u1), 0.5f * (v0 + v1));
+					const glm::vec3 radiance = texel(face, x, y) * weight;
+					const auto basis = evaluateBasis(direction);
+					for (uint32_t i = 0; i < COEFFICIENT_COUNT; i++)
+					{
+						result.coefficients[i] += radiance * basis[i];
+					}
+					totalWeight += weight;
+				}
+			}
+		}
+
+		const float normalization = 4.0f * PI / totalWeight;
+		for (auto& coefficient : result.coefficients)
+		{
+			coefficient *= normalization;
+		}
+		return result;
+	}
+
+	SphericalHarmonics9 SphericalHarmonics9::convolveLambert() const
+	{
+		// 余弦瓣各阶的卷积系数A_l = π, 2π/3, π/4，再除以π
+		constexpr float bandFactors[3] = {1.0f, 2.0f / 3.0f, 0.25f};
+		constexpr uint32_t coefficientBands[COEFFICIENT_COUNT] = {0, 1, 1, 1, 2, 2, 2, 2, 2};
+
+		SphericalHarmonics9 result;
+		for (uint32_t i = 0; i < COEFFICIENT_COUNT; i++)
+		{
+			result.coefficients[i] = coefficients[i] * bandFactors[coefficientBands[i]];
+		}
+		return result;
+	}
+
+	glm::vec3 SphericalHarmonics9::evaluate(const glm::vec3& direction) const
+	{
+		const auto basis = evaluateBasis(direction);
+		glm::vec3 result(0.0f);
+		for (uint32_t i = 0; i < COEFFICIENT_COUNT; i++)
+		{
+			result += coefficients[i] * basis[i];
+		}
+		return result;
+	}
+
+	void SphericalHarmonics9::runSelfTest()
+	{
+		constexpr uint32_t size = 32;
+		const glm::vec3 testDirections[] = {
+			glm::vec3(0.0f, 0.0f, 1.0f),
+			glm::vec3(0.0f, 0.0f, -1.0f),
+			glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f)),
+			glm::normalize(glm::vec3(-0.3f, 0.8f, 0.5f)),
+		};
+		auto nearlyEqual = [](const glm::vec3& a, const glm::vec3& b, float tolerance)
+		{
+			return glm::all(glm::lessThanEqual(glm::abs(a - b), glm::vec3(tolerance)));
+		};
+
+		// 常数radiance L=1，irradiance/π处处为1
+		const SphericalHarmonics9 constant = projectCubemap(size, [](uint32_t, uint32_t, uint32_t) { return glm::vec3(1.0f); }).convolveLambert();
+		for (const auto& direction : testDirections)
+		{
+			Nanite::TEST(nearlyEqual(constant.evaluate(direction), glm::vec3(1.0f), 1e-3f), "SH constant radiance");
+		}
+
+		// L = 1 + 0.5 * ω.z，余弦卷积后irradiance/π = 1 + (2/3) * 0.5 * n.z
+		const SphericalHarmonics9 linear = projectCubemap(size, [invSize = 1.0f / size](uint32_t face, uint32_t x, uint32_t y)
+		{
+			const glm::vec3 direction = cubemapDirection(face, (2.0f * x + 1.0f) * invSize - 1.0f, (2.0f * y + 1.0f) * invSize - 1.0f);
+			return glm::vec3(1.0f + 0.5f * direction.z);
+		}).convolveLambert();
+		for (const auto& direction : testDirections)
+		{
+			Nanite::TEST(nearlyEqual(linear.evaluate(direction), glm::vec3(1.0f + direction.z / 3.0f), 1e-2f), "SH linear radiance");
+		}
+
+		// 基函数正交归一，投影第i个基函数只得到第i个系数
+		for (uint32_t i = 0; i < COEFFICIENT_COUNT; i++)
+		{
+			const SphericalHarmonics9 basis = projectCubemap(size, [i, invSize = 1.0f / size](uint32_t face, uint32_t x, uint32_t y)
+			{
+				const glm::vec3 direction = cubemapDirection(face, (2.0f * x + 1.0f) * invSize - 1.0f, (2.0f * y + 1.0f) * invSize - 1.0f);
+				return glm::vec3(evaluateBasis(direction)[i]);
+			});
+			for (uint32_t j = 0; j < COEFFICIENT_COUNT; j++)
+			{
+				Nanite::TEST(std::abs(basis.coefficients[j].x - (i == j ? 1.0f : 0.0f)) < 1e-2f, "SH basis orthonormal " + std::to_string(i) + "/" + std::to_string(j));
+			}
+		}
+	}
+}
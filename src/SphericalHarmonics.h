@@ -0,0 +1,35 @@
+#pragma once
+#include <array>
+#include <functional>
+
+#include <glm/glm.hpp>
+
+namespace vks
+{
+	/**
+	* @brief 三阶(9个系数)实球谐，每个系数一个RGB，用来代替irradiance cubemap
+	* @note 系数顺序 (l,m) = (0,0) (1,-1) (1,0) (1,1) (2,-2) (2,-1) (2,0) (2,1) (2,2)
+	*/
+	struct SphericalHarmonics9
+	{
+		static constexpr uint32_t COEFFICIENT_COUNT = 9;
+
+		std::array<glm::vec3, COEFFICIENT_COUNT> coefficients{};
+
+		// 返回texel中心的radiance，face按Vulkan cubemap的+X,-X,+Y,-Y,+Z,-Z排列
+		using CubemapTexelFunc = std::function<glm::vec3(uint32_t face, uint32_t x, uint32_t y)>;
+
+		// 按texel立体角加权投影，权重总和归一化到4π抵消离散误差
+		[[nodiscard]] static SphericalHarmonics9 projectCubemap(uint32_t size, const CubemapTexelFunc& texel);
+		// 乘以余弦瓣的卷积系数再除以π，之后evaluate直接得到漫反射用的irradiance/π
+		[[nodiscard]] SphericalHarmonics9 convolveLambert() const;
+		[[nodiscard]] glm::vec3 evaluate(const glm::vec3& direction) const;
+
+		[[nodiscard]] static std::array<float, COEFFICIENT_COUNT> evaluateBasis(const glm::vec3& direction);
+		// u,v在[-1,1]，和GPU采样cubemap时的面坐标约定一致
+		[[nodiscard]] static glm::vec3 cubemapDirection(uint32_t face, float u, float v);
+
+		// 用解析结果校验投影和卷积，失败直接abort
+		static void runSelfTest();
+	};
+}
@@ -2,8 +2,78 @@
 
 #include <glm/detail/func_common.hpp>
 
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <fstream>
+#include <string>
+#include <sys/resource.h>
+#endif
+
 void Nanite::getTriangleAABB(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, glm::vec3& pMin, glm::vec3& pMax)
 {
 	pMin = glm::min(p0, glm::min(p1, p2));
 	pMax = glm::max(p0, glm::max(p1, p2));
 }
+
+#if !defined(_WIN32)
+namespace
+{
+	// /proc/self/status里的"VmRSS:  1234 kB"这类字段
+	size_t readProcStatusKB(const std::string& key)
+	{
+		std::ifstream status("/proc/self/status");
+		std::string line;
+		while (std::getline(status, line))
+		{
+			if (line.compare(0, key.size(), key) == 0)
+			{
+				return std::stoull(line.substr(key.size())) * 1024;
+			}
+		}
+		return 0;
+	}
+}
+#endif
+
+size_t Nanite::getCurrentRSS()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters{};
+	return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.WorkingSetSize : 0;
+#else
+	return readProcStatusKB("VmRSS:");
+#endif
+}
+
+size_t Nanite::getPeakRSS()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters{};
+	return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.PeakWorkingSetSize : 0;
+#else
+	if (const size_t peak = readProcStatusKB("VmHWM:"); peak != 0)
+	{
+		return peak;
+	}
+	// 没有procfs(macOS)时用getrusage，macOS上单位是字节
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+	return static_cast<size_t>(usage.ru_maxrss);
+#else
+	return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+void Nanite::resetPeakRSS()
+{
+#if defined(__linux__)
+	// 写5到clear_refs会把VmHWM重置成当前RSS(Linux 4.0+)
+	std::ofstream clearRefs("/proc/self/clear_refs");
+	clearRefs << "5";
+#endif
+}
@@ -25,6 +25,12 @@ namespace Nanite
 
 	void getTriangleAABB(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, glm::vec3& pMin, glm::vec3& pMax);
 
+	// 进程常驻内存(字节)，取不到时返回0
+	[[nodiscard]] size_t getCurrentRSS();
+	[[nodiscard]] size_t getPeakRSS();
+	// 把峰值重置成当前值，之后的getPeakRSS就是这一段的峰值；只有Linux支持，其他平台峰值从进程启动开始算
+	void resetPeakRSS();
+
 	inline void TEST(bool condition, std::string_view message, const std::source_location& loc = std::source_location::current())
 	{
 		if (!condition)
@@ -1,5 +1,12 @@
 ﻿#include "vksTools.h"
 
+#include <array>
+#include <filesystem>
+#include <type_traits>
+
+#include <glm/gtc/packing.hpp>
+
+#include "SphericalHarmonics.h"
 #include "VulkanDescriptorManager.h"
 #include "vulkanexamplebase.h"
 #include "../examples/pbrtexture/pbrTexture.h"
@@ -7,82 +14,324 @@
 
 namespace vks
 {
-	void vksTools::createStagingBuffer(VulkanExampleBase& variableLink, VkBufferUsageFlags sorceMemoryProperty, VkDeviceSize srcBufferSize, void* srcBufferData, VkBufferUsageFlags targetMemoryProperty, vkglTF::Model::Vertices& targetStaingBuffer, bool cmdRestart)
+	namespace
 	{
-		struct StagingBuffer
+		// IBL生成参数，generate*和缓存key共用
+		constexpr VkFormat BRDF_LUT_FORMAT = VK_FORMAT_R16G16_SFLOAT; // R16G16 is supported pretty much everywhere
+		constexpr int32_t BRDF_LUT_DIM = 512;
+		// 漫反射SH从环境图里边长不超过它的第一个mip投影，低频信息足够
+		constexpr uint32_t SH_PROJECTION_MAX_SIZE = 64;
+		constexpr VkFormat PREFILTERED_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+		constexpr int32_t PREFILTERED_DIM = 512;
+		constexpr uint32_t PREFILTERED_SAMPLES = 32u;
+
+		// 生成流程或缓存文件布局变了就加一，旧缓存的key对不上自然失效
+		constexpr uint32_t IBL_CACHE_VERSION = 2;
+
+		uint32_t getMipCount(int32_t dim)
 		{
-			VkBuffer buffer;
-			VkDeviceMemory memory;
-		} srcStaging;
+			return static_cast<uint32_t>(floor(log2(dim))) + 1;
+		}
 
-		VulkanDevice* vulkanDevice = variableLink.vulkanDevice;
-		VkQueue& queue = variableLink.GetQueue();
+		// FNV-1a 64，按8字节一组喂入，几十MB的环境图也只要几毫秒
+		class CacheKey
+		{
+		public:
+			void add(const void* data, size_t size)
+			{
+				const auto* bytes = static_cast<const uint8_t*>(data);
+				size_t i = 0;
+				for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+				{
+					uint64_t word;
+					memcpy(&word, bytes + i, sizeof(word));
+					mix(word);
+				}
+				for (; i < size; i++)
+				{
+					mix(bytes[i]);
+				}
+			}
 
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT | sorceMemoryProperty, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, srcBufferSize, &srcStaging.buffer, &srcStaging.memory, srcBufferData))
+			template <typename T>
+			void addValue(const T& value)
+			{
+				static_assert(std::is_trivially_copyable_v<T>);
+				add(&value, sizeof(T));
+			}
 
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT | targetMemoryProperty, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, srcBufferSize, &targetStaingBuffer.buffer, &targetStaingBuffer.memory, nullptr))
+			// 文件读不到时返回false，这时不走缓存
+			[[nodiscard]] bool addFile(const std::string& filename)
+			{
+				tools::MappedFile file;
+				if (!file.open(filename))
+				{
+					return false;
+				}
+				addValue(static_cast<uint64_t>(file.size()));
+				add(file.data(), file.size());
+				return true;
+			}
 
-		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, cmdRestart);
-		VkBufferCopy copyRegion = {};
+			[[nodiscard]] std::string toString() const
+			{
+				char text[17];
+				snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(hash));
+				return text;
+			}
 
-		copyRegion.size = srcBufferSize;
-		vkCmdCopyBuffer(copyCmd, srcStaging.buffer, targetStaingBuffer.buffer, 1, &copyRegion);
+		private:
+			void mix(uint64_t value)
+			{
+				hash ^= value;
+				hash *= 1099511628211ull;
+			}
 
-		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
-		vkDestroyBuffer(vulkanDevice->logicalDevice, srcStaging.buffer, nullptr);
-		vkFreeMemory(vulkanDevice->logicalDevice, srcStaging.memory, nullptr);
-	}
+			uint64_t hash = 14695981039346656037ull;
+		};
 
-	void vksTools::createStagingBuffer(VulkanExampleBase& variableLink, VkBufferUsageFlags sorceMemoryProperty, VkDeviceSize srcBufferSize, void* srcBufferData, VkBufferUsageFlags targetMemoryProperty, vkglTF::Model::Indices& targetStaingBuffer, bool cmdRestart)
-	{
-		struct StagingBuffer
+		// KTX1头里存的是GL内部格式
+		uint32_t getGlInternalFormat(VkFormat format)
 		{
-			VkBuffer buffer;
-			VkDeviceMemory memory;
-		} srcStaging;
+			switch (format)
+			{
+			case VK_FORMAT_R16G16_SFLOAT:
+				return 0x822F; // GL_RG16F
+			case VK_FORMAT_R16G16B16A16_SFLOAT:
+				return 0x881A; // GL_RGBA16F
+			case VK_FORMAT_R32G32B32A32_SFLOAT:
+				return 0x8814; // GL_RGBA32F
+			default:
+				return 0;
+			}
+		}
 
-		VulkanDevice* vulkanDevice = variableLink.vulkanDevice;
-		VkQueue& queue = variableLink.GetQueue();
+		VkDeviceSize getTexelSize(VkFormat format)
+		{
+			switch (format)
+			{
+			case VK_FORMAT_R16G16_SFLOAT:
+				return 4;
+			case VK_FORMAT_R16G16B16A16_SFLOAT:
+				return 8;
+			case VK_FORMAT_R32G32B32A32_SFLOAT:
+				return 16;
+			default:
+				return 0;
+			}
+		}
+
+		bool projectEnvironmentSH(const std::string& filename, SphericalHarmonics9& sh)
+		{
+			constexpr uint32_t GL_HALF_FLOAT_TYPE = 0x140B;
+			constexpr uint32_t GL_FLOAT_TYPE = 0x1406;
+			constexpr uint32_t GL_RGBA_FORMAT = 0x1908;
+
+			tools::MappedFile file;
+			if (!file.open(filename))
+			{
+				return false;
+			}
+			ktxTexture* texture = nullptr;
+			if (ktxTexture_CreateFromMemory(file.data(), file.size(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &texture) != KTX_SUCCESS)
+			{
+				return false;
+			}
+			const bool halfFloat = texture->glType == GL_HALF_FLOAT_TYPE;
+			if (!texture->isCubemap || texture->isCompressed || texture->glFormat != GL_RGBA_FORMAT || (!halfFloat && texture->glType != GL_FLOAT_TYPE))
+			{
+				ktxTexture_Destroy(texture);
+				return false;
+			}
 
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT | sorceMemoryProperty, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, srcBufferSize, &srcStaging.buffer, &srcStaging.memory, srcBufferData))
+			uint32_t level = 0;
+			while (level + 1 < texture->numLevels && (texture->baseWidth >> level) > SH_PROJECTION_MAX_SIZE)
+			{
+				level++;
+			}
+			const uint32_t size = std::max(1u, texture->baseWidth >> level);
+			const uint8_t* data = ktxTexture_GetData(texture);
+			std::array<const uint8_t*, 6> faces;
+			for (uint32_t face = 0; face < 6; face++)
+			{
+				ktx_size_t offset;
+				ktxTexture_GetImageOffset(texture, level, 0, face, &offset);
+				faces[face] = data + offset;
+			}
 
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT | targetMemoryProperty, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, srcBufferSize, &targetStaingBuffer.buffer, &targetStaingBuffer.memory, nullptr))
+			sh = SphericalHarmonics9::projectCubemap(size, [&](uint32_t face, uint32_t x, uint32_t y)
+			{
+				const size_t texelIndex = (static_cast<size_t>(y) * size + x) * 4;
+				if (halfFloat)
+				{
+					uint16_t rgb[3];
+					memcpy(rgb, faces[face] + texelIndex * sizeof(uint16_t), sizeof(rgb));
+					return glm::vec3(glm::unpackHalf1x16(rgb[0]), glm::unpackHalf1x16(rgb[1]), glm::unpackHalf1x16(rgb[2]));
+				}
+				glm::vec3 rgb;
+				memcpy(&rgb, faces[face] + texelIndex * sizeof(float), sizeof(rgb));
+				return rgb;
+			});
+			ktxTexture_Destroy(texture);
+			return true;
+		}
+
+		std::filesystem::path getIBLCacheDirectory()
+		{
+			return std::filesystem::path("cache") / "ibl";
+		}
+
+		// 读回生成好的所有mip和面写成KTX；先写临时文件再改名，中途退出不会留下半个文件，同前缀的旧缓存一并删掉
+		bool writeImageToKTX(PBRTexture& pbrTexture, VkImage image, VkFormat format, int32_t dim, uint32_t mipLevels, uint32_t faceCount, const std::filesystem::path& filename, const std::string& prefix)
+		{
+			auto& vulkanDevice = pbrTexture.vulkanDevice;
+			const VkDeviceSize texelSize = getTexelSize(format);
+			assert(texelSize != 0);
+
+			// 每个mip一个region，面在buffer里按层依次排列，和KTX里一个mip内的面顺序一致
+			std::vector<VkBufferImageCopy> regions(mipLevels);
+			std::vector<VkDeviceSize> faceSizes(mipLevels);
+			VkDeviceSize totalSize = 0;
+			for (uint32_t m = 0; m < mipLevels; m++)
+			{
+				const uint32_t extent = std::max(1u, static_cast<uint32_t>(dim) >> m);
+				faceSizes[m] = static_cast<VkDeviceSize>(extent) * extent * texelSize;
+				regions[m] = {};
+				regions[m].bufferOffset = totalSize;
+				regions[m].imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, m, 0, faceCount};
+				regions[m].imageExtent = {extent, extent, 1};
+				totalSize += faceSizes[m] * faceCount;
+			}
+
+			Buffer readback;
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &readback, totalSize))
+
+			VkImageSubresourceRange subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, faceCount};
+			VkCommandBuffer cmdBuf = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+			tools::setImageLayout(cmdBuf, image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, subresourceRange);
+			vkCmdCopyImageToBuffer(cmdBuf, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer, static_cast<uint32_t>(regions.size()), regions.data());
+			VkMemoryBarrier hostBarrier = initializers::memoryBarrier();
+			hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+			tools::setImageLayout(cmdBuf, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
+			vulkanDevice->flushCommandBuffer(cmdBuf, pbrTexture.GetQueue());
+
+			VK_CHECK_RESULT(readback.map())
+			const auto* data = static_cast<const uint8_t*>(readback.mapped);
+
+			ktxTextureCreateInfo createInfo = {};
+			createInfo.glInternalformat = getGlInternalFormat(format);
+			createInfo.baseWidth = static_cast<uint32_t>(dim);
+			createInfo.baseHeight = static_cast<uint32_t>(dim);
+			createInfo.baseDepth = 1;
+			createInfo.numDimensions = 2;
+			createInfo.numLevels = mipLevels;
+			createInfo.numLayers = 1;
+			createInfo.numFaces = faceCount;
+			createInfo.isArray = KTX_FALSE;
+			createInfo.generateMipmaps = KTX_FALSE;
+
+			ktxTexture* texture = nullptr;
+			KTX_error_code result = ktxTexture_Create(&createInfo, KTX_TEXTURE_CREATE_ALLOC_STORAGE, &texture);
+			for (uint32_t m = 0; m < mipLevels && result == KTX_SUCCESS; m++)
+			{
+				for (uint32_t face = 0; face < faceCount && result == KTX_SUCCESS; face++)
+				{
+					result = ktxTexture_SetImageFromMemory(texture, m, 0, face, data + regions[m].bufferOffset + face * faceSizes[m], faceSizes[m]);
+				}
+			}
+			readback.destroy();
+
+			std::error_code ec;
+			std::filesystem::create_directories(filename.parent_path(), ec);
+			const std::filesystem::path tempFilename = std::filesystem::path(filename).concat(".tmp");
+			if (result == KTX_SUCCESS)
+			{
+				result = ktxTexture_WriteToNamedFile(texture, tempFilename.string().c_str());
+			}
+			if (texture)
+			{
+				ktxTexture_Destroy(texture);
+			}
+			if (result != KTX_SUCCESS)
+			{
+				std::filesystem::remove(tempFilename, ec);
+				return false;
+			}
+			std::filesystem::rename(tempFilename, filename, ec);
+			if (ec)
+			{
+				std::filesystem::remove(tempFilename, ec);
+				return false;
+			}
 
-		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, cmdRestart);
-		VkBufferCopy copyRegion = {};
+			for (const auto& entry : std::filesystem::directory_iterator(filename.parent_path(), ec))
+			{
+				const std::string name = entry.path().filename().string();
+				if (entry.path() != filename && name.rfind(prefix, 0) == 0)
+				{
+					std::filesystem::remove(entry.path(), ec);
+				}
+			}
+			return true;
+		}
 
-		copyRegion.size = srcBufferSize;
-		vkCmdCopyBuffer(copyCmd, srcStaging.buffer, targetStaingBuffer.buffer, 1, &copyRegion);
+		// 命中缓存时走普通的KTX加载，上传进uploadManager的批次，和场景buffer一起在prepare()里等待；返回是否命中
+		template <typename TextureType>
+		bool loadOrGenerateIBL(PBRTexture& pbrTexture, TextureType& texture, const char* prefix, const CacheKey* key, VkFormat format, int32_t dim, uint32_t mipLevels, uint32_t faceCount, void (*generate)(PBRTexture&))
+		{
+			std::filesystem::path filename;
+			if (key)
+			{
+				filename = getIBLCacheDirectory() / (std::string(prefix) + key->toString() + ".ktx");
+				std::error_code ec;
+				if (std::filesystem::is_regular_file(filename, ec))
+				{
+					auto tStart = std::chrono::high_resolution_clock::now();
+					texture.loadFromFile(filename.string(), format, pbrTexture.vulkanDevice, pbrTexture.uploadManager);
+					auto tDiff = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tStart).count();
+					std::cout << "Loaded cached " << filename.string() << " in " << tDiff << " ms" << std::endl;
+					return true;
+				}
+			}
 
-		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
-		vkDestroyBuffer(vulkanDevice->logicalDevice, srcStaging.buffer, nullptr);
-		vkFreeMemory(vulkanDevice->logicalDevice, srcStaging.memory, nullptr);
+			generate(pbrTexture);
+			if (key && !writeImageToKTX(pbrTexture, texture.image, format, dim, mipLevels, faceCount, filename, prefix))
+			{
+				std::cerr << "Could not write IBL cache " << filename.string() << std::endl;
+			}
+			return false;
+		}
 	}
 
-	void vksTools::createStagingBuffer(VulkanExampleBase& variableLink, VkBufferUsageFlags sorceMemoryProperty, VkDeviceSize srcBufferSize, void* srcBufferData, VkBufferUsageFlags targetMemoryProperty, Buffer& targetStaingBuffer, bool cmdRestart)
+	UploadTicket vksTools::createStagingBuffer(VulkanExampleBase& variableLink, VkBufferUsageFlags sorceMemoryProperty, VkDeviceSize srcBufferSize, void* srcBufferData, VkBufferUsageFlags targetMemoryProperty, vkglTF::Model::Vertices& targetStaingBuffer, bool cmdRestart)
 	{
-		struct StagingBuffer
-		{
-			VkBuffer buffer;
-			VkDeviceMemory memory;
-		} srcStaging;
+		VulkanDevice* vulkanDevice = variableLink.vulkanDevice;
+
+		// 目标buffer在各队列族间concurrent共享，transfer队列写完后图形/计算队列直接用，不需要所有权转移
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT | targetMemoryProperty, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, srcBufferSize, &targetStaingBuffer.buffer, &targetStaingBuffer.memory, nullptr, true))
 
+		// 数据进上传环，拷贝攒批后在transfer队列上提交，不再每次提交并等队列空闲
+		return variableLink.uploadManager.uploadBuffer(targetStaingBuffer.buffer, 0, srcBufferData, srcBufferSize);
+	}
+
+	UploadTicket vksTools::createStagingBuffer(VulkanExampleBase& variableLink, VkBufferUsageFlags sorceMemoryProperty, VkDeviceSize srcBufferSize, void* srcBufferData, VkBufferUsageFlags targetMemoryProperty, vkglTF::Model::Indices& targetStaingBuffer, bool cmdRestart)
+	{
 		VulkanDevice* vulkanDevice = variableLink.vulkanDevice;
-		VkQueue& queue = variableLink.GetQueue();
 
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT | sorceMemoryProperty, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, srcBufferSize, &srcStaging.buffer, &srcStaging.memory, srcBufferData))
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT | targetMemoryProperty, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, srcBufferSize, &targetStaingBuffer.buffer, &targetStaingBuffer.memory, nullptr, true))
 
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT | targetMemoryProperty, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, srcBufferSize, &targetStaingBuffer.buffer, &targetStaingBuffer.memory, nullptr))
+		return variableLink.uploadManager.uploadBuffer(targetStaingBuffer.buffer, 0, srcBufferData, srcBufferSize);
+	}
 
-		VkCommandBuffer copyCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, cmdRestart);
-		VkBufferCopy copyRegion = {};
+	UploadTicket vksTools::createStagingBuffer(VulkanExampleBase& variableLink, VkBufferUsageFlags sorceMemoryProperty, VkDeviceSize srcBufferSize, void* srcBufferData, VkBufferUsageFlags targetMemoryProperty, Buffer& targetStaingBuffer, bool cmdRestart)
+	{
+		VulkanDevice* vulkanDevice = variableLink.vulkanDevice;
 
-		copyRegion.size = srcBufferSize;
-		vkCmdCopyBuffer(copyCmd, srcStaging.buffer, targetStaingBuffer.buffer, 1, &copyRegion);
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(VK_BUFFER_USAGE_TRANSFER_DST_BIT | targetMemoryProperty, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &targetStaingBuffer, srcBufferSize, nullptr, AllocationStrategy::FreeList, true))
 
-		vulkanDevice->flushCommandBuffer(copyCmd, queue, true);
-		vkDestroyBuffer(vulkanDevice->logicalDevice, srcStaging.buffer, nullptr);
-		vkFreeMemory(vulkanDevice->logicalDevice, srcStaging.memory, nullptr);
+		return variableLink.uploadManager.uploadBuffer(targetStaingBuffer.buffer, 0, srcBufferData, srcBufferSize);
 	}
 
 	void vksTools::setPbrDescriptor(PBRTexture& pbrTexture)
@@ -90,7 +339,7 @@ namespace vks
 		auto descMgr = VulkanDescriptorManager::getManager();
 		// scene
 		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings;
-		setLayoutBindings = {initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 1), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 4), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 5), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 6), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 7), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 8), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 9),};
+		setLayoutBindings = {initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 1), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 4), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 5), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 6), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 7), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 8), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 9), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 10), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 11), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 12), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 13), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 14),};
 		descMgr->addSetLayout(DescriptorType::Scene, setLayoutBindings, 6);
 
 		// hiz
@@ -105,13 +354,38 @@ namespace vks
 		setLayoutBindings = {initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),};
 		descMgr->addSetLayout(DescriptorType::depthCopy, setLayoutBindings, 1);
 
-		// culling
-		setLayoutBindings = {initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 5), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 6),};
+		// culling，0是PackedCluster，6是误差投影的uniform
+		setLayoutBindings = {initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 5), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 6), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 7), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 8), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 9), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 10), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 11), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 12), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 13), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 14),};
 		descMgr->addSetLayout(DescriptorType::culling, setLayoutBindings, 1);
 
-		// error proj
-		setLayoutBindings = {initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2),};
-		descMgr->addSetLayout(DescriptorType::errorPorj, setLayoutBindings, 1);
+		// instance culling
+		setLayoutBindings = {initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 4), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 5),};
+		descMgr->addSetLayout(DescriptorType::instanceCulling, setLayoutBindings, 1);
+
+		// dag traversal，binding 1原来是误差球，已经合进binding 0的PackedCluster，writeToSet按下标找binding，这里留空不写
+		setLayoutBindings = {initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 5), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 6), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 7), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 8), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 9), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 10), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 11), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 12), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 13), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 14), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 15), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 16), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 17),};
+		descMgr->addSetLayout(DescriptorType::dagTraversal, setLayoutBindings, 1);
+
+		// triangle culling
+		setLayoutBindings = {initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 5), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 6), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 7), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 8), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 9),};
+		descMgr->addSetLayout(DescriptorType::triangleCulling, setLayoutBindings, 1);
+
+		// software raster
+		setLayoutBindings = {initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 1), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 2), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 3), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 4), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 5), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 6), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 7),};
+		descMgr->addSetLayout(DescriptorType::swRaster, setLayoutBindings, 1);
+
+		// visibility buffer resolve，0-9和scene一致
+		setLayoutBindings = {initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 0), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 1), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 2), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 3), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 4), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 5), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 6), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 7), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 8), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 9), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 10), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 11), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 12), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 13), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 14),};
+		descMgr->addSetLayout(DescriptorType::visResolve, setLayoutBindings, 1);
+
+		// visibility buffer geometry pass，3-6是顶点着色器按索引流取顶点用的
+		setLayoutBindings = {initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT, 1), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 2), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 3), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 4), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 5), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 6),};
+		descMgr->addSetLayout(DescriptorType::visBuffer, setLayoutBindings, 1);
+
+		// mesh shading，task和mesh共用一个set，4和9只有task shader用
+		constexpr VkShaderStageFlags meshStages = VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+		setLayoutBindings = {initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, meshStages, 0), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, meshStages, 1), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, meshStages, 2), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, meshStages, 3), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, meshStages, 4), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, meshStages, 5), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, meshStages, 6), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, meshStages, 7), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, meshStages, 8), initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, meshStages, 9),};
+		descMgr->addSetLayout(DescriptorType::meshShading, setLayoutBindings, 1);
 
 		descMgr->createLayoutsAndSets(pbrTexture.GetDevice());
 		auto &uniformBuffers = pbrTexture.uniformBuffers;
@@ -120,7 +394,7 @@ namespace vks
 
 		descMgr->writeToSet(DescriptorType::Scene, 0, 0, &uniformBuffers.scene.descriptor);
 		descMgr->writeToSet(DescriptorType::Scene, 0, 1, &uniformBuffers.params.descriptor);
-		descMgr->writeToSet(DescriptorType::Scene, 0, 2, &textures.irradianceCube.descriptor);
+		// binding 2在pbr的set里不再使用(irradiance改成params里的SH)，布局保留给天空盒的环境图
 		descMgr->writeToSet(DescriptorType::Scene, 0, 3, &textures.lutBrdf.descriptor);
 		descMgr->writeToSet(DescriptorType::Scene, 0, 4, &textures.prefilteredCube.descriptor);
 		descMgr->writeToSet(DescriptorType::Scene, 0, 5, &textures.albedoMap.descriptor);
@@ -155,30 +429,140 @@ namespace vks
 
 		// culling
 		pbrTexture.clustersInfoBuffer.setupDescriptor();
+		pbrTexture.packedClustersBuffer.setupDescriptor();
 		pbrTexture.culledIndicesBuffer.setupDescriptor();
 		pbrTexture.drawIndexedIndirectBuffer.setupDescriptor();
 		pbrTexture.cullingUniformBuffer.setupDescriptor();
-		pbrTexture.projectedErrorBuffer.setupDescriptor();
+		pbrTexture.errorUniformBuffer.setupDescriptor();
+		pbrTexture.cullingStatsBuffer.setupDescriptor();
 
 		VkDescriptorBufferInfo inputIndicesInfo = {};
 		inputIndicesInfo.buffer = pbrTexture.scene.indices.buffer;
 		inputIndicesInfo.range = VK_WHOLE_SIZE;
 
-		descMgr->writeToSet(DescriptorType::culling, 0, 0, &pbrTexture.clustersInfoBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::culling, 0, 0, &pbrTexture.packedClustersBuffer.descriptor);
 		descMgr->writeToSet(DescriptorType::culling, 0, 1, &inputIndicesInfo);
 		descMgr->writeToSet(DescriptorType::culling, 0, 2, &pbrTexture.culledIndicesBuffer.descriptor);
 		descMgr->writeToSet(DescriptorType::culling, 0, 3, &pbrTexture.drawIndexedIndirectBuffer.descriptor);
 		descMgr->writeToSet(DescriptorType::culling, 0, 4, &pbrTexture.cullingUniformBuffer.descriptor);
 		descMgr->writeToSet(DescriptorType::culling, 0, 5, &pbrTexture.textures.hizBuffer.descriptor);
-		descMgr->writeToSet(DescriptorType::culling, 0, 6, &pbrTexture.projectedErrorBuffer.descriptor);
-
-		// error
-		pbrTexture.errorInfoBuffer.setupDescriptor();
-		pbrTexture.projectedErrorBuffer.setupDescriptor();
-		pbrTexture.errorUniformBuffer.setupDescriptor();
-		descMgr->writeToSet(DescriptorType::errorPorj, 0, 0, &pbrTexture.errorInfoBuffer.descriptor);
-		descMgr->writeToSet(DescriptorType::errorPorj, 0, 1, &pbrTexture.projectedErrorBuffer.descriptor);
-		descMgr->writeToSet(DescriptorType::errorPorj, 0, 2, &pbrTexture.errorUniformBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::culling, 0, 6, &pbrTexture.errorUniformBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::culling, 0, 7, &pbrTexture.cullingStatsBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::culling, 0, 8, &pbrTexture.instanceInfoBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::culling, 0, 9, &pbrTexture.visibleInstancesBuffer.descriptor);
+		pbrTexture.triangleCullDispatchBuffer.setupDescriptor();
+		pbrTexture.triangleCullClustersBuffer.setupDescriptor();
+		descMgr->writeToSet(DescriptorType::culling, 0, 10, &pbrTexture.triangleCullDispatchBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::culling, 0, 11, &pbrTexture.triangleCullClustersBuffer.descriptor);
+		pbrTexture.swRasterDispatchBuffer.setupDescriptor();
+		pbrTexture.swRasterClustersBuffer.setupDescriptor();
+		descMgr->writeToSet(DescriptorType::culling, 0, 12, &pbrTexture.swRasterDispatchBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::culling, 0, 13, &pbrTexture.swRasterClustersBuffer.descriptor);
+		pbrTexture.culledTriangleIdsBuffer.setupDescriptor();
+		descMgr->writeToSet(DescriptorType::culling, 0, 14, &pbrTexture.culledTriangleIdsBuffer.descriptor);
+
+		// instance culling
+		pbrTexture.instanceInfoBuffer.setupDescriptor();
+		pbrTexture.visibleInstancesBuffer.setupDescriptor();
+		pbrTexture.clusterDispatchBuffer.setupDescriptor();
+		descMgr->writeToSet(DescriptorType::instanceCulling, 0, 0, &pbrTexture.instanceInfoBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::instanceCulling, 0, 1, &pbrTexture.visibleInstancesBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::instanceCulling, 0, 2, &pbrTexture.clusterDispatchBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::instanceCulling, 0, 3, &pbrTexture.cullingUniformBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::instanceCulling, 0, 4, &pbrTexture.textures.hizBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::instanceCulling, 0, 5, &pbrTexture.cullingStatsBuffer.descriptor);
+
+		// dag traversal
+		pbrTexture.dagBuffer.setupDescriptor();
+		pbrTexture.dagQueueBuffer.setupDescriptor();
+		descMgr->writeToSet(DescriptorType::dagTraversal, 0, 0, &pbrTexture.packedClustersBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::dagTraversal, 0, 2, &inputIndicesInfo);
+		descMgr->writeToSet(DescriptorType::dagTraversal, 0, 3, &pbrTexture.culledIndicesBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::dagTraversal, 0, 4, &pbrTexture.drawIndexedIndirectBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::dagTraversal, 0, 5, &pbrTexture.errorUniformBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::dagTraversal, 0, 6, &pbrTexture.cullingUniformBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::dagTraversal, 0, 7, &pbrTexture.cullingStatsBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::dagTraversal, 0, 8, &pbrTexture.instanceInfoBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::dagTraversal, 0, 9, &pbrTexture.visibleInstancesBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::dagTraversal, 0, 10, &pbrTexture.clusterDispatchBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::dagTraversal, 0, 11, &pbrTexture.dagBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::dagTraversal, 0, 12, &pbrTexture.dagQueueBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::dagTraversal, 0, 13, &pbrTexture.triangleCullDispatchBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::dagTraversal, 0, 14, &pbrTexture.triangleCullClustersBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::dagTraversal, 0, 15, &pbrTexture.swRasterDispatchBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::dagTraversal, 0, 16, &pbrTexture.swRasterClustersBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::dagTraversal, 0, 17, &pbrTexture.culledTriangleIdsBuffer.descriptor);
+
+		// triangle culling
+		VkDescriptorBufferInfo inputVerticesInfo = {};
+		inputVerticesInfo.buffer = pbrTexture.scene.vertices.buffer;
+		inputVerticesInfo.range = VK_WHOLE_SIZE;
+		pbrTexture.instanceTransformsBuffer.setupDescriptor();
+		descMgr->writeToSet(DescriptorType::triangleCulling, 0, 0, &pbrTexture.clustersInfoBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::triangleCulling, 0, 1, &inputIndicesInfo);
+		descMgr->writeToSet(DescriptorType::triangleCulling, 0, 2, &inputVerticesInfo);
+		descMgr->writeToSet(DescriptorType::triangleCulling, 0, 3, &pbrTexture.culledIndicesBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::triangleCulling, 0, 4, &pbrTexture.drawIndexedIndirectBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::triangleCulling, 0, 5, &pbrTexture.cullingUniformBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::triangleCulling, 0, 6, &pbrTexture.triangleCullClustersBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::triangleCulling, 0, 7, &pbrTexture.cullingStatsBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::triangleCulling, 0, 8, &pbrTexture.instanceTransformsBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::triangleCulling, 0, 9, &pbrTexture.culledTriangleIdsBuffer.descriptor);
+
+		// software raster
+		pbrTexture.visibilityBuffer.setupDescriptor();
+		descMgr->writeToSet(DescriptorType::swRaster, 0, 0, &pbrTexture.clustersInfoBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::swRaster, 0, 1, &inputIndicesInfo);
+		descMgr->writeToSet(DescriptorType::swRaster, 0, 2, &inputVerticesInfo);
+		descMgr->writeToSet(DescriptorType::swRaster, 0, 3, &pbrTexture.cullingUniformBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::swRaster, 0, 4, &pbrTexture.swRasterClustersBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::swRaster, 0, 5, &pbrTexture.visibilityBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::swRaster, 0, 6, &pbrTexture.instanceTransformsBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::swRaster, 0, 7, &pbrTexture.cullingStatsBuffer.descriptor);
+
+		// visibility buffer resolve
+		descMgr->writeToSet(DescriptorType::visResolve, 0, 0, &uniformBuffers.scene.descriptor);
+		descMgr->writeToSet(DescriptorType::visResolve, 0, 1, &uniformBuffers.params.descriptor);
+		descMgr->writeToSet(DescriptorType::visResolve, 0, 3, &textures.lutBrdf.descriptor);
+		descMgr->writeToSet(DescriptorType::visResolve, 0, 4, &textures.prefilteredCube.descriptor);
+		descMgr->writeToSet(DescriptorType::visResolve, 0, 5, &textures.albedoMap.descriptor);
+		descMgr->writeToSet(DescriptorType::visResolve, 0, 6, &textures.normalMap.descriptor);
+		descMgr->writeToSet(DescriptorType::visResolve, 0, 7, &textures.aoMap.descriptor);
+		descMgr->writeToSet(DescriptorType::visResolve, 0, 8, &textures.metallicMap.descriptor);
+		descMgr->writeToSet(DescriptorType::visResolve, 0, 9, &textures.roughnessMap.descriptor);
+		descMgr->writeToSet(DescriptorType::visResolve, 0, 10, &pbrTexture.visibilityBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::visResolve, 0, 11, &pbrTexture.clustersInfoBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::visResolve, 0, 12, &inputIndicesInfo);
+		descMgr->writeToSet(DescriptorType::visResolve, 0, 13, &inputVerticesInfo);
+		descMgr->writeToSet(DescriptorType::visResolve, 0, 14, &pbrTexture.instanceTransformsBuffer.descriptor);
+
+		// visibility buffer geometry pass
+		descMgr->writeToSet(DescriptorType::visBuffer, 0, 0, &uniformBuffers.scene.descriptor);
+		descMgr->writeToSet(DescriptorType::visBuffer, 0, 1, &pbrTexture.visibilityBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::visBuffer, 0, 2, &pbrTexture.culledTriangleIdsBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::visBuffer, 0, 3, &pbrTexture.culledIndicesBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::visBuffer, 0, 4, &pbrTexture.clustersInfoBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::visBuffer, 0, 5, &inputVerticesInfo);
+		descMgr->writeToSet(DescriptorType::visBuffer, 0, 6, &pbrTexture.instanceTransformsBuffer.descriptor);
+
+		// pbr的顶点着色器同样按剔除输出的索引流取顶点，多个实例各用自己的变换
+		descMgr->writeToSet(DescriptorType::Scene, 0, 10, &pbrTexture.culledIndicesBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::Scene, 0, 11, &pbrTexture.culledTriangleIdsBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::Scene, 0, 12, &pbrTexture.clustersInfoBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::Scene, 0, 13, &inputVerticesInfo);
+		descMgr->writeToSet(DescriptorType::Scene, 0, 14, &pbrTexture.instanceTransformsBuffer.descriptor);
+
+		// mesh shading
+		descMgr->writeToSet(DescriptorType::meshShading, 0, 0, &pbrTexture.clustersInfoBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::meshShading, 0, 1, &inputIndicesInfo);
+		descMgr->writeToSet(DescriptorType::meshShading, 0, 2, &inputVerticesInfo);
+		descMgr->writeToSet(DescriptorType::meshShading, 0, 3, &pbrTexture.cullingUniformBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::meshShading, 0, 4, &pbrTexture.packedClustersBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::meshShading, 0, 5, &pbrTexture.cullingStatsBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::meshShading, 0, 6, &pbrTexture.instanceInfoBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::meshShading, 0, 7, &pbrTexture.visibleInstancesBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::meshShading, 0, 8, &pbrTexture.instanceTransformsBuffer.descriptor);
+		descMgr->writeToSet(DescriptorType::meshShading, 0, 9, &pbrTexture.errorUniformBuffer.descriptor);
 	}
 
 	VkImageSubresourceRange vksTools::genDepthSubresourceRange()
@@ -198,8 +582,8 @@ namespace vks
 	{
 		auto tStart = std::chrono::high_resolution_clock::now();
 
-		constexpr VkFormat format = VK_FORMAT_R16G16_SFLOAT; // R16G16 is supported pretty much everywhere
-		constexpr int32_t dim = 512;
+		constexpr VkFormat format = BRDF_LUT_FORMAT;
+		constexpr int32_t dim = BRDF_LUT_DIM;
 		auto device = pbrTexture.GetDevice();
 		auto& textures = pbrTexture.textures;
 		auto& vulkanDevice = pbrTexture.vulkanDevice;
@@ -215,15 +599,10 @@ namespace vks
 		imageCI.arrayLayers = 1;
 		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		// TRANSFER_SRC用于读回写入磁盘缓存
+		imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &textures.lutBrdf.image));
-		VkMemoryAllocateInfo memAlloc = initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-		vkGetImageMemoryRequirements(device, textures.lutBrdf.image, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &textures.lutBrdf.deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device, textures.lutBrdf.image, textures.lutBrdf.deviceMemory, 0));
+		textures.lutBrdf.allocateImageMemory(vulkanDevice);
 		// Image view
 		VkImageViewCreateInfo viewCI = initializers::imageViewCreateInfo();
 		viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D;
@@ -387,7 +766,7 @@ namespace vks
 		auto queue = pbrTexture.GetQueue();
 		vulkanDevice->flushCommandBuffer(cmdBuf, queue);
 
-		vkQueueWaitIdle(queue);
+		vulkanDevice->queueWaitIdle(queue);
 
 		vkDestroyPipeline(device, pipeline, nullptr);
 		vkDestroyPipelineLayout(device, pipelinelayout, nullptr);
@@ -401,357 +780,6 @@ namespace vks
 		std::cout << "Generating BRDF LUT took " << tDiff << " ms" << std::endl;
 	}
 
-	void vksTools::generateIrradianceCube(PBRTexture& pbrTexture)
-	{
-		auto device = pbrTexture.GetDevice();
-		auto& textures = pbrTexture.textures;
-		auto& vulkanDevice = pbrTexture.vulkanDevice;
-		auto queue = pbrTexture.GetQueue();
-
-		auto tStart = std::chrono::high_resolution_clock::now();
-
-		constexpr VkFormat format = VK_FORMAT_R32G32B32A32_SFLOAT;
-		constexpr int32_t dim = 64;
-		const uint32_t numMips = static_cast<uint32_t>(floor(log2(dim))) + 1;
-
-		// Pre-filtered cube map
-		// Image
-		VkImageCreateInfo imageCI = initializers::imageCreateInfo();
-		imageCI.imageType = VK_IMAGE_TYPE_2D;
-		imageCI.format = format;
-		imageCI.extent.width = dim;
-		imageCI.extent.height = dim;
-		imageCI.extent.depth = 1;
-		imageCI.mipLevels = numMips;
-		imageCI.arrayLayers = 6;
-		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
-		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-		imageCI.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
-		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &textures.irradianceCube.image));
-		VkMemoryAllocateInfo memAlloc = initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-		vkGetImageMemoryRequirements(device, textures.irradianceCube.image, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &textures.irradianceCube.deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device, textures.irradianceCube.image, textures.irradianceCube.deviceMemory, 0));
-		// Image view
-		VkImageViewCreateInfo viewCI = initializers::imageViewCreateInfo();
-		viewCI.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
-		viewCI.format = format;
-		viewCI.subresourceRange = {};
-		viewCI.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		viewCI.subresourceRange.levelCount = numMips;
-		viewCI.subresourceRange.layerCount = 6;
-		viewCI.image = textures.irradianceCube.image;
-		VK_CHECK_RESULT(vkCreateImageView(device, &viewCI, nullptr, &textures.irradianceCube.view));
-		// Sampler
-		VkSamplerCreateInfo samplerCI = initializers::samplerCreateInfo();
-		samplerCI.magFilter = VK_FILTER_LINEAR;
-		samplerCI.minFilter = VK_FILTER_LINEAR;
-		samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-		samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-		samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-		samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-		samplerCI.minLod = 0.0f;
-		samplerCI.maxLod = static_cast<float>(numMips);
-		samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		VK_CHECK_RESULT(vkCreateSampler(device, &samplerCI, nullptr, &textures.irradianceCube.sampler));
-
-		textures.irradianceCube.descriptor.imageView = textures.irradianceCube.view;
-		textures.irradianceCube.descriptor.sampler = textures.irradianceCube.sampler;
-		textures.irradianceCube.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		textures.irradianceCube.device = vulkanDevice;
-
-		// FB, Att, RP, Pipe, etc.
-		VkAttachmentDescription attDesc = {};
-		// Color attachment
-		attDesc.format = format;
-		attDesc.samples = VK_SAMPLE_COUNT_1_BIT;
-		attDesc.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		attDesc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		attDesc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		attDesc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		attDesc.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attDesc.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-		VkAttachmentReference colorReference = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
-
-		VkSubpassDescription subpassDescription = {};
-		subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpassDescription.colorAttachmentCount = 1;
-		subpassDescription.pColorAttachments = &colorReference;
-
-		// Use subpass dependencies for layout transitions
-		std::array<VkSubpassDependency, 2> dependencies;
-		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependencies[0].dstSubpass = 0;
-		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-		dependencies[1].srcSubpass = 0;
-		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-		// Renderpass
-		VkRenderPassCreateInfo renderPassCI = initializers::renderPassCreateInfo();
-		renderPassCI.attachmentCount = 1;
-		renderPassCI.pAttachments = &attDesc;
-		renderPassCI.subpassCount = 1;
-		renderPassCI.pSubpasses = &subpassDescription;
-		renderPassCI.dependencyCount = 2;
-		renderPassCI.pDependencies = dependencies.data();
-		VkRenderPass renderpass;
-		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCI, nullptr, &renderpass));
-
-		struct
-		{
-			VkImage image;
-			VkImageView view;
-			VkDeviceMemory memory;
-			VkFramebuffer framebuffer;
-		} offscreen;
-
-		// Offfscreen framebuffer
-		{
-			// Color attachment
-			VkImageCreateInfo imageCreateInfo = initializers::imageCreateInfo();
-			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-			imageCreateInfo.format = format;
-			imageCreateInfo.extent.width = dim;
-			imageCreateInfo.extent.height = dim;
-			imageCreateInfo.extent.depth = 1;
-			imageCreateInfo.mipLevels = 1;
-			imageCreateInfo.arrayLayers = 1;
-			imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-			imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-			imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			imageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-			imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-			VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &offscreen.image));
-
-			VkMemoryAllocateInfo memAlloc = initializers::memoryAllocateInfo();
-			VkMemoryRequirements memReqs;
-			vkGetImageMemoryRequirements(device, offscreen.image, &memReqs);
-			memAlloc.allocationSize = memReqs.size;
-			memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &offscreen.memory));
-			VK_CHECK_RESULT(vkBindImageMemory(device, offscreen.image, offscreen.memory, 0));
-
-			VkImageViewCreateInfo colorImageView = initializers::imageViewCreateInfo();
-			colorImageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-			colorImageView.format = format;
-			colorImageView.flags = 0;
-			colorImageView.subresourceRange = {};
-			colorImageView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			colorImageView.subresourceRange.baseMipLevel = 0;
-			colorImageView.subresourceRange.levelCount = 1;
-			colorImageView.subresourceRange.baseArrayLayer = 0;
-			colorImageView.subresourceRange.layerCount = 1;
-			colorImageView.image = offscreen.image;
-			VK_CHECK_RESULT(vkCreateImageView(device, &colorImageView, nullptr, &offscreen.view));
-
-			VkFramebufferCreateInfo fbufCreateInfo = initializers::framebufferCreateInfo();
-			fbufCreateInfo.renderPass = renderpass;
-			fbufCreateInfo.attachmentCount = 1;
-			fbufCreateInfo.pAttachments = &offscreen.view;
-			fbufCreateInfo.width = dim;
-			fbufCreateInfo.height = dim;
-			fbufCreateInfo.layers = 1;
-			VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &offscreen.framebuffer));
-
-			VkCommandBuffer layoutCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-			tools::setImageLayout(layoutCmd, offscreen.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-			vulkanDevice->flushCommandBuffer(layoutCmd, queue, true);
-		}
-
-		// Descriptors
-		VkDescriptorSetLayout descriptorsetlayout;
-		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),};
-		VkDescriptorSetLayoutCreateInfo descriptorsetlayoutCI = initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorsetlayoutCI, nullptr, &descriptorsetlayout));
-
-		// Descriptor Pool
-		std::vector<VkDescriptorPoolSize> poolSizes = {initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1)};
-		VkDescriptorPoolCreateInfo descriptorPoolCI = initializers::descriptorPoolCreateInfo(poolSizes, 2);
-		VkDescriptorPool descriptorpool;
-		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCI, nullptr, &descriptorpool));
-
-		// Descriptor sets
-		VkDescriptorSet descriptorset;
-		VkDescriptorSetAllocateInfo allocInfo = initializers::descriptorSetAllocateInfo(descriptorpool, &descriptorsetlayout, 1);
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorset));
-		VkWriteDescriptorSet writeDescriptorSet = initializers::writeDescriptorSet(descriptorset, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &textures.environmentCube.descriptor);
-		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
-
-		// Pipeline layout
-		struct PushBlock
-		{
-			glm::mat4 mvp;
-			// Sampling deltas
-			float deltaPhi = (2.0f * static_cast<float>(M_PI)) / 180.0f;
-			float deltaTheta = (0.5f * static_cast<float>(M_PI)) / 64.0f;
-		} pushBlock;
-
-		VkPipelineLayout pipelinelayout;
-		std::vector<VkPushConstantRange> pushConstantRanges = {initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(PushBlock), 0),};
-		VkPipelineLayoutCreateInfo pipelineLayoutCI = initializers::pipelineLayoutCreateInfo(&descriptorsetlayout, 1);
-		pipelineLayoutCI.pushConstantRangeCount = 1;
-		pipelineLayoutCI.pPushConstantRanges = pushConstantRanges.data();
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelinelayout));
-
-		// Pipeline
-		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
-		VkPipelineRasterizationStateCreateInfo rasterizationState = initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE);
-		VkPipelineColorBlendAttachmentState blendAttachmentState = initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
-		VkPipelineColorBlendStateCreateInfo colorBlendState = initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
-		VkPipelineDepthStencilStateCreateInfo depthStencilState = initializers::pipelineDepthStencilStateCreateInfo(VK_FALSE, VK_FALSE, VK_COMPARE_OP_LESS_OR_EQUAL);
-		VkPipelineViewportStateCreateInfo viewportState = initializers::pipelineViewportStateCreateInfo(1, 1);
-		VkPipelineMultisampleStateCreateInfo multisampleState = initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT);
-		std::vector<VkDynamicState> dynamicStateEnables = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
-		VkPipelineDynamicStateCreateInfo dynamicState = initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
-		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
-
-		VkGraphicsPipelineCreateInfo pipelineCI = initializers::pipelineCreateInfo(pipelinelayout, renderpass);
-		pipelineCI.pInputAssemblyState = &inputAssemblyState;
-		pipelineCI.pRasterizationState = &rasterizationState;
-		pipelineCI.pColorBlendState = &colorBlendState;
-		pipelineCI.pMultisampleState = &multisampleState;
-		pipelineCI.pViewportState = &viewportState;
-		pipelineCI.pDepthStencilState = &depthStencilState;
-		pipelineCI.pDynamicState = &dynamicState;
-		pipelineCI.stageCount = 2;
-		pipelineCI.pStages = shaderStages.data();
-		pipelineCI.renderPass = renderpass;
-		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::UV});
-
-		shaderStages[0] = pbrTexture.loadShader(pbrTexture.getShadersPath() + "pbrtexture/filtercube.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shaderStages[1] = pbrTexture.loadShader(pbrTexture.getShadersPath() + "pbrtexture/irradiancecube.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-		VkPipeline pipeline;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pbrTexture.GetPipelineCache(), 1, &pipelineCI, nullptr, &pipeline));
-
-		// Render
-
-		VkClearValue clearValues[1];
-		clearValues[0].color = {{0.0f, 0.0f, 0.2f, 0.0f}};
-
-		VkRenderPassBeginInfo renderPassBeginInfo = initializers::renderPassBeginInfo();
-		// Reuse render pass from example pass
-		renderPassBeginInfo.renderPass = renderpass;
-		renderPassBeginInfo.framebuffer = offscreen.framebuffer;
-		renderPassBeginInfo.renderArea.extent.width = dim;
-		renderPassBeginInfo.renderArea.extent.height = dim;
-		renderPassBeginInfo.clearValueCount = 1;
-		renderPassBeginInfo.pClearValues = clearValues;
-
-		std::vector<glm::mat4> matrices = {
-			// POSITIVE_X
-			glm::rotate(glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)), glm::radians(180.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
-			// NEGATIVE_X
-			glm::rotate(glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f)), glm::radians(180.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
-			// POSITIVE_Y
-			glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
-			// NEGATIVE_Y
-			glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
-			// POSITIVE_Z
-			glm::rotate(glm::mat4(1.0f), glm::radians(180.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
-			// NEGATIVE_Z
-			glm::rotate(glm::mat4(1.0f), glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f)),
-		};
-
-		VkCommandBuffer cmdBuf = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-		VkViewport viewport = initializers::viewport(static_cast<float>(dim), static_cast<float>(dim), 0.0f, 1.0f);
-		VkRect2D scissor = initializers::rect2D(dim, dim, 0, 0);
-
-		vkCmdSetViewport(cmdBuf, 0, 1, &viewport);
-		vkCmdSetScissor(cmdBuf, 0, 1, &scissor);
-
-		VkImageSubresourceRange subresourceRange = {};
-		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		subresourceRange.baseMipLevel = 0;
-		subresourceRange.levelCount = numMips;
-		subresourceRange.layerCount = 6;
-
-		// Change image layout for all cubemap faces to transfer destination
-		tools::setImageLayout(cmdBuf, textures.irradianceCube.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
-
-		for (uint32_t m = 0; m < numMips; m++)
-		{
-			for (uint32_t f = 0; f < 6; f++)
-			{
-				viewport.width = static_cast<float>(dim * std::pow(0.5f, m));
-				viewport.height = static_cast<float>(dim * std::pow(0.5f, m));
-				vkCmdSetViewport(cmdBuf, 0, 1, &viewport);
-
-				// Render scene from cube face's point of view
-				vkCmdBeginRenderPass(cmdBuf, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				// Update shader push constant block
-				pushBlock.mvp = glm::perspective(static_cast<float>((M_PI / 2.0)), 1.0f, 0.1f, 512.0f) * matrices[f];
-
-				vkCmdPushConstants(cmdBuf, pipelinelayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushBlock), &pushBlock);
-
-				vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-				vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelinelayout, 0, 1, &descriptorset, 0, nullptr);
-
-				pbrTexture.models.skybox.draw(cmdBuf);
-
-				vkCmdEndRenderPass(cmdBuf);
-
-				tools::setImageLayout(cmdBuf, offscreen.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-
-				// Copy region for transfer from framebuffer to cube face
-				VkImageCopy copyRegion = {};
-
-				copyRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				copyRegion.srcSubresource.baseArrayLayer = 0;
-				copyRegion.srcSubresource.mipLevel = 0;
-				copyRegion.srcSubresource.layerCount = 1;
-				copyRegion.srcOffset = {0, 0, 0};
-
-				copyRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				copyRegion.dstSubresource.baseArrayLayer = f;
-				copyRegion.dstSubresource.mipLevel = m;
-				copyRegion.dstSubresource.layerCount = 1;
-				copyRegion.dstOffset = {0, 0, 0};
-
-				copyRegion.extent.width = static_cast<uint32_t>(viewport.width);
-				copyRegion.extent.height = static_cast<uint32_t>(viewport.height);
-				copyRegion.extent.depth = 1;
-
-				vkCmdCopyImage(cmdBuf, offscreen.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, textures.irradianceCube.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
-
-				// Transform framebuffer color attachment back
-				tools::setImageLayout(cmdBuf, offscreen.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-			}
-		}
-
-		tools::setImageLayout(cmdBuf, textures.irradianceCube.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
-
-		vulkanDevice->flushCommandBuffer(cmdBuf, queue);
-
-		vkDestroyRenderPass(device, renderpass, nullptr);
-		vkDestroyFramebuffer(device, offscreen.framebuffer, nullptr);
-		vkFreeMemory(device, offscreen.memory, nullptr);
-		vkDestroyImageView(device, offscreen.view, nullptr);
-		vkDestroyImage(device, offscreen.image, nullptr);
-		vkDestroyDescriptorPool(device, descriptorpool, nullptr);
-		vkDestroyDescriptorSetLayout(device, descriptorsetlayout, nullptr);
-		vkDestroyPipeline(device, pipeline, nullptr);
-		vkDestroyPipelineLayout(device, pipelinelayout, nullptr);
-
-		auto tEnd = std::chrono::high_resolution_clock::now();
-		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
-		std::cout << "Generating irradiance cube with " << numMips << " mip levels took " << tDiff << " ms" << std::endl;
-	}
-
 	void vksTools::generatePrefilteredCube(PBRTexture& pbrTexture)
 	{
 		auto device = pbrTexture.GetDevice();
@@ -761,11 +789,11 @@ namespace vks
 
 		auto tStart = std::chrono::high_resolution_clock::now();
 
-		constexpr VkFormat format = VK_FORMAT_R16G16B16A16_SFLOAT;
-		constexpr int32_t dim = 512;
-		const uint32_t numMips = static_cast<uint32_t>(floor(log2(dim))) + 1;
+		constexpr VkFormat format = PREFILTERED_FORMAT;
+		constexpr int32_t dim = PREFILTERED_DIM;
+		const uint32_t numMips = getMipCount(dim);
 
-		// Pre-filtered cube map
+		// Pre-filtered cube map，compute直接写入各mip，不再需要离屏framebuffer和逐面拷贝
 		// Image
 		VkImageCreateInfo imageCI = initializers::imageCreateInfo();
 		imageCI.imageType = VK_IMAGE_TYPE_2D;
@@ -777,16 +805,10 @@ namespace vks
 		imageCI.arrayLayers = 6;
 		imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageCI.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 		imageCI.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
 		VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &textures.prefilteredCube.image));
-		VkMemoryAllocateInfo memAlloc = initializers::memoryAllocateInfo();
-		VkMemoryRequirements memReqs;
-		vkGetImageMemoryRequirements(device, textures.prefilteredCube.image, &memReqs);
-		memAlloc.allocationSize = memReqs.size;
-		memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &textures.prefilteredCube.deviceMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(device, textures.prefilteredCube.image, textures.prefilteredCube.deviceMemory, 0));
+		textures.prefilteredCube.allocateImageMemory(vulkanDevice);
 
 		// Image view
 		VkImageViewCreateInfo viewCI = initializers::imageViewCreateInfo();
@@ -817,291 +839,183 @@ namespace vks
 		textures.prefilteredCube.descriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 		textures.prefilteredCube.device = vulkanDevice;
 
-		// FB, Att, RP, Pipe, etc.
-		VkAttachmentDescription attDesc = {};
-		// Color attachment
-		attDesc.format = format;
-		attDesc.samples = VK_SAMPLE_COUNT_1_BIT;
-		attDesc.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		attDesc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		attDesc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		attDesc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		attDesc.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attDesc.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-		VkAttachmentReference colorReference = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
-
-		VkSubpassDescription subpassDescription = {};
-		subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpassDescription.colorAttachmentCount = 1;
-		subpassDescription.pColorAttachments = &colorReference;
-
-		// Use subpass dependencies for layout transitions
-		std::array<VkSubpassDependency, 2> dependencies;
-		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependencies[0].dstSubpass = 0;
-		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-		dependencies[1].srcSubpass = 0;
-		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-		dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-		// Renderpass
-		VkRenderPassCreateInfo renderPassCI = initializers::renderPassCreateInfo();
-		renderPassCI.attachmentCount = 1;
-		renderPassCI.pAttachments = &attDesc;
-		renderPassCI.subpassCount = 1;
-		renderPassCI.pSubpasses = &subpassDescription;
-		renderPassCI.dependencyCount = 2;
-		renderPassCI.pDependencies = dependencies.data();
-		VkRenderPass renderpass;
-		VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassCI, nullptr, &renderpass));
-
-		struct
-		{
-			VkImage image;
-			VkImageView view;
-			VkDeviceMemory memory;
-			VkFramebuffer framebuffer;
-		} offscreen;
-
-		// Offfscreen framebuffer
+		// 每个mip一个2D array视图作为storage image
+		std::vector<VkImageView> mipViews(numMips);
+		for (uint32_t m = 0; m < numMips; m++)
 		{
-			// Color attachment
-			VkImageCreateInfo imageCreateInfo = initializers::imageCreateInfo();
-			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-			imageCreateInfo.format = format;
-			imageCreateInfo.extent.width = dim;
-			imageCreateInfo.extent.height = dim;
-			imageCreateInfo.extent.depth = 1;
-			imageCreateInfo.mipLevels = 1;
-			imageCreateInfo.arrayLayers = 1;
-			imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-			imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-			imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			imageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-			imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-			VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &offscreen.image));
-
-			VkMemoryAllocateInfo memAlloc = initializers::memoryAllocateInfo();
-			VkMemoryRequirements memReqs;
-			vkGetImageMemoryRequirements(device, offscreen.image, &memReqs);
-			memAlloc.allocationSize = memReqs.size;
-			memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(device, &memAlloc, nullptr, &offscreen.memory));
-			VK_CHECK_RESULT(vkBindImageMemory(device, offscreen.image, offscreen.memory, 0));
-
-			VkImageViewCreateInfo colorImageView = initializers::imageViewCreateInfo();
-			colorImageView.viewType = VK_IMAGE_VIEW_TYPE_2D;
-			colorImageView.format = format;
-			colorImageView.flags = 0;
-			colorImageView.subresourceRange = {};
-			colorImageView.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-			colorImageView.subresourceRange.baseMipLevel = 0;
-			colorImageView.subresourceRange.levelCount = 1;
-			colorImageView.subresourceRange.baseArrayLayer = 0;
-			colorImageView.subresourceRange.layerCount = 1;
-			colorImageView.image = offscreen.image;
-			VK_CHECK_RESULT(vkCreateImageView(device, &colorImageView, nullptr, &offscreen.view));
-
-			VkFramebufferCreateInfo fbufCreateInfo = initializers::framebufferCreateInfo();
-			fbufCreateInfo.renderPass = renderpass;
-			fbufCreateInfo.attachmentCount = 1;
-			fbufCreateInfo.pAttachments = &offscreen.view;
-			fbufCreateInfo.width = dim;
-			fbufCreateInfo.height = dim;
-			fbufCreateInfo.layers = 1;
-			VK_CHECK_RESULT(vkCreateFramebuffer(device, &fbufCreateInfo, nullptr, &offscreen.framebuffer));
-
-			VkCommandBuffer layoutCmd = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-			tools::setImageLayout(layoutCmd, offscreen.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-			vulkanDevice->flushCommandBuffer(layoutCmd, queue, true);
+			VkImageViewCreateInfo mipViewCI = initializers::imageViewCreateInfo();
+			mipViewCI.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+			mipViewCI.format = format;
+			mipViewCI.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, m, 1, 0, 6};
+			mipViewCI.image = textures.prefilteredCube.image;
+			VK_CHECK_RESULT(vkCreateImageView(device, &mipViewCI, nullptr, &mipViews[m]));
 		}
 
 		// Descriptors
 		VkDescriptorSetLayout descriptorsetlayout;
-		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 0),};
+		std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = {
+			initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0),
+			initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1),
+		};
 		VkDescriptorSetLayoutCreateInfo descriptorsetlayoutCI = initializers::descriptorSetLayoutCreateInfo(setLayoutBindings);
 		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorsetlayoutCI, nullptr, &descriptorsetlayout));
 
 		// Descriptor Pool
-		std::vector<VkDescriptorPoolSize> poolSizes = {initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1)};
-		VkDescriptorPoolCreateInfo descriptorPoolCI = initializers::descriptorPoolCreateInfo(poolSizes, 2);
+		std::vector<VkDescriptorPoolSize> poolSizes = {initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, numMips), initializers::descriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, numMips)};
+		VkDescriptorPoolCreateInfo descriptorPoolCI = initializers::descriptorPoolCreateInfo(poolSizes, numMips);
 		VkDescriptorPool descriptorpool;
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCI, nullptr, &descriptorpool));
 
 		// Descriptor sets
-		VkDescriptorSet descriptorset;
-		VkDescriptorSetAllocateInfo allocInfo = initializers::descriptorSetAllocateInfo(descriptorpool, &descriptorsetlayout, 1);
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorset));
-		VkWriteDescriptorSet writeDescriptorSet = initializers::writeDescriptorSet(descriptorset, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &textures.environmentCube.descriptor);
-		vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+		std::vector<VkDescriptorSet> descriptorsets(numMips);
+		std::vector<VkDescriptorSetLayout> setLayouts(numMips, descriptorsetlayout);
+		VkDescriptorSetAllocateInfo allocInfo = initializers::descriptorSetAllocateInfo(descriptorpool, setLayouts.data(), numMips);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, descriptorsets.data()));
+		for (uint32_t m = 0; m < numMips; m++)
+		{
+			VkDescriptorImageInfo outputImage = initializers::descriptorImageInfo(VK_NULL_HANDLE, mipViews[m], VK_IMAGE_LAYOUT_GENERAL);
+			std::array<VkWriteDescriptorSet, 2> writeDescriptorSets = {
+				initializers::writeDescriptorSet(descriptorsets[m], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &textures.environmentCube.descriptor),
+				initializers::writeDescriptorSet(descriptorsets[m], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &outputImage),
+			};
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		}
 
 		// Pipeline layout
 		struct PushBlock
 		{
-			glm::mat4 mvp;
 			float roughness;
-			uint32_t numSamples = 32u;
+			uint32_t numSamples = PREFILTERED_SAMPLES;
+			uint32_t mipSize;
 		} pushBlock;
 
 		VkPipelineLayout pipelinelayout;
-		std::vector<VkPushConstantRange> pushConstantRanges = {initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(PushBlock), 0),};
+		VkPushConstantRange pushConstantRange = initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushBlock), 0);
 		VkPipelineLayoutCreateInfo pipelineLayoutCI = initializers::pipelineLayoutCreateInfo(&descriptorsetlayout, 1);
 		pipelineLayoutCI.pushConstantRangeCount = 1;
-		pipelineLayoutCI.pPushConstantRanges = pushConstantRanges.data();
+		pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
 		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelinelayout));
 
 		// Pipeline
-		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = initializers::pipelineInputAssemblyStateCreateInfo(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
-		VkPipelineRasterizationStateCreateInfo rasterizationState = initializers::pipelineRasterizationStateCreateInfo(VK_POLYGON_MODE_FILL, VK_CULL_MODE_NONE, VK_FRONT_FACE_COUNTER_CLOCKWISE);
-		VkPipelineColorBlendAttachmentState blendAttachmentState = initializers::pipelineColorBlendAttachmentState(0xf, VK_FALSE);
-		VkPipelineColorBlendStateCreateInfo colorBlendState = initializers::pipelineColorBlendStateCreateInfo(1, &blendAttachmentState);
-		VkPipelineDepthStencilStateCreateInfo depthStencilState = initializers::pipelineDepthStencilStateCreateInfo(VK_FALSE, VK_FALSE, VK_COMPARE_OP_LESS_OR_EQUAL);
-		VkPipelineViewportStateCreateInfo viewportState = initializers::pipelineViewportStateCreateInfo(1, 1);
-		VkPipelineMultisampleStateCreateInfo multisampleState = initializers::pipelineMultisampleStateCreateInfo(VK_SAMPLE_COUNT_1_BIT);
-		std::vector<VkDynamicState> dynamicStateEnables = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
-		VkPipelineDynamicStateCreateInfo dynamicState = initializers::pipelineDynamicStateCreateInfo(dynamicStateEnables);
-		std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages;
-
-		VkGraphicsPipelineCreateInfo pipelineCI = initializers::pipelineCreateInfo(pipelinelayout, renderpass);
-		pipelineCI.pInputAssemblyState = &inputAssemblyState;
-		pipelineCI.pRasterizationState = &rasterizationState;
-		pipelineCI.pColorBlendState = &colorBlendState;
-		pipelineCI.pMultisampleState = &multisampleState;
-		pipelineCI.pViewportState = &viewportState;
-		pipelineCI.pDepthStencilState = &depthStencilState;
-		pipelineCI.pDynamicState = &dynamicState;
-		pipelineCI.stageCount = 2;
-		pipelineCI.pStages = shaderStages.data();
-		pipelineCI.renderPass = renderpass;
-		pipelineCI.pVertexInputState = vkglTF::Vertex::getPipelineVertexInputState({vkglTF::VertexComponent::Position, vkglTF::VertexComponent::Normal, vkglTF::VertexComponent::UV});
-
-		shaderStages[0] = pbrTexture.loadShader(pbrTexture.getShadersPath() + "pbrtexture/filtercube.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-		shaderStages[1] = pbrTexture.loadShader(pbrTexture.getShadersPath() + "pbrtexture/prefilterenvmap.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		VkComputePipelineCreateInfo pipelineCI = initializers::computePipelineCreateInfo(pipelinelayout, 0);
+		pipelineCI.stage = pbrTexture.loadShader(pbrTexture.getShadersPath() + "pbrtexture/prefilterenvmap.comp.spv", VK_SHADER_STAGE_COMPUTE_BIT);
 		VkPipeline pipeline;
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, pbrTexture.GetPipelineCache(), 1, &pipelineCI, nullptr, &pipeline));
-
-		// Render
-
-		VkClearValue clearValues[1];
-		clearValues[0].color = {{0.0f, 0.0f, 0.2f, 0.0f}};
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, pbrTexture.GetPipelineCache(), 1, &pipelineCI, nullptr, &pipeline));
 
-		VkRenderPassBeginInfo renderPassBeginInfo = initializers::renderPassBeginInfo();
-		// Reuse render pass from example pass
-		renderPassBeginInfo.renderPass = renderpass;
-		renderPassBeginInfo.framebuffer = offscreen.framebuffer;
-		renderPassBeginInfo.renderArea.extent.width = dim;
-		renderPassBeginInfo.renderArea.extent.height = dim;
-		renderPassBeginInfo.clearValueCount = 1;
-		renderPassBeginInfo.pClearValues = clearValues;
-
-		std::vector<glm::mat4> matrices = {
-			// POSITIVE_X
-			glm::rotate(glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)), glm::radians(180.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
-			// NEGATIVE_X
-			glm::rotate(glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f)), glm::radians(180.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
-			// POSITIVE_Y
-			glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
-			// NEGATIVE_Y
-			glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
-			// POSITIVE_Z
-			glm::rotate(glm::mat4(1.0f), glm::radians(180.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
-			// NEGATIVE_Z
-			glm::rotate(glm::mat4(1.0f), glm::radians(180.0f), glm::vec3(0.0f, 0.0f, 1.0f)),
-		};
+		VkImageSubresourceRange subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, numMips, 0, 6};
+		VkImageMemoryBarrier imageBarrier = initializers::imageMemoryBarrier();
+		imageBarrier.image = textures.prefilteredCube.image;
+		imageBarrier.subresourceRange = subresourceRange;
+		imageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageBarrier.srcAccessMask = 0;
+		imageBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
 
 		VkCommandBuffer cmdBuf = vulkanDevice->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-		VkViewport viewport = initializers::viewport(static_cast<float>(dim), static_cast<float>(dim), 0.0f, 1.0f);
-		VkRect2D scissor = initializers::rect2D(dim, dim, 0, 0);
-
-		vkCmdSetViewport(cmdBuf, 0, 1, &viewport);
-		vkCmdSetScissor(cmdBuf, 0, 1, &scissor);
-
-		VkImageSubresourceRange subresourceRange = {};
-		subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		subresourceRange.baseMipLevel = 0;
-		subresourceRange.levelCount = numMips;
-		subresourceRange.layerCount = 6;
-
-		// Change image layout for all cubemap faces to transfer destination
-		tools::setImageLayout(cmdBuf, textures.prefilteredCube.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
-
+		vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+		vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		// 各mip只读环境图、写各自的子资源，dispatch之间没有依赖
 		for (uint32_t m = 0; m < numMips; m++)
 		{
 			pushBlock.roughness = static_cast<float>(m) / static_cast<float>(numMips - 1);
-			for (uint32_t f = 0; f < 6; f++)
-			{
-				viewport.width = static_cast<float>(dim * std::pow(0.5f, m));
-				viewport.height = static_cast<float>(dim * std::pow(0.5f, m));
-				vkCmdSetViewport(cmdBuf, 0, 1, &viewport);
-
-				// Render scene from cube face's point of view
-				vkCmdBeginRenderPass(cmdBuf, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-				// Update shader push constant block
-				pushBlock.mvp = glm::perspective(static_cast<float>((M_PI / 2.0)), 1.0f, 0.1f, 512.0f) * matrices[f];
-
-				vkCmdPushConstants(cmdBuf, pipelinelayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushBlock), &pushBlock);
-
-				vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-				vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelinelayout, 0, 1, &descriptorset, 0, nullptr);
-
-				pbrTexture.models.skybox.draw(cmdBuf);
-
-				vkCmdEndRenderPass(cmdBuf);
-
-				tools::setImageLayout(cmdBuf, offscreen.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-
-				// Copy region for transfer from framebuffer to cube face
-				VkImageCopy copyRegion = {};
-
-				copyRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				copyRegion.srcSubresource.baseArrayLayer = 0;
-				copyRegion.srcSubresource.mipLevel = 0;
-				copyRegion.srcSubresource.layerCount = 1;
-				copyRegion.srcOffset = {0, 0, 0};
-
-				copyRegion.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				copyRegion.dstSubresource.baseArrayLayer = f;
-				copyRegion.dstSubresource.mipLevel = m;
-				copyRegion.dstSubresource.layerCount = 1;
-				copyRegion.dstOffset = {0, 0, 0};
+			pushBlock.mipSize = std::max(1u, static_cast<uint32_t>(dim) >> m);
+			const uint32_t groupCount = (pushBlock.mipSize + 7) / 8;
+			vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, pipelinelayout, 0, 1, &descriptorsets[m], 0, nullptr);
+			vkCmdPushConstants(cmdBuf, pipelinelayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushBlock), &pushBlock);
+			vkCmdDispatch(cmdBuf, groupCount, groupCount, 6);
+		}
+		imageBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		imageBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+		vulkanDevice->flushCommandBuffer(cmdBuf, queue);
 
-				copyRegion.extent.width = static_cast<uint32_t>(viewport.width);
-				copyRegion.extent.height = static_cast<uint32_t>(viewport.height);
-				copyRegion.extent.depth = 1;
+		vkDestroyPipeline(device, pipeline, nullptr);
+		vkDestroyPipelineLayout(device, pipelinelayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, descriptorsetlayout, nullptr);
+		vkDestroyDescriptorPool(device, descriptorpool, nullptr);
+		for (VkImageView mipView : mipViews)
+		{
+			vkDestroyImageView(device, mipView, nullptr);
+		}
 
-				vkCmdCopyImage(cmdBuf, offscreen.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, textures.prefilteredCube.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+		auto tEnd = std::chrono::high_resolution_clock::now();
+		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+		std::cout << "Generating pre-filtered enivornment cube with " << numMips << " mip levels took " << tDiff << " ms" << std::endl;
+	}
 
-				// Transform framebuffer color attachment back
-				tools::setImageLayout(cmdBuf, offscreen.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-			}
+	void vksTools::prepareIBL(PBRTexture& pbrTexture, const std::string& environmentFile)
+	{
+		auto& textures = pbrTexture.textures;
+		const std::string shadersPath = pbrTexture.getShadersPath() + "pbrtexture/";
+
+		CacheKey lutKey;
+		CacheKey prefilteredKey;
+#if defined(__ANDROID__)
+		// apk里的资源只读，安卓上每次都重新生成
+		const bool cacheable = false;
+#else
+		// key包含生成参数和SPIR-V，改了着色器或参数都会重新生成；BRDF LUT和环境图无关
+		lutKey.addValue(IBL_CACHE_VERSION);
+		lutKey.addValue(BRDF_LUT_FORMAT);
+		lutKey.addValue(BRDF_LUT_DIM);
+		bool cacheable = lutKey.addFile(shadersPath + "genbrdflut.vert.spv") && lutKey.addFile(shadersPath + "genbrdflut.frag.spv");
+
+		CacheKey environmentKey;
+		environmentKey.addValue(IBL_CACHE_VERSION);
+		cacheable = cacheable && environmentKey.addFile(environmentFile);
+
+		prefilteredKey = environmentKey;
+		prefilteredKey.addValue(PREFILTERED_FORMAT);
+		prefilteredKey.addValue(PREFILTERED_DIM);
+		prefilteredKey.addValue(PREFILTERED_SAMPLES);
+		cacheable = cacheable && prefilteredKey.addFile(shadersPath + "prefilterenvmap.comp.spv");
+#endif
+
+		if (loadOrGenerateIBL(pbrTexture, textures.lutBrdf, "brdflut_", cacheable ? &lutKey : nullptr, BRDF_LUT_FORMAT, BRDF_LUT_DIM, 1, 1, generateBRDFLUT))
+		{
+			// 2D贴图加载用的是REPEAT，LUT要和生成时一样clamp到边缘
+			auto device = pbrTexture.GetDevice();
+			vkDestroySampler(device, textures.lutBrdf.sampler, nullptr);
+			VkSamplerCreateInfo samplerCI = initializers::samplerCreateInfo();
+			samplerCI.magFilter = VK_FILTER_LINEAR;
+			samplerCI.minFilter = VK_FILTER_LINEAR;
+			samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+			samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+			samplerCI.minLod = 0.0f;
+			samplerCI.maxLod = 1.0f;
+			samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+			VK_CHECK_RESULT(vkCreateSampler(device, &samplerCI, nullptr, &textures.lutBrdf.sampler));
+			textures.lutBrdf.updateDescriptor();
 		}
+		loadOrGenerateIBL(pbrTexture, textures.prefilteredCube, "prefiltered_", cacheable ? &prefilteredKey : nullptr, PREFILTERED_FORMAT, PREFILTERED_DIM, getMipCount(PREFILTERED_DIM), 6, generatePrefilteredCube);
 
-		tools::setImageLayout(cmdBuf, textures.prefilteredCube.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
+		generateIrradianceSH(pbrTexture, environmentFile);
+	}
 
-		vulkanDevice->flushCommandBuffer(cmdBuf, queue);
+	void vksTools::generateIrradianceSH(PBRTexture& pbrTexture, const std::string& environmentFile)
+	{
+#if !defined(NDEBUG)
+		SphericalHarmonics9::runSelfTest();
+#endif
+		auto tStart = std::chrono::high_resolution_clock::now();
 
-		vkDestroyRenderPass(device, renderpass, nullptr);
-		vkDestroyFramebuffer(device, offscreen.framebuffer, nullptr);
-		vkFreeMemory(device, offscreen.memory, nullptr);
-		vkDestroyImageView(device, offscreen.view, nullptr);
-		vkDestroyImage(device, offscreen.image, nullptr);
-		vkDestroyDescriptorPool(device, descriptorpool, nullptr);
-		vkDestroyDescriptorSetLayout(device, descriptorsetlayout, nullptr);
-		vkDestroyPipeline(device, pipeline, nullptr);
-		vkDestroyPipelineLayout(device, pipelinelayout, nullptr);
+		SphericalHarmonics9 radiance;
+		if (!projectEnvironmentSH(environmentFile, radiance))
+		{
+			std::cerr << "Could not project " << environmentFile << " to spherical harmonics, diffuse IBL is disabled" << std::endl;
+		}
+		const SphericalHarmonics9 irradiance = radiance.convolveLambert();
+		for (uint32_t i = 0; i < SphericalHarmonics9::COEFFICIENT_COUNT; i++)
+		{
+			pbrTexture.uniformDataParams.shIrradiance[i] = glm::vec4(irradiance.coefficients[i], 0.0f);
+		}
 
 		auto tEnd = std::chrono::high_resolution_clock::now();
 		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
-		std::cout << "Generating pre-filtered enivornment cube with " << numMips << " mip levels took " << tDiff << " ms" << std::endl;
+		std::cout << "Projecting irradiance SH took " << tDiff << " ms" << std::endl;
 	}
 }
@@ -1,5 +1,6 @@
 ﻿#pragma once
 #include "NaniteMesh/NaniteMesh.h"
+#include "VulkanUploadManager.h"
 
 
 class PBRTexture;
@@ -10,18 +11,23 @@ namespace vks
 	class vksTools
 	{
 	public:
-		void static createStagingBuffer(VulkanExampleBase& variableLink, VkBufferUsageFlags sorceMemoryProperty, VkDeviceSize srcBufferSize, void* srcBufferData, VkBufferUsageFlags targetMemoryProperty, vkglTF::Model::Vertices& targetStaingBuffer, bool cmdRestart = true);
+		// 拷贝进uploadManager的批次，返回的ticket完成前目标buffer不能被读；cmdRestart只为兼容旧调用保留
+		UploadTicket static createStagingBuffer(VulkanExampleBase& variableLink, VkBufferUsageFlags sorceMemoryProperty, VkDeviceSize srcBufferSize, void* srcBufferData, VkBufferUsageFlags targetMemoryProperty, vkglTF::Model::Vertices& targetStaingBuffer, bool cmdRestart = true);
 
-		void static createStagingBuffer(VulkanExampleBase& variableLink, VkBufferUsageFlags sorceMemoryProperty, VkDeviceSize srcBufferSize, void* srcBufferData, VkBufferUsageFlags targetMemoryProperty, vkglTF::Model::Indices& targetStaingBuffer, bool cmdRestart = true);
+		UploadTicket static createStagingBuffer(VulkanExampleBase& variableLink, VkBufferUsageFlags sorceMemoryProperty, VkDeviceSize srcBufferSize, void* srcBufferData, VkBufferUsageFlags targetMemoryProperty, vkglTF::Model::Indices& targetStaingBuffer, bool cmdRestart = true);
 
-		void static createStagingBuffer(VulkanExampleBase& variableLink, VkBufferUsageFlags sorceMemoryProperty, VkDeviceSize srcBufferSize, void* srcBufferData, VkBufferUsageFlags targetMemoryProperty, Buffer& targetStaingBuffer, bool cmdRestart = true);
+		UploadTicket static createStagingBuffer(VulkanExampleBase& variableLink, VkBufferUsageFlags sorceMemoryProperty, VkDeviceSize srcBufferSize, void* srcBufferData, VkBufferUsageFlags targetMemoryProperty, Buffer& targetStaingBuffer, bool cmdRestart = true);
 
 		void static setPbrDescriptor(PBRTexture& pbrTexture);
 
 		VkImageSubresourceRange static genDepthSubresourceRange();
 
 		void static generateBRDFLUT(PBRTexture& pbrTexture);
-		void static generateIrradianceCube(PBRTexture& pbrTexture);
+		// compute一条dispatch链写完所有mip和面
 		void static generatePrefilteredCube(PBRTexture& pbrTexture);
+		// 漫反射irradiance在CPU上投影成9个SH系数，写进uniformDataParams
+		void static generateIrradianceSH(PBRTexture& pbrTexture, const std::string& environmentFile);
+		// BRDF LUT和prefiltered cube按环境图内容、生成参数和SPIR-V算key缓存成KTX，命中时走普通贴图加载，key变了才重新生成
+		void static prepareIBL(PBRTexture& pbrTexture, const std::string& environmentFile);
 	};
 }